@@ -0,0 +1,447 @@
+//Copyright 2016 Microchip Technology Inc. (www.microchip.com)
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "mcc_generated_files/usb/usb_device.h"
+#include "mcc_generated_files/usb/usb_device_cdc.h"
+#include "cdc_mux.h"
+#include "console.h"
+#include "dma_copy.h"
+
+//Per channel FIFOs, powers of two: the head and tail indices are free
+//running and reduced to a buffer offset with a mask, as in console.c.
+#define TX_FIFO_SIZE        128u
+#define RX_FIFO_SIZE        128u
+
+//Data bytes a channel may put in a packet before the next channel's turn.
+#define QUANTUM             16u
+
+//Received space is granted back once this much has been read, so that
+//credit frames do not eat into every packet.
+#define CREDIT_THRESHOLD    (RX_FIFO_SIZE / 4u)
+
+#define CREDIT_FRAME_SIZE   (CDC_MUX_FRAME_HEADER_SIZE + 2u)
+#define MAX_PACKET          CDC_DATA_IN_EP_SIZE
+#define MAX_PAYLOAD         (MAX_PACKET - CDC_MUX_FRAME_HEADER_SIZE)
+
+#define IS_POWER_OF_TWO(x) (((x) & ((x) - 1u)) == 0u)
+
+#if !IS_POWER_OF_TWO(TX_FIFO_SIZE) || !IS_POWER_OF_TWO(RX_FIFO_SIZE)
+#error "CDC mux FIFO sizes must be powers of two"
+#endif
+
+#if (CDC_MUX_CHANNEL_COUNT == 0u) || (CDC_MUX_CHANNEL_COUNT > 0x7Fu)
+#error "CDC_MUX_CHANNEL_COUNT must be 1 to 127"
+#endif
+
+typedef enum
+{
+    PARSE_ID,
+    PARSE_LENGTH,
+    PARSE_PAYLOAD
+} PARSE_STATE;
+
+typedef struct
+{
+    uint16_t txHead;
+    uint16_t txTail;
+    uint16_t txCredit;          //bytes the host still accepts
+    uint16_t rxHead;
+    uint16_t rxTail;
+    uint16_t rxUngranted;       //read (or never granted) space not yet returned as credit
+} CHANNEL;
+
+static uint8_t txFIFO[CDC_MUX_CHANNEL_COUNT][TX_FIFO_SIZE];
+static uint8_t rxFIFO[CDC_MUX_CHANNEL_COUNT][RX_FIFO_SIZE];
+static CHANNEL channels[CDC_MUX_CHANNEL_COUNT];
+
+//Channel that goes first in the next packet.
+static uint8_t nextChannel = 0;
+static bool resetPending = false;
+
+//The host has reset the link since CDC_MUX_Initialize(); nothing is sent
+//before that.
+static bool linked = false;
+
+//What CDC_MUX_Tasks() saw last, to notice the host going away.
+static bool configured = false;
+static bool dtePresent = false;
+
+//Must stay untouched until the CDC driver has sent it.
+static uint8_t txPacket[MAX_PACKET];
+static uint8_t rxPacket[CDC_DATA_OUT_EP_SIZE];
+
+static PARSE_STATE parseState = PARSE_ID;
+static uint8_t parseID;
+static uint8_t parseRemaining;
+static uint8_t parseCredit[2];
+static uint8_t parseCreditLength;
+
+static void Reset(void);
+static void Receive(const uint8_t* data, uint8_t length);
+static void FrameComplete(void);
+static uint8_t PackControl(uint8_t* packet, uint8_t room);
+static uint8_t PackData(uint8_t* packet, uint8_t room);
+static void CopyIn(uint8_t* fifo, uint16_t mask, uint16_t index, const uint8_t* data, uint16_t length);
+static void CopyOut(uint8_t* data, const uint8_t* fifo, uint16_t mask, uint16_t index, uint16_t length);
+
+void CDC_MUX_Initialize(void)
+{
+    Reset();
+    resetPending = false;
+    linked = false;
+    configured = false;
+    dtePresent = false;
+    parseState = PARSE_ID;
+}
+
+uint16_t CDC_MUX_Write(uint8_t channel, const uint8_t* data, uint16_t length)
+{
+    CHANNEL* c = &channels[channel];
+    uint16_t space = CDC_MUX_GetWriteSpace(channel);
+    
+    if(length > space)
+    {
+        length = space;
+    }
+    
+    CopyIn(txFIFO[channel], TX_FIFO_SIZE - 1u, c->txTail, data, length);
+    c->txTail += length;
+    
+    return length;
+}
+
+uint16_t CDC_MUX_GetWriteSpace(uint8_t channel)
+{
+    CHANNEL* c = &channels[channel];
+    
+    return TX_FIFO_SIZE - (uint16_t)(c->txTail - c->txHead);
+}
+
+uint16_t CDC_MUX_Read(uint8_t channel, uint8_t* data, uint16_t length)
+{
+    CHANNEL* c = &channels[channel];
+    uint16_t count = c->rxTail - c->rxHead;
+    
+    if(length > count)
+    {
+        length = count;
+    }
+    
+    CopyOut(data, rxFIFO[channel], RX_FIFO_SIZE - 1u, c->rxHead, length);
+    c->rxHead += length;
+    c->rxUngranted += length;
+    
+    return length;
+}
+
+void CDC_MUX_Tasks(void)
+{
+    uint8_t length;
+    bool dte;
+    
+    //With a single CDC function the console has it.
+    if(CDC_MUX_CDC_INSTANCE == CONSOLE_CDC_INSTANCE)
+    {
+        return;
+    }
+    
+    /*
+     * A detach, a new enumeration or the host closing the port (which drops
+     * DTR) ends the link.  Whatever the last host left, a half parsed frame
+     * included, must not be taken for the start of the next host's stream,
+     * so the mux starts over and waits for the next reset.
+     */
+    if(USBGetDeviceState() != CONFIGURED_STATE)
+    {
+        if(configured == true)
+        {
+            CDC_MUX_Initialize();
+        }
+        
+        return;
+    }
+    
+    configured = true;
+    dte = (cdc_instance[CDC_MUX_CDC_INSTANCE].control_signal_bitmap.DTE_PRESENT == 1u);
+    
+    if((dtePresent == true) && (dte == false))
+    {
+        CDC_MUX_Initialize();
+        configured = true;
+    }
+    
+    dtePresent = dte;
+    
+    if(USBIsDeviceSuspended() == true)
+    {
+        return;
+    }
+    
+    /*
+     * Every packet is read, whatever the channels hold: a host that keeps
+     * to its credit never sends more than fits, so one full channel does
+     * not stall the pipe for the others.
+     */
+    length = getsUSBUSART(CDC_MUX_CDC_INSTANCE, rxPacket, sizeof(rxPacket));
+    Receive(rxPacket, length);
+    
+    if((linked == true) && (USBUSARTIsTxTrfReady(CDC_MUX_CDC_INSTANCE) == true))
+    {
+        length = PackControl(txPacket, MAX_PACKET);
+        length += PackData(&txPacket[length], MAX_PACKET - length);
+        
+        if(length != 0u)
+        {
+            putUSBUSART(CDC_MUX_CDC_INSTANCE, txPacket, length);
+        }
+    }
+    
+    CDCTxService(CDC_MUX_CDC_INSTANCE);
+}
+
+//The host's credit is gone and everything queued is dropped; the whole of
+//each receive FIFO is granted to the host again.
+static void Reset(void)
+{
+    uint8_t i;
+    
+    for(i = 0; i < CDC_MUX_CHANNEL_COUNT; i++)
+    {
+        channels[i].txHead = 0;
+        channels[i].txTail = 0;
+        channels[i].txCredit = 0;
+        channels[i].rxHead = 0;
+        channels[i].rxTail = 0;
+        channels[i].rxUngranted = RX_FIFO_SIZE;
+    }
+    
+    nextChannel = 0;
+}
+
+static void Receive(const uint8_t* data, uint8_t length)
+{
+    CHANNEL* c;
+    uint8_t count;
+    uint8_t i;
+    uint16_t space;
+    
+    while(length != 0u)
+    {
+        switch(parseState)
+        {
+            case PARSE_ID:
+                parseID = *data++;
+                length--;
+                parseState = PARSE_LENGTH;
+                break;
+            
+            case PARSE_LENGTH:
+                parseRemaining = *data++;
+                length--;
+                parseCreditLength = 0;
+                parseState = PARSE_PAYLOAD;
+                
+                if(parseRemaining == 0u)
+                {
+                    FrameComplete();
+                }
+                break;
+            
+            case PARSE_PAYLOAD:
+                count = (length < parseRemaining) ? length : parseRemaining;
+                
+                if(parseID < CDC_MUX_CHANNEL_COUNT)
+                {
+                    /*
+                     * Data beyond the credit granted is dropped.
+                     */
+                    c = &channels[parseID];
+                    space = RX_FIFO_SIZE - (uint16_t)(c->rxTail - c->rxHead);
+                    
+                    if(space > count)
+                    {
+                        space = count;
+                    }
+                    
+                    CopyIn(rxFIFO[parseID], RX_FIFO_SIZE - 1u, c->rxTail, data, space);
+                    c->rxTail += space;
+                }
+                else
+                {
+                    for(i = 0; (i < count) && (parseCreditLength < sizeof(parseCredit)); i++)
+                    {
+                        parseCredit[parseCreditLength++] = data[i];
+                    }
+                }
+                
+                data += count;
+                length -= count;
+                parseRemaining -= count;
+                
+                if(parseRemaining == 0u)
+                {
+                    FrameComplete();
+                }
+                break;
+            
+            default:
+                parseState = PARSE_ID;
+                break;
+        }
+    }
+}
+
+static void FrameComplete(void)
+{
+    uint8_t channel = parseID & (uint8_t)~CDC_MUX_CREDIT_FRAME;
+    
+    parseState = PARSE_ID;
+    
+    if(parseID == CDC_MUX_RESET_FRAME)
+    {
+        Reset();
+        resetPending = true;
+        linked = true;
+    }
+    else if(((parseID & CDC_MUX_CREDIT_FRAME) != 0u) && (channel < CDC_MUX_CHANNEL_COUNT) && (parseCreditLength == sizeof(parseCredit)))
+    {
+        channels[channel].txCredit += (uint16_t)parseCredit[0] | ((uint16_t)parseCredit[1] << 8);
+    }
+}
+
+//The reset answer, then the credit of every channel that has read enough
+//(or everything it has read, once its FIFO is empty).
+static uint8_t PackControl(uint8_t* packet, uint8_t room)
+{
+    uint8_t length = 0;
+    uint8_t i;
+    CHANNEL* c;
+    
+    if(resetPending == true)
+    {
+        packet[length++] = CDC_MUX_RESET_FRAME;
+        packet[length++] = 0;
+        resetPending = false;
+    }
+    
+    for(i = 0; i < CDC_MUX_CHANNEL_COUNT; i++)
+    {
+        c = &channels[i];
+        
+        if((c->rxUngranted == 0u) || ((uint8_t)(room - length) < CREDIT_FRAME_SIZE))
+        {
+            continue;
+        }
+        
+        if((c->rxUngranted >= CREDIT_THRESHOLD) || (c->rxTail == c->rxHead))
+        {
+            packet[length++] = CDC_MUX_CREDIT_FRAME | i;
+            packet[length++] = 2;
+            packet[length++] = (uint8_t)c->rxUngranted;
+            packet[length++] = (uint8_t)(c->rxUngranted >> 8);
+            c->rxUngranted = 0;
+        }
+    }
+    
+    return length;
+}
+
+//Round robin over the channels that have data and credit, at most QUANTUM
+//bytes per turn, starting after the channel that went last in the
+//previous packet, until the packet is full.
+static uint8_t PackData(uint8_t* packet, uint8_t room)
+{
+    uint8_t length = 0;
+    uint8_t turn;
+    uint8_t channel = nextChannel;
+    uint8_t idle = 0;
+    uint16_t count;
+    CHANNEL* c;
+    
+    while((idle < CDC_MUX_CHANNEL_COUNT) && ((uint8_t)(room - length) > CDC_MUX_FRAME_HEADER_SIZE))
+    {
+        c = &channels[channel];
+        count = c->txTail - c->txHead;
+        
+        if(count > c->txCredit)
+        {
+            count = c->txCredit;
+        }
+        
+        turn = (uint8_t)(room - length - CDC_MUX_FRAME_HEADER_SIZE);
+        
+        if(turn > QUANTUM)
+        {
+            turn = QUANTUM;
+        }
+        
+        if(count > turn)
+        {
+            count = turn;
+        }
+        
+        if(count == 0u)
+        {
+            idle++;
+        }
+        else
+        {
+            packet[length++] = CDC_MUX_DATA_FRAME | channel;
+            packet[length++] = (uint8_t)count;
+            CopyOut(&packet[length], txFIFO[channel], TX_FIFO_SIZE - 1u, c->txHead, count);
+            length += (uint8_t)count;
+            c->txHead += count;
+            c->txCredit -= count;
+            idle = 0;
+            nextChannel = (uint8_t)((channel + 1u) % CDC_MUX_CHANNEL_COUNT);
+        }
+        
+        channel = (uint8_t)((channel + 1u) % CDC_MUX_CHANNEL_COUNT);
+    }
+    
+    return length;
+}
+
+//At most two spans: up to the end of the FIFO, then from its start.
+static void CopyIn(uint8_t* fifo, uint16_t mask, uint16_t index, const uint8_t* data, uint16_t length)
+{
+    uint16_t offset = index & mask;
+    uint16_t span = (mask + 1u) - offset;
+    
+    if(span > length)
+    {
+        span = length;
+    }
+    
+    DMA_COPY_Copy(&fifo[offset], data, span);
+    DMA_COPY_Copy(fifo, &data[span], length - span);
+}
+
+static void CopyOut(uint8_t* data, const uint8_t* fifo, uint16_t mask, uint16_t index, uint16_t length)
+{
+    uint16_t offset = index & mask;
+    uint16_t span = (mask + 1u) - offset;
+    
+    if(span > length)
+    {
+        span = length;
+    }
+    
+    DMA_COPY_Copy(data, &fifo[offset], span);
+    DMA_COPY_Copy(&data[span], fifo, length - span);
+}
@@ -0,0 +1,125 @@
+//Copyright 2016 Microchip Technology Inc. (www.microchip.com)
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+#ifndef CDC_MUX_H
+#define CDC_MUX_H
+
+#include <stdint.h>
+
+//Logical channels carried over the data CDC function (instance 0, the
+//first COM port).  Each direction of the byte stream is a sequence of
+//frames, [id][length][length bytes]:
+//
+//  id 0x00 + channel   data for the channel, length 1 to 62
+//  id 0x80 + channel   credit: LE16 count of further data bytes the sender
+//                      of this frame accepts on the channel
+//  id 0xFF             reset, length 0
+//
+//Data is only sent against credit, so a channel whose reader is slow stops
+//on its own without holding up the others.  The host starts with a reset
+//and its credits; the board answers with a reset, then its own credits, and
+//sends nothing before that.  Leaving the configured state, or the host
+//dropping DTR as it closes the port, ends the link: the board forgets what
+//it held, a partly received frame included, and waits for the next reset.
+//tools/cdc_mux.py is the host side.
+#define CDC_MUX_CDC_INSTANCE    0u
+#define CDC_MUX_CHANNEL_COUNT   4u
+
+#define CDC_MUX_FRAME_HEADER_SIZE   2u
+#define CDC_MUX_DATA_FRAME          0x00u
+#define CDC_MUX_CREDIT_FRAME        0x80u
+#define CDC_MUX_RESET_FRAME         0xFFu
+
+/*********************************************************************
+* Function: void CDC_MUX_Initialize(void);
+*
+* Overview: Empties every channel.  Nothing is sent until the host resets
+*           the link.
+*
+* PreCondition: None
+*
+* Input: None
+*
+* Output: None
+*
+********************************************************************/
+void CDC_MUX_Initialize(void);
+
+/*********************************************************************
+* Function: uint16_t CDC_MUX_Write(uint8_t channel, const uint8_t* data, uint16_t length);
+*
+* Overview: Queues data on a channel.  CDC_MUX_Tasks() sends it as the
+*           host grants credit.
+*
+* PreCondition: None
+*
+* Input: channel - 0 to CDC_MUX_CHANNEL_COUNT - 1
+*        data - the bytes to send
+*        length - the number of bytes
+*
+* Output: The number of bytes queued, less than length when the channel's
+*         transmit FIFO is full.
+*
+********************************************************************/
+uint16_t CDC_MUX_Write(uint8_t channel, const uint8_t* data, uint16_t length);
+
+/*********************************************************************
+* Function: uint16_t CDC_MUX_GetWriteSpace(uint8_t channel);
+*
+* Overview: Returns how many bytes CDC_MUX_Write() would queue now.
+*
+* PreCondition: None
+*
+* Input: channel - 0 to CDC_MUX_CHANNEL_COUNT - 1
+*
+* Output: Free bytes in the channel's transmit FIFO.
+*
+********************************************************************/
+uint16_t CDC_MUX_GetWriteSpace(uint8_t channel);
+
+/*********************************************************************
+* Function: uint16_t CDC_MUX_Read(uint8_t channel, uint8_t* data, uint16_t length);
+*
+* Overview: Takes received data from a channel.  The space it frees is
+*           granted back to the host as credit.
+*
+* PreCondition: None
+*
+* Input: channel - 0 to CDC_MUX_CHANNEL_COUNT - 1
+*        data - where to copy the bytes
+*        length - the most bytes to copy
+*
+* Output: The number of bytes copied, 0 when the channel has none.
+*
+********************************************************************/
+uint16_t CDC_MUX_Read(uint8_t channel, uint8_t* data, uint16_t length);
+
+/*********************************************************************
+* Function: void CDC_MUX_Tasks(void);
+*
+* Overview: Reads at most one CDC packet and sorts its frames into the
+*           channels, then, once the previous one has gone, packs the next
+*           CDC packet: the reset answer and credits first, then data, a
+*           quantum per channel in turn.  Call from the main loop.
+*
+* PreCondition: CDC_MUX_Initialize() has been called.
+*
+* Input: None
+*
+* Output: None
+*
+********************************************************************/
+void CDC_MUX_Tasks(void);
+
+#endif //CDC_MUX_H
@@ -12,116 +12,1889 @@
 //See the License for the specific language governing permissions and
 //limitations under the License.
 
+
+#include <xc.h>
+
 #include "mcc_generated_files/usb/usb_device_cdc.h"
+#include "console.h"
+#include "console_lzss.h"
+#include "console_trace.h"
+#include "console_uart.h"
+#include "dma_copy.h"
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stdarg.h>
+#include <string.h>
+
+//Each lane is a byte FIFO plus a queue of segments.  All sizes must be
+//powers of two: the head and tail indices are free running and are reduced
+//to a buffer offset with a mask, so there is no compare-and-wrap per byte
+//and the full buffer can be used.
+#define FAULT_FIFO_SIZE     256u
+#define FAULT_SEGMENT_COUNT 16u
+#define WARN_FIFO_SIZE      256u
+#define WARN_SEGMENT_COUNT  16u
+#define INFO_FIFO_SIZE      1024u
+#define INFO_SEGMENT_COUNT  64u
+
+//The shell's stats command queues its whole report on the info lane in one
+//main loop pass, before CONSOLE_Tasks() sends any of it: with every build
+//option on, up to 37 segments and 348 bytes in text mode.  32 segments
+//truncated it, hence 64; console_test checks that the report fits.
+
+#define MAX_PACKET CDC_DATA_IN_EP_SIZE
+
+#if defined(CONSOLE_UART)
+#define UART_WRITE      (&CONSOLE_UART_Write)
+#define UART_ENABLED    true
+#else
+#define UART_WRITE      NULL
+#define UART_ENABLED    false
+#endif
+
+//Record mode frame, before COBS encoding: sequence (LE16), 1ms tick (LE32),
+//lane, then the message.  COBS adds one code byte per 254 bytes (plus one)
+//and each frame ends with a 0x00 delimiter.
+#define RECORD_HEADER_SIZE  7u
+#define COBS_BLOCK_SIZE     254u
+#define COBS_MAX_CODE       0xFFu
+#define FRAME_DELIMITER     0x00u
+
+//How long repeats are gathered before their summary is printed anyway, and
+//how long after the last one a duplicate counts as a new message again.
+#define REPEAT_REPORT_INTERVAL  1000u
+
+//Default for CONSOLE_SetCoalescing().
+#define COALESCE_DEADLINE       2u
+
+//Enough for a 32-bit value in decimal, sign included.
+#define PRINTF_NUMBER_SIZE      11u
+
+//32/16 bit division with a 16-bit quotient is a single DIV.UD on this core;
+//written as C it becomes a call to the 32-bit division library routine.
+#if defined(__XC16__)
+#define DIVIDE_32_BY_16(numerator, denominator) __builtin_divud((numerator), (denominator))
+#else
+#define DIVIDE_32_BY_16(numerator, denominator) ((uint16_t)((numerator) / (denominator)))
+#endif
+
+#define IS_POWER_OF_TWO(x) (((x) & ((x) - 1u)) == 0u)
+
+#if !IS_POWER_OF_TWO(FAULT_FIFO_SIZE) || !IS_POWER_OF_TWO(WARN_FIFO_SIZE) || !IS_POWER_OF_TWO(INFO_FIFO_SIZE)
+#error "Console FIFO sizes must be powers of two"
+#endif
+
+#if !IS_POWER_OF_TWO(FAULT_SEGMENT_COUNT) || !IS_POWER_OF_TWO(WARN_SEGMENT_COUNT) || !IS_POWER_OF_TWO(INFO_SEGMENT_COUNT)
+#error "Console segment counts must be powers of two"
+#endif
+
+//Keeps the compiler from sinking the buffer copy below the index update that
+//publishes it to the other side.
+#define FIFO_BARRIER() __asm__ __volatile__("" ::: "memory")
+
+//Messages are queued as segments, in order.  A CONSOLE_MEMORY_RAM segment's
+//bytes are copied into the lane's FIFO; a CONSOLE_MEMORY_CONST segment only
+//keeps the pointer and is copied once, straight into the outgoing packet.
+typedef struct
+{
+    const uint8_t* data;
+    uint16_t length;
+    CONSOLE_MEMORY memory;
+} SEGMENT;
+
+//Single producer / single consumer (CONSOLE_Tasks) per lane.  The producer
+//only writes tail and segmentTail, the consumer only writes head,
+//segmentHead and segmentOffset.  16-bit stores are atomic on this core, so
+//a lane can be fed from an interrupt without masking, as long as only one
+//context produces into that lane.  The fault lane is the exception: it has
+//many producers, see EnqueueFault().
+typedef struct
+{
+    uint8_t* fifo;
+    uint16_t fifoMask;
+    SEGMENT* segments;
+    uint16_t segmentMask;
+    volatile uint16_t head;
+    volatile uint16_t tail;
+    volatile uint16_t segmentHead;
+    volatile uint16_t segmentTail;
+    uint16_t segmentOffset;
+    uint16_t sequence;
+} LANE;
+
+static uint8_t faultFIFO[FAULT_FIFO_SIZE];
+static SEGMENT faultSegments[FAULT_SEGMENT_COUNT];
+static uint8_t warnFIFO[WARN_FIFO_SIZE];
+static SEGMENT warnSegments[WARN_SEGMENT_COUNT];
+static uint8_t infoFIFO[INFO_FIFO_SIZE];
+static SEGMENT infoSegments[INFO_SEGMENT_COUNT];
+
+//Ordered by priority: CONSOLE_Tasks() always drains lower indices first.
+static LANE lanes[CONSOLE_LANE_COUNT] =
+{
+    {faultFIFO, FAULT_FIFO_SIZE - 1u, faultSegments, FAULT_SEGMENT_COUNT - 1u, 0, 0, 0, 0, 0, 0},
+    {warnFIFO,  WARN_FIFO_SIZE - 1u,  warnSegments,  WARN_SEGMENT_COUNT - 1u,  0, 0, 0, 0, 0, 0},
+    {infoFIFO,  INFO_FIFO_SIZE - 1u,  infoSegments,  INFO_SEGMENT_COUNT - 1u,  0, 0, 0, 0, 0, 0},
+};
+
+//Fault lane space handed out to writers that have not all finished yet.
+static volatile uint16_t faultReserved = 0;
+static volatile uint16_t faultSegmentReserved = 0;
+static volatile uint8_t faultWriters = 0;
+
+static CONSOLE_OVERFLOW_POLICY overflowPolicy = CONSOLE_OVERFLOW_DROP_NEWEST;
+static uint16_t overflowTimeout = 0;
+static CONSOLE_STATISTICS statistics;
+
+//The CDC sink is fed through the lanes; the others get a copy of each
+//message as it is queued.
+typedef struct
+{
+    uint16_t (*write)(const uint8_t* data, uint16_t length);
+    bool enabled;
+    CONSOLE_LANE level;
+} SINK;
+
+static SINK sinks[CONSOLE_SINK_COUNT] =
+{
+    {NULL,                  true,           CONSOLE_LANE_INFO},
+    {UART_WRITE,            UART_ENABLED,   CONSOLE_LANE_INFO},
+    {&CONSOLE_TRACE_Write,  true,           CONSOLE_LANE_INFO},
+};
+
+//COBS encodes a record straight into a lane FIFO, behind its published
+//tail, in as many pieces as the message comes in.
+typedef struct
+{
+    LANE* lane;
+    uint16_t tail;                          //where the frame starts
+    uint16_t count;                         //frame bytes so far, code bytes included
+    uint16_t codeIndex;                     //offset of the open code byte
+    uint8_t code;
+} RECORD_WRITER;
+
+//Where CONSOLE_Printf() output goes.  A message for the CDC sink is
+//formatted twice: once to measure it, so that the overflow policy can make
+//room for all of it as it does for CONSOLE_Print(), then again into the
+//room made.
+typedef enum
+{
+    PRINTF_DIRECT,                          //text straight into the lane FIFO
+    PRINTF_MEASURE,                         //only counted, to make room
+    PRINTF_RECORD,                          //COBS encoded into the lane FIFO
+    PRINTF_SINKS                            //to the other sinks only
+} PRINTF_MODE;
 
-#define FIFO_SIZE 1000u
-#define MAX_PACKET 64u
+typedef struct
+{
+    CONSOLE_LANE lane;
+    PRINTF_MODE mode;
+    CONSOLE_OVERFLOW_POLICY policy;
+    uint16_t tail;                          //direct: where the message starts
+    uint16_t length;                        //bytes formatted so far
+    uint16_t space;                         //direct and record: room left
+    uint16_t dropped;                       //direct: bytes that did not fit
+    bool queue;                             //meant for the CDC sink too: a drop if it ends up in sinks
+    RECORD_WRITER writer;
+} PRINTF_OUTPUT;
+
+static bool attached = false;
+
+static bool replaying = false;
+static uint16_t replayPosition;
+static uint16_t replayEnd;
+
+typedef struct
+{
+    uint8_t tokens;
+    uint8_t burst;
+    uint16_t refillPeriod;
+    uint32_t lastRefill;
+} BUCKET;
+
+static BUCKET buckets[CONSOLE_SOURCE_COUNT];
+
+static bool lastValid = false;
+static uint8_t lastSource;
+static uint32_t lastSignature;
+static uint32_t lastTime;
+static uint16_t repeatCount = 0;
+static uint32_t repeatStart;
+
+//Set while a BLOCK writer drains the lanes from WaitForSpace().
+static bool waiting = false;
 
-static uint8_t fifo[FIFO_SIZE];
-static uint8_t txBuffer[MAX_PACKET];
-static uint16_t head = 0;
-static uint16_t tail = 0;
+static uint16_t coalesceDeadline = COALESCE_DEADLINE;
+static bool coalescing = false;
+static uint32_t coalesceStart;
+static bool flushRequested = false;
 
+#if defined(CONSOLE_RECORDS)
+static bool recordMode = true;
+#else
+static bool recordMode = false;
+#endif
+
+static bool Queue(CONSOLE_LANE lane, const uint8_t* data, uint16_t length, CONSOLE_MEMORY memory, bool whole);
+static bool QueueMessage(CONSOLE_LANE lane, const CONSOLE_PIECE* pieces, uint8_t count, bool whole);
+static void FanOut(CONSOLE_LANE lane, const uint8_t* data, uint16_t length);
+static bool Format(CONSOLE_LANE lane, const char* format, va_list arguments);
+static void FormatText(PRINTF_OUTPUT* output, const char* format, va_list arguments);
+static void PrintfBegin(PRINTF_OUTPUT* output, CONSOLE_LANE lane);
+static void PrintfReserve(PRINTF_OUTPUT* output);
+static void PrintfPut(PRINTF_OUTPUT* output, const char* text, uint16_t length);
+static void PrintfPad(PRINTF_OUTPUT* output, char pad, uint8_t count);
+static bool PrintfEnd(PRINTF_OUTPUT* output);
+static uint8_t FormatDecimal(uint32_t value, char* end);
+static uint8_t FormatHex(uint32_t value, char* end, const char* digits);
+static uint16_t DivideBy10(uint16_t value);
+static uint16_t DivideBy10000(uint32_t* value);
+static void ReplayTasks(void);
+static bool TakeToken(uint8_t source, uint32_t now);
+static void ReportRepeats(void);
+static void EndRepeats(void);
+static void RepeatTasks(void);
+static bool IsPacketDue(void);
+static uint16_t GetPendingBytes(uint16_t limit);
+static bool Enqueue(LANE* lane, const CONSOLE_PIECE* pieces, uint8_t count, bool whole);
+static bool EnqueueFault(const uint8_t* data, uint16_t length);
+static CONSOLE_OVERFLOW_POLICY MakeRoom(LANE* lane, uint16_t length, uint8_t segments);
+static bool IsSpaceAvailable(LANE* lane, uint16_t length, uint8_t segments);
+static void WaitForSpace(LANE* lane, uint16_t length, uint8_t segments);
+static void DiscardOldest(LANE* lane, uint16_t length, uint8_t segments);
+static uint16_t DiscardSegment(LANE* lane);
+static void CountDrop(CONSOLE_OVERFLOW_POLICY policy, uint16_t bytes);
+static void CountSinkDrop(CONSOLE_SINK sink, uint16_t bytes);
+static void UpdateHighWaterMark(LANE* lane);
+static uint16_t BuildPacket(uint8_t* packet, uint16_t size);
+#if defined(CONSOLE_COMPRESSION)
+static uint16_t BuildCompressedPacket(uint8_t* packet, uint16_t size);
+#endif
+static uint16_t GetSegments(LANE* lane, uint8_t* packet, uint16_t size, bool oneSegment);
 static void FlushFIFO(void);
-static void FIFOPut(uint8_t data);
-static uint16_t GetFIFODepth(void);
-static uint8_t FIFOGet(void);
+static uint16_t GetRecordSize(uint16_t length);
+static void RecordBegin(RECORD_WRITER* writer, LANE* lane, uint16_t tail, uint16_t sequence);
+static void RecordAppend(RECORD_WRITER* writer, const uint8_t* data, uint16_t length);
+static uint16_t RecordEnd(RECORD_WRITER* writer);
+static uint16_t FIFOPut(LANE* lane, const uint8_t* data, uint16_t length);
+static uint16_t GetFIFODepth(LANE* lane);
+static uint16_t GetFIFOSpace(LANE* lane);
+static uint16_t FIFOGet(LANE* lane, uint8_t* data, uint16_t length);
 
 void CONSOLE_Initialize(void)
 {
     FlushFIFO();
+    CONSOLE_TRACE_Initialize();
+    
+#if defined(CONSOLE_UART)
+    CONSOLE_UART_Initialize();
+#endif
+    
+#if defined(CONSOLE_COMPRESSION)
+    CONSOLE_LZSS_Initialize();
+#endif
+}
+
+bool CONSOLE_Print(char* inputString)
+{
+    return CONSOLE_PrintLane(CONSOLE_LANE_INFO, inputString);
+}
+
+bool CONSOLE_PrintLane(CONSOLE_LANE lane, char* inputString)
+{
+    EndRepeats();
+    
+    return Queue(lane, (const uint8_t*)inputString, (uint16_t)strlen(inputString), CONSOLE_MEMORY_RAM, false);
+}
+
+bool CONSOLE_PrintConst(const char* inputString)
+{
+    EndRepeats();
+    
+    return Queue(CONSOLE_LANE_INFO, (const uint8_t*)inputString, (uint16_t)strlen(inputString), CONSOLE_MEMORY_CONST, true);
+}
+
+bool CONSOLE_PrintFault(const char* inputString)
+{
+    uint16_t length = (uint16_t)strlen(inputString);
+    
+    FanOut(CONSOLE_LANE_FAULT, (const uint8_t*)inputString, length);
+    
+    if(sinks[CONSOLE_SINK_CDC].enabled == false)
+    {
+        return true;
+    }
+    
+    //Copied so that callers may pass buffers on an interrupt's stack.
+    return EnqueueFault((const uint8_t*)inputString, length);
+}
+
+bool CONSOLE_Write(const uint8_t* data, uint16_t length)
+{
+    return Queue(CONSOLE_LANE_INFO, data, length, CONSOLE_MEMORY_RAM, true);
+}
+
+bool CONSOLE_WriteSegment(CONSOLE_LANE lane, const uint8_t* data, uint16_t length, CONSOLE_MEMORY memory)
+{
+    return Queue(lane, data, length, memory, true);
+}
+
+bool CONSOLE_WriteMessage(CONSOLE_LANE lane, const CONSOLE_PIECE* pieces, uint8_t count)
+{
+    return QueueMessage(lane, pieces, count, true);
+}
+
+bool CONSOLE_Printf(const char* format, ...)
+{
+    va_list arguments;
+    bool result;
+    
+    EndRepeats();
+    
+    va_start(arguments, format);
+    result = Format(CONSOLE_LANE_INFO, format, arguments);
+    va_end(arguments);
+    
+    return result;
+}
+
+bool CONSOLE_PrintfLane(CONSOLE_LANE lane, const char* format, ...)
+{
+    va_list arguments;
+    bool result;
+    
+    EndRepeats();
+    
+    va_start(arguments, format);
+    result = Format(lane, format, arguments);
+    va_end(arguments);
+    
+    return result;
+}
+
+void CONSOLE_SetOverflowPolicy(CONSOLE_OVERFLOW_POLICY policy, uint16_t timeoutMilliseconds)
+{
+    if(policy < CONSOLE_OVERFLOW_POLICY_COUNT)
+    {
+        overflowPolicy = policy;
+        overflowTimeout = timeoutMilliseconds;
+    }
+}
+
+void CONSOLE_SetSink(CONSOLE_SINK sink, bool enable, CONSOLE_LANE level)
+{
+    if((sink < CONSOLE_SINK_COUNT) && (level < CONSOLE_LANE_COUNT))
+    {
+        //A sink that was not built in cannot be turned on.
+        if((sink == CONSOLE_SINK_CDC) || (sinks[sink].write != NULL))
+        {
+            sinks[sink].enabled = enable;
+        }
+        
+        sinks[sink].level = level;
+    }
 }
 
-void CONSOLE_Print(char* inputString)
+void CONSOLE_ReplayTrace(void)
 {
-    char* data = inputString;
+    replayPosition = CONSOLE_TRACE_GetStart();
+    replayEnd = CONSOLE_TRACE_GetEnd();
+    replaying = true;
+}
+
+void CONSOLE_SetRecordMode(bool enable)
+{
+    recordMode = enable;
+}
+
+void CONSOLE_SetCoalescing(uint16_t deadlineMilliseconds)
+{
+    coalesceDeadline = deadlineMilliseconds;
+}
+
+void CONSOLE_Flush(void)
+{
+    flushRequested = true;
+}
+
+void CONSOLE_SetRateLimit(uint8_t source, uint8_t burst, uint16_t refillMilliseconds)
+{
+    if(source < CONSOLE_SOURCE_COUNT)
+    {
+        buckets[source].burst = burst;
+        buckets[source].tokens = burst;
+        buckets[source].refillPeriod = refillMilliseconds;
+        buckets[source].lastRefill = USBGet1msTickCount();
+    }
+}
+
+bool CONSOLE_Admit(uint8_t source, uint32_t signature)
+{
+    uint32_t now = USBGet1msTickCount();
+    
+    if((lastValid == true) && (source == lastSource) && (signature == lastSignature))
+    {
+        if(repeatCount == 0u)
+        {
+            repeatStart = now;
+        }
+        
+        if(repeatCount != UINT16_MAX)
+        {
+            repeatCount++;
+        }
+        
+        lastTime = now;
+        statistics.repeatedMessages++;
+        return false;
+    }
     
-    while(*data != 0u)
+    ReportRepeats();
+    
+    if(TakeToken(source, now) == false)
     {
-        FIFOPut((uint8_t)*data++);
+        statistics.rateLimitedMessages++;
+        return false;
     }
+    
+    lastValid = true;
+    lastSource = source;
+    lastSignature = signature;
+    lastTime = now;
+    
+    return true;
+}
+
+void CONSOLE_GetStatistics(CONSOLE_STATISTICS* result)
+{
+    uint16_t ipl;
+    
+    SET_AND_SAVE_CPU_IPL(ipl, 7);
+    *result = statistics;
+    RESTORE_CPU_IPL(ipl);
+}
+
+void CONSOLE_ClearStatistics(void)
+{
+    uint16_t ipl;
+    
+    SET_AND_SAVE_CPU_IPL(ipl, 7);
+    (void)memset(&statistics, 0, sizeof(statistics));
+    RESTORE_CPU_IPL(ipl);
 }
 
 void CONSOLE_Tasks(void)
 {
-    uint16_t transmitSize = GetFIFODepth();
-    uint8_t i;
+    uint16_t transmitSize;
+    uint8_t* packet;
+    
+    //While a BLOCK writer waits for room, only drain: a repeat summary or
+    //replayed trace queued from here would compete with it for the room,
+    //and could itself wait, re-entering WaitForSpace().
+    if(waiting == false)
+    {
+        RepeatTasks();
+        ReplayTasks();
+    }
+    
+#if defined(CONSOLE_UART)
+    CONSOLE_UART_Tasks();
+#endif
     
     if(USBGetDeviceState() != CONFIGURED_STATE)
     {
-        CONSOLE_Initialize();
+        //The lanes keep what is queued until the host is back.
+        attached = false;
     }
     else
     {
-        if( (USBUSARTIsTxTrfReady() == true) && (transmitSize != 0u) )
+        if(attached == false)
         {
-            if(transmitSize > MAX_PACKET)
-            {
-                transmitSize = MAX_PACKET;
-            }
-
-            for(i=0; i<transmitSize; i++)
+            attached = true;
+            
+#if defined(CONSOLE_COMPRESSION)
+            //The host starts a new decompressor with every connection.
+            CONSOLE_LZSS_Initialize();
+#endif
+        }
+        
+        //Drain straight into the CDC IN endpoint buffers.  Both ping-pong
+        //buffers are filled when there is enough queued.
+        packet = CDCTxAcquireBuffer(CONSOLE_CDC_INSTANCE);
+        
+        while(packet != NULL)
+        {
+#if defined(CONSOLE_COMPRESSION)
+            transmitSize = BuildCompressedPacket(packet, MAX_PACKET);
+#else
+            transmitSize = (IsPacketDue() == true) ? BuildPacket(packet, MAX_PACKET) : 0u;
+#endif
+            
+            if(transmitSize == 0u)
             {
-                txBuffer[i] = FIFOGet();
+                //Give the buffer back, or the ZLP owed by a full packet
+                //never goes.
+                CDCTxCommitBuffer(CONSOLE_CDC_INSTANCE, 0u);
+                break;
             }
-
-            putUSBUSART(txBuffer,transmitSize);
+            
+            CDCTxCommitBuffer(CONSOLE_CDC_INSTANCE, (uint8_t)transmitSize);
+            packet = CDCTxAcquireBuffer(CONSOLE_CDC_INSTANCE);
         }
 
-        CDCTxService();
+        CDCTxService(CONSOLE_CDC_INSTANCE);
     }
 }
 
-static uint16_t GetFIFODepth(void)
+//Nagle style coalescing: a short packet only goes out once the oldest byte
+//in it has waited coalesceDeadline, or on CONSOLE_Flush(), or for a fault.
+static bool IsPacketDue(void)
 {
-    uint16_t depth = (tail - head);
-            
-    if(tail < head)
+    uint16_t pending = GetPendingBytes(MAX_PACKET);
+    
+    if(pending == 0u)
+    {
+        coalescing = false;
+        flushRequested = false;
+        return false;
+    }
+    
+    if((pending >= MAX_PACKET) || (coalesceDeadline == 0u) || (flushRequested == true) ||
+       (lanes[CONSOLE_LANE_FAULT].segmentHead != lanes[CONSOLE_LANE_FAULT].segmentTail))
+    {
+        return true;
+    }
+    
+    //The deadline runs from when the data was first held, and is not
+    //restarted by full packets sent in the meantime.
+    if(coalescing == false)
     {
-        depth = ((FIFO_SIZE - head) + tail);
+        coalescing = true;
+        coalesceStart = USBGet1msTickCount();
     }
     
-    return depth;
+    return ((USBGet1msTickCount() - coalesceStart) >= coalesceDeadline);
 }
 
-static void FlushFIFO(void)
+//Bytes queued for the CDC sink, counted up to limit only.
+static uint16_t GetPendingBytes(uint16_t limit)
+{
+    uint16_t count = 0;
+    uint16_t length;
+    uint16_t offset;
+    uint16_t index;
+    uint8_t i;
+    LANE* lane;
+    
+    for(i = 0; (i < (uint8_t)CONSOLE_LANE_COUNT) && (count < limit); i++)
+    {
+        lane = &lanes[i];
+        
+        //Only the head segment can be partly sent.
+        offset = lane->segmentOffset;
+        
+        for(index = lane->segmentHead; (index != lane->segmentTail) && (count < limit); index++)
+        {
+            length = lane->segments[index & lane->segmentMask].length - offset;
+            offset = 0;
+            count = (length < (limit - count)) ? (count + length) : limit;
+        }
+    }
+    
+    return count;
+}
+
+static bool Queue(CONSOLE_LANE lane, const uint8_t* data, uint16_t length, CONSOLE_MEMORY memory, bool whole)
 {
-    head = 0;
-    tail = 0;
+    CONSOLE_PIECE piece;
+    
+    piece.data = data;
+    piece.length = length;
+    piece.memory = memory;
+    
+    return QueueMessage(lane, &piece, 1u, whole);
 }
 
-static void FIFOPut(uint8_t data)
+static bool QueueMessage(CONSOLE_LANE lane, const CONSOLE_PIECE* pieces, uint8_t count, bool whole)
 {
-    if(GetFIFODepth() < (FIFO_SIZE - 1u))
+    uint8_t i;
+    
+    //Only CONSOLE_PrintFault() may feed the fault lane.
+    if(lane == CONSOLE_LANE_FAULT)
     {
-        fifo[tail] = data;
-        tail++;
-        
-        if(tail == FIFO_SIZE)
+        return false;
+    }
+    
+    for(i = 0; i < count; i++)
+    {
+        FanOut(lane, pieces[i].data, pieces[i].length);
+    }
+    
+    if((sinks[CONSOLE_SINK_CDC].enabled == false) || (lane > sinks[CONSOLE_SINK_CDC].level))
+    {
+        return true;
+    }
+    
+    return Enqueue(&lanes[lane], pieces, count, whole);
+}
+
+static void FanOut(CONSOLE_LANE lane, const uint8_t* data, uint16_t length)
+{
+    CONSOLE_SINK sink;
+    uint16_t accepted;
+    
+    for(sink = CONSOLE_SINK_UART; sink < CONSOLE_SINK_COUNT; sink++)
+    {
+        if((sinks[sink].enabled == true) && (lane <= sinks[sink].level))
         {
-            tail = 0;
+            accepted = sinks[sink].write(data, length);
+            
+            if(accepted != length)
+            {
+                CountSinkDrop(sink, length - accepted);
+            }
         }
     }
 }
 
-static uint8_t FIFOGet(void)
+static bool Format(CONSOLE_LANE lane, const char* format, va_list arguments)
 {
-    uint8_t data = 0u;
+    PRINTF_OUTPUT output;
+    va_list measured;
+    
+    //Only CONSOLE_PrintFault() may feed the fault lane.
+    if(lane == CONSOLE_LANE_FAULT)
+    {
+        return false;
+    }
     
-    if(GetFIFODepth() > 0u)
+    PrintfBegin(&output, lane);
+    
+    if(output.mode == PRINTF_MEASURE)
     {
-        data = fifo[head];
-        head++;
+        va_copy(measured, arguments);
+        FormatText(&output, format, measured);
+        va_end(measured);
+        PrintfReserve(&output);
+    }
+    
+    FormatText(&output, format, arguments);
+    
+    return PrintfEnd(&output);
+}
 
-        if(head == FIFO_SIZE)
+static void FormatText(PRINTF_OUTPUT* output, const char* format, va_list arguments)
+{
+    static const char upperDigits[] = "0123456789ABCDEF";
+    static const char lowerDigits[] = "0123456789abcdef";
+    char number[PRINTF_NUMBER_SIZE];
+    const char* literal;
+    const char* text;
+    uint32_t value;
+    uint16_t length;
+    uint8_t width;
+    char pad;
+    bool left;
+    bool isLong;
+    bool negative;
+    
+    while(*format != 0)
+    {
+        literal = format;
+        
+        while((*format != 0) && (*format != '%'))
+        {
+            format++;
+        }
+        
+        PrintfPut(output, literal, (uint16_t)(format - literal));
+        
+        if(*format == 0)
+        {
+            break;
+        }
+        
+        format++;
+        pad = ' ';
+        left = false;
+        width = 0;
+        isLong = false;
+        negative = false;
+        
+        if(*format == '-')
+        {
+            left = true;
+            format++;
+        }
+        else if(*format == '0')
+        {
+            pad = '0';
+            format++;
+        }
+        
+        while((*format >= '0') && (*format <= '9'))
+        {
+            width = (uint8_t)((width * 10u) + (uint8_t)(*format - '0'));
+            format++;
+        }
+        
+        if(*format == 'l')
+        {
+            isLong = true;
+            format++;
+        }
+        
+        text = number;
+        length = 0;
+        
+        switch(*format)
+        {
+            case 'd':
+            case 'i':
+                if(isLong == true)
+                {
+                    long signedValue = va_arg(arguments, long);
+                    
+                    negative = (signedValue < 0);
+                    value = (negative == true) ? (0ul - (uint32_t)signedValue) : (uint32_t)signedValue;
+                }
+                else
+                {
+                    int signedValue = va_arg(arguments, int);
+                    
+                    negative = (signedValue < 0);
+                    value = (negative == true) ? (0ul - (uint32_t)(long)signedValue) : (uint32_t)signedValue;
+                }
+                
+                length = FormatDecimal(value, &number[PRINTF_NUMBER_SIZE]);
+                break;
+                
+            case 'u':
+                value = (isLong == true) ? va_arg(arguments, unsigned long) : va_arg(arguments, unsigned int);
+                length = FormatDecimal(value, &number[PRINTF_NUMBER_SIZE]);
+                break;
+                
+            case 'x':
+            case 'X':
+                value = (isLong == true) ? va_arg(arguments, unsigned long) : va_arg(arguments, unsigned int);
+                length = FormatHex(value, &number[PRINTF_NUMBER_SIZE], (*format == 'x') ? lowerDigits : upperDigits);
+                break;
+                
+            case 'c':
+                number[PRINTF_NUMBER_SIZE - 1u] = (char)va_arg(arguments, int);
+                length = 1;
+                break;
+                
+            case 's':
+                text = va_arg(arguments, const char*);
+                
+                if(text == NULL)
+                {
+                    text = "(null)";
+                }
+                
+                length = (uint16_t)strlen(text);
+                break;
+                
+            case 0:
+                format--;
+                break;
+                
+            default:
+                //%% and anything unsupported print the character itself.
+                text = format;
+                length = 1;
+                break;
+        }
+        
+        format++;
+        
+        if(text == number)
+        {
+            text = &number[PRINTF_NUMBER_SIZE - length];
+        }
+        
+        if(negative == true)
+        {
+            //The sign goes in front of zero padding, behind space padding.
+            if(pad == '0')
+            {
+                PrintfPut(output, "-", 1u);
+                
+                if(width != 0u)
+                {
+                    width--;
+                }
+            }
+            else
+            {
+                text--;
+                number[PRINTF_NUMBER_SIZE - length - 1u] = '-';
+                length++;
+            }
+        }
+        
+        if((left == false) && (width > length))
+        {
+            PrintfPad(output, pad, (uint8_t)(width - length));
+        }
+        
+        PrintfPut(output, text, length);
+        
+        if((left == true) && (width > length))
         {
-            head = 0;
+            PrintfPad(output, ' ', (uint8_t)(width - length));
         }
     }
+}
+
+static void PrintfBegin(PRINTF_OUTPUT* output, CONSOLE_LANE lane)
+{
+    output->lane = lane;
+    output->policy = overflowPolicy;
+    output->length = 0;
+    output->dropped = 0;
+    output->queue = false;
+    
+    if((sinks[CONSOLE_SINK_CDC].enabled == false) || (lane > sinks[CONSOLE_SINK_CDC].level))
+    {
+        output->mode = PRINTF_SINKS;
+        return;
+    }
     
-    return data;
+    output->mode = PRINTF_MEASURE;
 }
 
+//Makes room for the message just measured under the overflow policy.  A
+//record goes in whole or not at all.  Text goes straight into the lane
+//FIFO, behind its published tail, as one segment: whatever still does not
+//fit is truncated, as CONSOLE_Print() truncates it, unless the policy is
+//ALL_OR_NOTHING.  Without a free segment nothing can be queued at all.
+static void PrintfReserve(PRINTF_OUTPUT* output)
+{
+    LANE* lane = &lanes[output->lane];
+    uint16_t required = (recordMode == true) ? GetRecordSize(output->length) : output->length;
+    bool fits;
+    
+    output->policy = MakeRoom(lane, required, 1u);
+    output->queue = (output->length != 0u);
+    fits = IsSpaceAvailable(lane, required, 1u);
+    
+    if(output->length == 0u)
+    {
+        output->mode = PRINTF_SINKS;
+    }
+    else if(recordMode == true)
+    {
+        output->mode = (fits == true) ? PRINTF_RECORD : PRINTF_SINKS;
+        output->space = output->length;
+        
+        if(fits == true)
+        {
+            RecordBegin(&output->writer, lane, lane->tail, lane->sequence);
+        }
+    }
+    else if((fits == true) ||
+            ((output->policy != CONSOLE_OVERFLOW_ALL_OR_NOTHING) && (IsSpaceAvailable(lane, 0u, 1u) == true)))
+    {
+        output->mode = PRINTF_DIRECT;
+        output->tail = lane->tail;
+        output->space = (fits == true) ? output->length : GetFIFOSpace(lane);
+    }
+    else
+    {
+        output->mode = PRINTF_SINKS;
+    }
+    
+    output->length = 0;
+}
+
+static void PrintfPut(PRINTF_OUTPUT* output, const char* text, uint16_t length)
+{
+    LANE* lane = &lanes[output->lane];
+    uint16_t offset;
+    uint16_t span;
+    
+    if(output->mode == PRINTF_DIRECT)
+    {
+        //Arguments that changed since they were measured cannot overrun
+        //the room made.
+        if(length > output->space)
+        {
+            output->dropped += length - output->space;
+            length = output->space;
+        }
+        
+        offset = (output->tail + output->length) & lane->fifoMask;
+        span = (lane->fifoMask + 1u) - offset;
+        
+        if(span > length)
+        {
+            span = length;
+        }
+        
+        (void)memcpy(&lane->fifo[offset], text, span);
+        (void)memcpy(&lane->fifo[0], &text[span], length - span);
+        output->space -= length;
+    }
+    else if(output->mode == PRINTF_RECORD)
+    {
+        //Only what was measured has room; arguments that changed in
+        //between cannot overrun the reservation.
+        if(length > output->space)
+        {
+            length = output->space;
+        }
+        
+        RecordAppend(&output->writer, (const uint8_t*)text, length);
+        FanOut(output->lane, (const uint8_t*)text, length);
+        output->space -= length;
+    }
+    else if(output->mode == PRINTF_SINKS)
+    {
+        FanOut(output->lane, (const uint8_t*)text, length);
+    }
+    
+    output->length += length;
+}
+
+static void PrintfPad(PRINTF_OUTPUT* output, char pad, uint8_t count)
+{
+    static const char spaces[] = "        ";
+    static const char zeros[] = "00000000";
+    const char* text = (pad == '0') ? zeros : spaces;
+    uint8_t chunk;
+    
+    while(count != 0u)
+    {
+        chunk = (count > (sizeof(spaces) - 1u)) ? (uint8_t)(sizeof(spaces) - 1u) : count;
+        PrintfPut(output, text, chunk);
+        count -= chunk;
+    }
+}
+
+static bool PrintfEnd(PRINTF_OUTPUT* output)
+{
+    LANE* lane = &lanes[output->lane];
+    uint16_t offset;
+    uint16_t span;
+    uint16_t localTail;
+    SEGMENT* segment;
+    
+    //Dropped records still use up a sequence number so the host can count
+    //the gap.
+    if((output->queue == true) && (recordMode == true))
+    {
+        lane->sequence++;
+    }
+    
+    if(output->mode == PRINTF_SINKS)
+    {
+        if((output->queue == true) && (output->length != 0u))
+        {
+            CountDrop(output->policy, output->length);
+            return false;
+        }
+        
+        return true;
+    }
+    
+    localTail = lane->segmentTail;
+    segment = &lane->segments[localTail & lane->segmentMask];
+    segment->data = NULL;
+    segment->memory = CONSOLE_MEMORY_RAM;
+    
+    if(output->mode == PRINTF_RECORD)
+    {
+        segment->length = RecordEnd(&output->writer);
+        FIFO_BARRIER();
+        lane->tail = output->writer.tail + segment->length;
+        FIFO_BARRIER();
+        lane->segmentTail = localTail + 1u;
+        UpdateHighWaterMark(lane);
+        
+        return true;
+    }
+    
+    //Output the room made could not take is truncated, except that
+    //ALL_OR_NOTHING drops it whole.
+    if(output->dropped != 0u)
+    {
+        if(output->policy == CONSOLE_OVERFLOW_ALL_OR_NOTHING)
+        {
+            output->dropped += output->length;
+            output->length = 0;
+        }
+        
+        CountDrop(output->policy, output->dropped);
+    }
+    
+    if(output->length == 0u)
+    {
+        return (output->dropped == 0u);
+    }
+    
+    offset = output->tail & lane->fifoMask;
+    span = (lane->fifoMask + 1u) - offset;
+    
+    if(span > output->length)
+    {
+        span = output->length;
+    }
+    
+    FanOut(output->lane, &lane->fifo[offset], span);
+    FanOut(output->lane, &lane->fifo[0], output->length - span);
+    
+    segment->length = output->length;
+    
+    FIFO_BARRIER();
+    lane->tail = output->tail + output->length;
+    FIFO_BARRIER();
+    lane->segmentTail = localTail + 1u;
+    
+    UpdateHighWaterMark(lane);
+    
+    return (output->dropped == 0u);
+}
+
+static uint8_t FormatDecimal(uint32_t value, char* end)
+{
+    uint16_t part;
+    uint16_t quotient;
+    uint8_t count = 0;
+    uint8_t i;
+    
+    //Four digits at a time while the value needs 32 bits, then 16-bit
+    //arithmetic only.
+    while(value > 0xFFFFul)
+    {
+        part = DivideBy10000(&value);
+        
+        for(i = 0; i < 4u; i++)
+        {
+            quotient = DivideBy10(part);
+            *--end = (char)('0' + (part - (quotient * 10u)));
+            part = quotient;
+        }
+        
+        count += 4u;
+    }
+    
+    part = (uint16_t)value;
+    
+    do
+    {
+        quotient = DivideBy10(part);
+        *--end = (char)('0' + (part - (quotient * 10u)));
+        part = quotient;
+        count++;
+    } while(part != 0u);
+    
+    return count;
+}
+
+static uint8_t FormatHex(uint32_t value, char* end, const char* digits)
+{
+    uint16_t part = (uint16_t)value;
+    uint16_t high = (uint16_t)(value >> 16);
+    uint8_t count = 0;
+    
+    //The low half is written in full only if the high half has digits.
+    if(high != 0u)
+    {
+        for(count = 0; count < 4u; count++)
+        {
+            *--end = digits[part & 0x0Fu];
+            part >>= 4;
+        }
+        
+        part = high;
+    }
+    
+    do
+    {
+        *--end = digits[part & 0x0Fu];
+        part >>= 4;
+        count++;
+    } while(part != 0u);
+    
+    return count;
+}
+
+static uint16_t DivideBy10(uint16_t value)
+{
+    //Exact for every 16-bit value; a 16x16 multiply instead of a divide.
+    return (uint16_t)(((uint32_t)value * 0xCCCDu) >> 19);
+}
+
+static uint16_t DivideBy10000(uint32_t* value)
+{
+    uint16_t high = (uint16_t)(*value >> 16);
+    uint16_t quotientHigh = high / 10000u;
+    uint32_t rest = ((uint32_t)(uint16_t)(high - (quotientHigh * 10000u)) << 16) | (uint16_t)*value;
+    uint16_t quotientLow;
+    
+    //Long division in two steps whose quotients both fit in 16 bits.
+    quotientLow = DIVIDE_32_BY_16(rest, 10000u);
+    *value = ((uint32_t)quotientHigh << 16) | quotientLow;
+    
+    return (uint16_t)((uint16_t)rest - (quotientLow * 10000u));
+}
+
+static void ReplayTasks(void)
+{
+    uint8_t buffer[MAX_PACKET];
+    CONSOLE_PIECE piece;
+    uint16_t length;
+    uint16_t required = (recordMode == true) ? GetRecordSize(MAX_PACKET) : MAX_PACKET;
+    
+    //Replayed bytes go to the CDC lanes only, never back into the sinks.
+    //A chunk is read only once it is sure to fit, so nothing is lost.
+    while((replaying == true) && IsSpaceAvailable(&lanes[CONSOLE_LANE_INFO], required, 1u))
+    {
+        length = (uint16_t)(replayEnd - replayPosition);
+        
+        if((int16_t)length <= 0)
+        {
+            replaying = false;
+            break;
+        }
+        
+        if(length > MAX_PACKET)
+        {
+            length = MAX_PACKET;
+        }
+        
+        piece.data = buffer;
+        piece.length = CONSOLE_TRACE_Read(&replayPosition, buffer, length);
+        piece.memory = CONSOLE_MEMORY_RAM;
+        (void)Enqueue(&lanes[CONSOLE_LANE_INFO], &piece, 1u, true);
+    }
+}
+
+static bool TakeToken(uint8_t source, uint32_t now)
+{
+    BUCKET* bucket;
+    uint32_t refills;
+    
+    if((source >= CONSOLE_SOURCE_COUNT) || (buckets[source].burst == 0u))
+    {
+        return true;
+    }
+    
+    bucket = &buckets[source];
+    
+    if(bucket->refillPeriod != 0u)
+    {
+        refills = (now - bucket->lastRefill) / bucket->refillPeriod;
+        
+        if((bucket->tokens + refills) >= bucket->burst)
+        {
+            bucket->tokens = bucket->burst;
+            bucket->lastRefill = now;
+        }
+        else
+        {
+            bucket->tokens += (uint8_t)refills;
+            bucket->lastRefill += refills * bucket->refillPeriod;
+        }
+    }
+    
+    if(bucket->tokens == 0u)
+    {
+        return false;
+    }
+    
+    bucket->tokens--;
+    
+    return true;
+}
+
+static void ReportRepeats(void)
+{
+    static const char prefix[] = "last message repeated ";
+    static const char suffix[] = " times\r\n";
+    char text[sizeof(prefix) + 5u + sizeof(suffix)];
+    char digits[5];
+    uint8_t length = sizeof(prefix) - 1u;
+    uint8_t count = 0;
+    uint16_t value = repeatCount;
+    
+    if(repeatCount == 0u)
+    {
+        return;
+    }
+    
+    repeatCount = 0;
+    
+    do
+    {
+        digits[count++] = (char)('0' + (value % 10u));
+        value /= 10u;
+    } while(value != 0u);
+    
+    (void)memcpy(text, prefix, length);
+    
+    while(count != 0u)
+    {
+        text[length++] = digits[--count];
+    }
+    
+    (void)memcpy(&text[length], suffix, sizeof(suffix) - 1u);
+    length += sizeof(suffix) - 1u;
+    
+    (void)Queue(CONSOLE_LANE_INFO, (const uint8_t*)text, length, CONSOLE_MEMORY_RAM, true);
+}
+
+static void EndRepeats(void)
+{
+    //Other output in between means the next message is not a repeat.
+    if(SRbits.IPL == 0u)
+    {
+        ReportRepeats();
+        lastValid = false;
+    }
+}
+
+static void RepeatTasks(void)
+{
+    uint32_t now = USBGet1msTickCount();
+    
+    if((repeatCount != 0u) && ((now - repeatStart) >= REPEAT_REPORT_INTERVAL))
+    {
+        ReportRepeats();
+    }
+    
+    if((lastValid == true) && (repeatCount == 0u) && ((now - lastTime) >= REPEAT_REPORT_INTERVAL))
+    {
+        lastValid = false;
+    }
+}
+
+//The pieces are one message: queued whole or not at all, and in record mode
+//one record.  Only a single RAM piece queued with whole false may be cut
+//short to the free space.  Consecutive RAM pieces share a segment, and all
+//of the message's segments are published with one store.
+static bool Enqueue(LANE* lane, const CONSOLE_PIECE* pieces, uint8_t count, bool whole)
+{
+    CONSOLE_OVERFLOW_POLICY policy;
+    bool records = recordMode;
+    bool inRAM = false;
+    uint16_t length = 0;
+    uint16_t required = 0;
+    uint8_t segments = 0;
+    uint16_t accepted;
+    uint16_t pieceLength;
+    uint16_t localTail;
+    SEGMENT* segment = NULL;
+    RECORD_WRITER writer;
+    uint8_t i;
+    
+    for(i = 0; i < count; i++)
+    {
+        if(pieces[i].length == 0u)
+        {
+            continue;
+        }
+        
+        length += pieces[i].length;
+        
+        if(pieces[i].memory == CONSOLE_MEMORY_CONST)
+        {
+            segments++;
+            inRAM = false;
+        }
+        else
+        {
+            required += pieces[i].length;
+            segments += (inRAM == true) ? 0u : 1u;
+            inRAM = true;
+        }
+    }
+    
+    if(length == 0u)
+    {
+        return true;
+    }
+    
+    //A record is always copied and queued whole: a truncated frame would
+    //only be thrown away by the host.
+    if(records == true)
+    {
+        required = GetRecordSize(length);
+        segments = 1u;
+        whole = true;
+    }
+    
+    if((count != 1u) || (required != length))
+    {
+        whole = true;
+    }
+    
+    accepted = length;
+    policy = MakeRoom(lane, required, segments);
+    
+    if(IsSpaceAvailable(lane, required, segments) == false)
+    {
+        //Only RAM data can be truncated to the free FIFO space.  Without a
+        //free segment nothing can be queued at all.
+        if((whole == true) || (policy == CONSOLE_OVERFLOW_ALL_OR_NOTHING) ||
+           ((uint16_t)(lane->segmentTail - lane->segmentHead) > lane->segmentMask))
+        {
+            accepted = 0u;
+        }
+        else
+        {
+            accepted = GetFIFOSpace(lane);
+        }
+    }
+    
+    if(accepted != 0u)
+    {
+        localTail = lane->segmentTail;
+        
+        if(records == true)
+        {
+            RecordBegin(&writer, lane, lane->tail, lane->sequence);
+            
+            for(i = 0; i < count; i++)
+            {
+                RecordAppend(&writer, pieces[i].data, pieces[i].length);
+            }
+            
+            segment = &lane->segments[localTail++ & lane->segmentMask];
+            segment->data = NULL;
+            segment->length = RecordEnd(&writer);
+            segment->memory = CONSOLE_MEMORY_RAM;
+            
+            FIFO_BARRIER();
+            lane->tail = writer.tail + segment->length;
+        }
+        else
+        {
+            for(i = 0; i < count; i++)
+            {
+                pieceLength = (pieces[i].length > accepted) ? accepted : pieces[i].length;
+                
+                if(pieceLength == 0u)
+                {
+                    continue;
+                }
+                
+                if(pieces[i].memory == CONSOLE_MEMORY_RAM)
+                {
+                    (void)FIFOPut(lane, pieces[i].data, pieceLength);
+                    
+                    if((segment != NULL) && (segment->memory == CONSOLE_MEMORY_RAM))
+                    {
+                        segment->length += pieceLength;
+                        continue;
+                    }
+                }
+                
+                segment = &lane->segments[localTail++ & lane->segmentMask];
+                segment->data = (pieces[i].memory == CONSOLE_MEMORY_RAM) ? NULL : pieces[i].data;
+                segment->length = pieceLength;
+                segment->memory = pieces[i].memory;
+            }
+        }
+        
+        FIFO_BARRIER();
+        lane->segmentTail = localTail;
+    }
+    
+    //Dropped records still use up a sequence number so the host can count
+    //the gap.
+    if(records == true)
+    {
+        lane->sequence++;
+    }
+    
+    if(accepted != length)
+    {
+        CountDrop(policy, length - accepted);
+    }
+    
+    UpdateHighWaterMark(lane);
+    
+    return (accepted == length);
+}
+
+//Any context may feed the fault lane, and one call may interrupt another.
+//Only reserving the space and publishing it are done with interrupts
+//masked, the copy is not; the last writer to finish, which is the one
+//that was interrupted, publishes tail and segmentTail for all of them, as
+//CONSOLE_UART_Write() does.  A message is queued whole or not at all and
+//older ones are never discarded, so this never waits on the consumer.  A
+//record is reserved at its worst case size; bytes its encoding did not
+//need are delimiters, which the host skips as empty frames.
+static bool EnqueueFault(const uint8_t* data, uint16_t length)
+{
+    LANE* lane = &lanes[CONSOLE_LANE_FAULT];
+    CONSOLE_OVERFLOW_POLICY policy = overflowPolicy;
+    bool records = recordMode;
+    uint16_t required = (records == true) ? GetRecordSize(length) : length;
+    uint16_t offset;
+    uint16_t localTail;
+    uint16_t sequence;
+    uint16_t span;
+    uint16_t ipl;
+    bool reserved;
+    RECORD_WRITER writer;
+    SEGMENT* segment;
+    
+    if(length == 0u)
+    {
+        return true;
+    }
+    
+    SET_AND_SAVE_CPU_IPL(ipl, 7);
+    
+    offset = faultReserved;
+    localTail = faultSegmentReserved;
+    sequence = lane->sequence;
+    
+    //Dropped records still use up a sequence number so the host can count
+    //the gap.
+    if(records == true)
+    {
+        lane->sequence = sequence + 1u;
+    }
+    
+    reserved = (required <= (uint16_t)((lane->fifoMask + 1u) - (uint16_t)(offset - lane->head))) &&
+               ((uint16_t)(localTail - lane->segmentHead) <= lane->segmentMask);
+    
+    if(reserved == true)
+    {
+        faultReserved = offset + required;
+        faultSegmentReserved = localTail + 1u;
+        faultWriters++;
+    }
+    
+    RESTORE_CPU_IPL(ipl);
+    
+    if(reserved == false)
+    {
+        CountDrop((policy == CONSOLE_OVERFLOW_ALL_OR_NOTHING) ? policy : CONSOLE_OVERFLOW_DROP_NEWEST, length);
+        return false;
+    }
+    
+    if(records == true)
+    {
+        RecordBegin(&writer, lane, offset, sequence);
+        RecordAppend(&writer, data, length);
+        span = RecordEnd(&writer);
+        
+        while(span < required)
+        {
+            lane->fifo[(offset + span++) & lane->fifoMask] = FRAME_DELIMITER;
+        }
+    }
+    else
+    {
+        span = (lane->fifoMask + 1u) - (offset & lane->fifoMask);
+        
+        if(span > length)
+        {
+            span = length;
+        }
+        
+        (void)memcpy(&lane->fifo[offset & lane->fifoMask], data, span);
+        (void)memcpy(&lane->fifo[0], &data[span], length - span);
+    }
+    
+    segment = &lane->segments[localTail & lane->segmentMask];
+    segment->data = NULL;
+    segment->length = required;
+    segment->memory = CONSOLE_MEMORY_RAM;
+    
+    SET_AND_SAVE_CPU_IPL(ipl, 7);
+    
+    if(--faultWriters == 0u)
+    {
+        FIFO_BARRIER();
+        lane->tail = faultReserved;
+        lane->segmentTail = faultSegmentReserved;
+    }
+    
+    RESTORE_CPU_IPL(ipl);
+    
+    UpdateHighWaterMark(lane);
+    
+    return true;
+}
+
+//Applies the overflow policy to make room for length FIFO bytes and
+//segments segments.  Returns the policy applied.
+static CONSOLE_OVERFLOW_POLICY MakeRoom(LANE* lane, uint16_t length, uint8_t segments)
+{
+    CONSOLE_OVERFLOW_POLICY policy = overflowPolicy;
+    
+    //Discarding moves the consumer's indices, which is only safe from the
+    //consumer's own context, so interrupts fall back to drop-newest.
+    if((policy == CONSOLE_OVERFLOW_DROP_OLDEST) && (SRbits.IPL != 0u))
+    {
+        policy = CONSOLE_OVERFLOW_DROP_NEWEST;
+    }
+    
+    if(IsSpaceAvailable(lane, length, segments) == false)
+    {
+        if(policy == CONSOLE_OVERFLOW_DROP_OLDEST)
+        {
+            DiscardOldest(lane, length, segments);
+        }
+        else if(policy == CONSOLE_OVERFLOW_BLOCK)
+        {
+            WaitForSpace(lane, length, segments);
+        }
+    }
+    
+    return policy;
+}
+
+static bool IsSpaceAvailable(LANE* lane, uint16_t length, uint8_t segments)
+{
+    uint16_t freeSegments = (lane->segmentMask + 1u) - (uint16_t)(lane->segmentTail - lane->segmentHead);
+    
+    return (segments <= freeSegments) && (length <= GetFIFOSpace(lane));
+}
+
+static void WaitForSpace(LANE* lane, uint16_t length, uint8_t segments)
+{
+    uint32_t start = USBGet1msTickCount();
+    
+    //Waiting only helps while CONSOLE_Tasks() can drain to the host, and it
+    //must never spin inside an interrupt (IPL above 0).  Anything queued
+    //from inside the wait drops newest instead of waiting in turn.
+    if((SRbits.IPL != 0u) || (waiting == true))
+    {
+        return;
+    }
+    
+    waiting = true;
+    
+    while((USBGetDeviceState() == CONFIGURED_STATE) &&
+          (IsSpaceAvailable(lane, length, segments) == false) &&
+          ((USBGet1msTickCount() - start) < overflowTimeout))
+    {
+        CONSOLE_Tasks();
+    }
+    
+    waiting = false;
+}
+
+static void DiscardOldest(LANE* lane, uint16_t length, uint8_t segments)
+{
+    uint16_t discarded;
+    
+    //The producer moves the consumer's indices here, so this policy is only
+    //safe when the producer and CONSOLE_Tasks() run in the same context.
+    //Whole segments are discarded so message boundaries are kept.
+    while((IsSpaceAvailable(lane, length, segments) == false) && (lane->segmentHead != lane->segmentTail))
+    {
+        discarded = DiscardSegment(lane);
+        CountDrop(CONSOLE_OVERFLOW_DROP_OLDEST, discarded);
+    }
+}
+
+static uint16_t DiscardSegment(LANE* lane)
+{
+    uint16_t localHead = lane->segmentHead;
+    SEGMENT* segment = &lane->segments[localHead & lane->segmentMask];
+    uint16_t remaining = segment->length - lane->segmentOffset;
+    
+    if(segment->memory == CONSOLE_MEMORY_RAM)
+    {
+        lane->head = lane->head + remaining;
+    }
+    
+    lane->segmentOffset = 0;
+    FIFO_BARRIER();
+    lane->segmentHead = localHead + 1u;
+    
+    return remaining;
+}
+
+//The counters are 32 bits wide and the fault lane is fed from interrupts,
+//so they are only updated, and read as a set, with interrupts masked.
+static void CountDrop(CONSOLE_OVERFLOW_POLICY policy, uint16_t bytes)
+{
+    uint16_t ipl;
+    
+    SET_AND_SAVE_CPU_IPL(ipl, 7);
+    statistics.policy[policy].droppedBytes += bytes;
+    statistics.policy[policy].droppedMessages++;
+    RESTORE_CPU_IPL(ipl);
+}
+
+static void CountSinkDrop(CONSOLE_SINK sink, uint16_t bytes)
+{
+    uint16_t ipl;
+    
+    SET_AND_SAVE_CPU_IPL(ipl, 7);
+    statistics.sinkDroppedBytes[sink] += bytes;
+    RESTORE_CPU_IPL(ipl);
+}
+
+static void UpdateHighWaterMark(LANE* lane)
+{
+    uint16_t depth = GetFIFODepth(lane);
+    uint16_t ipl;
+    
+    SET_AND_SAVE_CPU_IPL(ipl, 7);
+    
+    if(depth > statistics.highWaterMark[lane - lanes])
+    {
+        statistics.highWaterMark[lane - lanes] = depth;
+    }
+    
+    RESTORE_CPU_IPL(ipl);
+}
+
+static uint16_t BuildPacket(uint8_t* packet, uint16_t size)
+{
+    uint16_t count = 0;
+    uint8_t i;
+    
+    //A segment cut off by the end of the previous packet is finished first,
+    //so a higher lane only ever preempts at a segment boundary.
+    for(i = 0; i < (uint8_t)CONSOLE_LANE_COUNT; i++)
+    {
+        if(lanes[i].segmentOffset != 0u)
+        {
+            count = GetSegments(&lanes[i], packet, size, true);
+            break;
+        }
+    }
+    
+    for(i = 0; (i < (uint8_t)CONSOLE_LANE_COUNT) && (count < size); i++)
+    {
+        count += GetSegments(&lanes[i], &packet[count], size - count, false);
+    }
+    
+    return count;
+}
+
+#if defined(CONSOLE_COMPRESSION)
+static uint16_t BuildCompressedPacket(uint8_t* packet, uint16_t size)
+{
+    uint8_t input[MAX_PACKET];
+    uint16_t space;
+    uint16_t length;
+    
+    //Compress until the lanes are empty (or held back for coalescing) or the
+    //compressor's output is full; a partly filled packet is then sent as it
+    //is.  Output already compressed is always sent.
+    while((IsPacketDue() == true) && ((space = CONSOLE_LZSS_GetSpace()) != 0u))
+    {
+        length = BuildPacket(input, (space > sizeof(input)) ? sizeof(input) : space);
+        
+        if(length == 0u)
+        {
+            break;
+        }
+        
+        CONSOLE_LZSS_Write(input, length);
+    }
+    
+    return CONSOLE_LZSS_Read(packet, size);
+}
+#endif
+
+static uint16_t GetSegments(LANE* lane, uint8_t* packet, uint16_t size, bool oneSegment)
+{
+    uint16_t count = 0;
+    uint16_t chunk;
+    SEGMENT* segment;
+    
+    while((count < size) && (lane->segmentHead != lane->segmentTail))
+    {
+        segment = &lane->segments[lane->segmentHead & lane->segmentMask];
+        chunk = segment->length - lane->segmentOffset;
+        
+        if(chunk > (size - count))
+        {
+            chunk = size - count;
+        }
+        
+        if(segment->memory == CONSOLE_MEMORY_RAM)
+        {
+            (void)FIFOGet(lane, &packet[count], chunk);
+        }
+        else
+        {
+            DMA_COPY_Copy(&packet[count], &segment->data[lane->segmentOffset], chunk);
+        }
+        
+        count += chunk;
+        lane->segmentOffset += chunk;
+        
+        if(lane->segmentOffset != segment->length)
+        {
+            break;
+        }
+        
+        lane->segmentOffset = 0;
+        FIFO_BARRIER();
+        lane->segmentHead = lane->segmentHead + 1u;
+        
+        if(oneSegment == true)
+        {
+            break;
+        }
+    }
+    
+    return count;
+}
+
+static void FlushFIFO(void)
+{
+    uint8_t i;
+    
+    //Only the consumer side indices are moved, one segment at a time, so
+    //the producers are never raced.
+    for(i = 0; i < (uint8_t)CONSOLE_LANE_COUNT; i++)
+    {
+        while(lanes[i].segmentHead != lanes[i].segmentTail)
+        {
+            (void)DiscardSegment(&lanes[i]);
+        }
+    }
+}
+
+static uint16_t GetRecordSize(uint16_t length)
+{
+    uint16_t encoded = RECORD_HEADER_SIZE + length;
+    
+    //Worst case COBS output plus the delimiter.
+    return encoded + (encoded / COBS_BLOCK_SIZE) + 2u;
+}
+
+//The caller has checked that GetRecordSize() bytes are free from tail, and
+//the consumer sees none of the frame until the caller publishes it.
+static void RecordBegin(RECORD_WRITER* writer, LANE* lane, uint16_t tail, uint16_t sequence)
+{
+    uint32_t timestamp = USBGet1msTickCount();
+    uint8_t header[RECORD_HEADER_SIZE];
+    
+    header[0] = (uint8_t)sequence;
+    header[1] = (uint8_t)(sequence >> 8);
+    header[2] = (uint8_t)timestamp;
+    header[3] = (uint8_t)(timestamp >> 8);
+    header[4] = (uint8_t)(timestamp >> 16);
+    header[5] = (uint8_t)(timestamp >> 24);
+    header[6] = (uint8_t)(lane - lanes);
+    
+    writer->lane = lane;
+    writer->tail = tail;
+    writer->codeIndex = 0;
+    writer->count = 1;
+    writer->code = 1;
+    
+    RecordAppend(writer, header, sizeof(header));
+}
+
+static void RecordAppend(RECORD_WRITER* writer, const uint8_t* data, uint16_t length)
+{
+    uint8_t* fifo = writer->lane->fifo;
+    uint16_t mask = writer->lane->fifoMask;
+    uint16_t i;
+    
+    for(i = 0; i < length; i++)
+    {
+        if(data[i] == 0u)
+        {
+            fifo[(writer->tail + writer->codeIndex) & mask] = writer->code;
+            writer->codeIndex = writer->count++;
+            writer->code = 1;
+        }
+        else
+        {
+            fifo[(writer->tail + writer->count++) & mask] = data[i];
+            
+            if(++writer->code == COBS_MAX_CODE)
+            {
+                fifo[(writer->tail + writer->codeIndex) & mask] = writer->code;
+                writer->codeIndex = writer->count++;
+                writer->code = 1;
+            }
+        }
+    }
+}
+
+static uint16_t RecordEnd(RECORD_WRITER* writer)
+{
+    LANE* lane = writer->lane;
+    
+    lane->fifo[(writer->tail + writer->codeIndex) & lane->fifoMask] = writer->code;
+    lane->fifo[(writer->tail + writer->count++) & lane->fifoMask] = FRAME_DELIMITER;
+    
+    return writer->count;
+}
+
+static uint16_t GetFIFODepth(LANE* lane)
+{
+    return (uint16_t)(lane->tail - lane->head);
+}
+
+static uint16_t GetFIFOSpace(LANE* lane)
+{
+    return (uint16_t)((lane->fifoMask + 1u) - GetFIFODepth(lane));
+}
+
+static uint16_t FIFOPut(LANE* lane, const uint8_t* data, uint16_t length)
+{
+    uint16_t localTail = lane->tail;
+    uint16_t offset = localTail & lane->fifoMask;
+    uint16_t space = GetFIFOSpace(lane);
+    uint16_t span;
+    
+    if(length > space)
+    {
+        length = space;
+    }
+    
+    span = (lane->fifoMask + 1u) - offset;
+    
+    if(span > length)
+    {
+        span = length;
+    }
+    
+    (void)memcpy(&lane->fifo[offset], data, span);
+    (void)memcpy(&lane->fifo[0], &data[span], length - span);
+    
+    FIFO_BARRIER();
+    lane->tail = localTail + length;
+    
+    return length;
+}
+
+static uint16_t FIFOGet(LANE* lane, uint8_t* data, uint16_t length)
+{
+    uint16_t localHead = lane->head;
+    uint16_t offset = localHead & lane->fifoMask;
+    uint16_t depth = GetFIFODepth(lane);
+    uint16_t span;
+    
+    if(length > depth)
+    {
+        length = depth;
+    }
+    
+    span = (lane->fifoMask + 1u) - offset;
+    
+    if(span > length)
+    {
+        span = length;
+    }
+    
+    DMA_COPY_Copy(data, &lane->fifo[offset], span);
+    DMA_COPY_Copy(&data[span], &lane->fifo[0], length - span);
+    
+    FIFO_BARRIER();
+    lane->head = localHead + length;
+    
+    return length;
+}
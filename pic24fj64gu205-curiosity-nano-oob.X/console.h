@@ -15,8 +15,161 @@
 #ifndef CONSOLE_H
 #define CONSOLE_H
 
+#include <stdint.h>
+#include <stdbool.h>
+
+//What happens to a message that does not fit in its lane's FIFO.
+typedef enum
+{
+    CONSOLE_OVERFLOW_DROP_NEWEST,       //queue what fits, drop the rest
+    CONSOLE_OVERFLOW_DROP_OLDEST,       //discard queued bytes to make room
+    CONSOLE_OVERFLOW_BLOCK,             //drain to the host until it fits or the timeout expires, then drop newest
+    CONSOLE_OVERFLOW_ALL_OR_NOTHING,    //queue the whole message or none of it
+    CONSOLE_OVERFLOW_POLICY_COUNT
+} CONSOLE_OVERFLOW_POLICY;
+
+//Console priority lanes, highest first.  Each lane has its own FIFO.  The
+//fault lane is only fed through CONSOLE_PrintFault(), which is safe from
+//any context at any IPL, nested calls included.  The others must only be
+//fed from one context, normally the main loop; the functions that take a
+//lane refuse CONSOLE_LANE_FAULT and return false.
+typedef enum
+{
+    CONSOLE_LANE_FAULT,
+    CONSOLE_LANE_WARN,
+    CONSOLE_LANE_INFO,
+    CONSOLE_LANE_COUNT
+} CONSOLE_LANE;
+
+//Where console output goes.  Each sink takes the lanes from FAULT down to
+//its level.  The CDC sink keeps its output in the lanes while the host is
+//detached (subject to the overflow policy) and sends it once the host is
+//back; the UART (only built with CONSOLE_UART defined) and the RAM trace
+//get a copy of each message as it is queued.
+typedef enum
+{
+    CONSOLE_SINK_CDC,
+    CONSOLE_SINK_UART,
+    CONSOLE_SINK_TRACE,
+    CONSOLE_SINK_COUNT
+} CONSOLE_SINK;
+
+//CDC function of the CDC sink and the shell: the last one, so that on the
+//composite device (CDC_INSTANCE_COUNT of 2) logs never share a pipe with
+//application data on the first.
+#define CONSOLE_CDC_INSTANCE    (CDC_INSTANCE_COUNT - 1u)
+
+//Where a queued segment's data lives.
+typedef enum
+{
+    CONSOLE_MEMORY_RAM,     //copied into the console FIFO when queued
+    CONSOLE_MEMORY_CONST    //referenced until sent: constants (program memory through PSV) or static buffers that do not change
+} CONSOLE_MEMORY;
+
+//One part of a message given to CONSOLE_WriteMessage().
+typedef struct
+{
+    const uint8_t* data;
+    uint16_t length;
+    CONSOLE_MEMORY memory;
+} CONSOLE_PIECE;
+
+typedef struct
+{
+    uint32_t droppedBytes;
+    uint32_t droppedMessages;
+} CONSOLE_DROP_COUNT;
+
+typedef struct
+{
+    CONSOLE_DROP_COUNT policy[CONSOLE_OVERFLOW_POLICY_COUNT];  //indexed by the policy that dropped, DROP_OLDEST counts evictions
+    uint16_t highWaterMark[CONSOLE_LANE_COUNT];                 //deepest FIFO level seen per lane, in bytes
+    uint32_t repeatedMessages;                                  //consecutive duplicates folded into a summary
+    uint32_t rateLimitedMessages;                               //refused by a source's rate limit
+    uint32_t sinkDroppedBytes[CONSOLE_SINK_COUNT];              //bytes a copying sink had no room for
+} CONSOLE_STATISTICS;
+
+//Number of sources CONSOLE_SetRateLimit() can track.  CONSOLE_Log() uses
+//the message ID as the source.
+#define CONSOLE_SOURCE_COUNT 16u
+
+//Call once at startup.  Keeps the RAM trace from before a reset.
 void CONSOLE_Initialize(void);
-void CONSOLE_Print(char* input);
+
+//Queues on the info lane.  Returns false if any part of the string was
+//dropped.
+bool CONSOLE_Print(char* input);
+bool CONSOLE_PrintLane(CONSOLE_LANE lane, char* input);
+
+//The only path into the fault lane, safe from any context: space is
+//reserved with interrupts masked (IPL 7) for the few instructions it takes,
+//so one call may interrupt another.  The string is copied, queued whole or
+//not at all, and this never blocks or discards older messages.
+bool CONSOLE_PrintFault(const char* input);
+
+//printf subset written straight into the lane FIFO, with no buffer or heap:
+//%d %i %u %x %X %c %s %% with an optional - or 0 flag, width and l (32-bit)
+//modifier.  A NULL %s prints (null).  The message is formatted twice, to
+//measure it so that the overflow policy can make room for all of it, then
+//into the lane.  Output that still does not fit is truncated as by
+//CONSOLE_Print(), or dropped whole under ALL_OR_NOTHING; in record mode the
+//record is queued whole or not at all.  Arguments are checked against the
+//format string at compile time.
+bool CONSOLE_Printf(const char* format, ...) __attribute__((format(printf, 1, 2)));
+bool CONSOLE_PrintfLane(CONSOLE_LANE lane, const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+//Queues a reference to a string that stays valid and unchanged until sent,
+//such as a literal.  Nothing is copied until the packet is built.
+bool CONSOLE_PrintConst(const char* input);
+
+//Queues length bytes (which may include 0x00) as a unit: they are never
+//truncated, only dropped whole.  Returns false if they were dropped.
+bool CONSOLE_Write(const uint8_t* data, uint16_t length);
+bool CONSOLE_WriteSegment(CONSOLE_LANE lane, const uint8_t* data, uint16_t length, CONSOLE_MEMORY memory);
+
+//Queues count pieces as one message, under the same rules as
+//CONSOLE_Write(): all of them or none, and in record mode a single record.
+//RAM pieces are copied, CONST pieces referenced.
+bool CONSOLE_WriteMessage(CONSOLE_LANE lane, const CONSOLE_PIECE* pieces, uint8_t count);
+
+//Inside an interrupt DROP_OLDEST acts as DROP_NEWEST and BLOCK does not
+//wait, since neither may touch the consumer side from there.
+void CONSOLE_SetOverflowPolicy(CONSOLE_OVERFLOW_POLICY policy, uint16_t timeoutMilliseconds);
+
+//In record mode every queued message becomes one COBS frame (ended by
+//0x00) holding a per-lane sequence number, the 1ms tick, the lane and the
+//message.  Defaults to on when CONSOLE_RECORDS is defined.
+void CONSOLE_SetRecordMode(bool enable);
+
+//Token bucket per source: up to burst messages at once, then one more every
+//refillMilliseconds.  A burst of 0 (the default) removes the limit.
+void CONSOLE_SetRateLimit(uint8_t source, uint8_t burst, uint16_t refillMilliseconds);
+
+//Less than a full CDC packet is held back for up to deadlineMilliseconds so
+//that a burst of short writes goes out in full packets instead of one
+//packet each.  The fault lane is never held.  0 sends at once.
+void CONSOLE_SetCoalescing(uint16_t deadlineMilliseconds);
+
+//Sends everything queued so far on the next CONSOLE_Tasks() without
+//waiting for the coalescing deadline.
+void CONSOLE_Flush(void);
+
+//Main loop only.  Called before a message is queued; returns false if it
+//must be skipped, either because it repeats the previous message (same
+//source and signature) or because the source is over its rate limit.
+//Repeats are reported as one "last message repeated N times" line once the
+//message changes, any other text is printed, or at most a second later.
+bool CONSOLE_Admit(uint8_t source, uint32_t signature);
+
+void CONSOLE_SetSink(CONSOLE_SINK sink, bool enable, CONSOLE_LANE level);
+
+//Queues the RAM trace, including what survived the last reset, on the CDC
+//sink.  It is sent in chunks as room frees up in the info lane.
+void CONSOLE_ReplayTrace(void);
+
+void CONSOLE_GetStatistics(CONSOLE_STATISTICS* statistics);
+void CONSOLE_ClearStatistics(void);
+
 void CONSOLE_Tasks(void);
 
 #endif
@@ -0,0 +1,289 @@
+//Copyright 2016 Microchip Technology Inc. (www.microchip.com)
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "console.h"
+#include "console_log.h"
+
+#define RECORD_START        0x00u
+#define RECORD_HEADER_SIZE  4u
+#define ARGUMENT_SIZE       4u
+
+#define FNV_OFFSET_BASIS    0x811C9DC5ul
+#define FNV_PRIME           0x01000193ul
+
+static uint32_t GetSignature(CONSOLE_LOG_ID id, uint8_t count, const uint32_t* arguments);
+
+#if defined(CONSOLE_LOG_TOKENIZED)
+
+bool CONSOLE_Log(CONSOLE_LOG_ID id, uint8_t count, const uint32_t* arguments)
+{
+    uint8_t record[RECORD_HEADER_SIZE + (CONSOLE_LOG_MAX_ARGUMENTS * ARGUMENT_SIZE)];
+    uint8_t length = RECORD_HEADER_SIZE;
+    uint32_t value;
+    uint8_t i;
+    uint8_t j;
+    
+    if(count > CONSOLE_LOG_MAX_ARGUMENTS)
+    {
+        count = CONSOLE_LOG_MAX_ARGUMENTS;
+    }
+    
+    if(CONSOLE_Admit((uint8_t)id, GetSignature(id, count, arguments)) == false)
+    {
+        return false;
+    }
+    
+    record[0] = RECORD_START;
+    record[1] = (uint8_t)id;
+    record[2] = (uint8_t)((uint16_t)id >> 8);
+    record[3] = count;
+    
+    for(i = 0; i < count; i++)
+    {
+        value = arguments[i];
+        
+        for(j = 0; j < ARGUMENT_SIZE; j++)
+        {
+            record[length++] = (uint8_t)value;
+            value >>= 8;
+        }
+    }
+    
+    //A record is queued whole or not at all so the host never loses sync.
+    return CONSOLE_Write(record, length);
+}
+
+#else
+
+static const char* const logStrings[CONSOLE_LOG_ID_COUNT] =
+{
+#define CONSOLE_LOG_STRING(id, text) text,
+#include "console_log_strings.h"
+#undef CONSOLE_LOG_STRING
+};
+
+//A message is put together as a list of pieces and queued as one unit, so
+//that in record mode it is one record.  Numbers and short literals are
+//gathered in a small RAM buffer; literals of at least REFERENCE_SIZE bytes,
+//or that the buffer has no room for, are queued by reference instead.
+#define TEXT_SIZE       64u
+#define REFERENCE_SIZE  16u
+#define NUMBER_SIZE     11u
+
+//A literal before, between and after the arguments, and the arguments.
+#define PIECE_COUNT     ((2u * CONSOLE_LOG_MAX_ARGUMENTS) + 1u)
+
+typedef struct
+{
+    CONSOLE_PIECE pieces[PIECE_COUNT];
+    uint8_t count;
+    uint8_t text[TEXT_SIZE];
+    uint8_t length;
+    uint8_t reserved;                       //text room kept for the arguments still to come
+    bool complete;
+} MESSAGE;
+
+static void PrintLiteral(MESSAGE* message, const char* text, const char* end);
+static void PrintArgument(MESSAGE* message, char conversion, uint32_t value);
+static void AddText(MESSAGE* message, const char* text, uint8_t length);
+static void AddReference(MESSAGE* message, const char* text, uint16_t length);
+
+bool CONSOLE_Log(CONSOLE_LOG_ID id, uint8_t count, const uint32_t* arguments)
+{
+    const char* format = logStrings[id];
+    const char* literal = format;
+    uint8_t argument = 0;
+    MESSAGE message;
+    
+    if(CONSOLE_Admit((uint8_t)id, GetSignature(id, count, arguments)) == false)
+    {
+        return false;
+    }
+    
+    if(count > CONSOLE_LOG_MAX_ARGUMENTS)
+    {
+        count = CONSOLE_LOG_MAX_ARGUMENTS;
+    }
+    
+    message.count = 0;
+    message.length = 0;
+    message.reserved = count * NUMBER_SIZE;
+    message.complete = true;
+    
+    while(*format != 0)
+    {
+        if(*format != '%')
+        {
+            format++;
+            continue;
+        }
+        
+        PrintLiteral(&message, literal, format);
+        format++;
+        
+        if(*format == '%')
+        {
+            PrintLiteral(&message, format, &format[1]);
+        }
+        else if((*format != 0) && (argument < count))
+        {
+            PrintArgument(&message, *format, arguments[argument++]);
+        }
+        
+        if(*format != 0)
+        {
+            format++;
+        }
+        
+        literal = format;
+    }
+    
+    PrintLiteral(&message, literal, format);
+    
+    return CONSOLE_WriteMessage(CONSOLE_LANE_INFO, message.pieces, message.count) && message.complete;
+}
+
+static void PrintLiteral(MESSAGE* message, const char* text, const char* end)
+{
+    uint16_t length = (uint16_t)(end - text);
+    
+    //The format strings are constants, so they can be queued by reference.
+    if((length >= REFERENCE_SIZE) || ((message->length + length + message->reserved) > TEXT_SIZE))
+    {
+        AddReference(message, text, length);
+    }
+    else
+    {
+        AddText(message, text, (uint8_t)length);
+    }
+}
+
+static void PrintArgument(MESSAGE* message, char conversion, uint32_t value)
+{
+    static const char digits[] = "0123456789ABCDEF";
+    char text[NUMBER_SIZE];
+    uint8_t i = sizeof(text);
+    uint8_t base = 10u;
+    bool negative = false;
+    
+    if(conversion == 'x')
+    {
+        base = 16u;
+    }
+    else if((conversion == 'd') && ((int32_t)value < 0))
+    {
+        negative = true;
+        value = (uint32_t)(-(int32_t)value);
+    }
+    
+    do
+    {
+        text[--i] = digits[value % base];
+        value /= base;
+    } while(value != 0u);
+    
+    if(negative == true)
+    {
+        text[--i] = '-';
+    }
+    
+    message->reserved -= NUMBER_SIZE;
+    AddText(message, &text[i], (uint8_t)(sizeof(text) - i));
+}
+
+//The RAM pieces are laid out in the buffer one after the other, so text
+//following a RAM piece extends it.
+static void AddText(MESSAGE* message, const char* text, uint8_t length)
+{
+    CONSOLE_PIECE* piece;
+    
+    if(length == 0u)
+    {
+        return;
+    }
+    
+    if((message->count != 0u) && (message->pieces[message->count - 1u].memory == CONSOLE_MEMORY_RAM))
+    {
+        message->pieces[message->count - 1u].length += length;
+    }
+    else if(message->count < PIECE_COUNT)
+    {
+        piece = &message->pieces[message->count++];
+        piece->data = &message->text[message->length];
+        piece->length = length;
+        piece->memory = CONSOLE_MEMORY_RAM;
+    }
+    else
+    {
+        message->complete = false;
+        return;
+    }
+    
+    (void)memcpy(&message->text[message->length], text, length);
+    message->length += length;
+}
+
+static void AddReference(MESSAGE* message, const char* text, uint16_t length)
+{
+    CONSOLE_PIECE* piece;
+    
+    if(length == 0u)
+    {
+        return;
+    }
+    
+    if(message->count >= PIECE_COUNT)
+    {
+        message->complete = false;
+        return;
+    }
+    
+    piece = &message->pieces[message->count++];
+    piece->data = (const uint8_t*)text;
+    piece->length = length;
+    piece->memory = CONSOLE_MEMORY_CONST;
+}
+
+#endif
+
+//FNV-1a over the ID and the argument values: equal messages always give the
+//same signature, which is all repeat detection needs.
+static uint32_t GetSignature(CONSOLE_LOG_ID id, uint8_t count, const uint32_t* arguments)
+{
+    uint32_t hash = FNV_OFFSET_BASIS;
+    uint32_t value = (uint32_t)id;
+    uint8_t i;
+    uint8_t j;
+    
+    for(i = 0; i <= count; i++)
+    {
+        for(j = 0; j < ARGUMENT_SIZE; j++)
+        {
+            hash = (hash ^ (uint8_t)value) * FNV_PRIME;
+            value >>= 8;
+        }
+        
+        if(i < count)
+        {
+            value = arguments[i];
+        }
+    }
+    
+    return hash;
+}
@@ -0,0 +1,66 @@
+//Copyright 2016 Microchip Technology Inc. (www.microchip.com)
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+#ifndef CONSOLE_LOG_H
+#define CONSOLE_LOG_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+//Define CONSOLE_LOG_TOKENIZED to send each CONSOLE_LOG() call as a binary
+//record instead of text.  A record is:
+//
+//  0x00, ID (16-bit little endian), argument count, arguments (32-bit little
+//  endian each)
+//
+//Console text never contains 0x00, so records and CONSOLE_Print() output can
+//share the stream.  tools/console_log.py rebuilds the text on the host from
+//console_log_strings.h.
+
+typedef enum
+{
+#define CONSOLE_LOG_STRING(id, text) id,
+#include "console_log_strings.h"
+#undef CONSOLE_LOG_STRING
+    CONSOLE_LOG_ID_COUNT
+} CONSOLE_LOG_ID;
+
+#define CONSOLE_LOG_MAX_ARGUMENTS 4u
+
+#define CONSOLE_LOG0(id)            CONSOLE_Log((id), 0u, NULL)
+#define CONSOLE_LOG1(id, a)         CONSOLE_Log((id), 1u, (const uint32_t[]){(uint32_t)(a)})
+#define CONSOLE_LOG2(id, a, b)      CONSOLE_Log((id), 2u, (const uint32_t[]){(uint32_t)(a), (uint32_t)(b)})
+#define CONSOLE_LOG3(id, a, b, c)   CONSOLE_Log((id), 3u, (const uint32_t[]){(uint32_t)(a), (uint32_t)(b), (uint32_t)(c)})
+
+/*********************************************************************
+* Function: bool CONSOLE_Log(CONSOLE_LOG_ID id, uint8_t count, const uint32_t* arguments);
+*
+* Overview: Queues a log message on the console, either as text or as a
+*           tokenized record (see CONSOLE_LOG_TOKENIZED).
+*
+* PreCondition: None
+*
+* Input: id - entry of console_log_strings.h to log
+*        count - number of arguments (at most CONSOLE_LOG_MAX_ARGUMENTS)
+*        arguments - argument values, in format string order
+*
+* Output: true if the whole message was queued, false if it was dropped,
+*         folded into a repeat count or refused by the ID's rate limit
+*         (see CONSOLE_Admit())
+*
+********************************************************************/
+bool CONSOLE_Log(CONSOLE_LOG_ID id, uint8_t count, const uint32_t* arguments);
+
+#endif //CONSOLE_LOG_H
@@ -0,0 +1,58 @@
+//Copyright 2016 Microchip Technology Inc. (www.microchip.com)
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+//Format string table for CONSOLE_LOG().  This file is included more than
+//once (no include guard): console_log.h builds the CONSOLE_LOG_ID enum from
+//it and console_log.c builds the text table, and tools/console_log.py reads
+//it to build the host-side string table.  Append new entries at the end so
+//existing IDs keep their value.
+//
+//Supported conversions are %u, %d, %x and %%.  Every argument is logged as
+//32 bits.
+
+CONSOLE_LOG_STRING(CONSOLE_LOG_WELCOME,
+    "\r\n"
+    "*******************************************************\r\n"
+    "PIC24FJ64GU205 Curiosity Nano Demo\r\n"
+    "*******************************************************\r\n")
+
+CONSOLE_LOG_STRING(CONSOLE_LOG_BUTTON_PRESSED,
+    "Button Pressed\r\n")
+
+CONSOLE_LOG_STRING(CONSOLE_LOG_SHELL_DROPS,
+    "policy %u: %u bytes, %u messages dropped\r\n")
+
+CONSOLE_LOG_STRING(CONSOLE_LOG_SHELL_HIGH_WATER,
+    "lane %u: FIFO high water mark %u bytes\r\n")
+
+CONSOLE_LOG_STRING(CONSOLE_LOG_SHELL_UPTIME,
+    "%u ms\r\n")
+
+CONSOLE_LOG_STRING(CONSOLE_LOG_SHELL_SUPPRESSED,
+    "%u repeats folded, %u messages rate limited\r\n")
+
+CONSOLE_LOG_STRING(CONSOLE_LOG_SHELL_SINK_DROPS,
+    "sink %u: %u bytes dropped\r\n")
+
+CONSOLE_LOG_STRING(CONSOLE_LOG_SHELL_RX_HIGH_WATER,
+    "USB RX ring high water mark %u of %u bytes\r\n")
+
+CONSOLE_LOG_STRING(CONSOLE_LOG_SHELL_MASKED,
+    "USB interrupt masked by CDC for at most %u timer counts\r\n")
+
+CONSOLE_LOG_STRING(CONSOLE_LOG_SHELL_COPY,
+    "64 byte packet copy: %u timer counts by DMA_COPY_Copy(), %u by memcpy()\r\n")
+
+CONSOLE_LOG_STRING(CONSOLE_LOG_SHELL_RX_THROTTLED,
+    "USB RX flow control held the host off %u times\r\n")
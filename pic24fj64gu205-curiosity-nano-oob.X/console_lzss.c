@@ -0,0 +1,281 @@
+//Copyright 2016 Microchip Technology Inc. (www.microchip.com)
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "console_lzss.h"
+
+#if defined(CONSOLE_COMPRESSION)
+
+#define WINDOW_SIZE     512u
+#define WINDOW_MASK     (WINDOW_SIZE - 1u)
+#define MIN_MATCH       3u
+#define MAX_MATCH       (MIN_MATCH + 126u)
+#define GOOD_MATCH      32u
+#define END_OF_GROUP    0x7Fu
+#define GROUP_ITEMS     8u
+#define INPUT_CHUNK     32u
+
+//Every position of the window is on a hash chain by its first three bytes.
+//FindMatch() follows at most MAX_CANDIDATES links of a chain, so one call
+//compares at most MAX_CANDIDATES * MAX_MATCH bytes however repetitive the
+//window is.
+#define HASH_SIZE       128u
+#define MAX_CANDIDATES  8u
+#define NO_POSITION     0xFFFFu
+
+//Room for two full USB packets: one being handed out while the next is
+//compressed behind it.
+#define OUTPUT_SIZE     128u
+
+static uint8_t window[WINDOW_SIZE];
+static uint16_t windowPosition;
+static uint16_t windowFill;
+static uint16_t hashHeads[HASH_SIZE];
+static uint16_t hashChain[WINDOW_SIZE];
+static uint16_t hashPosition;
+static uint8_t output[OUTPUT_SIZE];
+static uint16_t outputLength;
+static uint16_t flagIndex;
+static uint8_t flagBit = GROUP_ITEMS;
+
+static uint8_t GetHash(uint8_t first, uint8_t second, uint8_t third);
+static uint16_t FindMatch(const uint8_t* data, uint16_t index, uint16_t length, uint16_t* distance);
+static void AddToWindow(const uint8_t* data, uint16_t length);
+static void HashPositions(const uint8_t* data, uint16_t index, uint16_t length);
+static uint8_t GetByte(const uint8_t* data, uint16_t index, uint16_t position);
+static void PutItem(bool literal);
+
+void CONSOLE_LZSS_Initialize(void)
+{
+    windowPosition = 0;
+    windowFill = 0;
+    hashPosition = 0;
+    (void)memset(hashHeads, 0xFF, sizeof(hashHeads));
+    outputLength = 0;
+    flagBit = GROUP_ITEMS;
+}
+
+uint16_t CONSOLE_LZSS_GetSpace(void)
+{
+    uint16_t free = OUTPUT_SIZE - outputLength;
+    uint16_t space;
+    
+    //Worst case every input byte is a literal, plus a flag byte per eight
+    //of them and one more for a group opened part way.  Three bytes are
+    //kept back for ending a group (flag byte and end marker).
+    if(free <= 5u)
+    {
+        return 0;
+    }
+    
+    space = ((free - 5u) * GROUP_ITEMS) / (GROUP_ITEMS + 1u);
+    
+    return (space > INPUT_CHUNK) ? INPUT_CHUNK : space;
+}
+
+void CONSOLE_LZSS_Write(const uint8_t* data, uint16_t length)
+{
+    uint16_t index = 0;
+    uint16_t match;
+    uint16_t distance;
+    
+    while(index < length)
+    {
+        HashPositions(data, index, length);
+        match = FindMatch(data, index, length, &distance);
+        
+        if(match >= MIN_MATCH)
+        {
+            PutItem(false);
+            distance--;
+            output[outputLength++] = (uint8_t)distance;
+            output[outputLength++] = (uint8_t)(((distance >> 8) << 7) | (match - MIN_MATCH));
+        }
+        else
+        {
+            PutItem(true);
+            output[outputLength++] = data[index];
+            match = 1;
+        }
+        
+        AddToWindow(&data[index], match);
+        index += match;
+    }
+}
+
+uint16_t CONSOLE_LZSS_Read(uint8_t* packet, uint16_t size)
+{
+    uint16_t ready = (flagBit < GROUP_ITEMS) ? flagIndex : outputLength;
+    
+    if((ready < size) && (flagBit < GROUP_ITEMS))
+    {
+        PutItem(false);
+        output[outputLength++] = 0;
+        output[outputLength++] = END_OF_GROUP;
+        flagBit = GROUP_ITEMS;
+        ready = outputLength;
+    }
+    
+    if(ready > size)
+    {
+        ready = size;
+    }
+    
+    (void)memcpy(packet, output, ready);
+    (void)memmove(output, &output[ready], outputLength - ready);
+    outputLength -= ready;
+    flagIndex -= ready;
+    
+    return ready;
+}
+
+//index is the stream position windowPosition: the bytes before it are in
+//the window, the bytes from it on are still in data.  The chain gives the
+//candidates nearest first, so short distances win ties, and a match may run
+//on into the bytes it is copying (distance less than length).
+static uint16_t FindMatch(const uint8_t* data, uint16_t index, uint16_t length, uint16_t* distance)
+{
+    uint16_t limit = length - index;
+    uint16_t best = 0;
+    uint16_t candidate;
+    uint16_t candidateDistance;
+    uint16_t previousDistance = 0;
+    uint16_t count;
+    uint8_t tries;
+    uint8_t value;
+    
+    if(limit > MAX_MATCH)
+    {
+        limit = MAX_MATCH;
+    }
+    
+    if(limit < MIN_MATCH)
+    {
+        return 0;
+    }
+    
+    candidate = hashHeads[GetHash(data[index], data[index + 1u], data[index + 2u])];
+    
+    for(tries = 0; tries < MAX_CANDIDATES; tries++)
+    {
+        //A link to a position that has since left the window, or been
+        //overwritten by a newer one, ends the chain.
+        candidateDistance = windowPosition - candidate;
+        
+        if((candidate == NO_POSITION) || (candidateDistance <= previousDistance) || (candidateDistance > windowFill))
+        {
+            break;
+        }
+        
+        previousDistance = candidateDistance;
+        
+        for(count = 0; count < limit; count++)
+        {
+            if(count < candidateDistance)
+            {
+                value = window[(candidate + count) & WINDOW_MASK];
+            }
+            else
+            {
+                value = data[index + count - candidateDistance];
+            }
+            
+            if(value != data[index + count])
+            {
+                break;
+            }
+        }
+        
+        if(count > best)
+        {
+            best = count;
+            *distance = candidateDistance;
+            
+            if(best >= GOOD_MATCH)
+            {
+                break;
+            }
+        }
+        
+        candidate = hashChain[candidate & WINDOW_MASK];
+    }
+    
+    return best;
+}
+
+static void AddToWindow(const uint8_t* data, uint16_t length)
+{
+    uint16_t i;
+    
+    for(i = 0; i < length; i++)
+    {
+        window[windowPosition & WINDOW_MASK] = data[i];
+        windowPosition++;
+    }
+    
+    windowFill = ((windowFill + length) > WINDOW_SIZE) ? WINDOW_SIZE : (windowFill + length);
+}
+
+//Chains every window position whose three bytes are known by now, the last
+//two of them possibly still in data.  The two positions before the end of a
+//chunk wait for the next one.
+static void HashPositions(const uint8_t* data, uint16_t index, uint16_t length)
+{
+    uint16_t known = windowPosition + (length - index);
+    uint8_t hash;
+    
+    while((hashPosition != windowPosition) && ((uint16_t)(known - hashPosition) >= MIN_MATCH))
+    {
+        hash = GetHash(GetByte(data, index, hashPosition), GetByte(data, index, hashPosition + 1u),
+                       GetByte(data, index, hashPosition + 2u));
+        hashChain[hashPosition & WINDOW_MASK] = hashHeads[hash];
+        hashHeads[hash] = hashPosition;
+        hashPosition++;
+    }
+}
+
+static uint8_t GetHash(uint8_t first, uint8_t second, uint8_t third)
+{
+    return (uint8_t)(((first << 4) ^ (second << 2) ^ third) & (HASH_SIZE - 1u));
+}
+
+static uint8_t GetByte(const uint8_t* data, uint16_t index, uint16_t position)
+{
+    uint16_t ahead = position - windowPosition;
+    
+    return (ahead < WINDOW_SIZE) ? data[index + ahead] : window[position & WINDOW_MASK];
+}
+
+static void PutItem(bool literal)
+{
+    if(flagBit >= GROUP_ITEMS)
+    {
+        flagIndex = outputLength++;
+        output[flagIndex] = 0;
+        flagBit = 0;
+    }
+    
+    if(literal == true)
+    {
+        output[flagIndex] |= (uint8_t)(1u << flagBit);
+    }
+    
+    flagBit++;
+}
+
+#endif
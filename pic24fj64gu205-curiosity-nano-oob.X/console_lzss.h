@@ -0,0 +1,99 @@
+//Copyright 2016 Microchip Technology Inc. (www.microchip.com)
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+
+#ifndef CONSOLE_LZSS_H
+#define CONSOLE_LZSS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+//Streaming LZSS compressor for the console (enabled by defining
+//CONSOLE_COMPRESSION).  It uses a fixed 512 byte history window and no heap.
+//
+//The stream is a sequence of groups: a flag byte followed by up to eight
+//items, one per flag bit starting at bit 0.  A set bit is a literal byte.  A
+//clear bit is a two byte match:
+//
+//  byte 0 - distance - 1, bits 0-7
+//  byte 1 - bit 7: distance - 1, bit 8; bits 0-6: length - 3 (3 to 129)
+//
+//A length field of 0x7F instead ends the group early, so the data gathered so
+//far can be sent without waiting for eight items.  A match never reaches back
+//before the start of the stream, which restarts whenever the console is
+//reinitialized (USB detach).
+//tools/console_log.py decode --lzss undoes it on the host.
+
+/*********************************************************************
+* Function: void CONSOLE_LZSS_Initialize(void);
+*
+* Overview: Clears the history window and any pending output.
+*
+* PreCondition: None
+*
+* Input: None
+*
+* Output: None
+*
+********************************************************************/
+void CONSOLE_LZSS_Initialize(void);
+
+/*********************************************************************
+* Function: uint16_t CONSOLE_LZSS_GetSpace(void);
+*
+* Overview: Returns how many input bytes CONSOLE_LZSS_Write() can take
+*           right now without its output overflowing.
+*
+* PreCondition: None
+*
+* Input: None
+*
+* Output: number of bytes
+*
+********************************************************************/
+uint16_t CONSOLE_LZSS_GetSpace(void);
+
+/*********************************************************************
+* Function: void CONSOLE_LZSS_Write(const uint8_t* data, uint16_t length);
+*
+* Overview: Compresses data into the pending output.
+*
+* PreCondition: length is no more than CONSOLE_LZSS_GetSpace()
+*
+* Input: data - bytes to compress
+*        length - number of bytes
+*
+* Output: None
+*
+********************************************************************/
+void CONSOLE_LZSS_Write(const uint8_t* data, uint16_t length);
+
+/*********************************************************************
+* Function: uint16_t CONSOLE_LZSS_Read(uint8_t* packet, uint16_t size);
+*
+* Overview: Moves compressed output into a packet.  If less than a full
+*           packet is ready the open group is ended so that nothing
+*           written so far is held back.
+*
+* PreCondition: None
+*
+* Input: packet - where to put the compressed bytes
+*        size - room in packet
+*
+* Output: number of bytes put in packet
+*
+********************************************************************/
+uint16_t CONSOLE_LZSS_Read(uint8_t* packet, uint16_t size);
+
+#endif //CONSOLE_LZSS_H
@@ -0,0 +1,183 @@
+//Copyright 2016 Microchip Technology Inc. (www.microchip.com)
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+
+#include <xc.h>
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "console_trace.h"
+
+#define TRACE_SIZE  1024u
+#define TRACE_MASK  (TRACE_SIZE - 1u)
+#define TRACE_MAGIC 0x7C3Eu
+
+#if (TRACE_SIZE & TRACE_MASK) != 0u
+#error "TRACE_SIZE must be a power of two"
+#endif
+
+//head and tail are free running like the console FIFO indices.  check ties
+//them to magic, so a ring left in a random power-up state is not trusted.
+typedef struct
+{
+    uint16_t magic;
+    uint16_t head;
+    uint16_t tail;
+    uint16_t check;
+    uint8_t data[TRACE_SIZE];
+} TRACE;
+
+//Placed in .pbss: the startup code does not clear it.
+static TRACE trace __attribute__((persistent));
+
+//Space handed out to writers still filling it, beyond trace.tail.
+static volatile uint16_t reserved;
+static volatile uint8_t writers;
+
+static const char resetMarker[] = "\r\n--- reset ---\r\n";
+
+static uint16_t GetCheck(void);
+
+void CONSOLE_TRACE_Initialize(void)
+{
+    writers = 0;
+    
+    if((trace.magic == TRACE_MAGIC) &&
+       (trace.check == GetCheck()) &&
+       ((uint16_t)(trace.tail - trace.head) <= TRACE_SIZE))
+    {
+        reserved = trace.tail;
+        (void)CONSOLE_TRACE_Write((const uint8_t*)resetMarker, sizeof(resetMarker) - 1u);
+    }
+    else
+    {
+        trace.head = 0;
+        trace.tail = 0;
+        trace.magic = TRACE_MAGIC;
+        trace.check = GetCheck();
+        reserved = 0;
+    }
+}
+
+uint16_t CONSOLE_TRACE_Write(const uint8_t* data, uint16_t length)
+{
+    uint16_t ipl;
+    uint16_t offset;
+    uint16_t span;
+    uint16_t copy = length;
+    
+    //Only the newest TRACE_SIZE bytes can be kept anyway.
+    if(copy > TRACE_SIZE)
+    {
+        data = &data[copy - TRACE_SIZE];
+        copy = TRACE_SIZE;
+    }
+    
+    //Interrupts may write too.  Only reserving the space, and dropping the
+    //oldest bytes it overwrites, is done with interrupts masked; the copy is
+    //not.  A writer interrupted while copying finishes last, and publishes
+    //the tail for all of them, so the trace never ends in a partial write.
+    SET_AND_SAVE_CPU_IPL(ipl, 7);
+    
+    offset = reserved;
+    reserved = offset + copy;
+    writers++;
+    
+    if((uint16_t)(reserved - trace.head) > TRACE_SIZE)
+    {
+        trace.head = reserved - TRACE_SIZE;
+        trace.check = GetCheck();
+    }
+    
+    RESTORE_CPU_IPL(ipl);
+    
+    offset &= TRACE_MASK;
+    span = TRACE_SIZE - offset;
+    
+    if(span > copy)
+    {
+        span = copy;
+    }
+    
+    (void)memcpy(&trace.data[offset], data, span);
+    (void)memcpy(&trace.data[0], &data[span], copy - span);
+    
+    SET_AND_SAVE_CPU_IPL(ipl, 7);
+    
+    if(--writers == 0u)
+    {
+        trace.tail = reserved;
+        trace.check = GetCheck();
+    }
+    
+    RESTORE_CPU_IPL(ipl);
+    
+    return length;
+}
+
+uint16_t CONSOLE_TRACE_GetStart(void)
+{
+    return trace.head;
+}
+
+uint16_t CONSOLE_TRACE_GetEnd(void)
+{
+    return trace.tail;
+}
+
+uint16_t CONSOLE_TRACE_Read(uint16_t* position, uint8_t* data, uint16_t size)
+{
+    uint16_t ipl;
+    uint16_t available;
+    uint16_t offset;
+    uint16_t span;
+    
+    SET_AND_SAVE_CPU_IPL(ipl, 7);
+    
+    if((uint16_t)(trace.tail - *position) > (uint16_t)(trace.tail - trace.head))
+    {
+        *position = trace.head;
+    }
+    
+    available = trace.tail - *position;
+    
+    if(size > available)
+    {
+        size = available;
+    }
+    
+    offset = *position & TRACE_MASK;
+    span = TRACE_SIZE - offset;
+    
+    if(span > size)
+    {
+        span = size;
+    }
+    
+    (void)memcpy(data, &trace.data[offset], span);
+    (void)memcpy(&data[span], &trace.data[0], size - span);
+    
+    *position += size;
+    
+    RESTORE_CPU_IPL(ipl);
+    
+    return size;
+}
+
+static uint16_t GetCheck(void)
+{
+    return (uint16_t)~(TRACE_MAGIC ^ trace.head ^ trace.tail);
+}
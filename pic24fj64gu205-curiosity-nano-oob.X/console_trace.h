@@ -0,0 +1,103 @@
+//Copyright 2016 Microchip Technology Inc. (www.microchip.com)
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+
+#ifndef CONSOLE_TRACE_H
+#define CONSOLE_TRACE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+//Console sink that keeps the most recent output in a RAM ring which is not
+//cleared at startup, so the log leading up to a reset (watchdog, trap,
+//MCLR) can still be read afterwards.  A power cycle loses it.
+
+/*********************************************************************
+* Function: void CONSOLE_TRACE_Initialize(void);
+*
+* Overview: Keeps the trace left by the previous run if it is intact, and
+*           marks the reset in it, or starts an empty trace otherwise.
+*
+* PreCondition: None
+*
+* Input: None
+*
+* Output: None
+*
+********************************************************************/
+void CONSOLE_TRACE_Initialize(void);
+
+/*********************************************************************
+* Function: uint16_t CONSOLE_TRACE_Write(const uint8_t* data, uint16_t length);
+*
+* Overview: Appends to the trace, overwriting the oldest bytes.  Safe to
+*           call from interrupts.
+*
+* PreCondition: CONSOLE_TRACE_Initialize() was called
+*
+* Input: data - bytes to append
+*        length - number of bytes
+*
+* Output: length (the trace always accepts everything)
+*
+********************************************************************/
+uint16_t CONSOLE_TRACE_Write(const uint8_t* data, uint16_t length);
+
+/*********************************************************************
+* Function: uint16_t CONSOLE_TRACE_GetStart(void);
+*
+* Overview: Returns the position of the oldest byte still in the trace,
+*           to start a CONSOLE_TRACE_Read() from.
+*
+* PreCondition: CONSOLE_TRACE_Initialize() was called
+*
+* Input: None
+*
+* Output: position (free running)
+*
+********************************************************************/
+uint16_t CONSOLE_TRACE_GetStart(void);
+
+/*********************************************************************
+* Function: uint16_t CONSOLE_TRACE_GetEnd(void);
+*
+* Overview: Returns the position just past the newest byte in the trace.
+*
+* PreCondition: CONSOLE_TRACE_Initialize() was called
+*
+* Input: None
+*
+* Output: position (free running)
+*
+********************************************************************/
+uint16_t CONSOLE_TRACE_GetEnd(void);
+
+/*********************************************************************
+* Function: uint16_t CONSOLE_TRACE_Read(uint16_t* position, uint8_t* data, uint16_t size);
+*
+* Overview: Copies trace bytes from a position and advances it.  A position
+*           that has since been overwritten skips ahead to the oldest byte.
+*
+* PreCondition: CONSOLE_TRACE_Initialize() was called
+*
+* Input: position - where to read from, updated
+*        data - where to copy to
+*        size - room in data
+*
+* Output: number of bytes copied, 0 once position has caught up
+*
+********************************************************************/
+uint16_t CONSOLE_TRACE_Read(uint16_t* position, uint8_t* data, uint16_t size);
+
+#endif //CONSOLE_TRACE_H
@@ -0,0 +1,182 @@
+//Copyright 2016 Microchip Technology Inc. (www.microchip.com)
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+
+#if defined(CONSOLE_UART) && !defined(SYSTEM_PERIPHERAL_CLOCK)
+#define SYSTEM_PERIPHERAL_CLOCK 16000000
+#pragma message "This module requires a definition for the peripheral clock frequency.  Assuming 16MHz Fcy (32MHz Fosc).  Define value if this is not correct."
+#endif
+
+#include <xc.h>
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "console_uart.h"
+#include "dma_copy.h"
+
+#if defined(CONSOLE_UART)
+
+#define FIFO_SIZE   256u
+#define FIFO_MASK   (FIFO_SIZE - 1u)
+
+#if (FIFO_SIZE & FIFO_MASK) != 0u
+#error "FIFO_SIZE must be a power of two"
+#endif
+
+//High speed mode: 4 clocks per bit.
+#define BRG_SETTING ((SYSTEM_PERIPHERAL_CLOCK / (4ul * CONSOLE_UART_BAUD_RATE)) - 1ul)
+
+//DMA trigger source number of the UART1 transmitter, from the DMA channel
+//trigger sources table of the device data sheet.
+#ifndef CONSOLE_UART_DMA_TRIGGER
+#define CONSOLE_UART_DMA_TRIGGER 0x0Cu
+#endif
+
+#define DMA_SIZE_BYTE           1u
+#define DMA_TRMODE_ONE_SHOT     0u
+#define DMA_SAMODE_INCREMENT    1u
+#define DMA_DAMODE_UNCHANGED    0u
+
+static uint8_t fifo[FIFO_SIZE];
+static volatile uint16_t head = 0;
+static volatile uint16_t tail = 0;
+static volatile uint16_t reserved = 0;
+static volatile uint8_t writers = 0;
+static uint16_t transferLength = 0;
+
+void CONSOLE_UART_Initialize(void)
+{
+    U1MODE = 0;
+    U1STA = 0;
+    U1BRG = (uint16_t)BRG_SETTING;
+    U1MODEbits.BRGH = 1;
+    U1MODEbits.UARTEN = 1;
+    U1STAbits.UTXEN = 1;
+    
+    DMACONbits.DMAEN = 1;
+    DMAL = DMA_COPY_LOW_LIMIT;
+    DMAH = DMA_COPY_HIGH_LIMIT;
+    
+    DMACH0 = 0;
+    DMACH0bits.SIZE = DMA_SIZE_BYTE;
+    DMACH0bits.TRMODE = DMA_TRMODE_ONE_SHOT;
+    DMACH0bits.SAMODE = DMA_SAMODE_INCREMENT;
+    DMACH0bits.DAMODE = DMA_DAMODE_UNCHANGED;
+    DMAINT0 = 0;
+    DMAINT0bits.CHSEL = CONSOLE_UART_DMA_TRIGGER;
+    DMADST0 = (uint16_t)&U1TXREG;
+    
+    head = 0;
+    tail = 0;
+    reserved = 0;
+    writers = 0;
+    transferLength = 0;
+}
+
+uint16_t CONSOLE_UART_Write(const uint8_t* data, uint16_t length)
+{
+    uint16_t ipl;
+    uint16_t offset;
+    uint16_t space;
+    uint16_t span;
+    
+    //Interrupts may write too.  Only reserving the space is done with
+    //interrupts masked, the copy is not; the last writer to finish, which
+    //is the one that was interrupted, publishes tail for all of them.
+    //CONSOLE_UART_Tasks() only ever moves head.
+    SET_AND_SAVE_CPU_IPL(ipl, 7);
+    
+    offset = reserved;
+    space = FIFO_SIZE - (uint16_t)(offset - head);
+    
+    if(length > space)
+    {
+        length = space;
+    }
+    
+    reserved = offset + length;
+    writers++;
+    
+    RESTORE_CPU_IPL(ipl);
+    
+    offset &= FIFO_MASK;
+    span = FIFO_SIZE - offset;
+    
+    if(span > length)
+    {
+        span = length;
+    }
+    
+    (void)memcpy(&fifo[offset], data, span);
+    (void)memcpy(&fifo[0], &data[span], length - span);
+    
+    SET_AND_SAVE_CPU_IPL(ipl, 7);
+    
+    if(--writers == 0u)
+    {
+        tail = reserved;
+    }
+    
+    RESTORE_CPU_IPL(ipl);
+    
+    return length;
+}
+
+void CONSOLE_UART_Tasks(void)
+{
+    uint16_t localHead;
+    uint16_t offset;
+    uint16_t length;
+    
+    if(transferLength != 0u)
+    {
+        if(DMAINT0bits.DONEIF == 0u)
+        {
+            return;
+        }
+        
+        DMAINT0bits.DONEIF = 0;
+        head = head + transferLength;
+        transferLength = 0;
+    }
+    
+    localHead = head;
+    length = tail - localHead;
+    
+    if(length == 0u)
+    {
+        return;
+    }
+    
+    //One contiguous span per transfer; a wrapped FIFO takes two.
+    offset = localHead & FIFO_MASK;
+    
+    if(length > (FIFO_SIZE - offset))
+    {
+        length = FIFO_SIZE - offset;
+    }
+    
+    transferLength = length;
+    DMASRC0 = (uint16_t)&fifo[offset];
+    DMACNT0 = length;
+    DMACH0bits.CHEN = 1;
+    
+    //The transmitter's trigger is level based and only fires on a change,
+    //so the first byte is requested by hand.
+    DMACH0bits.CHREQ = 1;
+}
+
+#endif
@@ -0,0 +1,75 @@
+//Copyright 2016 Microchip Technology Inc. (www.microchip.com)
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+
+#ifndef CONSOLE_UART_H
+#define CONSOLE_UART_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+//Console sink on UART1 (8N1, CONSOLE_UART_BAUD_RATE).  Bytes are queued in a
+//small FIFO and sent by DMA channel 0, so the CPU only touches each byte
+//once.  U1TX must be mapped to a pin in pin_manager.c.
+
+#ifndef CONSOLE_UART_BAUD_RATE
+#define CONSOLE_UART_BAUD_RATE 115200ul
+#endif
+
+/*********************************************************************
+* Function: void CONSOLE_UART_Initialize(void);
+*
+* Overview: Sets up UART1 and DMA channel 0 and empties the FIFO.
+*
+* PreCondition: None
+*
+* Input: None
+*
+* Output: None
+*
+********************************************************************/
+void CONSOLE_UART_Initialize(void);
+
+/*********************************************************************
+* Function: uint16_t CONSOLE_UART_Write(const uint8_t* data, uint16_t length);
+*
+* Overview: Queues as much of data as fits in the FIFO.  Safe to call from
+*           interrupts.
+*
+* PreCondition: CONSOLE_UART_Initialize() was called
+*
+* Input: data - bytes to send
+*        length - number of bytes
+*
+* Output: number of bytes queued
+*
+********************************************************************/
+uint16_t CONSOLE_UART_Write(const uint8_t* data, uint16_t length);
+
+/*********************************************************************
+* Function: void CONSOLE_UART_Tasks(void);
+*
+* Overview: Releases the bytes of a finished DMA transfer and starts the
+*           next one.  Call from the main loop.
+*
+* PreCondition: CONSOLE_UART_Initialize() was called
+*
+* Input: None
+*
+* Output: None
+*
+********************************************************************/
+void CONSOLE_UART_Tasks(void);
+
+#endif //CONSOLE_UART_H
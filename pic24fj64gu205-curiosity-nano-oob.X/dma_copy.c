@@ -0,0 +1,215 @@
+//Copyright 2016 Microchip Technology Inc. (www.microchip.com)
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+#include <xc.h>
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "dma_copy.h"
+
+#define DMA_SIZE_WORD           0u
+#define DMA_SIZE_BYTE           1u
+#define DMA_TRMODE_CONTINUOUS   2u
+#define DMA_SAMODE_INCREMENT    1u
+#define DMA_DAMODE_INCREMENT    1u
+
+//Copies are started with CHREQ, so the channel's trigger source is not
+//relied on for what it selects: a trigger can only start the channel while
+//CHEN is set, and CHEN is set only for the length of a claimed copy, which
+//its CHREQ has already started.  CheckFirstTransfer() makes sure that a
+//copy started this way completes, and moves the right bytes.
+#define DMA_TRIGGER_SOURCE      0x00u
+
+//Polls of DONEIF before the first transfer is given up on: many times what
+//the channel needs, which moves a byte or a word per transfer.
+#define DMA_CHECK_POLLS_PER_BYTE    8u
+#define DMA_CHECK_POLLS_MARGIN      64u
+
+typedef enum
+{
+    CHANNEL_UNCHECKED,
+    CHANNEL_WORKS,
+    CHANNEL_FAILED
+} CHANNEL_STATE;
+
+static volatile bool channelBusy = false;
+static CHANNEL_STATE channelState = CHANNEL_UNCHECKED;
+
+static bool CheckFirstTransfer(const void* destination, const void* source, uint16_t length);
+static void StartTransfer(void* destination, const void* source, uint16_t length);
+static bool ClaimChannel(void);
+static bool IsReachable(const void* address, uint16_t length);
+static void CopyWords(uint8_t* destination, const uint8_t* source, uint16_t length);
+
+void DMA_COPY_Initialize(void)
+{
+    DMACONbits.DMAEN = 1;
+    DMAL = DMA_COPY_LOW_LIMIT;
+    DMAH = DMA_COPY_HIGH_LIMIT;
+    
+    DMACH1 = 0;
+    DMACH1bits.TRMODE = DMA_TRMODE_CONTINUOUS;
+    DMACH1bits.SAMODE = DMA_SAMODE_INCREMENT;
+    DMACH1bits.DAMODE = DMA_DAMODE_INCREMENT;
+    DMAINT1 = 0;
+    DMAINT1bits.CHSEL = DMA_TRIGGER_SOURCE;
+    
+    channelBusy = false;
+    channelState = CHANNEL_UNCHECKED;
+}
+
+void DMA_COPY_Copy(void* destination, const void* source, uint16_t length)
+{
+    if((length < DMA_COPY_THRESHOLD) ||
+       (IsReachable(destination, length) == false) ||
+       (IsReachable(source, length) == false) ||
+       (ClaimChannel() == false))
+    {
+        CopyWords((uint8_t*)destination, (const uint8_t*)source, length);
+        return;
+    }
+    
+    StartTransfer(destination, source, length);
+    
+    if(channelState == CHANNEL_UNCHECKED)
+    {
+        channelState = (CheckFirstTransfer(destination, source, length) == true) ? CHANNEL_WORKS : CHANNEL_FAILED;
+    }
+    else
+    {
+        while(DMAINT1bits.DONEIF == 0u)
+        {
+        }
+    }
+    
+    DMAINT1bits.DONEIF = 0;
+    
+    if(channelState == CHANNEL_FAILED)
+    {
+        CopyWords((uint8_t*)destination, (const uint8_t*)source, length);
+    }
+    
+    channelBusy = false;
+}
+
+//The channel is set up from the datasheet, so its first transfer is checked
+//before it is trusted: it must finish within a generous bound and move the
+//right bytes.  If not, the channel is turned off and the CPU makes every
+//copy from then on.
+static bool CheckFirstTransfer(const void* destination, const void* source, uint16_t length)
+{
+    uint32_t polls = ((uint32_t)length * DMA_CHECK_POLLS_PER_BYTE) + DMA_CHECK_POLLS_MARGIN;
+    
+    while((DMAINT1bits.DONEIF == 0u) && (polls != 0u))
+    {
+        polls--;
+    }
+    
+    if(polls == 0u)
+    {
+        DMACH1bits.CHEN = 0;
+        return false;
+    }
+    
+    return memcmp(destination, source, length) == 0;
+}
+
+static void StartTransfer(void* destination, const void* source, uint16_t length)
+{
+    uint16_t addresses = (uint16_t)destination | (uint16_t)source;
+    
+    //Word transfers take half the bus cycles, but only suit even addresses
+    //and lengths.
+    if(((addresses | length) & 1u) == 0u)
+    {
+        DMACH1bits.SIZE = DMA_SIZE_WORD;
+        DMACNT1 = length >> 1;
+    }
+    else
+    {
+        DMACH1bits.SIZE = DMA_SIZE_BYTE;
+        DMACNT1 = length;
+    }
+    
+    DMASRC1 = (uint16_t)source;
+    DMADST1 = (uint16_t)destination;
+    DMAINT1bits.DONEIF = 0;
+    DMACH1bits.CHEN = 1;
+    
+    //In continuous mode one request moves the whole block.
+    DMACH1bits.CHREQ = 1;
+}
+
+//Interrupts only nest, and run to completion.  One arriving between the
+//test and the set below has let go of the channel again before the
+//interrupted code takes it; one arriving after the set finds the channel
+//busy and copies with the CPU, instead of waiting for a transfer that
+//cannot finish until it returns.  So nothing needs masking here.
+static bool ClaimChannel(void)
+{
+    if((channelState == CHANNEL_FAILED) || (channelBusy == true))
+    {
+        return false;
+    }
+    
+    channelBusy = true;
+    
+    return true;
+}
+
+static bool IsReachable(const void* address, uint16_t length)
+{
+    uint16_t start = (uint16_t)address;
+    
+    return ((start >= DMA_COPY_LOW_LIMIT) && (start <= DMA_COPY_HIGH_LIMIT) &&
+            ((uint16_t)(DMA_COPY_HIGH_LIMIT - start) >= (uint16_t)(length - 1u)));
+}
+
+//Word moves need both addresses on the same alignment; a lone leading or
+//trailing byte is moved on its own.
+static void CopyWords(uint8_t* destination, const uint8_t* source, uint16_t length)
+{
+    uint16_t* wordDestination;
+    const uint16_t* wordSource;
+    uint16_t words;
+    
+    if((((uint16_t)destination ^ (uint16_t)source) & 1u) == 0u)
+    {
+        if((((uint16_t)destination & 1u) != 0u) && (length != 0u))
+        {
+            *destination++ = *source++;
+            length--;
+        }
+        
+        wordDestination = (uint16_t*)(void*)destination;
+        wordSource = (const uint16_t*)(const void*)source;
+        
+        for(words = length >> 1; words != 0u; words--)
+        {
+            *wordDestination++ = *wordSource++;
+        }
+        
+        destination = (uint8_t*)(void*)wordDestination;
+        source = (const uint8_t*)(const void*)wordSource;
+        length &= 1u;
+    }
+    
+    while(length != 0u)
+    {
+        *destination++ = *source++;
+        length--;
+    }
+}
@@ -0,0 +1,78 @@
+//Copyright 2016 Microchip Technology Inc. (www.microchip.com)
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+
+#ifndef DMA_COPY_H
+#define DMA_COPY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+//Memory to memory copies for the USB packet buffers and the console.  Copies
+//of at least DMA_COPY_THRESHOLD bytes between data RAM addresses are done by
+//DMA channel 1; shorter ones, constants in program memory and copies made
+//while the channel is in use by an interrupt are done by the CPU, a word at a
+//time where the alignment allows.  Channel 0 belongs to console_uart.c.
+
+#ifndef DMA_COPY_THRESHOLD
+#define DMA_COPY_THRESHOLD 32u
+#endif
+
+//The DMA may only reach addresses between DMAL and DMAH: all of data RAM,
+//taken from the __DATA_BASE and __DATA_LENGTH symbols of the device's linker
+//script rather than written down here.  Constants read through the PSV
+//window lie above it and are copied by the CPU.  Both channels' users
+//program DMAL and DMAH with these.
+#ifndef DMA_COPY_LOW_LIMIT
+extern uint8_t _DATA_BASE;
+extern uint8_t _DATA_LENGTH;
+#define DMA_COPY_LOW_LIMIT  ((uint16_t)&_DATA_BASE)
+#define DMA_COPY_HIGH_LIMIT ((uint16_t)(((uint16_t)&_DATA_BASE + (uint16_t)&_DATA_LENGTH) - 1u))
+#endif
+
+/*********************************************************************
+* Function: void DMA_COPY_Initialize(void);
+*
+* Overview: Enables the DMA module and sets up channel 1 for software
+*           triggered memory to memory transfers.  The first transfer is
+*           checked; if it does not complete, or comes out wrong, every copy
+*           is done by the CPU.
+*
+* PreCondition: None
+*
+* Input: None
+*
+* Output: None
+*
+********************************************************************/
+void DMA_COPY_Initialize(void);
+
+/*********************************************************************
+* Function: void DMA_COPY_Copy(void* destination, const void* source, uint16_t length);
+*
+* Overview: Copies length bytes and returns once they are in place.  Safe to
+*           call from interrupts.  The areas must not overlap.
+*
+* PreCondition: DMA_COPY_Initialize() was called
+*
+* Input: destination - where to put the bytes
+*        source - bytes to copy
+*        length - number of bytes
+*
+* Output: None
+*
+********************************************************************/
+void DMA_COPY_Copy(void* destination, const void* source, uint16_t length);
+
+#endif //DMA_COPY_H
@@ -44,14 +44,17 @@
 
 #include "mcc_generated_files/system.h"
 #include "button.h"
+#include "cdc_mux.h"
 #include "led.h"
 #include "console.h"
+#include "console_log.h"
+#include "dma_copy.h"
+#include "shell.h"
 #include "timer_1ms.h"
+#include "usb_control.h"
 #include "mcc_generated_files/usb/usb_device.h"
 #include "usb_status_indicator.h"
 
-extern void MCC_USB_CDC_DemoTasks(void);
-
 static bool welcomePrinted = false;
 static bool buttonPressedPrinted = false;
 
@@ -59,12 +62,21 @@ static bool IsWelcomeMessageNeeded(void);
 static void PrintWelcomeMessage(void);
 static bool IsButtonPressedMessageNeeded(void);
 static void PrintButtonPressedMessage(void);
+static void EchoMuxChannels(void);
             
 int main(void)
 {    
     SYSTEM_Initialize();
+    DMA_COPY_Initialize();
+    CONSOLE_Initialize();
     LED_Enable();
     (void)TIMER_SetConfiguration(TIMER_CONFIGURATION_1MS);
+    SHELL_Initialize();
+    CDC_MUX_Initialize();
+    
+    //A bouncing or hammered button may print a few times in a row, but not
+    //flood the link.
+    CONSOLE_SetRateLimit(CONSOLE_LOG_BUTTON_PRESSED, 4u, 250u);
         
     while (1)
     { 
@@ -81,7 +93,10 @@ int main(void)
         }
         
         CONSOLE_Tasks();
-        MCC_USB_CDC_DemoTasks();
+        SHELL_Tasks();
+        USB_CONTROL_Tasks();
+        EchoMuxChannels();
+        CDC_MUX_Tasks();
         USB_STATUS_INDICATOR_Tasks();
     }
 
@@ -114,10 +129,7 @@ static bool IsWelcomeMessageNeeded(void)
 static void PrintWelcomeMessage(void)
 {
     welcomePrinted = true;
-    CONSOLE_Print("\r\n");
-    CONSOLE_Print("*******************************************************\r\n");
-    CONSOLE_Print("PIC24FJ64GU205 Curiosity Nano Demo\r\n");
-    CONSOLE_Print("*******************************************************\r\n");
+    (void)CONSOLE_LOG0(CONSOLE_LOG_WELCOME);
 }
 
 static bool IsButtonPressedMessageNeeded(void)
@@ -145,6 +157,28 @@ static bool IsButtonPressedMessageNeeded(void)
 static void PrintButtonPressedMessage(void)
 {
     buttonPressedPrinted = true;
-    CONSOLE_Print("Button Pressed\r\n");
+    (void)CONSOLE_LOG0(CONSOLE_LOG_BUTTON_PRESSED);
+}
+
+//Each channel of the data port sends back what it receives, as fast as
+//the host takes it; tools/cdc_mux.py echo exercises this.
+static void EchoMuxChannels(void)
+{
+    uint8_t buffer[32];
+    uint16_t length;
+    uint8_t channel;
+    
+    for(channel = 0; channel < CDC_MUX_CHANNEL_COUNT; channel++)
+    {
+        length = CDC_MUX_GetWriteSpace(channel);
+        
+        if(length > sizeof(buffer))
+        {
+            length = sizeof(buffer);
+        }
+        
+        length = CDC_MUX_Read(channel, buffer, length);
+        (void)CDC_MUX_Write(channel, buffer, length);
+    }
 }
 
@@ -62,6 +62,7 @@ please contact mla_licensing@microchip.com
 #define USB_DESCRIPTOR_OTHER_SPEED      0x07    // bDescriptorType for a Other Speed Configuration.
 #define USB_DESCRIPTOR_INTERFACE_POWER  0x08    // bDescriptorType for Interface Power.
 #define USB_DESCRIPTOR_OTG              0x09    // bDescriptorType for an OTG Descriptor.
+#define USB_DESCRIPTOR_INTERFACE_ASSOCIATION 0x0B   // bDescriptorType for an Interface Association Descriptor.
 
 // *****************************************************************************
 /* USB Device Descriptor Structure
@@ -151,36 +151,84 @@ state according to the definition in the USB specification.
 #pragma romdata
 #endif
 
+/* Device class of a composite device whose functions are grouped by
+ * Interface Association Descriptors (USB IAD ECN) */
+#define MISC_DEVICE             0xEF
+#define COMMON_CLASS            0x02
+#define IAD_PROTOCOL            0x01
+
 /* Device Descriptor */
 const USB_DEVICE_DESCRIPTOR device_dsc=
 {
     0x12,                   // Size of this descriptor in bytes
     USB_DESCRIPTOR_DEVICE,  // DEVICE descriptor type
     0x0200,                 // USB Spec Release Number in BCD format
+#if (CDC_INSTANCE_COUNT > 1)
+    MISC_DEVICE,            // Class Code
+    COMMON_CLASS,           // Subclass code
+    IAD_PROTOCOL,           // Protocol code
+#else
     CDC_DEVICE,             // Class Code
     0x00,                   // Subclass code
     0x00,                   // Protocol code
+#endif
     USB_EP0_BUFF_SIZE,      // Max packet size for EP0, see usb_device_config.h
     0x04D8,                 // Vendor ID
     0x000A,                 // Product ID
+#if (CDC_INSTANCE_COUNT > 1)
+    0x0200,                 // Device release number in BCD format (new
+                            // release so hosts do not reuse the cached
+                            // single function descriptors)
+#else
     0x0100,                 // Device release number in BCD format
+#endif
     0x01,                   // Manufacturer string index
     0x02,                   // Product string index
     0x00,                   // Device serial number string index
     0x01                    // Number of possible configurations
 };
 
+/* Lengths that make up the total length of configuration 1: the
+ * configuration descriptor, each CDC function (two interfaces, their class
+ * specific descriptors and three endpoints) and, on the composite device,
+ * the IAD in front of each function. */
+#define CONFIG_DSC_LENGTH       9u
+#define IAD_DSC_LENGTH          8u
+#define CDC_FUNCTION_LENGTH     58u
+
+#if (CDC_INSTANCE_COUNT > 1)
+    #define CONFIG1_TOTAL_LENGTH    (CONFIG_DSC_LENGTH + (CDC_INSTANCE_COUNT * (IAD_DSC_LENGTH + CDC_FUNCTION_LENGTH)))
+#else
+    #define CONFIG1_TOTAL_LENGTH    (CONFIG_DSC_LENGTH + CDC_FUNCTION_LENGTH)
+#endif
+
 /* Configuration 1 Descriptor */
 const uint8_t configDescriptor1[]={
     /* Configuration Descriptor */
     0x09,//sizeof(USB_CFG_DSC),    // Size of this descriptor in bytes
     USB_DESCRIPTOR_CONFIGURATION,  // CONFIGURATION descriptor type
-    67,0,                          // Total length of data for this cfg
+    (uint8_t)CONFIG1_TOTAL_LENGTH, (uint8_t)(CONFIG1_TOTAL_LENGTH >> 8),  // Total length of data for this cfg
+#if (CDC_INSTANCE_COUNT > 1)
+    4,                             // Number of interfaces in this cfg
+#else
     2,                             // Number of interfaces in this cfg
+#endif
     1,                             // Index value of this configuration
     0,                             // Configuration string index
     _DEFAULT | _SELF,              // Attributes, see usb_device.h
     50,                            // Max power consumption (2X mA)
+
+#if (CDC_INSTANCE_COUNT > 1)
+    /* Interface Association Descriptor: data function */
+    8,                          // Size of this descriptor in bytes
+    USB_DESCRIPTOR_INTERFACE_ASSOCIATION,   // IAD descriptor type
+    CDC_COMM_INTF_ID,           // First interface of the function
+    2,                          // Number of interfaces of the function
+    COMM_INTF,                  // Class code
+    ABSTRACT_CONTROL_MODEL,     // Subclass code
+    V25TER,                     // Protocol code
+    3,                          // Function string index
+#endif
 							
     /* Interface Descriptor */
     9,//sizeof(USB_INTF_DSC),   // Size of this descriptor in bytes
@@ -191,7 +239,11 @@ const uint8_t configDescriptor1[]={
     COMM_INTF,                  // Class code
     ABSTRACT_CONTROL_MODEL,     // Subclass code
     V25TER,                     // Protocol code
+#if (CDC_INSTANCE_COUNT > 1)
+    3,                          // Interface string index
+#else
     0,                          // Interface string index
+#endif
 
     /* CDC Class-Specific Descriptors */
     sizeof(USB_CDC_HEADER_FN_DSC),
@@ -253,8 +305,93 @@ const uint8_t configDescriptor1[]={
     _BULK,                      //Attributes
     0x40,0x00,                  //size
     0x00,                       //Interval
+
+#if (CDC_INSTANCE_COUNT > 1)
+    /* Interface Association Descriptor: console function */
+    8,                          // Size of this descriptor in bytes
+    USB_DESCRIPTOR_INTERFACE_ASSOCIATION,   // IAD descriptor type
+    CDC1_COMM_INTF_ID,          // First interface of the function
+    2,                          // Number of interfaces of the function
+    COMM_INTF,                  // Class code
+    ABSTRACT_CONTROL_MODEL,     // Subclass code
+    V25TER,                     // Protocol code
+    4,                          // Function string index
+
+    /* Interface Descriptor */
+    9,//sizeof(USB_INTF_DSC),   // Size of this descriptor in bytes
+    USB_DESCRIPTOR_INTERFACE,   // INTERFACE descriptor type
+    CDC1_COMM_INTF_ID,          // Interface Number
+    0,                          // Alternate Setting Number
+    1,                          // Number of endpoints in this intf
+    COMM_INTF,                  // Class code
+    ABSTRACT_CONTROL_MODEL,     // Subclass code
+    V25TER,                     // Protocol code
+    4,                          // Interface string index
+
+    /* CDC Class-Specific Descriptors */
+    sizeof(USB_CDC_HEADER_FN_DSC),
+    CS_INTERFACE,
+    DSC_FN_HEADER,
+    0x10,0x01,
+
+    sizeof(USB_CDC_ACM_FN_DSC),
+    CS_INTERFACE,
+    DSC_FN_ACM,
+    USB_CDC_ACM_FN_DSC_VAL,
+
+    sizeof(USB_CDC_UNION_FN_DSC),
+    CS_INTERFACE,
+    DSC_FN_UNION,
+    CDC1_COMM_INTF_ID,
+    CDC1_DATA_INTF_ID,
+
+    sizeof(USB_CDC_CALL_MGT_FN_DSC),
+    CS_INTERFACE,
+    DSC_FN_CALL_MGT,
+    0x00,
+    CDC1_DATA_INTF_ID,
+
+    /* Endpoint Descriptor */
+    0x07,/*sizeof(USB_EP_DSC)*/
+    USB_DESCRIPTOR_ENDPOINT,    //Endpoint Descriptor
+    _EP03_IN,                   //EndpointAddress
+    _INTERRUPT,                 //Attributes
+    0x0A,0x00,                  //size
+    0x02,                       //Interval
+
+    /* Interface Descriptor */
+    9,//sizeof(USB_INTF_DSC),   // Size of this descriptor in bytes
+    USB_DESCRIPTOR_INTERFACE,   // INTERFACE descriptor type
+    CDC1_DATA_INTF_ID,          // Interface Number
+    0,                          // Alternate Setting Number
+    2,                          // Number of endpoints in this intf
+    DATA_INTF,                  // Class code
+    0,                          // Subclass code
+    NO_PROTOCOL,                // Protocol code
+    0,                          // Interface string index
+
+    /* Endpoint Descriptor */
+    0x07,/*sizeof(USB_EP_DSC)*/
+    USB_DESCRIPTOR_ENDPOINT,    //Endpoint Descriptor
+    _EP04_OUT,                  //EndpointAddress
+    _BULK,                      //Attributes
+    0x40,0x00,                  //size
+    0x00,                       //Interval
+
+    /* Endpoint Descriptor */
+    0x07,/*sizeof(USB_EP_DSC)*/
+    USB_DESCRIPTOR_ENDPOINT,    //Endpoint Descriptor
+    _EP04_IN,                   //EndpointAddress
+    _BULK,                      //Attributes
+    0x40,0x00,                  //size
+    0x00,                       //Interval
+#endif
 };
 
+/* Fails to compile (negative array size) if the descriptors above do not
+ * add up to the total length the host is given. */
+typedef char CONFIG1_TOTAL_LENGTH_CHECK[(sizeof(configDescriptor1) == CONFIG1_TOTAL_LENGTH) ? 1 : -1];
+
 //Language code string descriptor
 const struct{uint8_t bLength;uint8_t bDscType;uint16_t string[1];}sd000={
 sizeof(sd000),USB_DESCRIPTOR_STRING,{0x0409}};
@@ -271,6 +408,17 @@ sizeof(sd002),USB_DESCRIPTOR_STRING,
 {'P','r','o','d','u','c','t',' ','N','a','m','e'}
 };
 
+//Function string descriptors
+const struct{uint8_t bLength;uint8_t bDscType;uint16_t string[4];}sd003={
+sizeof(sd003),USB_DESCRIPTOR_STRING,
+{'D','a','t','a'}
+};
+
+const struct{uint8_t bLength;uint8_t bDscType;uint16_t string[7];}sd004={
+sizeof(sd004),USB_DESCRIPTOR_STRING,
+{'C','o','n','s','o','l','e'}
+};
+
 //Array of configuration descriptors
 const uint8_t *const USB_CD_Ptr[]=
 {
@@ -282,7 +430,9 @@ const uint8_t *const USB_SD_Ptr[USB_NUM_STRING_DESCRIPTORS]=
 {
     (const uint8_t *const)&sd000,
     (const uint8_t *const)&sd001,
-    (const uint8_t *const)&sd002
+    (const uint8_t *const)&sd002,
+    (const uint8_t *const)&sd003,
+    (const uint8_t *const)&sd004
 };
 
 #if defined(__18CXX)
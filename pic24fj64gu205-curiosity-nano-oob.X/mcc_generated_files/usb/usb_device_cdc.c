@@ -61,9 +61,59 @@ please contact mla_licensing@microchip.com
     #error "One of the fixed memory address definitions is not defined.  Please define the required address tags for the required buffers."
 #endif
 
+#if defined(USB_CDC_RX_RING_SIZE)
+    #if (USB_CDC_RX_RING_SIZE & (USB_CDC_RX_RING_SIZE - 1)) != 0
+        #error "USB_CDC_RX_RING_SIZE must be a power of 2"
+    #endif
+    #if (USB_CDC_RX_RING_SIZE < CDC_DATA_OUT_EP_SIZE) || (USB_CDC_RX_RING_SIZE > 0x8000)
+        #error "USB_CDC_RX_RING_SIZE must hold at least one packet and at most 32768 bytes"
+    #endif
+    #define CDC_RX_RING_MASK    (USB_CDC_RX_RING_SIZE - 1)
+#endif
+
+#if defined(USB_CDC_RX_FLOW_CONTROL)
+    #if !defined(USB_CDC_RX_RING_SIZE)
+        #error "USB_CDC_RX_FLOW_CONTROL needs the USB_CDC_RX_RING_SIZE receive ring"
+    #endif
+    #if (USB_CDC_RX_FLOW_ON_LEVEL >= USB_CDC_RX_FLOW_OFF_LEVEL) || (USB_CDC_RX_FLOW_OFF_LEVEL > USB_CDC_RX_RING_SIZE)
+        #error "USB_CDC_RX_FLOW_ON_LEVEL must be below USB_CDC_RX_FLOW_OFF_LEVEL, and that at most USB_CDC_RX_RING_SIZE"
+    #endif
+#endif
+
+/*
+ * Payload moves between the endpoint buffers and the caller's data go
+ * through USB_CDC_COPY().  They use memcpy() unless the project's
+ * preprocessor macros name a faster routine with the same arguments in
+ * USB_CDC_COPY_FUNCTION, as this project does with DMA_COPY_Copy().  It is
+ * set there rather than in usb_device_config.h so that the USB stack does
+ * not depend on an application header.
+ */
+#if defined(USB_CDC_COPY_FUNCTION)
+    void USB_CDC_COPY_FUNCTION(void* destination, const void* source, uint16_t length);
+    #define USB_CDC_COPY(destination, source, length)   USB_CDC_COPY_FUNCTION((destination), (source), (length))
+#else
+    #include <string.h>
+    #define USB_CDC_COPY(destination, source, length)   (void)memcpy((destination), (source), (length))
+#endif
+
+/*
+ * Every section of this driver that masks the USB interrupt goes through
+ * these, so that USB_CDC_MASKED_TIMER can time the longest one.  Sections
+ * are kept to a few state changes: packet copies and callbacks run
+ * unmasked, and the USB interrupt hands its work over to them instead (see
+ * CDCTxPump()).
+ */
+#if defined(USB_CDC_MASKED_TIMER)
+    #define CDCMaskInterrupts()     {USBMaskInterrupts(); cdc_masked_start = USB_CDC_MASKED_TIMER();}
+    #define CDCUnmaskInterrupts()   {CDCMaskedWindowEnd(); USBUnmaskInterrupts();}
+#else
+    #define CDCMaskInterrupts()     USBMaskInterrupts()
+    #define CDCUnmaskInterrupts()   USBUnmaskInterrupts()
+#endif
+
 /** V A R I A B L E S ********************************************************/
-volatile unsigned char cdc_data_tx[CDC_DATA_IN_EP_SIZE] IN_DATA_BUFFER_ADDRESS_TAG;
-volatile unsigned char cdc_data_rx[CDC_DATA_OUT_EP_SIZE] OUT_DATA_BUFFER_ADDRESS_TAG;
+volatile unsigned char cdc_data_tx[CDC_INSTANCE_COUNT][CDC_TX_BUFFER_COUNT][CDC_DATA_IN_EP_SIZE] IN_DATA_BUFFER_ADDRESS_TAG;
+volatile unsigned char cdc_data_rx[CDC_INSTANCE_COUNT][CDC_RX_BUFFER_COUNT][CDC_DATA_OUT_EP_SIZE] OUT_DATA_BUFFER_ADDRESS_TAG;
 
 typedef union
 {
@@ -73,41 +123,80 @@ typedef union
 
 //static CONTROL_BUFFER controlBuffer CONTROL_BUFFER_ADDRESS_TAG;
 
-LINE_CODING line_coding;    // Buffer to store line coding information
 CDC_NOTICE cdc_notice;
 
-#if defined(USB_CDC_SUPPORT_DSR_REPORTING)
-    SERIAL_STATE_NOTIFICATION SerialStatePacket DRIVER_DATA_ADDRESS_TAG;
+#if defined(CDC_SERIAL_STATE_NOTIFICATIONS)
+    SERIAL_STATE_NOTIFICATION cdc_serial_state_packet[CDC_INSTANCE_COUNT] DRIVER_DATA_ADDRESS_TAG;
 #endif
 
-uint8_t cdc_rx_len;            // total rx length
-uint8_t cdc_trf_state;         // States are defined cdc.h
-POINTER pCDCSrc;            // Dedicated source pointer
-POINTER pCDCDst;            // Dedicated destination pointer
-uint8_t cdc_tx_len;            // total tx length
-uint8_t cdc_mem_type;          // _ROM, _RAM
+/*
+ * Interfaces and endpoints of each CDC function, as numbered in the
+ * configuration descriptor.
+ */
+typedef struct
+{
+    uint8_t comm_intf;
+    uint8_t data_intf;
+    uint8_t comm_ep;
+    uint8_t data_ep;
+} CDC_INTERFACES;
 
-USB_HANDLE CDCDataOutHandle;
-USB_HANDLE CDCDataInHandle;
+static const CDC_INTERFACES cdc_interfaces[CDC_INSTANCE_COUNT] =
+{
+    {CDC_COMM_INTF_ID, CDC_DATA_INTF_ID, CDC_COMM_EP, CDC_DATA_EP},
+#if (CDC_INSTANCE_COUNT > 1)
+    {CDC1_COMM_INTF_ID, CDC1_DATA_INTF_ID, CDC1_COMM_EP, CDC1_DATA_EP},
+#endif
+};
+
+/*
+ * Everything else a CDC function keeps is in its CDC_INSTANCE (see
+ * usb_device_cdc.h), so the functions share no state but the masked time
+ * measurement and the control transfer buffers.
+ */
+CDC_INSTANCE cdc_instance[CDC_INSTANCE_COUNT];
+
+#if defined(USB_CDC_MASKED_TIMER)
+uint16_t cdc_masked_start;
+uint16_t cdc_masked_longest;
+#endif
 
+#if defined(USB_CDC_RX_RING_SIZE)
+/*
+ * Filled from the USB interrupt (only it moves rx_ring_head) and read by
+ * the application (only it moves rx_ring_tail).  The indexes run freely
+ * and are masked on use.
+ */
+uint8_t cdc_rx_ring[CDC_INSTANCE_COUNT][USB_CDC_RX_RING_SIZE];
+#endif
 
-CONTROL_SIGNAL_BITMAP control_signal_bitmap;
 uint32_t BaudRateGen;			// BRG value calculated from baud rate
 
-#if defined(USB_CDC_SUPPORT_DSR_REPORTING)
-    BM_SERIAL_STATE SerialStateBitmap;
-    BM_SERIAL_STATE OldSerialStateBitmap;
-    USB_HANDLE CDCNotificationInHandle;
-#endif
-
 /**************************************************************************
   SEND_ENCAPSULATED_COMMAND and GET_ENCAPSULATED_RESPONSE are required
-  requests according to the CDC specification.
-  However, it is not really being used here, therefore a dummy buffer is
-  used for conformance.
+  requests according to the CDC specification.  The USB interrupt takes a
+  command in (RECEIVING, then PENDING once its data stage is done), the
+  main loop answers it through CDCEncapsulatedCommandAcquire() and
+  CDCEncapsulatedCommandRespond() (back to IDLE), and the response waits
+  for GET_ENCAPSULATED_RESPONSE.  Only the USB interrupt leaves IDLE, and
+  only the main loop leaves PENDING.
  **************************************************************************/
-#define dummy_length    0x08
-uint8_t dummy_encapsulated_cmd_response[dummy_length];
+#define CDC_ENCAPSULATED_IDLE       0
+#define CDC_ENCAPSULATED_RECEIVING  1
+#define CDC_ENCAPSULATED_PENDING    2
+
+typedef struct
+{
+    volatile uint8_t state;
+    uint8_t instance;               // CDC function of the last command
+    uint16_t command_length;
+    volatile uint16_t response_length;  // 0: no response waiting
+} CDC_ENCAPSULATED;
+
+static CDC_ENCAPSULATED cdc_encapsulated;
+uint8_t cdc_encapsulated_command[USB_CDC_ENCAPSULATED_SIZE];
+uint8_t cdc_encapsulated_response[USB_CDC_ENCAPSULATED_SIZE];
+CDC_NOTIFICATION cdc_response_available_packet[CDC_INSTANCE_COUNT] DRIVER_DATA_ADDRESS_TAG;
 
 #if defined(USB_CDC_SET_LINE_CODING_HANDLER)
 CTRL_TRF_RETURN USB_CDC_SET_LINE_CODING_HANDLER(CTRL_TRF_PARAMS);
@@ -115,6 +204,29 @@ CTRL_TRF_RETURN USB_CDC_SET_LINE_CODING_HANDLER(CTRL_TRF_PARAMS);
 
 /** P R I V A T E  P R O T O T Y P E S ***************************************/
 void USBCDCSetLineCoding(void);
+static void CDCInitInstance(uint8_t instance);
+static void CDCEncapsulatedCommandReceived(void);
+static void CDCTxArm(uint8_t instance, uint8_t length);
+static void CDCTxContinue(uint8_t instance);
+static void CDCTxPump(uint8_t instance);
+static void CDCTxAbort(uint8_t instance);
+static void CDCTxReset(uint8_t instance);
+static bool CDCTxArmStaged(uint8_t instance, uint8_t length);
+#if defined(USB_CDC_MASKED_TIMER)
+static void CDCMaskedWindowEnd(void);
+#endif
+static void CDCRxArm(uint8_t instance);
+static void CDCRxArmAll(uint8_t instance);
+static void CDCRxRearm(uint8_t instance);
+static void CDCRxNext(uint8_t instance);
+static void CDCRxReset(uint8_t instance);
+#if defined(USB_CDC_RX_RING_SIZE)
+static void CDCRxRingFill(uint8_t instance);
+static void CDCRxRingPump(uint8_t instance);
+static bool CDCRxRingCommit(uint8_t instance, uint16_t head);
+#endif
+static uint8_t CDCTxStreamFill(uint8_t instance, uint8_t* packet);
+static bool CDCTxStreamRefill(uint8_t instance);
 
 /** D E C L A R A T I O N S **************************************************/
 //#pragma code
@@ -146,6 +258,9 @@ void USBCDCSetLineCoding(void);
   *****************************************************************************/
 void USBCheckCDCRequest(void)
 {
+    uint8_t instance;
+    CDC_INSTANCE* cdc;
+    
     /*
      * If request recipient is not an interface then return
      */
@@ -160,43 +275,74 @@ void USBCheckCDCRequest(void)
      * Interface ID must match interface numbers associated with
      * CDC class, else return
      */
-    if((SetupPkt.bIntfID != CDC_COMM_INTF_ID)&&
-       (SetupPkt.bIntfID != CDC_DATA_INTF_ID)) return;
+    for(instance = 0; instance < CDC_INSTANCE_COUNT; instance++)
+    {
+        if((SetupPkt.bIntfID == cdc_interfaces[instance].comm_intf) ||
+           (SetupPkt.bIntfID == cdc_interfaces[instance].data_intf)) break;
+    }
+    if(instance == CDC_INSTANCE_COUNT) return;
+    
+    cdc = &cdc_instance[instance];
     
     switch(SetupPkt.bRequest)
     {
         //****** These commands are required ******//
         case SEND_ENCAPSULATED_COMMAND:
-         //send the packet
-            inPipes[0].pSrc.bRam = (uint8_t*)&dummy_encapsulated_cmd_response;
-            inPipes[0].wCount.Val = dummy_length;
-            inPipes[0].info.bits.ctrl_trf_mem = USB_EP0_RAM;
-            inPipes[0].info.bits.busy = 1;
+            /*
+             * Left unclaimed, and so stalled, while the previous command is
+             * still waiting for the main loop, or if it does not fit.
+             */
+            if((cdc_encapsulated.state == CDC_ENCAPSULATED_PENDING) ||
+               (SetupPkt.wLength == 0) ||
+               (SetupPkt.wLength > USB_CDC_ENCAPSULATED_SIZE))
+                break;
+            
+            //A response the host has not read is dropped.
+            cdc_instance[cdc_encapsulated.instance].response_notify = false;
+            cdc_encapsulated.response_length = 0;
+            cdc_encapsulated.instance = instance;
+            cdc_encapsulated.command_length = SetupPkt.wLength;
+            cdc_encapsulated.state = CDC_ENCAPSULATED_RECEIVING;
+            USBEP0Receive(cdc_encapsulated_command, SetupPkt.wLength, &CDCEncapsulatedCommandReceived);
             break;
         case GET_ENCAPSULATED_RESPONSE:
-            // Populate dummy_encapsulated_cmd_response first.
-            inPipes[0].pSrc.bRam = (uint8_t*)&dummy_encapsulated_cmd_response;
-            inPipes[0].info.bits.busy = 1;
+            if((cdc_encapsulated.state == CDC_ENCAPSULATED_IDLE) &&
+               (cdc_encapsulated.instance == instance))
+            {
+                /*
+                 * The response is read once.  Its buffer is not written
+                 * again before the next command, which cannot start until
+                 * this transfer is over.
+                 */
+                USBEP0SendRAMPtr(cdc_encapsulated_response, cdc_encapsulated.response_length, USB_EP0_INCLUDE_ZERO);
+                cdc_encapsulated.response_length = 0;
+                cdc->response_notify = false;
+            }
+            else
+            {
+                //Nothing to return: a zero length data stage.
+                USBEP0SendRAMPtr(cdc_encapsulated_response, 0, USB_EP0_INCLUDE_ZERO);
+            }
             break;
         //****** End of required commands ******//
 
         #if defined(USB_CDC_SUPPORT_ABSTRACT_CONTROL_MANAGEMENT_CAPABILITIES_D1)
         case SET_LINE_CODING:
             outPipes[0].wCount.Val = SetupPkt.wLength;
-            outPipes[0].pDst.bRam = (uint8_t*)LINE_CODING_TARGET;
+            outPipes[0].pDst.bRam = (uint8_t*)LINE_CODING_TARGET(instance);
             outPipes[0].pFunc = LINE_CODING_PFUNC;
             outPipes[0].info.bits.busy = 1;
             break;
             
         case GET_LINE_CODING:
             USBEP0SendRAMPtr(
-                (uint8_t*)&line_coding,
+                (uint8_t*)&cdc->line_coding,
                 LINE_CODING_LENGTH,
                 USB_EP0_INCLUDE_ZERO);
             break;
 
         case SET_CONTROL_LINE_STATE:
-            control_signal_bitmap._byte = (uint8_t)SetupPkt.wValue;
+            cdc->control_signal_bitmap._byte = (uint8_t)SetupPkt.wValue;
             //------------------------------------------------------------------            
             //One way to control the RTS pin is to allow the USB host to decide the value
             //that should be output on the RTS pin.  Although RTS and CTS pin functions
@@ -215,11 +361,11 @@ void USBCheckCDCRequest(void)
             //controlled in the application firmware responsible for operating the 
             //hardware UART of this microcontroller.
             //---------            
-            //CONFIGURE_RTS(control_signal_bitmap.CARRIER_CONTROL);  
+            //CONFIGURE_RTS(cdc->control_signal_bitmap.CARRIER_CONTROL);  
             //------------------------------------------------------------------            
             
             #if defined(USB_CDC_SUPPORT_DTR_SIGNALING)
-                if(control_signal_bitmap.DTE_PRESENT == 1)
+                if(cdc->control_signal_bitmap.DTE_PRESENT == 1)
                 {
                     UART_DTR = USB_CDC_DTR_ACTIVE_LEVEL;
                 }
@@ -273,7 +419,8 @@ void USBCheckCDCRequest(void)
     This function initializes the CDC function driver. This function sets
     the default line coding (baud rate, bit parity, number of data bits,
     and format). This function also enables the endpoints and prepares for
-    the first transfer from the host.
+    the first transfer from the host.  Every CDC function of the
+    configuration (CDC_INSTANCE_COUNT) is initialized.
     
     This function should be called after the SET_CONFIGURATION command.
     This is most simply done by calling this function from the
@@ -293,13 +440,41 @@ void USBCheckCDCRequest(void)
   **************************************************************************/
 void CDCInitEP(void)
 {
+    uint8_t instance;
+    
+    for(instance = 0; instance < CDC_INSTANCE_COUNT; instance++)
+    {
+        CDCInitInstance(instance);
+    }
+    
+    /*
+     * A command the main loop is answering is completed by it.
+     */
+    if(cdc_encapsulated.state != CDC_ENCAPSULATED_PENDING)
+    {
+        cdc_encapsulated.state = CDC_ENCAPSULATED_IDLE;
+        cdc_encapsulated.response_length = 0;
+    }
+}//end CDCInitEP
+
+/**************************************************************************
+  Function:
+        static void CDCInitInstance(uint8_t instance)
+    
+  Summary:
+    Initializes one CDC function for CDCInitEP().
+  **************************************************************************/
+static void CDCInitInstance(uint8_t instance)
+{
+    CDC_INSTANCE* cdc = &cdc_instance[instance];
+    
     //Abstract line coding information
-    line_coding.dwDTERate   = 19200;      // baud rate
-    line_coding.bCharFormat = 0x00;             // 1 stop bit
-    line_coding.bParityType = 0x00;             // None
-    line_coding.bDataBits = 0x08;               // 5,6,7,8, or 16
+    cdc->line_coding.dwDTERate   = 19200;      // baud rate
+    cdc->line_coding.bCharFormat = 0x00;             // 1 stop bit
+    cdc->line_coding.bParityType = 0x00;             // None
+    cdc->line_coding.bDataBits = 0x08;               // 5,6,7,8, or 16
 
-    cdc_rx_len = 0;
+    cdc->rx_len = 0;
     
     /*
      * Do not have to init Cnt of IN pipes here.
@@ -312,26 +487,54 @@ void CDCInitEP(void)
      *          be known right before the data is
      *          sent.
      */
-    USBEnableEndpoint(CDC_COMM_EP,USB_IN_ENABLED|USB_HANDSHAKE_ENABLED|USB_DISALLOW_SETUP);
-    USBEnableEndpoint(CDC_DATA_EP,USB_IN_ENABLED|USB_OUT_ENABLED|USB_HANDSHAKE_ENABLED|USB_DISALLOW_SETUP);
-
-    CDCDataOutHandle = USBRxOnePacket(CDC_DATA_EP,(uint8_t*)&cdc_data_rx,sizeof(cdc_data_rx));
-    CDCDataInHandle = NULL;
+    USBEnableEndpoint(cdc_interfaces[instance].comm_ep,USB_IN_ENABLED|USB_HANDSHAKE_ENABLED|USB_DISALLOW_SETUP);
+    USBEnableEndpoint(cdc_interfaces[instance].data_ep,USB_IN_ENABLED|USB_OUT_ENABLED|USB_HANDSHAKE_ENABLED|USB_DISALLOW_SETUP);
 
-    #if defined(USB_CDC_SUPPORT_DSR_REPORTING)
-      	CDCNotificationInHandle = NULL;
-        mInitDTSPin();  //Configure DTS as a digital input
-      	SerialStateBitmap.byte = 0x00;
-      	OldSerialStateBitmap.byte = !SerialStateBitmap.byte;    //To force firmware to send an initial serial state packet to the host.
+    /*
+     * Enabling the endpoint also points it back at its EVEN BDT entries and
+     * takes every buffer back from the SIE.  CDCInitEP() runs from the USB
+     * interrupt: a side the main loop is copying packets on is reset by the
+     * main loop once the copy is done, and nothing is armed on it until
+     * then.  The receive ring is left as it is; its bytes were acknowledged
+     * to the host, and the application owns its tail.
+     */
+    if(cdc->rx_owner == true)
+        cdc->rx_reset = true;
+    else
+        CDCRxReset(instance);
+    
+    if(cdc->tx_owner == true)
+        cdc->tx_reset = true;
+    else
+        CDCTxReset(instance);
+    cdc->tx_acquired = false;
+
+    cdc->notification_in_handle = NULL;
+    cdc->response_notify = false;
+    cdc_response_available_packet[instance].bmRequestType = 0xA1;
+    cdc_response_available_packet[instance].bNotification = RESPONSE_AVAILABLE;
+    cdc_response_available_packet[instance].wValue = 0x0000;
+    cdc_response_available_packet[instance].wIndex = cdc_interfaces[instance].comm_intf;
+    cdc_response_available_packet[instance].wLength = 0x0000;
+    
+    #if defined(CDC_SERIAL_STATE_NOTIFICATIONS)
+        #if defined(USB_CDC_SUPPORT_DSR_REPORTING)
+            mInitDTSPin();  //Configure DTS as a digital input
+        #endif
+        #if defined(USB_CDC_RX_FLOW_CONTROL)
+            cdc->rx_throttled = false;
+        #endif
+      	cdc->serial_state.byte = 0x00;
+      	cdc->old_serial_state.byte = !cdc->serial_state.byte;    //To force firmware to send an initial serial state packet to the host.
         //Prepare a SerialState notification element packet (contains info like DSR state)
-        SerialStatePacket.bmRequestType = 0xA1; //Always 0xA1 for this type of packet.
-        SerialStatePacket.bNotification = SERIAL_STATE;
-        SerialStatePacket.wValue = 0x0000;  //Always 0x0000 for this type of packet
-        SerialStatePacket.wIndex = CDC_COMM_INTF_ID;  //Interface number  
-        SerialStatePacket.SerialState.byte = 0x00;
-        SerialStatePacket.Reserved = 0x00;
-        SerialStatePacket.wLength = 0x02;   //Always 2 bytes for this type of packet    
-        CDCNotificationHandler();
+        cdc_serial_state_packet[instance].bmRequestType = 0xA1; //Always 0xA1 for this type of packet.
+        cdc_serial_state_packet[instance].bNotification = SERIAL_STATE;
+        cdc_serial_state_packet[instance].wValue = 0x0000;  //Always 0x0000 for this type of packet
+        cdc_serial_state_packet[instance].wIndex = cdc_interfaces[instance].comm_intf;  //Interface number  
+        cdc_serial_state_packet[instance].SerialState.byte = 0x00;
+        cdc_serial_state_packet[instance].Reserved = 0x00;
+        cdc_serial_state_packet[instance].wLength = 0x02;   //Always 2 bytes for this type of packet    
+        CDCNotificationHandler(instance);
   	#endif
   	
   	#if defined(USB_CDC_SUPPORT_DTR_SIGNALING)
@@ -342,60 +545,113 @@ void CDCInitEP(void)
   	    mInitRTSPin();
   	    mInitCTSPin();
   	#endif
-    
-    cdc_trf_state = CDC_TX_READY;
-}//end CDCInitEP
+}//end CDCInitInstance
 
 
 /**************************************************************************
-  Function: void CDCNotificationHandler(void)
-  Summary: Checks for changes in DSR status and reports them to the USB host.
-  Description: Checks for changes in DSR pin state and reports any changes
-               to the USB host. 
+  Function: void CDCNotificationHandler(uint8_t instance)
+  Summary: Sends pending notifications, and changes in DSR status, to the
+           USB host.
+  Description: Sends a RESPONSE_AVAILABLE notification once an
+               encapsulated command response is waiting, and checks for
+               changes in DSR pin state and reports any changes to the USB
+               host. 
   Conditions: CDCInitEP() must have been called previously, prior to calling
               CDCNotificationHandler() for the first time.
   Remarks:
-    This function is only implemented and needed when the 
-    USB_CDC_SUPPORT_DSR_REPORTING option has been enabled.  If the function is
-    enabled, it should be called periodically to sample the DSR pin and feed
-    the information to the USB host.  This can be done by calling 
-    CDCNotificationHandler() by itself, or, by calling CDCTxService() which
-    also calls CDCNotificationHandler() internally, when appropriate.
+    The DSR state is only reported when the USB_CDC_SUPPORT_DSR_REPORTING
+    or USB_CDC_RX_FLOW_CONTROL option has been enabled.  It should then be
+    called periodically to sample the DSR pin and feed the information to
+    the USB host.  This can be done by calling CDCNotificationHandler() by
+    itself, or, by calling CDCTxService() which also calls
+    CDCNotificationHandler() internally, when appropriate.  The one DSR pin
+    is reported on every CDC function.
+    
+    The driver also calls it itself when a notification has gone, when a
+    response is ready and, with USB_CDC_RX_FLOW_CONTROL, whenever the
+    receive ring level changes.  It must not be interrupted by the USB
+    interrupt: the main loop calls it with the interrupt masked.
   **************************************************************************/
-#if defined(USB_CDC_SUPPORT_DSR_REPORTING)
-void CDCNotificationHandler(void)
+void CDCNotificationHandler(uint8_t instance)
 {
+    CDC_INSTANCE* cdc = &cdc_instance[instance];
+    #if defined(USB_CDC_RX_FLOW_CONTROL)
+        uint16_t count;
+    #endif
+    
+    /*
+     * A waiting response is announced first; a serial state change follows
+     * once that notification has gone.
+     */
+    if((cdc->response_notify == true) && (!USBHandleBusy(cdc->notification_in_handle)))
+    {
+        cdc->response_notify = false;
+        cdc->notification_in_handle = USBTransferOnePacket(cdc_interfaces[instance].comm_ep, IN_TO_HOST, (uint8_t*)&cdc_response_available_packet[instance], sizeof(CDC_NOTIFICATION));
+    }
+    
+    #if defined(CDC_SERIAL_STATE_NOTIFICATIONS)
+    #if defined(USB_CDC_SUPPORT_DSR_REPORTING)
     //Check the DTS I/O pin and if a state change is detected, notify the 
     //USB host by sending a serial state notification element packet.
     if(UART_DTS == USB_CDC_DSR_ACTIVE_LEVEL) //UART_DTS must be defined to be an I/O pin in the hardware profile to use the DTS feature (ex: "PORTXbits.RXY")
     {
-        SerialStateBitmap.bits.DSR = 1;
+        cdc->serial_state.bits.DSR = 1;
     }  
     else
     {
-        SerialStateBitmap.bits.DSR = 0;
+        cdc->serial_state.bits.DSR = 0;
     }        
+    #else
+        cdc->serial_state.bits.DSR = 1;
+    #endif
+    
+    #if defined(USB_CDC_RX_FLOW_CONTROL)
+    /*
+     * Drop DSR once the ring is filled to the off level, and only raise it
+     * again once it has been read down to the on level, so that a host
+     * writing just below one level does not toggle it on every packet.
+     * The room above the off level takes what the host already had queued
+     * when it saw DSR drop; past that it is NAKed as before.
+     */
+    count = cdc->rx_ring_head - cdc->rx_ring_tail;
+    
+    if(count >= USB_CDC_RX_FLOW_OFF_LEVEL)
+    {
+        if(cdc->rx_throttled == false)
+        {
+            cdc->rx_throttle_count++;
+        }
+        cdc->rx_throttled = true;
+    }
+    else if(count <= USB_CDC_RX_FLOW_ON_LEVEL)
+    {
+        cdc->rx_throttled = false;
+    }
+    
+    if(cdc->rx_throttled == true)
+    {
+        cdc->serial_state.bits.DSR = 0;
+    }
+    #endif
     
     //If the state has changed, and the endpoint is available, send a packet to
     //notify the hUSB host of the change.
-    if((SerialStateBitmap.byte != OldSerialStateBitmap.byte) && (!USBHandleBusy(CDCNotificationInHandle)))
+    if((cdc->serial_state.byte != cdc->old_serial_state.byte) && (!USBHandleBusy(cdc->notification_in_handle)))
     {
         //Copy the updated value into the USB packet buffer to send.
-        SerialStatePacket.SerialState.byte = SerialStateBitmap.byte;
+        cdc_serial_state_packet[instance].SerialState.byte = cdc->serial_state.byte;
         //We don't need to write to the other bytes in the SerialStatePacket USB
         //buffer, since they don't change and will always be the same as our
         //initialized value.
 
         //Send the packet over USB to the host.
-        CDCNotificationInHandle = USBTransferOnePacket(CDC_COMM_EP, IN_TO_HOST, (uint8_t*)&SerialStatePacket, sizeof(SERIAL_STATE_NOTIFICATION));
+        cdc->notification_in_handle = USBTransferOnePacket(cdc_interfaces[instance].comm_ep, IN_TO_HOST, (uint8_t*)&cdc_serial_state_packet[instance], sizeof(SERIAL_STATE_NOTIFICATION));
         
         //Save the old value, so we can detect changes later.
-        OldSerialStateBitmap.byte = SerialStateBitmap.byte;
+        cdc->old_serial_state.byte = cdc->serial_state.byte;
     }    
-}//void CDCNotificationHandler(void)    
-#else
-    #define CDCNotificationHandler() {}
-#endif
+    #endif
+}//void CDCNotificationHandler(uint8_t instance)    
 
 
 /**********************************************************************************
@@ -423,19 +679,113 @@ void CDCNotificationHandler(void)
   **********************************************************************************/
 bool USBCDCEventHandler(USB_EVENT event, void *pdata, uint16_t size)
 {
+    uint8_t instance;
+    uint8_t i;
+    CDC_INSTANCE* cdc;
+    
     switch( (uint16_t)event )
     {  
         case EVENT_TRANSFER_TERMINATED:
-            if(pdata == CDCDataOutHandle)
+            for(instance = 0; instance < CDC_INSTANCE_COUNT; instance++)
+            {
+                cdc = &cdc_instance[instance];
+                
+                /*
+                 * Only buffers the SIE owned are terminated.  A buffer that
+                 * holds a packet not yet read, or lent out by
+                 * CDCRxAcquireBuffer(), keeps its packet.
+                 */
+                for(i = 0; i < CDC_RX_BUFFER_COUNT; i++)
+                {
+                    if(pdata == cdc->data_out_handles[i])
+                    {
+                        cdc->rx_terminated |= (uint8_t)(1 << i);
+                        
+                        /*
+                         * With ping-pong buffering the stack terminates the
+                         * two BDT entries one at a time.  Re-arm once
+                         * neither is owned by the SIE any more, so that the
+                         * buffers stay in step with the ping-pong pointer.
+                         */
+                        if(!USBHandleBusy(cdc->data_out_handles[0])
+                        #if (CDC_RX_BUFFER_COUNT > 1)
+                           && !USBHandleBusy(cdc->data_out_handles[1])
+                        #endif
+                          )
+                        {
+                            if(cdc->rx_owner == true)
+                                cdc->rx_rearm = true;
+                            else
+                                CDCRxRearm(instance);
+                        }
+                    }
+                }
+                if((pdata == cdc->data_in_handles[0])
+                #if (CDC_TX_BUFFER_COUNT > 1)
+                   || (pdata == cdc->data_in_handles[1])
+                #endif
+                  )
+                {
+                    //flush all of the data in the CDC buffer
+                    if(cdc->tx_owner == true)
+                        cdc->tx_abort = true;
+                    else
+                        CDCTxAbort(instance);
+                }
+            }
+            break;
+        case EVENT_TRANSFER:
+            for(instance = 0; instance < CDC_INSTANCE_COUNT; instance++)
+            {
+                if(USBHALGetLastEndpoint((*(USTAT_FIELDS*)pdata)) == cdc_interfaces[instance].data_ep)
+                    break;
+                
+                /*
+                 * A notification has gone: send what came up while the
+                 * endpoint was busy.
+                 */
+                if(USBHALGetLastEndpoint((*(USTAT_FIELDS*)pdata)) == cdc_interfaces[instance].comm_ep)
+                {
+                    CDCNotificationHandler(instance);
+                    return true;
+                }
+            }
+            if(instance == CDC_INSTANCE_COUNT)
+                break;
+            
+            cdc = &cdc_instance[instance];
+            
+            /*
+             * An IN packet on the data endpoint has gone, so its ping-pong
+             * buffer is free: fill it straight away rather than waiting
+             * for the next CDCTxService() call from the main loop.
+             */
+            if(USBHALGetLastDirection((*(USTAT_FIELDS*)pdata)) == IN_TO_HOST)
             {
-                CDCDataOutHandle = USBRxOnePacket(CDC_DATA_EP,(uint8_t*)&cdc_data_rx,sizeof(cdc_data_rx));
+                if(cdc->tx_owner == true)
+                    cdc->tx_again = true;
+                else
+                    CDCTxContinue(instance);
             }
-            if(pdata == CDCDataInHandle)
+            #if defined(USB_CDC_RX_RING_SIZE)
+            /*
+             * A packet has arrived on the data endpoint: move it into the
+             * ring and re-arm its buffer, so the host is not NAKed while
+             * the application gets round to reading it.
+             */
+            else
             {
-                //flush all of the data in the CDC buffer
-                cdc_trf_state = CDC_TX_READY;
-                cdc_tx_len = 0;
+                if(cdc->rx_owner == true)
+                    cdc->rx_again = true;
+                else
+                {
+                    CDCRxRingFill(instance);
+                    #if defined(USB_CDC_RX_FLOW_CONTROL)
+                        CDCNotificationHandler(instance);
+                    #endif
+                }
             }
+            #endif
             break;
         default:
             return false;
@@ -445,7 +795,7 @@ bool USBCDCEventHandler(USB_EVENT event, void *pdata, uint16_t size)
 
 /**********************************************************************************
   Function:
-        uint8_t getsUSBUSART(char *buffer, uint8_t len)
+        uint8_t getsUSBUSART(uint8_t instance, uint8_t *buffer, uint8_t len)
     
   Summary:
     getsUSBUSART copies a string of BYTEs received through USB CDC Bulk OUT
@@ -453,9 +803,9 @@ bool USBCDCEventHandler(USB_EVENT event, void *pdata, uint16_t size)
     It does not wait for data if there is no data available. Instead it
     returns '0' to notify the caller that there is no data available.
 
-    If a call is made and there is still data remaining in the buffer unread
-    when this function returns, it will be flushed and more data will be 
-    received from the bus.
+    Data that does not fit in 'buffer' is discarded, unless
+    USB_CDC_RX_RING_SIZE is defined: it then stays in the receive ring for
+    the next call.
 
   Description:
     getsUSBUSART copies a string of BYTEs received through USB CDC Bulk OUT
@@ -463,9 +813,9 @@ bool USBCDCEventHandler(USB_EVENT event, void *pdata, uint16_t size)
     It does not wait for data if there is no data available. Instead it
     returns '0' to notify the caller that there is no data available.
 
-    If a call is made and there is still data remaining in the buffer unread
-    when this function returns, it will be flushed and more data will be 
-    received from the bus.
+    Data that does not fit in 'buffer' is discarded, unless
+    USB_CDC_RX_RING_SIZE is defined: it then stays in the receive ring for
+    the next call.
     
     Typical Usage:
     <code>
@@ -486,9 +836,9 @@ bool USBCDCEventHandler(USB_EVENT event, void *pdata, uint16_t size)
     class. Input argument 'buffer' should point to a buffer area that is
     bigger or equal to the size specified by 'len'.
 
-    If a call is made and there is still data remaining in the buffer unread
-    when this function returns, it will be flushed and more data will be 
-    received from the bus.
+    Data that does not fit in 'buffer' is discarded, unless
+    USB_CDC_RX_RING_SIZE is defined: it then stays in the receive ring for
+    the next call.
 
   Input:
     buffer -  Pointer to where received BYTEs are to be stored
@@ -500,40 +850,79 @@ bool USBCDCEventHandler(USB_EVENT event, void *pdata, uint16_t size)
               indicates that no new CDC bulk OUT endpoint data was available.
                                                                                    
   **********************************************************************************/
-uint8_t getsUSBUSART(uint8_t *buffer, uint8_t len)
+uint8_t getsUSBUSART(uint8_t instance, uint8_t *buffer, uint8_t len)
 {
-    cdc_rx_len = 0;
+    CDC_INSTANCE* cdc = &cdc_instance[instance];
+#if defined(USB_CDC_RX_RING_SIZE)
+    uint16_t tail = cdc->rx_ring_tail;
+    uint16_t count = cdc->rx_ring_head - tail;
+    
+    /*
+     * Unlike the endpoint buffer, the ring keeps whatever does not fit in
+     * 'buffer' for the next call.
+     */
+    if(len > count)
+        len = (uint8_t)count;
+    
+    /*
+     * At most two spans: up to the end of the ring, then from its start.
+     */
+    tail &= CDC_RX_RING_MASK;
+    count = USB_CDC_RX_RING_SIZE - tail;
+    
+    if(count > len)
+        count = len;
+    
+    USB_CDC_COPY(buffer, &cdc_rx_ring[instance][tail], count);
+    USB_CDC_COPY(&buffer[count], &cdc_rx_ring[instance][0], len - count);
+    
+    cdc->rx_len = len;
+    cdc->rx_ring_tail += len;
+    
+    /*
+     * Pick up a packet that was held back in the endpoint buffer because
+     * the ring was full.
+     */
+    CDCRxRingPump(instance);
+    
+    return cdc->rx_len;
+#else
+    uint8_t* packet;
+    uint8_t length;
+    
+    cdc->rx_len = 0;
     
-    if(!USBHandleBusy(CDCDataOutHandle))
+    packet = CDCRxAcquireBuffer(instance, &length);
+    
+    if(packet != NULL)
     {
         /*
          * Adjust the expected number of BYTEs to equal
          * the actual number of BYTEs received.
          */
-        if(len > USBHandleGetLength(CDCDataOutHandle))
-            len = USBHandleGetLength(CDCDataOutHandle);
+        if(len > length)
+            len = length;
         
         /*
          * Copy data from dual-ram buffer to user's buffer
          */
-        for(cdc_rx_len = 0; cdc_rx_len < len; cdc_rx_len++)
-            buffer[cdc_rx_len] = cdc_data_rx[cdc_rx_len];
+        USB_CDC_COPY(buffer, packet, len);
+        cdc->rx_len = len;
 
         /*
          * Prepare dual-ram buffer for next OUT transaction
          */
-
-        CDCDataOutHandle = USBRxOnePacket(CDC_DATA_EP,(uint8_t*)&cdc_data_rx,sizeof(cdc_data_rx));
+        CDCRxReleaseBuffer(instance);
 
     }//end if
     
-    return cdc_rx_len;
-    
+    return cdc->rx_len;
+#endif
 }//end getsUSBUSART
 
 /******************************************************************************
   Function:
-	void putUSBUSART(char *data, uint8_t length)
+	void putUSBUSART(uint8_t instance, uint8_t *data, uint8_t length)
 		
   Summary:
     putUSBUSART writes an array of data to the USB. Use this version, is
@@ -571,10 +960,11 @@ uint8_t getsUSBUSART(uint8_t *buffer, uint8_t len)
     uint8_t length - the number of bytes to be transfered (must be less than 255).
 		
  *****************************************************************************/
-void putUSBUSART(uint8_t *data, uint8_t  length)
+void putUSBUSART(uint8_t instance, uint8_t *data, uint8_t  length)
 {
+    CDC_INSTANCE* cdc = &cdc_instance[instance];
     /*
-     * User should have checked that cdc_trf_state is in CDC_TX_READY state
+     * User should have checked that cdc->trf_state is in CDC_TX_READY state
      * before calling this function.
      * As a safety precaution, this function checks the state one more time
      * to make sure it does not override any pending transactions.
@@ -596,17 +986,17 @@ void putUSBUSART(uint8_t *data, uint8_t  length)
      * multi-tasking and a blocking code is not acceptable.
      * Use a state machine instead.
      */
-    USBMaskInterrupts();
-    if(cdc_trf_state == CDC_TX_READY)
+    CDCMaskInterrupts();
+    if(cdc->trf_state == CDC_TX_READY)
     {
-        mUSBUSARTTxRam((uint8_t*)data, length);     // See cdc.h
+        mUSBUSARTTxRam(instance, (uint8_t*)data, length);     // See cdc.h
     }
-    USBUnmaskInterrupts();
+    CDCUnmaskInterrupts();
 }//end putUSBUSART
 
 /******************************************************************************
 	Function:
-		void putsUSBUSART(char *data)
+		void putsUSBUSART(uint8_t instance, char *data)
 		
   Summary:
     putsUSBUSART writes a string of data to the USB including the null
@@ -644,13 +1034,14 @@ void putUSBUSART(uint8_t *data, uint8_t  length)
 		
  *****************************************************************************/
  
-void putsUSBUSART(char *data)
+void putsUSBUSART(uint8_t instance, char *data)
 {
+    CDC_INSTANCE* cdc = &cdc_instance[instance];
     uint8_t len;
     char *pData;
 
     /*
-     * User should have checked that cdc_trf_state is in CDC_TX_READY state
+     * User should have checked that cdc->trf_state is in CDC_TX_READY state
      * before calling this function.
      * As a safety precaution, this function checks the state one more time
      * to make sure it does not override any pending transactions.
@@ -672,16 +1063,10 @@ void putsUSBUSART(char *data)
      * multi-tasking and a blocking code is not acceptable.
      * Use a state machine instead.
      */
-    USBMaskInterrupts();
-    if(cdc_trf_state != CDC_TX_READY)
-    {
-        USBUnmaskInterrupts();
-        return;
-    }
-    
     /*
      * While loop counts the number of BYTEs to send including the
-     * null character.
+     * null character.  This is done before masking the USB interrupt, as
+     * only the hand-over to the state machine needs to be atomic.
      */
     len = 0;
     pData = data;
@@ -691,19 +1076,26 @@ void putsUSBUSART(char *data)
         if(len == 255) break;       // Break loop once max len is reached.
     }while(*pData++);
     
+    CDCMaskInterrupts();
+    if(cdc->trf_state != CDC_TX_READY)
+    {
+        CDCUnmaskInterrupts();
+        return;
+    }
+    
     /*
      * Second piece of information (length of data to send) is ready.
      * Call mUSBUSARTTxRam to setup the transfer.
      * The actual transfer process will be handled by CDCTxService(),
      * which should be called once per Main Program loop.
      */
-    mUSBUSARTTxRam((uint8_t*)data, len);     // See cdc.h
-    USBUnmaskInterrupts();
+    mUSBUSARTTxRam(instance, (uint8_t*)data, len);     // See cdc.h
+    CDCUnmaskInterrupts();
 }//end putsUSBUSART
 
 /**************************************************************************
   Function:
-        void putrsUSBUSART(const char *data)
+        void putrsUSBUSART(uint8_t instance, const char *data)
     
   Summary:
     putrsUSBUSART writes a string of data to the USB including the null
@@ -741,13 +1133,14 @@ void putsUSBUSART(char *data)
                             will be transferred to the host.
                                                                            
   **************************************************************************/
-void putrsUSBUSART(const char *data)
+void putrsUSBUSART(uint8_t instance, const char *data)
 {
+    CDC_INSTANCE* cdc = &cdc_instance[instance];
     uint8_t len;
     const char *pData;
 
     /*
-     * User should have checked that cdc_trf_state is in CDC_TX_READY state
+     * User should have checked that cdc->trf_state is in CDC_TX_READY state
      * before calling this function.
      * As a safety precaution, this function checks the state one more time
      * to make sure it does not override any pending transactions.
@@ -762,23 +1155,17 @@ void putrsUSBUSART(const char *data)
      *     putsUSBUSART(pData);
      *
      * IMPORTANT: Never use the following blocking while loop to wait:
-     * while(cdc_trf_state != CDC_TX_READY)
+     * while(cdc->trf_state != CDC_TX_READY)
      *     putsUSBUSART(pData);
      *
      * The whole firmware framework is written based on cooperative
      * multi-tasking and a blocking code is not acceptable.
      * Use a state machine instead.
      */
-    USBMaskInterrupts();
-    if(cdc_trf_state != CDC_TX_READY)
-    {
-        USBUnmaskInterrupts();
-        return;
-    }
-    
     /*
      * While loop counts the number of BYTEs to send including the
-     * null character.
+     * null character.  This is done before masking the USB interrupt, as
+     * only the hand-over to the state machine needs to be atomic.
      */
     len = 0;
     pData = data;
@@ -788,6 +1175,13 @@ void putrsUSBUSART(const char *data)
         if(len == 255) break;       // Break loop once max len is reached.
     }while(*pData++);
     
+    CDCMaskInterrupts();
+    if(cdc->trf_state != CDC_TX_READY)
+    {
+        CDCUnmaskInterrupts();
+        return;
+    }
+    
     /*
      * Second piece of information (length of data to send) is ready.
      * Call mUSBUSARTTxRom to setup the transfer.
@@ -795,14 +1189,14 @@ void putrsUSBUSART(const char *data)
      * which should be called once per Main Program loop.
      */
 
-    mUSBUSARTTxRom((const uint8_t*)data,len); // See cdc.h
-    USBUnmaskInterrupts();
+    mUSBUSARTTxRom(instance, (const uint8_t*)data,len); // See cdc.h
+    CDCUnmaskInterrupts();
 
 }//end putrsUSBUSART
 
 /************************************************************************
   Function:
-        void CDCTxService(void)
+        void CDCTxService(uint8_t instance)
     
   Summary:
     CDCTxService handles device-to-host transaction(s). This function
@@ -851,103 +1245,1071 @@ void putrsUSBUSART(const char *data)
     None                                                                 
   ************************************************************************/
  
-void CDCTxService(void)
+void CDCTxService(uint8_t instance)
 {
-    uint8_t byte_to_send;
-    uint8_t i;
+    CDCMaskInterrupts();
+    CDCNotificationHandler(instance);
+    CDCUnmaskInterrupts();
     
-    USBMaskInterrupts();
+    CDCTxPump(instance);
+}//end CDCTxService
+
+/**************************************************************************
+  Function:
+        static void CDCTxPump(uint8_t instance)
     
-    CDCNotificationHandler();
+  Summary:
+    Runs CDCTxContinue() from the main loop with the USB interrupt enabled.
+
+  Description:
+    Packet copies and the streaming refill callback run unmasked.  While
+    they do, the USB interrupt only records that a packet has gone
+    (cdc->tx_again), that the transfer was terminated (cdc->tx_abort) or
+    that CDCInitEP() ran (cdc->tx_reset), and these are dealt with here
+    before the main loop lets go of the transmit side.  Only that final
+    check and the arming of each packet (CDCTxArmStaged()) run masked.
+  **************************************************************************/
+static void CDCTxPump(uint8_t instance)
+{
+    CDC_INSTANCE* cdc = &cdc_instance[instance];
+    bool again;
     
-    if(USBHandleBusy(CDCDataInHandle)) 
+    do
     {
-        USBUnmaskInterrupts();
-        return;
-    }
+        /*
+         * Cleared before taking ownership, so a request made in between is
+         * not lost: before cdc->tx_owner is set the interrupt does the work
+         * itself.
+         */
+        cdc->tx_again = false;
+        cdc->tx_owner = true;
+        
+        CDCTxContinue(instance);
+        
+        CDCMaskInterrupts();
+        cdc->tx_owner = false;
+        if(cdc->tx_reset == true)
+        {
+            CDCTxReset(instance);
+        }
+        else if(cdc->tx_abort == true)
+        {
+            cdc->tx_abort = false;
+            CDCTxAbort(instance);
+        }
+        again = cdc->tx_again;
+        CDCUnmaskInterrupts();
+    } while(again == true);
+}//end CDCTxPump
 
-    /*
-     * Completing stage is necessary while [ mCDCUSartTxIsBusy()==1 ].
-     * By having this stage, user can always check cdc_trf_state,
-     * and not having to call mCDCUsartTxIsBusy() directly.
-     */
-    if(cdc_trf_state == CDC_TX_COMPLETING)
-        cdc_trf_state = CDC_TX_READY;
+/**************************************************************************
+  Function:
+        static void CDCTxAbort(uint8_t instance)
     
-    /*
-     * If CDC_TX_READY state, nothing to do, just return.
-     */
-    if(cdc_trf_state == CDC_TX_READY)
+  Summary:
+    Drops the current bulk IN transfer after a transfer terminated event.
+  **************************************************************************/
+static void CDCTxAbort(uint8_t instance)
+{
+    CDC_INSTANCE* cdc = &cdc_instance[instance];
+    cdc->trf_state = CDC_TX_READY;
+    cdc->tx_len = 0;
+    cdc->tx_zlp = false;
+    cdc->tx_refill = NULL;
+}//end CDCTxAbort
+
+/**************************************************************************
+  Function:
+        static void CDCTxReset(uint8_t instance)
+    
+  Summary:
+    Puts the transmit side back in step with an IN endpoint that
+    USBEnableEndpoint() has just enabled again.
+
+  Conditions:
+    USB interrupts masked.  The main loop does not own the transmit side.
+  **************************************************************************/
+static void CDCTxReset(uint8_t instance)
+{
+    CDC_INSTANCE* cdc = &cdc_instance[instance];
+    uint8_t i;
+    
+    cdc->data_in_handle = NULL;
+    
+    for(i = 0; i < CDC_TX_BUFFER_COUNT; i++)
     {
-        USBUnmaskInterrupts();
-        return;
+        cdc->data_in_handles[i] = NULL;
     }
+    cdc->tx_buffer = 0;
+    cdc->tx_again = false;
+    cdc->tx_abort = false;
+    cdc->tx_reset = false;
+    CDCTxAbort(instance);
+}//end CDCTxReset
+
+/**************************************************************************
+  Function:
+        static void CDCTxContinue(uint8_t instance)
+    
+  Summary:
+    Stages the next packets of the current transfer in whichever ping-pong
+    buffers are free, and sends an owed ZLP.
+
+  Description:
+    Called from CDCTxService() and, through USBCDCEventHandler(), from the
+    EVENT_TRANSFER of every completed IN packet on CDC_DATA_EP, so that a
+    multi-packet transfer keeps moving even while the main loop is busy
+    elsewhere.
+
+  Conditions:
+    Called from the USB interrupt while the main loop does not own the
+    transmit side, or from CDCTxPump() while it does.
+  **************************************************************************/
+static void CDCTxContinue(uint8_t instance)
+{
+    CDC_INSTANCE* cdc = &cdc_instance[instance];
+    uint8_t byte_to_send;
     
     /*
-     * If CDC_TX_BUSY_ZLP state, send zero length packet
+     * Stage a packet in every free ping-pong buffer, so that the second one
+     * is already armed while the first is still on the wire.
      */
-    if(cdc_trf_state == CDC_TX_BUSY_ZLP)
-    {
-        CDCDataInHandle = USBTxOnePacket(CDC_DATA_EP,NULL,0);
-        //CDC_DATA_BD_IN.CNT = 0;
-        cdc_trf_state = CDC_TX_COMPLETING;
-    }
-    else if(cdc_trf_state == CDC_TX_BUSY)
+    while((cdc->trf_state == CDC_TX_BUSY) &&
+          !USBHandleBusy(USBGetNextHandle(cdc_interfaces[instance].data_ep, IN_TO_HOST)))
     {
         /*
          * First, have to figure out how many byte of data to send.
          */
-    	if(cdc_tx_len > sizeof(cdc_data_tx))
-    	    byte_to_send = sizeof(cdc_data_tx);
+    	if(cdc->tx_len > CDC_DATA_IN_EP_SIZE)
+    	    byte_to_send = CDC_DATA_IN_EP_SIZE;
     	else
-    	    byte_to_send = cdc_tx_len;
+    	    byte_to_send = cdc->tx_len;
 
         /*
          * Subtract the number of bytes just about to be sent from the total.
          */
-    	cdc_tx_len = cdc_tx_len - byte_to_send;
+    	cdc->tx_len = cdc->tx_len - byte_to_send;
     	  
-        pCDCDst.bRam = (uint8_t*)&cdc_data_tx; // Set destination pointer
+        /*
+         * Constants are readable through the PSV window on this device, so
+         * ROM and RAM sources are copied the same way.
+         */
+        USB_CDC_COPY((uint8_t*)&cdc_data_tx[instance][cdc->tx_buffer], cdc->pSrc.bRom, byte_to_send);
+        cdc->pSrc.bRom += byte_to_send;
         
-        i = byte_to_send;
-        if(cdc_mem_type == USB_EP0_ROM)            // Determine type of memory source
+        /*
+         * The source data has been copied, so a new transfer can be
+         * accepted as soon as the last packet is armed.  Whether a zero
+         * length packet is owed (USB Specification 2.0: Section 5.8.3) is
+         * decided below, once it is known that no more data follows.
+         */
+        if(cdc->tx_len == 0)
         {
-            while(i)
-            {
-                *pCDCDst.bRam = *pCDCSrc.bRom;
-                pCDCDst.bRam++;
-                pCDCSrc.bRom++;
-                i--;
-            }//end while(byte_to_send)
+            cdc->trf_state = CDC_TX_READY;
         }
-        else
+        cdc->tx_zlp = ((cdc->tx_len == 0) && (byte_to_send == CDC_DATA_IN_EP_SIZE));
+        
+        if(CDCTxArmStaged(instance, byte_to_send) == false)
+        {
+            return;
+        }
+    }//end while(cdc_tx_sate == CDC_TX_BUSY)
+    
+    while((cdc->trf_state == CDC_TX_STREAMING) &&
+          !USBHandleBusy(USBGetNextHandle(cdc_interfaces[instance].data_ep, IN_TO_HOST)))
+    {
+        byte_to_send = CDCTxStreamFill(instance, (uint8_t*)&cdc_data_tx[instance][cdc->tx_buffer]);
+        
+        /*
+         * CDCTxStreamFill() looks ahead for the next chunk after a full
+         * packet, so an empty chunk means this packet is the last one.
+         */
+        if(cdc->tx_stream_len == 0)
         {
-            while(i)
+            cdc->trf_state = CDC_TX_READY;
+            cdc->tx_zlp = (byte_to_send == CDC_DATA_IN_EP_SIZE);
+            
+            if(byte_to_send == 0)
             {
-                *pCDCDst.bRam = *pCDCSrc.bRam;
-                pCDCDst.bRam++;
-                pCDCSrc.bRam++;
-                i--;
+                break;
             }
         }
+        else
+        {
+            cdc->tx_zlp = false;
+        }
         
+        if(CDCTxArmStaged(instance, byte_to_send) == false)
+        {
+            return;
+        }
+    }//end while(cdc_tx_sate == CDC_TX_STREAMING)
+    
+    /*
+     * A transfer that ended with a full packet needs a ZLP to end it on the
+     * host side.  It is held back until that packet has gone: if more data
+     * is queued in the meantime, the ZLP is not needed.
+     */
+    if((cdc->trf_state == CDC_TX_READY) && (cdc->tx_zlp == true) &&
+       (cdc->tx_acquired == false) && !USBHandleBusy(cdc->data_in_handle))
+    {
+        cdc->tx_zlp = false;
+        (void)CDCTxArmStaged(instance, 0);
+    }
+    
+}//end CDCTxContinue
+
+/**************************************************************************
+  Function:
+        uint8_t* CDCTxAcquireBuffer(uint8_t instance)
+    
+  Summary:
+    Returns the CDC bulk IN endpoint buffer so that the caller can build
+    the next packet in place, without an intermediate copy.
+
+  Conditions:
+    The device should be in the CONFIGURED_STATE.
+
+  Input:
+    uint8_t instance - the CDC function, 0 to CDC_INSTANCE_COUNT - 1
+
+  Output:
+    uint8_t* - pointer to the endpoint buffer, or NULL if a transfer is
+               still in progress.
+  **************************************************************************/
+uint8_t* CDCTxAcquireBuffer(uint8_t instance)
+{
+    CDC_INSTANCE* cdc = &cdc_instance[instance];
+    uint8_t* buffer = NULL;
+    
+    /*
+     * The buffer of the next ping-pong BDT entry is free once the host has
+     * taken the packet last sent from it, even if the other one is still
+     * waiting to go out.
+     */
+    CDCMaskInterrupts();
+    if((cdc->trf_state == CDC_TX_READY) &&
+       !USBHandleBusy(USBGetNextHandle(cdc_interfaces[instance].data_ep, IN_TO_HOST)))
+    {
         /*
-         * Lastly, determine if a zero length packet state is necessary.
-         * See explanation in USB Specification 2.0: Section 5.8.3
+         * Keeps the interrupt-driven ZLP from taking this buffer while
+         * the caller is filling it.
          */
-        if(cdc_tx_len == 0)
-        {
-            if(byte_to_send == CDC_DATA_IN_EP_SIZE)
-                cdc_trf_state = CDC_TX_BUSY_ZLP;
-            else
-                cdc_trf_state = CDC_TX_COMPLETING;
-        }//end if(cdc_tx_len...)
-        CDCDataInHandle = USBTxOnePacket(CDC_DATA_EP,(uint8_t*)&cdc_data_tx,byte_to_send);
+        cdc->tx_acquired = true;
+        buffer = (uint8_t*)&cdc_data_tx[instance][cdc->tx_buffer];
+    }
+    CDCUnmaskInterrupts();
+    
+    return buffer;
+}//end CDCTxAcquireBuffer
 
-    }//end if(cdc_tx_sate == CDC_TX_BUSY)
+/**************************************************************************
+  Function:
+        void CDCTxCommitBuffer(uint8_t instance, uint8_t length)
     
-    USBUnmaskInterrupts();
-}//end CDCTxService
+  Summary:
+    Sends the first 'length' bytes of the buffer returned by
+    CDCTxAcquireBuffer() to the host, and gives the buffer back.
+
+  Conditions:
+    CDCTxAcquireBuffer() must have returned a non-NULL pointer.
+
+  Input:
+    uint8_t instance - the CDC function, 0 to CDC_INSTANCE_COUNT - 1
+    uint8_t length - the number of bytes written into the endpoint buffer,
+                     0 to only give the buffer back.
+  **************************************************************************/
+void CDCTxCommitBuffer(uint8_t instance, uint8_t length)
+{
+    CDC_INSTANCE* cdc = &cdc_instance[instance];
+    if(length > CDC_DATA_IN_EP_SIZE)
+    {
+        length = CDC_DATA_IN_EP_SIZE;
+    }
+    
+    CDCMaskInterrupts();
+    
+    /*
+     * tx_acquired is cleared by CDCInitEP() as well: a buffer acquired
+     * before a reset is not sent after it.
+     */
+    if((cdc->tx_acquired == true) && (cdc->trf_state == CDC_TX_READY) && (length != 0u) &&
+       !USBHandleBusy(USBGetNextHandle(cdc_interfaces[instance].data_ep, IN_TO_HOST)))
+    {
+        /*
+         * The data is already in the endpoint buffer, so skip the
+         * CDC_TX_BUSY copy stage and arm the endpoint directly.  A full
+         * packet owes a ZLP, which CDCTxService() sends unless another
+         * packet is committed first.
+         */
+        cdc->tx_len = 0;
+        cdc->tx_zlp = (length == CDC_DATA_IN_EP_SIZE);
+        
+        CDCTxArm(instance, length);
+    }
+    cdc->tx_acquired = false;
+    CDCUnmaskInterrupts();
+}//end CDCTxCommitBuffer
+
+/**************************************************************************
+  Function:
+        bool CDCTxStreamStart(uint8_t instance, const uint8_t* data, uint32_t length,
+                              CDC_TX_REFILL refill)
+    
+  Summary:
+    Starts a transfer of any length to the host, fed from one or more
+    chunks of RAM.
+
+  Description:
+    See usb_device_cdc.h.
+  **************************************************************************/
+bool CDCTxStreamStart(uint8_t instance, const uint8_t* data, uint32_t length, CDC_TX_REFILL refill)
+{
+    CDC_INSTANCE* cdc = &cdc_instance[instance];
+    bool started = false;
+    
+    CDCMaskInterrupts();
+    if(cdc->trf_state == CDC_TX_READY)
+    {
+        cdc->tx_stream = data;
+        cdc->tx_stream_len = (data != NULL) ? length : 0;
+        cdc->tx_refill = refill;
+        cdc->trf_state = CDC_TX_STREAMING;
+        started = true;
+    }
+    CDCUnmaskInterrupts();
+    
+    return started;
+}//end CDCTxStreamStart
+
+/**************************************************************************
+  Function:
+        uint8_t* CDCRxAcquireBuffer(uint8_t instance, uint8_t* length)
+    
+  Summary:
+    Lends the oldest received CDC bulk OUT packet to the caller in place.
+
+  Description:
+    See usb_device_cdc.h.
+  **************************************************************************/
+uint8_t* CDCRxAcquireBuffer(uint8_t instance, uint8_t* length)
+{
+    CDC_INSTANCE* cdc = &cdc_instance[instance];
+#if defined(USB_CDC_RX_RING_SIZE)
+    uint16_t tail = cdc->rx_ring_tail;
+    uint16_t count = cdc->rx_ring_head - tail;
+    uint16_t contiguous = USB_CDC_RX_RING_SIZE - (tail & CDC_RX_RING_MASK);
+    
+    /*
+     * Lends the longest run of ring data that does not wrap, but no more
+     * than a packet: callers size their buffers for one.
+     */
+    if(count > contiguous)
+        count = contiguous;
+    if(count > CDC_DATA_OUT_EP_SIZE)
+        count = CDC_DATA_OUT_EP_SIZE;
+    
+    cdc->rx_lease = (uint8_t)count;
+    *length = cdc->rx_lease;
+    
+    return (count == 0) ? NULL : &cdc_rx_ring[instance][tail & CDC_RX_RING_MASK];
+#else
+    if((cdc->data_out_handle == NULL) || USBHandleBusy(cdc->data_out_handle))
+    {
+        *length = 0;
+        return NULL;
+    }
+    
+    *length = (uint8_t)USBHandleGetLength(cdc->data_out_handle);
+    
+    return (uint8_t*)&cdc_data_rx[instance][cdc->rx_buffer];
+#endif
+}//end CDCRxAcquireBuffer
+
+/**************************************************************************
+  Function:
+        void CDCRxReleaseBuffer(uint8_t instance)
+    
+  Summary:
+    Gives the packet returned by CDCRxAcquireBuffer() back to the USB
+    module.
+
+  Description:
+    See usb_device_cdc.h.
+  **************************************************************************/
+void CDCRxReleaseBuffer(uint8_t instance)
+{
+    CDC_INSTANCE* cdc = &cdc_instance[instance];
+#if defined(USB_CDC_RX_RING_SIZE)
+    cdc->rx_ring_tail += cdc->rx_lease;
+    cdc->rx_lease = 0;
+    
+    CDCRxRingPump(instance);
+#else
+    /*
+     * Checked with the interrupt masked: a transfer terminated event could
+     * otherwise re-arm the buffer in between.
+     */
+    CDCMaskInterrupts();
+    if((cdc->data_out_handle != NULL) && !USBHandleBusy(cdc->data_out_handle))
+    {
+        CDCRxNext(instance);
+    }
+    CDCUnmaskInterrupts();
+#endif
+}//end CDCRxReleaseBuffer
+
+/**************************************************************************
+  Function:
+        const uint8_t* CDCEncapsulatedCommandAcquire(uint8_t* instance, uint16_t* length)
+    
+  Summary:
+    Returns the encapsulated command waiting for an answer.
+
+  Description:
+    See usb_device_cdc.h.
+  **************************************************************************/
+const uint8_t* CDCEncapsulatedCommandAcquire(uint8_t* instance, uint16_t* length)
+{
+    if(cdc_encapsulated.state != CDC_ENCAPSULATED_PENDING)
+    {
+        return NULL;
+    }
+    
+    *instance = cdc_encapsulated.instance;
+    *length = cdc_encapsulated.command_length;
+    
+    return cdc_encapsulated_command;
+}//end CDCEncapsulatedCommandAcquire
+
+/**************************************************************************
+  Function:
+        void CDCEncapsulatedCommandRespond(const uint8_t* response, uint16_t length)
+    
+  Summary:
+    Answers the command returned by CDCEncapsulatedCommandAcquire().
+
+  Description:
+    See usb_device_cdc.h.
+  **************************************************************************/
+void CDCEncapsulatedCommandRespond(const uint8_t* response, uint16_t length)
+{
+    uint8_t instance = cdc_encapsulated.instance;
+    
+    if(cdc_encapsulated.state != CDC_ENCAPSULATED_PENDING)
+    {
+        return;
+    }
+    
+    if(length > USB_CDC_ENCAPSULATED_SIZE)
+    {
+        length = USB_CDC_ENCAPSULATED_SIZE;
+    }
+    
+    /*
+     * The USB interrupt does not touch the response while PENDING.
+     */
+    USB_CDC_COPY(cdc_encapsulated_response, response, length);
+    
+    CDCMaskInterrupts();
+    cdc_encapsulated.response_length = length;
+    cdc_encapsulated.state = CDC_ENCAPSULATED_IDLE;
+    if(length != 0)
+    {
+        cdc_instance[instance].response_notify = true;
+        CDCNotificationHandler(instance);
+    }
+    CDCUnmaskInterrupts();
+}//end CDCEncapsulatedCommandRespond
+
+#if defined(USB_CDC_RX_RING_SIZE)
+/**************************************************************************
+  Function:
+        uint16_t CDCRxRingGetHighWaterMark(uint8_t instance)
+    
+  Summary:
+    Returns the most bytes the receive ring has held at once.
+
+  Description:
+    See usb_device_cdc.h.
+  **************************************************************************/
+uint16_t CDCRxRingGetHighWaterMark(uint8_t instance)
+{
+    CDC_INSTANCE* cdc = &cdc_instance[instance];
+    return cdc->rx_ring_high_water;
+}//end CDCRxRingGetHighWaterMark
+
+/**************************************************************************
+  Function:
+        void CDCRxRingClearHighWaterMark(uint8_t instance)
+    
+  Summary:
+    Restarts the receive ring high water mark from the current fill level.
+
+  Description:
+    See usb_device_cdc.h.
+  **************************************************************************/
+void CDCRxRingClearHighWaterMark(uint8_t instance)
+{
+    CDC_INSTANCE* cdc = &cdc_instance[instance];
+    CDCMaskInterrupts();
+    cdc->rx_ring_high_water = cdc->rx_ring_head - cdc->rx_ring_tail;
+    CDCUnmaskInterrupts();
+}//end CDCRxRingClearHighWaterMark
+#endif
+
+#if defined(USB_CDC_RX_FLOW_CONTROL)
+/**************************************************************************
+  Function:
+        uint16_t CDCRxGetThrottleCount(uint8_t instance)
+    
+  Summary:
+    Returns how many times DSR was dropped to hold off the host.
+
+  Description:
+    See usb_device_cdc.h.
+  **************************************************************************/
+uint16_t CDCRxGetThrottleCount(uint8_t instance)
+{
+    CDC_INSTANCE* cdc = &cdc_instance[instance];
+    return cdc->rx_throttle_count;
+}//end CDCRxGetThrottleCount
+
+/**************************************************************************
+  Function:
+        void CDCRxClearThrottleCount(uint8_t instance)
+    
+  Summary:
+    Restarts the count of CDCRxGetThrottleCount().
+
+  Description:
+    See usb_device_cdc.h.
+  **************************************************************************/
+void CDCRxClearThrottleCount(uint8_t instance)
+{
+    CDC_INSTANCE* cdc = &cdc_instance[instance];
+    CDCMaskInterrupts();
+    cdc->rx_throttle_count = 0;
+    CDCUnmaskInterrupts();
+}//end CDCRxClearThrottleCount
+#endif
+
+#if defined(USB_CDC_MASKED_TIMER)
+/**************************************************************************
+  Function:
+        uint16_t CDCGetLongestMaskedTime(void)
+    
+  Summary:
+    Returns the longest time the CDC driver has kept the USB interrupt
+    masked.
+
+  Description:
+    See usb_device_cdc.h.
+  **************************************************************************/
+uint16_t CDCGetLongestMaskedTime(void)
+{
+    return cdc_masked_longest;
+}//end CDCGetLongestMaskedTime
+
+/**************************************************************************
+  Function:
+        void CDCClearLongestMaskedTime(void)
+    
+  Summary:
+    Restarts the measurement of CDCGetLongestMaskedTime().
+
+  Description:
+    See usb_device_cdc.h.
+  **************************************************************************/
+void CDCClearLongestMaskedTime(void)
+{
+    cdc_masked_longest = 0;
+}//end CDCClearLongestMaskedTime
+
+/**************************************************************************
+  Function:
+        static void CDCMaskedWindowEnd(void)
+    
+  Summary:
+    Ends the timing of a masked section started by CDCMaskInterrupts().
+
+  Conditions:
+    USB interrupts masked.
+  **************************************************************************/
+static void CDCMaskedWindowEnd(void)
+{
+    uint16_t now = USB_CDC_MASKED_TIMER();
+    uint16_t elapsed = now - cdc_masked_start;
+    
+    /*
+     * The timer counts up to its period and starts again from 0.
+     */
+    if(now < cdc_masked_start)
+    {
+        elapsed += USB_CDC_MASKED_TIMER_PERIOD;
+    }
+    
+    if(elapsed > cdc_masked_longest)
+    {
+        cdc_masked_longest = elapsed;
+    }
+}//end CDCMaskedWindowEnd
+#endif
+
+/**************************************************************************
+  Function:
+        static void CDCTxArm(uint8_t instance, uint8_t length)
+    
+  Summary:
+    Hands the current ping-pong transmit buffer to the USB module and moves
+    on to the other one.
+
+  Conditions:
+    USB interrupts masked.  The next IN BDT entry of CDC_DATA_EP is free.
+
+  Input:
+    uint8_t length - the number of bytes in cdc_data_tx[instance][cdc->tx_buffer], 0
+                     for a zero length packet.
+  **************************************************************************/
+static void CDCTxArm(uint8_t instance, uint8_t length)
+{
+    CDC_INSTANCE* cdc = &cdc_instance[instance];
+    cdc->data_in_handle = USBTxOnePacket(cdc_interfaces[instance].data_ep,(uint8_t*)&cdc_data_tx[instance][cdc->tx_buffer],length);
+    cdc->data_in_handles[cdc->tx_buffer] = cdc->data_in_handle;
+    
+    cdc->tx_buffer++;
+    if(cdc->tx_buffer >= CDC_TX_BUFFER_COUNT)
+    {
+        cdc->tx_buffer = 0;
+    }
+}//end CDCTxArm
+
+/**************************************************************************
+  Function:
+        static bool CDCTxArmStaged(uint8_t instance, uint8_t length)
+    
+  Summary:
+    Arms a packet CDCTxContinue() has staged in the current ping-pong
+    transmit buffer.
+
+  Description:
+    From the main loop this is the one step of staging a packet that runs
+    masked.  The packet is not sent if the USB interrupt terminated the
+    transfer or ran CDCInitEP() while it was being copied.
+
+  Output:
+    bool - true if the packet was armed.
+  **************************************************************************/
+static bool CDCTxArmStaged(uint8_t instance, uint8_t length)
+{
+    CDC_INSTANCE* cdc = &cdc_instance[instance];
+    bool armed = false;
+    
+    //From the USB interrupt itself
+    if(cdc->tx_owner == false)
+    {
+        CDCTxArm(instance, length);
+        return true;
+    }
+    
+    CDCMaskInterrupts();
+    if((cdc->tx_abort == false) && (cdc->tx_reset == false))
+    {
+        CDCTxArm(instance, length);
+        armed = true;
+    }
+    CDCUnmaskInterrupts();
+    
+    return armed;
+}//end CDCTxArmStaged
+
+/**************************************************************************
+  Function:
+        static void CDCRxArm(uint8_t instance)
+    
+  Summary:
+    Hands the next receive buffer to the USB module and moves on to the
+    other one.
+
+  Conditions:
+    USB interrupts masked.  The next OUT BDT entry of CDC_DATA_EP is free.
+  **************************************************************************/
+static void CDCRxArm(uint8_t instance)
+{
+    CDC_INSTANCE* cdc = &cdc_instance[instance];
+    cdc->data_out_handles[cdc->rx_arm] = USBRxOnePacket(cdc_interfaces[instance].data_ep,(uint8_t*)&cdc_data_rx[instance][cdc->rx_arm],CDC_DATA_OUT_EP_SIZE);
+    
+    cdc->rx_arm++;
+    if(cdc->rx_arm >= CDC_RX_BUFFER_COUNT)
+    {
+        cdc->rx_arm = 0;
+    }
+}//end CDCRxArm
+
+/**************************************************************************
+  Function:
+        static void CDCRxNext(uint8_t instance)
+    
+  Summary:
+    Re-arms the buffer of the packet that has just been read and moves on
+    to the next one.
+
+  Conditions:
+    USB interrupts masked.  The packet on cdc->data_out_handle has been read.
+  **************************************************************************/
+static void CDCRxNext(uint8_t instance)
+{
+    CDC_INSTANCE* cdc = &cdc_instance[instance];
+    /*
+     * Packets are read in the order they were armed, so this buffer is
+     * also the one whose BDT entry the ping-pong pointer is on.  The other
+     * buffer stayed armed the whole time.
+     */
+    CDCRxArm(instance);
+    
+    cdc->rx_buffer++;
+    if(cdc->rx_buffer >= CDC_RX_BUFFER_COUNT)
+    {
+        cdc->rx_buffer = 0;
+    }
+    cdc->data_out_handle = cdc->data_out_handles[cdc->rx_buffer];
+}//end CDCRxNext
+
+/**************************************************************************
+  Function:
+        static void CDCRxReset(uint8_t instance)
+    
+  Summary:
+    Arms every receive buffer of an OUT endpoint that USBEnableEndpoint()
+    has just enabled again.  Packets still in them are dropped.
+
+  Conditions:
+    USB interrupts masked.  The main loop does not own the receive side.
+  **************************************************************************/
+static void CDCRxReset(uint8_t instance)
+{
+    CDC_INSTANCE* cdc = &cdc_instance[instance];
+    cdc->rx_reset = false;
+    cdc->rx_rearm = false;
+    cdc->rx_terminated = 0;
+    cdc->rx_arm = 0;
+    CDCRxArmAll(instance);
+}//end CDCRxReset
+
+#if defined(USB_CDC_RX_RING_SIZE)
+/**************************************************************************
+  Function:
+        static void CDCRxRingFill(uint8_t instance)
+    
+  Summary:
+    Moves every received packet that fits into the receive ring and
+    re-arms its buffer.
+
+  Description:
+    A packet that does not fit stays in its endpoint buffer, and the host
+    is NAKed, until the application has read enough from the ring.  No
+    data is dropped.
+
+  Conditions:
+    Called from the USB interrupt while the main loop does not own the
+    receive side, or from CDCRxRingPump() while it does.
+  **************************************************************************/
+static void CDCRxRingFill(uint8_t instance)
+{
+    CDC_INSTANCE* cdc = &cdc_instance[instance];
+    uint16_t head;
+    uint16_t count;
+    uint16_t span;
+    uint8_t length;
+    uint8_t* packet;
+    
+    while((cdc->rx_reset == false) && (cdc->data_out_handle != NULL) && !USBHandleBusy(cdc->data_out_handle))
+    {
+        head = cdc->rx_ring_head;
+        count = head - cdc->rx_ring_tail;
+        length = (uint8_t)USBHandleGetLength(cdc->data_out_handle);
+        
+        if((uint16_t)(USB_CDC_RX_RING_SIZE - count) < length)
+        {
+            break;
+        }
+        
+        packet = (uint8_t*)&cdc_data_rx[instance][cdc->rx_buffer];
+        count += length;
+        
+        /*
+         * At most two spans: up to the end of the ring, then from its start.
+         */
+        span = USB_CDC_RX_RING_SIZE - (head & CDC_RX_RING_MASK);
+        
+        if(span > length)
+            span = length;
+        
+        USB_CDC_COPY(&cdc_rx_ring[instance][head & CDC_RX_RING_MASK], packet, span);
+        USB_CDC_COPY(&cdc_rx_ring[instance][0], &packet[span], length - span);
+        
+        if(CDCRxRingCommit(instance, head + length) == false)
+        {
+            break;
+        }
+        
+        if(count > cdc->rx_ring_high_water)
+        {
+            cdc->rx_ring_high_water = count;
+        }
+    }
+}//end CDCRxRingFill
+
+/**************************************************************************
+  Function:
+        static bool CDCRxRingCommit(uint8_t instance, uint16_t head)
+    
+  Summary:
+    Adds the packet CDCRxRingFill() has just copied to the receive ring and
+    re-arms its buffer.
+
+  Description:
+    From the main loop this is the one step of moving a packet that runs
+    masked.  The packet is dropped if the USB interrupt ran CDCInitEP()
+    while it was being copied.
+
+  Input:
+    uint16_t head - the ring head after the packet.
+
+  Output:
+    bool - true if the packet was added.
+  **************************************************************************/
+static bool CDCRxRingCommit(uint8_t instance, uint16_t head)
+{
+    CDC_INSTANCE* cdc = &cdc_instance[instance];
+    bool committed = false;
+    
+    //From the USB interrupt itself
+    if(cdc->rx_owner == false)
+    {
+        cdc->rx_ring_head = head;
+        CDCRxNext(instance);
+        return true;
+    }
+    
+    CDCMaskInterrupts();
+    if(cdc->rx_reset == false)
+    {
+        cdc->rx_ring_head = head;
+        CDCRxNext(instance);
+        committed = true;
+    }
+    CDCUnmaskInterrupts();
+    
+    return committed;
+}//end CDCRxRingCommit
+
+/**************************************************************************
+  Function:
+        static void CDCRxRingPump(uint8_t instance)
+    
+  Summary:
+    Runs CDCRxRingFill() from the main loop with the USB interrupt enabled.
+
+  Description:
+    The receive side counterpart of CDCTxPump(): packets are copied into
+    the ring unmasked, and only CDCRxRingCommit() and the final check of
+    the interrupt's requests run masked.
+  **************************************************************************/
+static void CDCRxRingPump(uint8_t instance)
+{
+    CDC_INSTANCE* cdc = &cdc_instance[instance];
+    bool again;
+    
+    do
+    {
+        cdc->rx_again = false;
+        cdc->rx_owner = true;
+        
+        CDCRxRingFill(instance);
+        
+        CDCMaskInterrupts();
+        cdc->rx_owner = false;
+        if(cdc->rx_reset == true)
+        {
+            CDCRxReset(instance);
+        }
+        else if(cdc->rx_rearm == true)
+        {
+            cdc->rx_rearm = false;
+            CDCRxRearm(instance);
+        }
+        again = cdc->rx_again;
+        #if defined(USB_CDC_RX_FLOW_CONTROL)
+            //The ring level changed in both directions: report it.
+            CDCNotificationHandler(instance);
+        #endif
+        CDCUnmaskInterrupts();
+    } while(again == true);
+}//end CDCRxRingPump
+#endif
+
+/**************************************************************************
+  Function:
+        static void CDCEncapsulatedCommandReceived(void)
+    
+  Summary:
+    Hands the command of a SEND_ENCAPSULATED_COMMAND request to the main
+    loop once its data stage is done.
+
+  Conditions:
+    Called by the USB stack, from the USB interrupt.
+  **************************************************************************/
+static void CDCEncapsulatedCommandReceived(void)
+{
+    cdc_encapsulated.state = CDC_ENCAPSULATED_PENDING;
+}//end CDCEncapsulatedCommandReceived
+
+/**************************************************************************
+  Function:
+        static void CDCRxArmAll(uint8_t instance)
+    
+  Summary:
+    Arms every receive buffer, starting with the one on the ping-pong
+    pointer, which is then also the first to be read.
+
+  Conditions:
+    None of the OUT BDT entries of CDC_DATA_EP is owned by the SIE.
+  **************************************************************************/
+static void CDCRxArmAll(uint8_t instance)
+{
+    CDC_INSTANCE* cdc = &cdc_instance[instance];
+    uint8_t i;
+    
+    cdc->rx_buffer = cdc->rx_arm;
+    
+    for(i = 0; i < CDC_RX_BUFFER_COUNT; i++)
+    {
+        CDCRxArm(instance);
+    }
+    
+    cdc->data_out_handle = cdc->data_out_handles[cdc->rx_buffer];
+}//end CDCRxArmAll
+
+/**************************************************************************
+  Function:
+        static void CDCRxRearm(uint8_t instance)
+    
+  Summary:
+    Re-arms the receive buffers whose OUT transfers were terminated.
+
+  Description:
+    Packets are received in the order the buffers were armed, so the
+    buffers still holding a packet come first from rx_buffer and the
+    terminated ones follow them.  The terminated ones are armed again in
+    that order; the others are left to be read.
+
+  Conditions:
+    USB interrupts masked.  None of the OUT BDT entries of CDC_DATA_EP is
+    owned by the SIE.
+  **************************************************************************/
+static void CDCRxRearm(uint8_t instance)
+{
+    CDC_INSTANCE* cdc = &cdc_instance[instance];
+    uint8_t i;
+    
+    cdc->rx_arm = cdc->rx_buffer;
+    
+    for(i = 0; i < CDC_RX_BUFFER_COUNT; i++)
+    {
+        if((cdc->rx_terminated & (1 << cdc->rx_arm)) != 0)
+        {
+            CDCRxArm(instance);
+        }
+        else
+        {
+            cdc->rx_arm++;
+            if(cdc->rx_arm >= CDC_RX_BUFFER_COUNT)
+            {
+                cdc->rx_arm = 0;
+            }
+        }
+    }
+    
+    cdc->rx_terminated = 0;
+    cdc->data_out_handle = cdc->data_out_handles[cdc->rx_buffer];
+}//end CDCRxRearm
+
+/**************************************************************************
+  Function:
+        static uint8_t CDCTxStreamFill(uint8_t instance, uint8_t* packet)
+    
+  Summary:
+    Copies up to one packet of a streaming transfer into 'packet', across
+    as many chunks as it takes.
+
+  Output:
+    uint8_t - the number of bytes copied.  When the packet is full the
+              next chunk has already been fetched, so cdc->tx_stream_len is
+              0 only if no data follows.
+  **************************************************************************/
+static uint8_t CDCTxStreamFill(uint8_t instance, uint8_t* packet)
+{
+    CDC_INSTANCE* cdc = &cdc_instance[instance];
+    uint8_t count = 0;
+    uint8_t i;
+    
+    while(count < CDC_DATA_IN_EP_SIZE)
+    {
+        if((cdc->tx_stream_len == 0) && (CDCTxStreamRefill(instance) == false))
+        {
+            return count;
+        }
+        
+        if(cdc->tx_stream_len > (uint32_t)(CDC_DATA_IN_EP_SIZE - count))
+            i = CDC_DATA_IN_EP_SIZE - count;
+        else
+            i = (uint8_t)cdc->tx_stream_len;
+        
+        cdc->tx_stream_len -= i;
+        
+        USB_CDC_COPY(&packet[count], cdc->tx_stream, i);
+        cdc->tx_stream += i;
+        count += i;
+    }
+    
+    if(cdc->tx_stream_len == 0)
+    {
+        (void)CDCTxStreamRefill(instance);
+    }
+    
+    return count;
+}//end CDCTxStreamFill
+
+/**************************************************************************
+  Function:
+        static bool CDCTxStreamRefill(uint8_t instance)
+    
+  Summary:
+    Asks the refill callback of a streaming transfer for its next chunk.
+
+  Output:
+    bool - true if a non-empty chunk was returned.  Once the callback has
+           returned none it is not called again for this transfer.
+  **************************************************************************/
+static bool CDCTxStreamRefill(uint8_t instance)
+{
+    CDC_INSTANCE* cdc = &cdc_instance[instance];
+    if(cdc->tx_refill != NULL)
+    {
+        cdc->tx_stream = cdc->tx_refill(&cdc->tx_stream_len);
+        
+        if((cdc->tx_stream != NULL) && (cdc->tx_stream_len != 0))
+        {
+            return true;
+        }
+        
+        cdc->tx_refill = NULL;
+    }
+    
+    cdc->tx_stream_len = 0;
+    return false;
+}//end CDCTxStreamRefill
 
 #endif //USB_USE_CDC
 
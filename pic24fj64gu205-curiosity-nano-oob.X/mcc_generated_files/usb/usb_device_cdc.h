@@ -93,14 +93,19 @@ please contact mla_licensing@microchip.com
 /* CDC Bulk IN transfer states */
 #define CDC_TX_READY                0
 #define CDC_TX_BUSY                 1
-#define CDC_TX_BUSY_ZLP             2       // ZLP: Zero Length Packet
-#define CDC_TX_COMPLETING           3
+#define CDC_TX_BUSY_ZLP             2       // ZLP: Zero Length Packet (unused with ping-pong TX)
+#define CDC_TX_COMPLETING           3       // unused with ping-pong TX
+#define CDC_TX_STREAMING            4       // CDCTxStreamStart() transfer
 
+/*
+ * The handler can tell which CDC function the request was for from
+ * SetupPkt.bIntfID.
+ */
 #if defined(USB_CDC_SET_LINE_CODING_HANDLER) 
-    #define LINE_CODING_TARGET &cdc_notice.SetLineCoding._byte[0]
+    #define LINE_CODING_TARGET(instance) &cdc_notice.SetLineCoding._byte[0]
     #define LINE_CODING_PFUNC &USB_CDC_SET_LINE_CODING_HANDLER
 #else
-    #define LINE_CODING_TARGET &line_coding._byte[0]
+    #define LINE_CODING_TARGET(instance) &cdc_instance[instance].line_coding._byte[0]
     #define LINE_CODING_PFUNC NULL
 #endif
 
@@ -142,7 +147,7 @@ please contact mla_licensing@microchip.com
 
 /******************************************************************************
     Function:
-        void CDCSetBaudRate(uint32_t baudRate)
+        void CDCSetBaudRate(uint8_t instance, uint32_t baudRate)
         
     Summary:
         This macro is used set the baud rate reported back to the host during
@@ -154,7 +159,7 @@ please contact mla_licensing@microchip.com
 
         Typical Usage:
         <code>
-            CDCSetBaudRate(19200);
+            CDCSetBaudRate(0, 19200);
         </code>
 
         This function is optional for CDC devices that do not actually convert
@@ -164,6 +169,7 @@ please contact mla_licensing@microchip.com
         None
         
     Parameters:
+        uint8_t instance - the CDC function, 0 to CDC_INSTANCE_COUNT - 1
         uint32_t baudRate - The desired baud rate
         
     Return Values:
@@ -173,11 +179,11 @@ please contact mla_licensing@microchip.com
         None
   
  *****************************************************************************/
-#define CDCSetBaudRate(baudRate) {line_coding.dwDTERate=baudRate;}
+#define CDCSetBaudRate(instance,baudRate) {cdc_instance[instance].line_coding.dwDTERate=baudRate;}
 
 /******************************************************************************
     Function:
-        void CDCSetCharacterFormat(uint8_t charFormat)
+        void CDCSetCharacterFormat(uint8_t instance, uint8_t charFormat)
         
     Summary:
         This macro is used manually set the character format reported back to 
@@ -189,7 +195,7 @@ please contact mla_licensing@microchip.com
 
         Typical Usage:
         <code>
-            CDCSetCharacterFormat(NUM_STOP_BITS_1);
+            CDCSetCharacterFormat(0, NUM_STOP_BITS_1);
         </code>
         
         This function is optional for CDC devices that do not actually convert
@@ -199,6 +205,7 @@ please contact mla_licensing@microchip.com
         None
         
     Parameters:
+        uint8_t instance - the CDC function, 0 to CDC_INSTANCE_COUNT - 1
         uint8_t charFormat - number of stop bits.  Available options are:
          * NUM_STOP_BITS_1 - 1 Stop bit
          * NUM_STOP_BITS_1_5 - 1.5 Stop bits
@@ -211,14 +218,14 @@ please contact mla_licensing@microchip.com
         None
   
  *****************************************************************************/
-#define CDCSetCharacterFormat(charFormat) {line_coding.bCharFormat=charFormat;}
+#define CDCSetCharacterFormat(instance,charFormat) {cdc_instance[instance].line_coding.bCharFormat=charFormat;}
 #define NUM_STOP_BITS_1     0   //1 stop bit - used by CDCSetLineCoding() and CDCSetCharacterFormat()
 #define NUM_STOP_BITS_1_5   1   //1.5 stop bit - used by CDCSetLineCoding() and CDCSetCharacterFormat()
 #define NUM_STOP_BITS_2     2   //2 stop bit - used by CDCSetLineCoding() and CDCSetCharacterFormat()
 
 /******************************************************************************
     Function:
-        void CDCSetParity(uint8_t parityType)
+        void CDCSetParity(uint8_t instance, uint8_t parityType)
         
     Summary:
         This function is used manually set the parity format reported back to 
@@ -230,7 +237,7 @@ please contact mla_licensing@microchip.com
 
         Typical Usage:
         <code>
-            CDCSetParity(PARITY_NONE);
+            CDCSetParity(0, PARITY_NONE);
         </code>
         
         This function is optional for CDC devices that do not actually convert
@@ -240,6 +247,7 @@ please contact mla_licensing@microchip.com
         None
         
     Parameters:
+        uint8_t instance - the CDC function, 0 to CDC_INSTANCE_COUNT - 1
         uint8_t parityType - Type of parity.  The options are the following:
             * PARITY_NONE
             * PARITY_ODD
@@ -254,7 +262,7 @@ please contact mla_licensing@microchip.com
         None
   
  *****************************************************************************/
-#define CDCSetParity(parityType) {line_coding.bParityType=parityType;}
+#define CDCSetParity(instance,parityType) {cdc_instance[instance].line_coding.bParityType=parityType;}
 #define PARITY_NONE     0 //no parity - used by CDCSetLineCoding() and CDCSetParity()
 #define PARITY_ODD      1 //odd parity - used by CDCSetLineCoding() and CDCSetParity()
 #define PARITY_EVEN     2 //even parity - used by CDCSetLineCoding() and CDCSetParity()
@@ -263,7 +271,7 @@ please contact mla_licensing@microchip.com
 
 /******************************************************************************
     Function:
-        void CDCSetDataSize(uint8_t dataBits)
+        void CDCSetDataSize(uint8_t instance, uint8_t dataBits)
         
     Summary:
         This function is used manually set the number of data bits reported back 
@@ -275,7 +283,7 @@ please contact mla_licensing@microchip.com
 
         Typical Usage:
         <code>
-            CDCSetDataSize(8);
+            CDCSetDataSize(0, 8);
         </code>
         
         This function is optional for CDC devices that do not actually convert
@@ -285,6 +293,7 @@ please contact mla_licensing@microchip.com
         None
         
     Parameters:
+        uint8_t instance - the CDC function, 0 to CDC_INSTANCE_COUNT - 1
         uint8_t dataBits - number of data bits.  The options are 5, 6, 7, 8, or 16.
         
     Return Values:
@@ -294,11 +303,11 @@ please contact mla_licensing@microchip.com
         None
   
  *****************************************************************************/
-#define CDCSetDataSize(dataBits) {line_coding.bDataBits=dataBits;}
+#define CDCSetDataSize(instance,dataBits) {cdc_instance[instance].line_coding.bDataBits=dataBits;}
 
 /******************************************************************************
     Function:
-        void CDCSetLineCoding(uint32_t baud, uint8_t format, uint8_t parity, uint8_t dataSize)
+        void CDCSetLineCoding(uint8_t instance, uint32_t baud, uint8_t format, uint8_t parity, uint8_t dataSize)
         
     Summary:
         This function is used to manually set the data reported back 
@@ -310,7 +319,7 @@ please contact mla_licensing@microchip.com
 
         Typical Usage:
         <code>
-            CDCSetLineCoding(19200, NUM_STOP_BITS_1, PARITY_NONE, 8);
+            CDCSetLineCoding(0, 19200, NUM_STOP_BITS_1, PARITY_NONE, 8);
         </code>
         
         This function is optional for CDC devices that do not actually convert
@@ -320,6 +329,7 @@ please contact mla_licensing@microchip.com
         None
         
     Parameters:
+        uint8_t instance - the CDC function, 0 to CDC_INSTANCE_COUNT - 1
         uint32_t baud - The desired baud rate
         uint8_t format - number of stop bits.  Available options are:
          * NUM_STOP_BITS_1 - 1 Stop bit
@@ -340,16 +350,16 @@ please contact mla_licensing@microchip.com
         None
   
  *****************************************************************************/
-#define CDCSetLineCoding(baud,format,parity,dataSize) {\
-            CDCSetBaudRate(baud);\
-            CDCSetCharacterFormat(format);\
-            CDCSetParity(parity);\
-            CDCSetDataSize(dataSize);\
+#define CDCSetLineCoding(instance,baud,format,parity,dataSize) {\
+            CDCSetBaudRate(instance,baud);\
+            CDCSetCharacterFormat(instance,format);\
+            CDCSetParity(instance,parity);\
+            CDCSetDataSize(instance,dataSize);\
         }
 
 /******************************************************************************
     Function:
-        bool USBUSARTIsTxTrfReady(void)
+        bool USBUSARTIsTxTrfReady(uint8_t instance)
         
     Summary:
         This macro is used to check if the CDC class is ready
@@ -361,9 +371,9 @@ please contact mla_licensing@microchip.com
 
         Typical Usage:
         <code>
-            if(USBUSARTIsTxTrfReady())
+            if(USBUSARTIsTxTrfReady(0))
             {
-                putrsUSBUSART("Hello World");
+                putrsUSBUSART(0, "Hello World");
             }
         </code>
         
@@ -372,7 +382,7 @@ please contact mla_licensing@microchip.com
         configured state (i.e. - USBDeviceGetState() returns CONFIGURED_STATE)
         
     Parameters:
-        None
+        uint8_t instance - the CDC function, 0 to CDC_INSTANCE_COUNT - 1
         
     Return Values:
         Returns a boolean value indicating if the CDC class handler firmware
@@ -390,7 +400,7 @@ please contact mla_licensing@microchip.com
         and complete.
   
  *****************************************************************************/
-#define USBUSARTIsTxTrfReady()      (cdc_trf_state == CDC_TX_READY)
+#define USBUSARTIsTxTrfReady(instance)  (cdc_instance[instance].trf_state == CDC_TX_READY)
 
 /******************************************************************************
     Function:
@@ -400,11 +410,11 @@ please contact mla_licensing@microchip.com
         Deprecated in MCHPFSUSB v2.3.  This macro has been replaced by 
         USBUSARTIsTxTrfReady().
  *****************************************************************************/
-#define mUSBUSARTIsTxTrfReady()     USBUSARTIsTxTrfReady()
+#define mUSBUSARTIsTxTrfReady(instance) USBUSARTIsTxTrfReady(instance)
 
 /******************************************************************************
     Function:
-        void mUSBUSARTTxRam(uint8_t *pData, uint8_t len)
+        void mUSBUSARTTxRam(uint8_t instance, uint8_t *pData, uint8_t len)
         
     Description:
         Use this macro to transfer data located in data memory.
@@ -418,9 +428,9 @@ please contact mla_licensing@microchip.com
  
          Typical Usage:
         <code>
-            if(USBUSARTIsTxTrfReady())
+            if(USBUSARTIsTxTrfReady(0))
             {
-                mUSBUSARTTxRam(&UserDataBuffer[0], 200);
+                mUSBUSARTTxRam(0, &UserDataBuffer[0], 200);
             }
         </code>
         
@@ -431,6 +441,7 @@ please contact mla_licensing@microchip.com
         to calling this API function for the first time.
         
     Parameters:
+        instance: The CDC function, 0 to CDC_INSTANCE_COUNT - 1
         pDdata  : Pointer to the starting location of data bytes
         len     : Number of bytes to be transferred
         
@@ -448,17 +459,17 @@ please contact mla_licensing@microchip.com
         
   
  *****************************************************************************/
-#define mUSBUSARTTxRam(pData,len)   \
-{                                   \
-    pCDCSrc.bRam = pData;           \
-    cdc_tx_len = len;               \
-    cdc_mem_type = USB_EP0_RAM;     \
-    cdc_trf_state = CDC_TX_BUSY;    \
+#define mUSBUSARTTxRam(instance,pData,len)          \
+{                                                   \
+    cdc_instance[instance].pSrc.bRam = pData;       \
+    cdc_instance[instance].tx_len = len;            \
+    cdc_instance[instance].mem_type = USB_EP0_RAM;  \
+    cdc_instance[instance].trf_state = CDC_TX_BUSY; \
 }
 
 /******************************************************************************
     Function:
-        void mUSBUSARTTxRom(rom uint8_t *pData, uint8_t len)
+        void mUSBUSARTTxRom(uint8_t instance, rom uint8_t *pData, uint8_t len)
         
     Description:
         Use this macro to transfer data located in program memory.
@@ -473,9 +484,9 @@ please contact mla_licensing@microchip.com
  
           Typical Usage:
         <code>
-            if(USBUSARTIsTxTrfReady())
+            if(USBUSARTIsTxTrfReady(0))
             {
-                mUSBUSARTTxRom(&SomeRomString[0], 200);
+                mUSBUSARTTxRom(0, &SomeRomString[0], 200);
             }
         </code>
        
@@ -484,6 +495,7 @@ please contact mla_licensing@microchip.com
         Value of 'len' must be equal to or smaller than 255 bytes.
         
     Parameters:
+        instance: The CDC function, 0 to CDC_INSTANCE_COUNT - 1
         pDdata  : Pointer to the starting location of data bytes
         len     : Number of bytes to be transferred
         
@@ -495,12 +507,12 @@ please contact mla_licensing@microchip.com
         actual transfer is handled by CDCTxService().
                     
  *****************************************************************************/
-#define mUSBUSARTTxRom(pData,len)   \
-{                                   \
-    pCDCSrc.bRom = pData;           \
-    cdc_tx_len = len;               \
-    cdc_mem_type = USB_EP0_ROM;     \
-    cdc_trf_state = CDC_TX_BUSY;    \
+#define mUSBUSARTTxRom(instance,pData,len)          \
+{                                                   \
+    cdc_instance[instance].pSrc.bRom = pData;       \
+    cdc_instance[instance].tx_len = len;            \
+    cdc_instance[instance].mem_type = USB_EP0_ROM;  \
+    cdc_instance[instance].trf_state = CDC_TX_BUSY; \
 }
 
 /**************************************************************************
@@ -515,7 +527,8 @@ please contact mla_licensing@microchip.com
     This function initializes the CDC function driver. This function sets
     the default line coding (baud rate, bit parity, number of data bits,
     and format). This function also enables the endpoints and prepares for
-    the first transfer from the host.
+    the first transfer from the host.  Every CDC function of the
+    configuration (CDC_INSTANCE_COUNT) is initialized.
     
     This function should be called after the SET_CONFIGURATION command.
     This is most simply done by calling this function from the
@@ -563,21 +576,33 @@ void USBCheckCDCRequest(void);
 
 
 /**************************************************************************
-  Function: void CDCNotificationHandler(void)
-  Summary: Checks for changes in DSR status and reports them to the USB host.
-  Description: Checks for changes in DSR pin state and reports any changes
-               to the USB host. 
+  Function: void CDCNotificationHandler(uint8_t instance)
+  Summary: Sends pending notifications, and changes in DSR status, to the
+           USB host.
+  Description: Sends a RESPONSE_AVAILABLE notification once an
+               encapsulated command response is waiting, and checks for
+               changes in DSR pin state and reports any changes to the USB
+               host. 
   Conditions: CDCInitEP() must have been called previously, prior to calling
               CDCNotificationHandler() for the first time.
+  Input:
+    uint8_t instance - the CDC function, 0 to CDC_INSTANCE_COUNT - 1
   Remarks:
-    This function is only implemented and needed when the 
-    USB_CDC_SUPPORT_DSR_REPORTING option has been enabled.  If the function is
-    enabled, it should be called periodically to sample the DSR pin and feed
-    the information to the USB host.  This can be done by calling 
-    CDCNotificationHandler() by itself, or, by calling CDCTxService() which
-    also calls CDCNotificationHandler() internally, when appropriate.
+    The DSR state is only reported when the USB_CDC_SUPPORT_DSR_REPORTING
+    or USB_CDC_RX_FLOW_CONTROL option has been enabled.  It should then be
+    called periodically to sample the DSR pin and feed the information to
+    the USB host.  This can be done by calling CDCNotificationHandler() by
+    itself, or, by calling CDCTxService() which also calls
+    CDCNotificationHandler() internally, when appropriate.  The one DSR pin
+    is reported on every CDC function.
+    
+    With USB_CDC_RX_FLOW_CONTROL, DSR is also dropped while the receive
+    ring holds USB_CDC_RX_FLOW_OFF_LEVEL bytes or more, and raised again
+    once it has been read down to USB_CDC_RX_FLOW_ON_LEVEL.  The driver
+    sends those changes by itself, from the USB interrupt as the ring
+    fills and from getsUSBUSART() and CDCRxReleaseBuffer() as it drains.
   **************************************************************************/
-void CDCNotificationHandler(void);
+void CDCNotificationHandler(uint8_t instance);
 
 
 /**********************************************************************************
@@ -592,6 +617,16 @@ void CDCNotificationHandler(void);
     Handles events from the USB stack.  This function should be called when 
     there is a USB event that needs to be processed by the CDC driver.
     
+    EVENT_TRANSFER_TERMINATED re-arms the bulk OUT buffers that were
+    terminated, leaving any that hold a packet not yet read or lent out by
+    CDCRxAcquireBuffer(), and abandons the current bulk IN transfer.
+    EVENT_TRANSFER for a completed bulk IN packet
+    stages the next packet of the current transfer (and any owed zero
+    length packet) straight from the USB interrupt, so multi-packet
+    transfers do not wait for the next CDCTxService() call.  The first
+    packet of a transfer is still sent by CDCTxService().  The endpoint or
+    handle of the event tells which CDC function it is for.
+    
   Conditions:
     Value of input argument 'len' should be smaller than the maximum
     endpoint size responsible for receiving bulk data from USB host for CDC
@@ -608,7 +643,7 @@ bool USBCDCEventHandler(USB_EVENT event, void *pdata, uint16_t size);
 
 /**********************************************************************************
   Function:
-        uint8_t getsUSBUSART(char *buffer, uint8_t len)
+        uint8_t getsUSBUSART(uint8_t instance, uint8_t *buffer, uint8_t len)
     
   Summary:
     getsUSBUSART copies a string of BYTEs received through USB CDC Bulk OUT
@@ -616,9 +651,9 @@ bool USBCDCEventHandler(USB_EVENT event, void *pdata, uint16_t size);
     It does not wait for data if there is no data available. Instead it
     returns '0' to notify the caller that there is no data available.
 
-    If a call is made and there is still data remaining in the buffer unread
-    when this function returns, it will be flushed and more data will be 
-    received from the bus.
+    Data that does not fit in 'buffer' is discarded, unless
+    USB_CDC_RX_RING_SIZE is defined: it then stays in the receive ring for
+    the next call.
 
   Description:
     getsUSBUSART copies a string of BYTEs received through USB CDC Bulk OUT
@@ -626,16 +661,16 @@ bool USBCDCEventHandler(USB_EVENT event, void *pdata, uint16_t size);
     It does not wait for data if there is no data available. Instead it
     returns '0' to notify the caller that there is no data available.
 
-    If a call is made and there is still data remaining in the buffer unread
-    when this function returns, it will be flushed and more data will be 
-    received from the bus.
+    Data that does not fit in 'buffer' is discarded, unless
+    USB_CDC_RX_RING_SIZE is defined: it then stays in the receive ring for
+    the next call.
     
     Typical Usage:
     <code>
         uint8_t numBytes;
         uint8_t buffer[64]
     
-        numBytes = getsUSBUSART(buffer,sizeof(buffer)); //until the buffer is free.
+        numBytes = getsUSBUSART(0,buffer,sizeof(buffer)); //until the buffer is free.
         if(numBytes \> 0)
         {
             //we received numBytes bytes of data and they are copied into
@@ -649,11 +684,12 @@ bool USBCDCEventHandler(USB_EVENT event, void *pdata, uint16_t size);
     class. Input argument 'buffer' should point to a buffer area that is
     bigger or equal to the size specified by 'len'.
 
-    If a call is made and there is still data remaining in the buffer unread
-    when this function returns, it will be flushed and more data will be 
-    received from the bus.
+    Data that does not fit in 'buffer' is discarded, unless
+    USB_CDC_RX_RING_SIZE is defined: it then stays in the receive ring for
+    the next call.
 
   Input:
+    instance - The CDC function, 0 to CDC_INSTANCE_COUNT - 1
     buffer -  Pointer to where received BYTEs are to be stored
     len -     The number of BYTEs expected.
   Output:
@@ -663,11 +699,11 @@ bool USBCDCEventHandler(USB_EVENT event, void *pdata, uint16_t size);
               indicates that no new CDC bulk OUT endpoint data was available.
                                                                                    
   **********************************************************************************/
-uint8_t getsUSBUSART(uint8_t *buffer, uint8_t len);
+uint8_t getsUSBUSART(uint8_t instance, uint8_t *buffer, uint8_t len);
 
 /******************************************************************************
   Function:
-	void putUSBUSART(char *data, uint8_t length)
+	void putUSBUSART(uint8_t instance, char *data, uint8_t length)
 		
   Summary:
     putUSBUSART writes an array of data to the USB. Use this version, is
@@ -681,10 +717,10 @@ uint8_t getsUSBUSART(uint8_t *buffer, uint8_t len);
     
     Typical Usage:
     <code>
-        if(USBUSARTIsTxTrfReady())
+        if(USBUSARTIsTxTrfReady(0))
         {
             char data[] = {0x00, 0x01, 0x02, 0x03, 0x04};
-            putUSBUSART(data,5);
+            putUSBUSART(0,data,5);
         }
     </code>
     
@@ -701,15 +737,16 @@ uint8_t getsUSBUSART(uint8_t *buffer, uint8_t len);
     255 BYTEs.
 
   Input:
+    uint8_t instance - the CDC function, 0 to CDC_INSTANCE_COUNT - 1
     char *data - pointer to a RAM array of data to be transfered to the host
     uint8_t length - the number of bytes to be transfered (must be less than 255).
 		
  *****************************************************************************/
-void putUSBUSART(uint8_t *data, uint8_t Length);
+void putUSBUSART(uint8_t instance, uint8_t *data, uint8_t Length);
 
 /******************************************************************************
 	Function:
-		void putsUSBUSART(char *data)
+		void putsUSBUSART(uint8_t instance, char *data)
 		
   Summary:
     putsUSBUSART writes a string of data to the USB including the null
@@ -721,10 +758,10 @@ void putUSBUSART(uint8_t *data, uint8_t Length);
     
     Typical Usage:
     <code>
-        if(USBUSARTIsTxTrfReady())
+        if(USBUSARTIsTxTrfReady(0))
         {
             char data[] = "Hello World";
-            putsUSBUSART(data);
+            putsUSBUSART(0,data);
         }
     </code>
     
@@ -741,17 +778,18 @@ void putUSBUSART(uint8_t *data, uint8_t Length);
     255 BYTEs.
 
   Input:
+    uint8_t instance - the CDC function, 0 to CDC_INSTANCE_COUNT - 1
     char *data -  null\-terminated string of constant data. If a
                             null character is not found, 255 BYTEs of data
                             will be transferred to the host.
 		
  *****************************************************************************/
-void putsUSBUSART(char *data);
+void putsUSBUSART(uint8_t instance, char *data);
 
 
 /**************************************************************************
   Function:
-        void putrsUSBUSART( const char *data)
+        void putrsUSBUSART(uint8_t instance, const char *data)
     
   Summary:
     putrsUSBUSART writes a string of data to the USB including the null
@@ -765,9 +803,9 @@ void putsUSBUSART(char *data);
     
     Typical Usage:
     <code>
-        if(USBUSARTIsTxTrfReady())
+        if(USBUSARTIsTxTrfReady(0))
         {
-            putrsUSBUSART("Hello World");
+            putrsUSBUSART(0,"Hello World");
         }
     </code>
     
@@ -784,16 +822,17 @@ void putsUSBUSART(char *data);
     255 BYTEs.
 
   Input:
+    uint8_t instance -      the CDC function, 0 to CDC_INSTANCE_COUNT - 1
     const char *data -      null\-terminated string of constant data. If a
                             null character is not found, 255 BYTEs of data
                             will be transferred to the host.
                                                                            
   **************************************************************************/
-void putrsUSBUSART(const char *data);
+void putrsUSBUSART(uint8_t instance, const char *data);
 
 /************************************************************************
   Function:
-        void CDCTxService(void)
+        void CDCTxService(uint8_t instance)
     
   Summary:
     CDCTxService handles device-to-host transaction(s). This function
@@ -827,7 +866,7 @@ void putrsUSBUSART(const char *data);
             else
             {
                 //Keep trying to send data to the PC as required
-                CDCTxService();
+                CDCTxService(0);
     
                 //Run application code.
                 UserApplication();
@@ -838,10 +877,436 @@ void putrsUSBUSART(const char *data);
   Conditions:
     CDCIniEP() function should have already exectuted/the device should be
     in the CONFIGURED_STATE.
+  Input:
+    uint8_t instance - the CDC function, 0 to CDC_INSTANCE_COUNT - 1
   Remarks:
     None                                                                 
   ************************************************************************/
-void CDCTxService(void);
+void CDCTxService(uint8_t instance);
+
+/**************************************************************************
+  Function:
+        uint8_t* CDCTxAcquireBuffer(uint8_t instance)
+    
+  Summary:
+    Returns the CDC bulk IN endpoint buffer so that the caller can build
+    the next packet in place, without an intermediate copy.
+
+  Description:
+    Returns the CDC bulk IN endpoint buffer so that the caller can build
+    the next packet in place, without an intermediate copy.  The buffer is
+    CDC_DATA_IN_EP_SIZE bytes long.  Once the data has been written, the
+    packet is handed to the USB module with CDCTxCommitBuffer().
+    
+    With ping-pong buffering there is one buffer per BDT entry, so a second
+    packet can be acquired and committed while the first one is still
+    waiting for the host.
+    
+    Typical Usage:
+    <code>
+        uint8_t* buffer = CDCTxAcquireBuffer(0);
+        
+        if(buffer != NULL)
+        {
+            buffer[0] = 'A';
+            CDCTxCommitBuffer(0, 1);
+        }
+        CDCTxService(0);
+    </code>
+
+  Conditions:
+    The device should be in the CONFIGURED_STATE.  A buffer that was
+    acquired must be committed, with a length of 0 if there turns out to be
+    nothing to send: the ZLP owed by a full packet is held back until then.
+
+  Input:
+    uint8_t instance - the CDC function, 0 to CDC_INSTANCE_COUNT - 1
+
+  Output:
+    uint8_t* - pointer to the endpoint buffer, or NULL if a putUSBUSART()
+               style transfer is still in progress (USBUSARTIsTxTrfReady()
+               is false) or both ping-pong buffers are owned by the USB
+               module.
+                                                                           
+  **************************************************************************/
+uint8_t* CDCTxAcquireBuffer(uint8_t instance);
+
+/**************************************************************************
+  Function:
+        void CDCTxCommitBuffer(uint8_t instance, uint8_t length)
+    
+  Summary:
+    Sends the first 'length' bytes of the buffer returned by
+    CDCTxAcquireBuffer() to the host.
+
+  Description:
+    Sends the first 'length' bytes of the buffer returned by
+    CDCTxAcquireBuffer() to the host.  If the packet is a full
+    CDC_DATA_IN_EP_SIZE bytes, CDCTxService() follows it with a zero
+    length packet once it has gone, unless another packet is committed
+    before then.
+
+  Conditions:
+    CDCTxAcquireBuffer() must have returned a non-NULL pointer, and no
+    other transfer may have been started since.
+
+  Input:
+    uint8_t instance - the CDC function, 0 to CDC_INSTANCE_COUNT - 1
+    uint8_t length - the number of bytes written into the endpoint buffer
+                     (at most CDC_DATA_IN_EP_SIZE).  0 cancels the
+                     acquisition.
+                                                                           
+  **************************************************************************/
+void CDCTxCommitBuffer(uint8_t instance, uint8_t length);
+
+/**************************************************************************
+  Function:
+        uint8_t* CDCRxAcquireBuffer(uint8_t instance, uint8_t* length)
+    
+  Summary:
+    Returns a pointer to the next received CDC bulk OUT packet, so that it
+    can be parsed in place instead of being copied out first.
+
+  Description:
+    Returns a pointer to the next received CDC bulk OUT packet, so that it
+    can be parsed in place instead of being copied out first.  The packet
+    stays valid, and its receive buffer stays out of use, until
+    CDCRxReleaseBuffer() is called.  With ping-pong buffering the other
+    receive buffer remains armed in the meantime, so the host can send one
+    more packet while this one is being processed.
+    
+    The packet may be 0 bytes long (a zero length packet from the host);
+    it must still be released.
+    
+    When USB_CDC_RX_RING_SIZE is defined, the USB interrupt has already
+    moved received packets into the receive ring, and this function lends
+    the longest run of ring data that does not wrap instead, up to
+    CDC_DATA_OUT_EP_SIZE bytes.
+    
+    Typical Usage:
+    <code>
+        uint8_t length;
+        uint8_t* packet = CDCRxAcquireBuffer(0, &length);
+        
+        if(packet != NULL)
+        {
+            Parse(packet, length);
+            CDCRxReleaseBuffer(0);
+        }
+    </code>
+
+  Conditions:
+    The device should be in the CONFIGURED_STATE.  getsUSBUSART() must not
+    be called while a packet is held.
+
+  Input:
+    uint8_t instance - the CDC function, 0 to CDC_INSTANCE_COUNT - 1
+    uint8_t* length - receives the number of bytes in the packet, at most
+                      CDC_DATA_OUT_EP_SIZE.
+
+  Output:
+    uint8_t* - pointer to the packet in the endpoint buffer, or NULL if no
+               new CDC bulk OUT data is available.
+                                                                           
+  **************************************************************************/
+uint8_t* CDCRxAcquireBuffer(uint8_t instance, uint8_t* length);
+
+/**************************************************************************
+  Function:
+        void CDCRxReleaseBuffer(uint8_t instance)
+    
+  Summary:
+    Re-arms the receive buffer of the packet returned by
+    CDCRxAcquireBuffer() for the next OUT transaction.
+
+  Description:
+    Re-arms the receive buffer of the packet returned by
+    CDCRxAcquireBuffer() for the next OUT transaction.  The pointer
+    returned by CDCRxAcquireBuffer() must not be used afterwards.  Calling
+    this function when no packet is held has no effect.
+
+  Conditions:
+    The device should be in the CONFIGURED_STATE.
+
+  Input:
+    uint8_t instance - the CDC function, 0 to CDC_INSTANCE_COUNT - 1
+                                                                           
+  **************************************************************************/
+void CDCRxReleaseBuffer(uint8_t instance);
+
+/**************************************************************************
+  Function:
+        const uint8_t* CDCEncapsulatedCommandAcquire(uint8_t* instance, uint16_t* length)
+    
+  Summary:
+    Returns the command the host last sent with SEND_ENCAPSULATED_COMMAND,
+    for the main loop to answer.
+
+  Description:
+    SEND_ENCAPSULATED_COMMAND and GET_ENCAPSULATED_RESPONSE carry commands
+    and responses over EP0, beside the bulk data stream: they are neither
+    mixed into it nor queued behind it.  The USB interrupt takes in the
+    command; the application answers it with
+    CDCEncapsulatedCommandRespond().  The host is then sent a
+    RESPONSE_AVAILABLE notification and reads the response with
+    GET_ENCAPSULATED_RESPONSE.  Until the command has been answered, further
+    commands are stalled; a GET_ENCAPSULATED_RESPONSE with no response
+    waiting returns no data.  EP0 carries one command at a time for all CDC
+    functions.
+
+    Typical usage:
+    <code>
+        uint8_t instance;
+        uint16_t length;
+        const uint8_t* command = CDCEncapsulatedCommandAcquire(&instance, &length);
+        
+        if(command != NULL)
+        {
+            length = BuildResponse(command, length, response);
+            CDCEncapsulatedCommandRespond(response, length);
+        }
+    </code>
+
+  Conditions:
+    The device should be in the CONFIGURED_STATE.
+
+  Input:
+    uint8_t* instance - receives the CDC function the command was sent to.
+    uint16_t* length - receives the command length, 1 to
+                       USB_CDC_ENCAPSULATED_SIZE bytes.
+
+  Output:
+    const uint8_t* - the command, or NULL if there is none to answer.  It
+                     stays valid until CDCEncapsulatedCommandRespond().
+                                                                           
+  **************************************************************************/
+const uint8_t* CDCEncapsulatedCommandAcquire(uint8_t* instance, uint16_t* length);
+
+/**************************************************************************
+  Function:
+        void CDCEncapsulatedCommandRespond(const uint8_t* response, uint16_t length)
+    
+  Summary:
+    Answers the command returned by CDCEncapsulatedCommandAcquire().
+
+  Description:
+    Copies the response, at most USB_CDC_ENCAPSULATED_SIZE bytes, for the
+    next GET_ENCAPSULATED_RESPONSE and sends the host a RESPONSE_AVAILABLE
+    notification.  A length of 0 answers the command without a response
+    (and without a notification).  The next command is accepted
+    afterwards; it discards a response the host has not read.
+
+  Conditions:
+    CDCEncapsulatedCommandAcquire() returned a command.
+
+  Input:
+    const uint8_t* response - the response.
+    uint16_t length - the number of bytes in the response.
+                                                                           
+  **************************************************************************/
+void CDCEncapsulatedCommandRespond(const uint8_t* response, uint16_t length);
+
+#if defined(USB_CDC_MASKED_TIMER)
+/**************************************************************************
+  Function:
+        uint16_t CDCGetLongestMaskedTime(void)
+    
+  Summary:
+    Returns the longest time the CDC driver has kept the USB interrupt
+    masked.
+
+  Description:
+    Returns the longest time the CDC driver has kept the USB interrupt
+    masked, in counts of USB_CDC_MASKED_TIMER().  Other interrupts that
+    preempt a masked section are included in its time.  The measurement
+    covers every CDC function.
+
+  Conditions:
+    USB_CDC_MASKED_TIMER() and USB_CDC_MASKED_TIMER_PERIOD are defined in
+    usb_device_config.h.
+
+  Output:
+    uint16_t - the longest masked section seen, in timer counts.
+                                                                           
+  **************************************************************************/
+uint16_t CDCGetLongestMaskedTime(void);
+
+/**************************************************************************
+  Function:
+        void CDCClearLongestMaskedTime(void)
+    
+  Summary:
+    Restarts the measurement of CDCGetLongestMaskedTime().
+
+  Conditions:
+    USB_CDC_MASKED_TIMER() and USB_CDC_MASKED_TIMER_PERIOD are defined in
+    usb_device_config.h.
+                                                                           
+  **************************************************************************/
+void CDCClearLongestMaskedTime(void);
+#endif
+
+#if defined(USB_CDC_RX_RING_SIZE)
+/**************************************************************************
+  Function:
+        uint16_t CDCRxRingGetHighWaterMark(uint8_t instance)
+    
+  Summary:
+    Returns the most bytes the USB_CDC_RX_RING_SIZE receive ring has held
+    at once.
+
+  Description:
+    Returns the most bytes the USB_CDC_RX_RING_SIZE receive ring has held
+    at once.  A value close to USB_CDC_RX_RING_SIZE means the host came
+    close to being NAKed while the application was busy; data is never
+    dropped.
+
+  Conditions:
+    USB_CDC_RX_RING_SIZE is defined in usb_device_config.h.
+
+  Input:
+    uint8_t instance - the CDC function, 0 to CDC_INSTANCE_COUNT - 1
+
+  Output:
+    uint16_t - the high water mark in bytes.
+                                                                           
+  **************************************************************************/
+uint16_t CDCRxRingGetHighWaterMark(uint8_t instance);
+
+/**************************************************************************
+  Function:
+        void CDCRxRingClearHighWaterMark(uint8_t instance)
+    
+  Summary:
+    Restarts the receive ring high water mark from the current fill level.
+
+  Conditions:
+    USB_CDC_RX_RING_SIZE is defined in usb_device_config.h.
+
+  Input:
+    uint8_t instance - the CDC function, 0 to CDC_INSTANCE_COUNT - 1
+                                                                           
+  **************************************************************************/
+void CDCRxRingClearHighWaterMark(uint8_t instance);
+#endif
+
+#if defined(USB_CDC_RX_FLOW_CONTROL)
+/**************************************************************************
+  Function:
+        uint16_t CDCRxGetThrottleCount(uint8_t instance)
+    
+  Summary:
+    Returns how many times DSR was dropped to hold off the host.
+
+  Description:
+    With USB_CDC_RX_FLOW_CONTROL the driver drops DSR in the SERIAL_STATE
+    notification while the receive ring is nearly full (see
+    CDCNotificationHandler()).  A host that honors DSR stops writing
+    instead of being NAKed.  A count that keeps growing means the
+    application reads more slowly than the host writes.
+
+  Conditions:
+    USB_CDC_RX_FLOW_CONTROL is defined in usb_device_config.h.
+
+  Input:
+    uint8_t instance - the CDC function, 0 to CDC_INSTANCE_COUNT - 1
+
+  Output:
+    uint16_t - the times DSR was dropped.
+                                                                           
+  **************************************************************************/
+uint16_t CDCRxGetThrottleCount(uint8_t instance);
+
+/**************************************************************************
+  Function:
+        void CDCRxClearThrottleCount(uint8_t instance)
+    
+  Summary:
+    Restarts the count returned by CDCRxGetThrottleCount().
+
+  Conditions:
+    USB_CDC_RX_FLOW_CONTROL is defined in usb_device_config.h.
+
+  Input:
+    uint8_t instance - the CDC function, 0 to CDC_INSTANCE_COUNT - 1
+                                                                           
+  **************************************************************************/
+void CDCRxClearThrottleCount(uint8_t instance);
+#endif
+
+/**************************************************************************
+  Function:
+        const uint8_t* CDC_TX_REFILL(uint32_t* length)
+    
+  Summary:
+    Supplies the next chunk of a CDCTxStreamStart() transfer.
+
+  Description:
+    Called by the CDC driver when the current chunk of a streaming transfer
+    has been copied into the endpoint buffers.  The chunk returned must
+    stay unchanged until the next call (or the end of the transfer).
+    Return NULL, or set *length to 0, to end the transfer.  The callback
+    runs from CDCTxService(), or from the USB interrupt itself when
+    USB_INTERRUPT is used, and must not block.
+
+  Input:
+    uint32_t* length - receives the number of bytes in the next chunk.
+
+  Output:
+    const uint8_t* - the next chunk, or NULL at the end of the data.
+  **************************************************************************/
+typedef const uint8_t* (*CDC_TX_REFILL)(uint32_t* length);
+
+/**************************************************************************
+  Function:
+        bool CDCTxStreamStart(uint8_t instance, const uint8_t* data,
+                              uint32_t length, CDC_TX_REFILL refill)
+    
+  Summary:
+    Starts a transfer of any length to the host, fed from one or more
+    chunks of RAM.
+
+  Description:
+    Starts a transfer of any length to the host, fed from one or more
+    chunks of RAM.  Unlike putUSBUSART() the length is not limited to 255
+    bytes: CDCTxService() sends 'data' and then asks 'refill' for further
+    chunks until it returns none.  Chunks are packed into full
+    CDC_DATA_IN_EP_SIZE packets regardless of their sizes, and the transfer
+    ends with a short packet, or with a zero length packet if the last one
+    was full (USB Specification 2.0: Section 5.8.3).
+    
+    Typical Usage:
+    <code>
+        static const uint8_t* Next(uint32_t* length)
+        {
+            return CaptureGetNextBlock(length);
+        }
+        
+        if(USBUSARTIsTxTrfReady(0))
+        {
+            CDCTxStreamStart(0, samples, sizeof(samples), &Next);
+        }
+        CDCTxService(0);
+    </code>
+
+  Conditions:
+    USBUSARTIsTxTrfReady() must return true.  The data must stay unchanged
+    until it has been copied, which is when 'refill' is next called or
+    USBUSARTIsTxTrfReady() returns true again.
+
+  Input:
+    uint8_t instance - the CDC function, 0 to CDC_INSTANCE_COUNT - 1
+    const uint8_t* data - the first chunk (may be NULL if 'length' is 0).
+    uint32_t length - the number of bytes in the first chunk.
+    CDC_TX_REFILL refill - called for further chunks, or NULL if 'data' is
+                           all there is.
+
+  Output:
+    bool - true if the transfer was started, false if another transfer is
+           still in progress.
+                                                                           
+  **************************************************************************/
+bool CDCTxStreamStart(uint8_t instance, const uint8_t* data, uint32_t length, CDC_TX_REFILL refill);
 
 
 /** S T R U C T U R E S ******************************************************/
@@ -957,18 +1422,149 @@ typedef struct
     uint8_t    Reserved;
 }SERIAL_STATE_NOTIFICATION;   
 
+/* Notification Packet Structure without data (RESPONSE_AVAILABLE) */
+typedef struct
+{
+    uint8_t    bmRequestType;  //Always 0xA1
+    uint8_t    bNotification;
+    uint16_t  wValue;
+    uint16_t  wIndex;     //Interface number
+    uint16_t  wLength;    //Always 0
+}CDC_NOTIFICATION;
+
+/*
+ * With ping-pong buffering on the data IN endpoint there is one transmit
+ * buffer per BDT entry (EVEN and ODD), so the next packet can be staged while
+ * the previous one is still waiting for the host.  USBTransferOnePacket()
+ * alternates between the two BDT entries on every call, and tx_buffer
+ * alternates with it, so buffer N always belongs to the BDT entry that
+ * USBGetNextHandle() returns.
+ */
+/*
+ * The data OUT endpoint likewise keeps both of its BDT entries armed with a
+ * receive buffer each.  The host can then send the next packet while the
+ * application is still reading the previous one, instead of being NAKed
+ * until getsUSBUSART() re-arms the endpoint.  Define CDC_RX_BUFFER_COUNT as
+ * 1 in usb_device_config.h to arm one buffer at a time instead, with 64
+ * bytes less RAM per CDC function.
+ */
+#if (USB_PING_PONG_MODE == USB_PING_PONG__FULL_PING_PONG) || (USB_PING_PONG_MODE == USB_PING_PONG__ALL_BUT_EP0)
+    #define CDC_TX_BUFFER_COUNT 2
+    #if !defined(CDC_RX_BUFFER_COUNT)
+        #define CDC_RX_BUFFER_COUNT 2
+    #endif
+#else
+    #define CDC_TX_BUFFER_COUNT 1
+    #undef CDC_RX_BUFFER_COUNT
+    #define CDC_RX_BUFFER_COUNT 1
+#endif
+
+#if !defined(CDC_INSTANCE_COUNT)
+    #define CDC_INSTANCE_COUNT 1
+#endif
+#if (CDC_INSTANCE_COUNT < 1) || (CDC_INSTANCE_COUNT > 2)
+    #error "CDC_INSTANCE_COUNT must be 1 or 2"
+#endif
+
+/*
+ * SERIAL_STATE notifications go out on the interrupt endpoint when the DSR
+ * pin is reported, or when DSR carries the receive flow control.
+ */
+#if defined(USB_CDC_SUPPORT_DSR_REPORTING) || defined(USB_CDC_RX_FLOW_CONTROL)
+    #define CDC_SERIAL_STATE_NOTIFICATIONS
+#endif
+
+/*
+ * Receive ring levels at which USB_CDC_RX_FLOW_CONTROL drops and raises DSR,
+ * unless usb_device_config.h sets them.
+ */
+#if defined(USB_CDC_RX_FLOW_CONTROL)
+    #if !defined(USB_CDC_RX_FLOW_OFF_LEVEL)
+        #define USB_CDC_RX_FLOW_OFF_LEVEL   (USB_CDC_RX_RING_SIZE - (USB_CDC_RX_RING_SIZE / 4))
+    #endif
+    #if !defined(USB_CDC_RX_FLOW_ON_LEVEL)
+        #define USB_CDC_RX_FLOW_ON_LEVEL    (USB_CDC_RX_RING_SIZE / 4)
+    #endif
+#endif
+
+/*
+ * Longest SEND_ENCAPSULATED_COMMAND command, and GET_ENCAPSULATED_RESPONSE
+ * response, in bytes.  Longer commands are stalled.
+ */
+#if !defined(USB_CDC_ENCAPSULATED_SIZE)
+    #define USB_CDC_ENCAPSULATED_SIZE   64
+#endif
+
+/* Driver state of one CDC function (cdc_instance[]) */
+typedef struct
+{
+    LINE_CODING line_coding;
+    CONTROL_SIGNAL_BITMAP control_signal_bitmap;
+    
+    uint8_t trf_state;              // States are defined above
+    POINTER pSrc;                   // Dedicated source pointer
+    uint8_t tx_len;                 // total tx length
+    uint8_t mem_type;               // _ROM, _RAM
+    uint8_t rx_len;                 // total rx length
+    uint8_t tx_buffer;              // cdc_data_tx[] entry the next packet goes in
+    uint8_t rx_buffer;              // cdc_data_rx[] entry the next packet is read from
+    uint8_t rx_arm;                 // cdc_data_rx[] entry that is armed next
+    uint8_t rx_terminated;          // cdc_data_rx[] entries whose OUT transfer was terminated
+    bool tx_zlp;                    // a full packet ended the last transfer
+    bool tx_acquired;               // CDCTxAcquireBuffer() buffer not yet committed
+    const uint8_t* tx_stream;       // CDC_TX_STREAMING: current chunk
+    uint32_t tx_stream_len;         // CDC_TX_STREAMING: bytes left in the chunk
+    CDC_TX_REFILL tx_refill;        // CDC_TX_STREAMING: next chunk, NULL when done
+    
+    /*
+     * Main loop / USB interrupt handoff.  While the main loop stages
+     * packets (tx_owner) or fills the receive ring (rx_owner) with the USB
+     * interrupt enabled, the interrupt does not touch that side of the
+     * driver: it only leaves a request, which the main loop carries out
+     * before it lets go.
+     */
+    volatile bool tx_owner;
+    volatile bool tx_again;         // a packet went meanwhile, stage again
+    volatile bool tx_abort;         // the IN transfer was terminated meanwhile
+    volatile bool tx_reset;         // CDCInitEP() ran meanwhile
+    volatile bool rx_owner;
+    volatile bool rx_again;         // a packet arrived meanwhile, fill again
+    volatile bool rx_rearm;         // the OUT transfers were terminated meanwhile
+    volatile bool rx_reset;         // CDCInitEP() ran meanwhile
+    
+    USB_HANDLE data_in_handle;      // most recently armed IN packet
+    USB_HANDLE data_in_handles[CDC_TX_BUFFER_COUNT];
+    USB_HANDLE data_out_handle;     // packet getsUSBUSART() reads next
+    USB_HANDLE data_out_handles[CDC_RX_BUFFER_COUNT];
+    
+#if defined(USB_CDC_RX_RING_SIZE)
+    volatile uint16_t rx_ring_head;
+    volatile uint16_t rx_ring_tail;
+    uint16_t rx_ring_high_water;
+    uint8_t rx_lease;               // bytes handed out by CDCRxAcquireBuffer()
+#endif
+
+    USB_HANDLE notification_in_handle;
+    volatile bool response_notify;  // RESPONSE_AVAILABLE still to be sent
+    
+#if defined(CDC_SERIAL_STATE_NOTIFICATIONS)
+    BM_SERIAL_STATE serial_state;
+    BM_SERIAL_STATE old_serial_state;
+#endif
+
+#if defined(USB_CDC_RX_FLOW_CONTROL)
+    bool rx_throttled;              // DSR held low until the ring drains
+    uint16_t rx_throttle_count;     // times DSR was dropped
+#endif
+} CDC_INSTANCE;
+
 //DOM-IGNORE-BEGIN
 /** E X T E R N S ************************************************************/
-extern uint8_t cdc_rx_len;
 extern USB_HANDLE lastTransmission;
 
-extern uint8_t cdc_trf_state;
-extern POINTER pCDCSrc;
-extern uint8_t cdc_tx_len;
-extern uint8_t cdc_mem_type;
+extern CDC_INSTANCE cdc_instance[CDC_INSTANCE_COUNT];
 
 extern CDC_NOTICE cdc_notice;
-extern LINE_CODING line_coding;
 
 extern volatile CTRL_TRF_SETUP SetupPkt;
 extern const uint8_t configDescriptor1[];
@@ -982,12 +1578,12 @@ extern const uint8_t configDescriptor1[];
 //void USBCheckCDCRequest(void);
 //void CDCInitEP(void);
 //bool USBCDCEventHandler(USB_EVENT event, void *pdata, uint16_t size);
-//uint8_t getsUSBUSART(char *buffer, uint8_t len);
-//void putUSBUSART(char *data, uint8_t Length);
-//void putsUSBUSART(char *data);
-//void putrsUSBUSART(const const char *data);
-//void CDCTxService(void);
-//void CDCNotificationHandler(void);
+//uint8_t getsUSBUSART(uint8_t instance, uint8_t *buffer, uint8_t len);
+//void putUSBUSART(uint8_t instance, char *data, uint8_t Length);
+//void putsUSBUSART(uint8_t instance, char *data);
+//void putrsUSBUSART(uint8_t instance, const const char *data);
+//void CDCTxService(uint8_t instance);
+//void CDCNotificationHandler(uint8_t instance);
 //------------------------------------------------------------------------------
 //DOM-IGNORE-END
 
@@ -36,8 +36,8 @@ please contact mla_licensing@microchip.com
 								// that use EP0 IN or OUT for sending large amounts of
 								// application related data.
 									
-#define USB_MAX_NUM_INT     	2   //Set this number to match the maximum interface number used in the descriptors for this firmware project
-#define USB_MAX_EP_NUMBER	    2   //Set this number to match the maximum endpoint number used in the descriptors for this firmware project
+#define USB_MAX_NUM_INT     	4   //Set this number to match the maximum interface number used in the descriptors for this firmware project
+#define USB_MAX_EP_NUMBER	    4   //Set this number to match the maximum endpoint number used in the descriptors for this firmware project
 
 //Device descriptor - if these two definitions are not defined then
 //  a const USB_DEVICE_DESCRIPTOR variable by the exact name of device_dsc
@@ -134,7 +134,7 @@ please contact mla_licensing@microchip.com
 
 #define USB_SUPPORT_DEVICE
 
-#define USB_NUM_STRING_DESCRIPTORS 3  //Set this number to match the total number of string descriptors that are implemented in the usb_descriptors.c file
+#define USB_NUM_STRING_DESCRIPTORS 5  //Set this number to match the total number of string descriptors that are implemented in the usb_descriptors.c file
 
 /*******************************************************************
  * Event disable options                                           
@@ -166,9 +166,37 @@ please contact mla_licensing@microchip.com
 #define CDC_DATA_OUT_EP_SIZE    64
 #define CDC_DATA_IN_EP_SIZE     64
 
+//Number of CDC-ACM functions in the configuration (1 or 2).  With 2 the
+//device is a composite device and the second function, which carries the
+//console, uses the CDC1_ interfaces and endpoints below.
+#define CDC_INSTANCE_COUNT      2
+
+#define CDC1_COMM_INTF_ID       0x02
+#define CDC1_COMM_EP            3
+#define CDC1_DATA_INTF_ID       0x03
+#define CDC1_DATA_EP            4
+
 #define USB_CDC_SUPPORT_ABSTRACT_CONTROL_MANAGEMENT_CAPABILITIES_D1 //Set_Line_Coding, Set_Control_Line_State, Get_Line_Coding, and Serial_State commands
 //#define USB_CDC_SUPPORT_ABSTRACT_CONTROL_MANAGEMENT_CAPABILITIES_D2 //Send_Break command
 
+//Uncomment to have the USB interrupt copy every received CDC packet into a
+//ring of this many bytes (a power of 2) and re-arm the endpoint straight
+//away.  getsUSBUSART() and CDCRxAcquireBuffer() then read from the ring.
+//#define USB_CDC_RX_RING_SIZE    256
+
+//Uncomment, with the ring above, to drop DSR in a SERIAL_STATE notification
+//while the ring holds USB_CDC_RX_FLOW_OFF_LEVEL bytes or more, and raise it
+//again at USB_CDC_RX_FLOW_ON_LEVEL (3/4 and 1/4 of the ring by default).
+//tools/cdc_flow.py shows a host side that pauses while DSR is low.
+//#define USB_CDC_RX_FLOW_CONTROL
+
+//Free running timer used to measure how long the CDC driver keeps the USB
+//interrupt masked (CDCGetLongestMaskedTime()).  TMR3 is the 1ms tick timer
+//of timer_1ms.c; at 16MHz Fcy it counts instruction cycles.  Comment out to
+//remove the measurement.
+#define USB_CDC_MASKED_TIMER()          TMR3
+#define USB_CDC_MASKED_TIMER_PERIOD     (PR3 + 1u)
+
 /** DEFINITIONS ****************************************************/
 
 /** DEFINITIONS ****************************************************/
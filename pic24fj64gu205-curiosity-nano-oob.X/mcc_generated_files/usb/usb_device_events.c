@@ -51,6 +51,9 @@ bool USER_USB_CALLBACK_EVENT_HANDLER(USB_EVENT event, void *pdata, uint16_t size
     switch( (int) event )
     {
         case EVENT_TRANSFER:
+            /* Lets the CDC driver queue the next IN packet as soon as the
+             * previous one has gone. */
+            USBCDCEventHandler(event, pdata, size);
             break;
 
         case EVENT_SOF:
@@ -89,6 +92,7 @@ bool USER_USB_CALLBACK_EVENT_HANDLER(USB_EVENT event, void *pdata, uint16_t size
             break;
 
         case EVENT_TRANSFER_TERMINATED:
+            USBCDCEventHandler(event, pdata, size);
             break;
 
         default:
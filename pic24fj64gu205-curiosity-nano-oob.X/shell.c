@@ -0,0 +1,477 @@
+//Copyright 2016 Microchip Technology Inc. (www.microchip.com)
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "mcc_generated_files/usb/usb_device_cdc.h"
+#include "button.h"
+#include "console.h"
+#include "console_log.h"
+#include "dma_copy.h"
+#include "shell.h"
+
+#define LINE_SIZE       64u
+#define MAX_ARGUMENTS   4u
+
+//Commands are looked up through a perfect hash: HASH_SEED puts every
+//command name in its own slot, so a lookup is one hash (computed while the
+//name is typed) and one compare.  tools/shell_seed.py finds the seed for the
+//command table below; run it again whenever a command is added or renamed.
+#define SLOT_COUNT      16u
+#define SLOT_MASK       (SLOT_COUNT - 1u)
+#define EMPTY_SLOT      0xFFu
+#define HASH_MULTIPLIER 31u
+#define HASH_SEED       0u
+
+//A stale HASH_SEED is caught at startup: the next few seeds are tried, and
+//if none fits, commands are looked up by comparing each name in turn.
+#define SEED_SEARCH_LIMIT   32u
+
+#if ((SLOT_COUNT & SLOT_MASK) != 0u)
+#error "SLOT_COUNT must be a power of two"
+#endif
+
+typedef void (*SHELL_HANDLER)(uint8_t argc, char* argv[]);
+
+typedef struct
+{
+    const char* name;
+    const char* help;
+    SHELL_HANDLER handler;
+} SHELL_COMMAND;
+
+static void HelpCommand(uint8_t argc, char* argv[]);
+static void StatsCommand(uint8_t argc, char* argv[]);
+static void ClearCommand(uint8_t argc, char* argv[]);
+static void UptimeCommand(uint8_t argc, char* argv[]);
+static void ButtonCommand(uint8_t argc, char* argv[]);
+static void TraceCommand(uint8_t argc, char* argv[]);
+
+static const SHELL_COMMAND commands[] =
+{
+    {"help",    "help     list commands\r\n",                   &HelpCommand},
+    {"stats",   "stats    console drop counters\r\n",           &StatsCommand},
+    {"clear",   "clear    reset the console drop counters\r\n", &ClearCommand},
+    {"uptime",  "uptime   milliseconds since USB start\r\n",    &UptimeCommand},
+    {"button",  "button   current button state\r\n",            &ButtonCommand},
+    {"trace",   "trace    replay the RAM trace (kept over reset)\r\n", &TraceCommand},
+};
+
+#define COMMAND_COUNT (sizeof(commands) / sizeof(commands[0]))
+
+static uint8_t slots[SLOT_COUNT];
+static uint16_t hashSeed = HASH_SEED;
+static bool hashed = false;
+
+static char line[LINE_SIZE];
+static uint8_t lineLength = 0;
+static uint16_t nameHash = 0;
+static uint8_t nameLength = 0;
+static bool nameComplete = false;
+static bool nameEdited = false;
+static bool lineOverflow = false;
+
+static bool BuildSlots(uint16_t seed);
+static uint16_t Hash(uint16_t seed, const char* name);
+static uint8_t FindCommand(const char* name);
+static void ResetLine(void);
+static void AddCharacter(char c);
+static void RunLine(void);
+
+#if defined(USB_CDC_MASKED_TIMER)
+//The stats command times a full CDC packet copy both ways; the shortest of
+//a few tries leaves out interrupts taken during one.
+#define COPY_TIMING_SIZE    64u
+#define COPY_TIMING_TRIES   4u
+
+static uint16_t TimePacketCopy(bool dma);
+#endif
+
+void SHELL_Initialize(void)
+{
+    uint8_t tries;
+    
+    hashSeed = HASH_SEED;
+    hashed = BuildSlots(hashSeed);
+    
+    for(tries = 1; (hashed == false) && (tries < SEED_SEARCH_LIMIT); tries++)
+    {
+        hashSeed++;
+        hashed = BuildSlots(hashSeed);
+    }
+    
+    if(hashed == false)
+    {
+        (void)CONSOLE_PrintConst("shell: HASH_SEED does not fit the commands, see tools/shell_seed.py\r\n");
+    }
+    
+    ResetLine();
+}
+
+void SHELL_Tasks(void)
+{
+    uint8_t* packet;
+    uint8_t length;
+    uint8_t echoed = 0;
+    uint8_t i;
+    
+    if((USBGetDeviceState() != CONFIGURED_STATE) || (USBIsDeviceSuspended() == true))
+    {
+        ResetLine();
+        return;
+    }
+    
+    //One packet per pass: a long line is parsed as it arrives instead of
+    //holding up the main loop.  The packet is parsed where the USB module
+    //put it; the other receive buffer stays armed meanwhile.
+    packet = CDCRxAcquireBuffer(CONSOLE_CDC_INSTANCE, &length);
+    
+    if(packet == NULL)
+    {
+        return;
+    }
+    
+    //Echo up to each line end before running the command so its output
+    //follows the line it answers.
+    for(i = 0; i < length; i++)
+    {
+        if((packet[i] == '\r') || (packet[i] == '\n'))
+        {
+            (void)CONSOLE_Write(&packet[echoed], (uint16_t)((i + 1u) - echoed));
+            echoed = i + 1u;
+        }
+        
+        AddCharacter((char)packet[i]);
+    }
+    
+    (void)CONSOLE_Write(&packet[echoed], (uint16_t)(length - echoed));
+    
+    CDCRxReleaseBuffer(CONSOLE_CDC_INSTANCE);
+}
+
+static bool BuildSlots(uint16_t seed)
+{
+    uint8_t i;
+    uint8_t slot;
+    
+    (void)memset(slots, EMPTY_SLOT, sizeof(slots));
+    
+    for(i = 0; i < (uint8_t)COMMAND_COUNT; i++)
+    {
+        slot = (uint8_t)(Hash(seed, commands[i].name) & SLOT_MASK);
+        
+        if(slots[slot] != EMPTY_SLOT)
+        {
+            return false;
+        }
+        
+        slots[slot] = i;
+    }
+    
+    return true;
+}
+
+static uint16_t Hash(uint16_t seed, const char* name)
+{
+    uint16_t hash = seed;
+    
+    while(*name != 0)
+    {
+        hash = (hash * HASH_MULTIPLIER) + (uint8_t)*name++;
+    }
+    
+    return hash;
+}
+
+static uint8_t FindCommand(const char* name)
+{
+    uint8_t i;
+    
+    for(i = 0; i < (uint8_t)COMMAND_COUNT; i++)
+    {
+        if(strcmp(commands[i].name, name) == 0)
+        {
+            return i;
+        }
+    }
+    
+    return EMPTY_SLOT;
+}
+
+static void ResetLine(void)
+{
+    lineLength = 0;
+    nameHash = hashSeed;
+    nameLength = 0;
+    nameComplete = false;
+    nameEdited = false;
+    lineOverflow = false;
+}
+
+static void AddCharacter(char c)
+{
+    switch(c)
+    {
+        case '\r':
+        case '\n':
+            if(lineOverflow == true)
+            {
+                (void)CONSOLE_PrintConst("\r\nline too long\r\n");
+            }
+            else if(lineLength != 0u)
+            {
+                RunLine();
+            }
+            
+            ResetLine();
+            break;
+            
+        case '\b':
+        case 0x7F:
+            //The hash cannot be unwound, so editing the command name means
+            //it is hashed again when the line completes.
+            if((lineLength != 0u) && (lineOverflow == false))
+            {
+                lineLength--;
+                nameEdited = true;
+            }
+            break;
+            
+        default:
+            if(lineLength >= (LINE_SIZE - 1u))
+            {
+                lineOverflow = true;
+            }
+            else
+            {
+                line[lineLength++] = c;
+                
+                if(c == ' ')
+                {
+                    nameComplete = (nameLength != 0u);
+                }
+                else if(nameComplete == false)
+                {
+                    nameHash = (nameHash * HASH_MULTIPLIER) + (uint8_t)c;
+                    nameLength++;
+                }
+            }
+            break;
+    }
+}
+
+static void RunLine(void)
+{
+    char* argv[MAX_ARGUMENTS];
+    uint8_t argc = 0;
+    uint8_t i = 0;
+    uint8_t index;
+    uint16_t hash = nameHash;
+    
+    line[lineLength] = 0;
+    
+    //Split into space separated words.
+    while((i < lineLength) && (argc < MAX_ARGUMENTS))
+    {
+        while(line[i] == ' ')
+        {
+            line[i++] = 0;
+        }
+        
+        if(line[i] == 0)
+        {
+            break;
+        }
+        
+        argv[argc++] = &line[i];
+        
+        while((line[i] != ' ') && (line[i] != 0))
+        {
+            i++;
+        }
+    }
+    
+    if(argc == 0u)
+    {
+        return;
+    }
+    
+    if(nameEdited == true)
+    {
+        hash = Hash(hashSeed, argv[0]);
+    }
+    
+    (void)CONSOLE_PrintConst("\r\n");
+    
+    index = (hashed == true) ? slots[hash & SLOT_MASK] : FindCommand(argv[0]);
+    
+    if((index != EMPTY_SLOT) && (strcmp(commands[index].name, argv[0]) == 0))
+    {
+        commands[index].handler(argc, argv);
+    }
+    else
+    {
+        (void)CONSOLE_PrintConst("unknown command, try help\r\n");
+    }
+}
+
+static void HelpCommand(uint8_t argc, char* argv[])
+{
+    uint8_t i;
+    
+    (void)argc;
+    (void)argv;
+    
+    for(i = 0; i < (uint8_t)COMMAND_COUNT; i++)
+    {
+        (void)CONSOLE_PrintConst(commands[i].help);
+    }
+}
+
+static void StatsCommand(uint8_t argc, char* argv[])
+{
+    CONSOLE_STATISTICS statistics;
+    uint8_t i;
+    
+    (void)argc;
+    (void)argv;
+    
+    CONSOLE_GetStatistics(&statistics);
+    
+    for(i = 0; i < (uint8_t)CONSOLE_OVERFLOW_POLICY_COUNT; i++)
+    {
+        (void)CONSOLE_LOG3(CONSOLE_LOG_SHELL_DROPS, i,
+                           statistics.policy[i].droppedBytes,
+                           statistics.policy[i].droppedMessages);
+    }
+    
+    for(i = 0; i < (uint8_t)CONSOLE_LANE_COUNT; i++)
+    {
+        (void)CONSOLE_LOG2(CONSOLE_LOG_SHELL_HIGH_WATER, i, statistics.highWaterMark[i]);
+    }
+    
+    (void)CONSOLE_LOG2(CONSOLE_LOG_SHELL_SUPPRESSED, statistics.repeatedMessages, statistics.rateLimitedMessages);
+    
+    for(i = CONSOLE_SINK_UART; i < (uint8_t)CONSOLE_SINK_COUNT; i++)
+    {
+        (void)CONSOLE_LOG2(CONSOLE_LOG_SHELL_SINK_DROPS, i, statistics.sinkDroppedBytes[i]);
+    }
+    
+#if defined(USB_CDC_RX_RING_SIZE)
+    (void)CONSOLE_LOG2(CONSOLE_LOG_SHELL_RX_HIGH_WATER, CDCRxRingGetHighWaterMark(CONSOLE_CDC_INSTANCE), USB_CDC_RX_RING_SIZE);
+#endif
+    
+#if defined(USB_CDC_RX_FLOW_CONTROL)
+    (void)CONSOLE_LOG1(CONSOLE_LOG_SHELL_RX_THROTTLED, CDCRxGetThrottleCount(CONSOLE_CDC_INSTANCE));
+#endif
+    
+#if defined(USB_CDC_MASKED_TIMER)
+    (void)CONSOLE_LOG1(CONSOLE_LOG_SHELL_MASKED, CDCGetLongestMaskedTime());
+    (void)CONSOLE_LOG2(CONSOLE_LOG_SHELL_COPY, TimePacketCopy(true), TimePacketCopy(false));
+#endif
+}
+
+static void ClearCommand(uint8_t argc, char* argv[])
+{
+    (void)argc;
+    (void)argv;
+    
+    CONSOLE_ClearStatistics();
+    
+#if defined(USB_CDC_RX_RING_SIZE)
+    CDCRxRingClearHighWaterMark(CONSOLE_CDC_INSTANCE);
+#endif
+    
+#if defined(USB_CDC_RX_FLOW_CONTROL)
+    CDCRxClearThrottleCount(CONSOLE_CDC_INSTANCE);
+#endif
+    
+#if defined(USB_CDC_MASKED_TIMER)
+    CDCClearLongestMaskedTime();
+#endif
+}
+
+static void UptimeCommand(uint8_t argc, char* argv[])
+{
+    (void)argc;
+    (void)argv;
+    
+    (void)CONSOLE_LOG1(CONSOLE_LOG_SHELL_UPTIME, USBGet1msTickCount());
+}
+
+static void ButtonCommand(uint8_t argc, char* argv[])
+{
+    (void)argc;
+    (void)argv;
+    
+    (void)CONSOLE_PrintConst((BUTTON_IsPressed() == true) ? "pressed\r\n" : "released\r\n");
+}
+
+static void TraceCommand(uint8_t argc, char* argv[])
+{
+    (void)argc;
+    (void)argv;
+    
+    CONSOLE_ReplayTrace();
+}
+
+#if defined(USB_CDC_MASKED_TIMER)
+//In counts of the timer CDCGetLongestMaskedTime() uses.  The buffers are
+//words so that DMA_COPY_Copy() can move them a word at a time.
+static uint16_t TimePacketCopy(bool dma)
+{
+    uint16_t source[COPY_TIMING_SIZE / 2u];
+    uint16_t destination[COPY_TIMING_SIZE / 2u];
+    uint16_t shortest = 0xFFFFu;
+    uint16_t start;
+    uint16_t now;
+    uint16_t elapsed;
+    uint8_t i;
+    
+    (void)memset(source, 0x5A, sizeof(source));
+    
+    for(i = 0; i < COPY_TIMING_TRIES; i++)
+    {
+        start = USB_CDC_MASKED_TIMER();
+        
+        if(dma == true)
+        {
+            DMA_COPY_Copy(destination, source, COPY_TIMING_SIZE);
+        }
+        else
+        {
+            (void)memcpy(destination, source, COPY_TIMING_SIZE);
+        }
+        
+        now = USB_CDC_MASKED_TIMER();
+        elapsed = now - start;
+        
+        //The timer counts up to its period and starts again from 0.
+        if(now < start)
+        {
+            elapsed += USB_CDC_MASKED_TIMER_PERIOD;
+        }
+        
+        if(elapsed < shortest)
+        {
+            shortest = elapsed;
+        }
+    }
+    
+    return shortest;
+}
+#endif
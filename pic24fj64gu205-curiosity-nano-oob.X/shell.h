@@ -0,0 +1,49 @@
+//Copyright 2016 Microchip Technology Inc. (www.microchip.com)
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+#ifndef SHELL_H
+#define SHELL_H
+
+/*********************************************************************
+* Function: void SHELL_Initialize(void);
+*
+* Overview: Builds the command dispatch table.  Must be called once before
+*           SHELL_Tasks().
+*
+* PreCondition: None
+*
+* Input: None
+*
+* Output: None
+*
+********************************************************************/
+void SHELL_Initialize(void);
+
+/*********************************************************************
+* Function: void SHELL_Tasks(void);
+*
+* Overview: Reads at most one CDC packet, echoes it and advances the line
+*           parser, running a command when a line is complete.  Call
+*           from the main loop.
+*
+* PreCondition: SHELL_Initialize() has been called.
+*
+* Input: None
+*
+* Output: None
+*
+********************************************************************/
+void SHELL_Tasks(void);
+
+#endif //SHELL_H
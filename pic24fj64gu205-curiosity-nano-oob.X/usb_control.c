@@ -0,0 +1,281 @@
+//Copyright 2016 Microchip Technology Inc. (www.microchip.com)
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "mcc_generated_files/usb/usb_device_cdc.h"
+#include "button.h"
+#include "console.h"
+#include "usb_control.h"
+
+//Code and status ahead of the results.
+#define RESPONSE_HEADER_SIZE    2u
+
+//The largest result, USB_CONTROL_GET_STATISTICS.
+#define STATISTICS_SIZE         ((CONSOLE_OVERFLOW_POLICY_COUNT * 8u) + (CONSOLE_LANE_COUNT * 2u) + 8u + (CONSOLE_SINK_COUNT * 4u))
+
+#if (RESPONSE_HEADER_SIZE + STATISTICS_SIZE) > USB_CDC_ENCAPSULATED_SIZE
+    #error "USB_CDC_ENCAPSULATED_SIZE is too small for the statistics response"
+#endif
+
+typedef struct
+{
+    USB_CONTROL_COMMAND code;
+    uint8_t argumentLength;
+    //Writes the results to 'results' and returns their length, or sets
+    //'status' and returns 0.
+    uint8_t (*handler)(const uint8_t* arguments, uint8_t* results, USB_CONTROL_STATUS* status);
+} USB_CONTROL_ENTRY;
+
+static uint8_t GetUptime(const uint8_t* arguments, uint8_t* results, USB_CONTROL_STATUS* status);
+static uint8_t GetStatistics(const uint8_t* arguments, uint8_t* results, USB_CONTROL_STATUS* status);
+static uint8_t ClearStatistics(const uint8_t* arguments, uint8_t* results, USB_CONTROL_STATUS* status);
+static uint8_t GetUSBStatistics(const uint8_t* arguments, uint8_t* results, USB_CONTROL_STATUS* status);
+static uint8_t SetCoalescing(const uint8_t* arguments, uint8_t* results, USB_CONTROL_STATUS* status);
+static uint8_t SetSink(const uint8_t* arguments, uint8_t* results, USB_CONTROL_STATUS* status);
+static uint8_t SetRecordMode(const uint8_t* arguments, uint8_t* results, USB_CONTROL_STATUS* status);
+static uint8_t GetButton(const uint8_t* arguments, uint8_t* results, USB_CONTROL_STATUS* status);
+
+static const USB_CONTROL_ENTRY entries[] =
+{
+    {USB_CONTROL_GET_UPTIME,            0u, &GetUptime},
+    {USB_CONTROL_GET_STATISTICS,        0u, &GetStatistics},
+    {USB_CONTROL_CLEAR_STATISTICS,      0u, &ClearStatistics},
+    {USB_CONTROL_GET_USB_STATISTICS,    0u, &GetUSBStatistics},
+    {USB_CONTROL_SET_COALESCING,        2u, &SetCoalescing},
+    {USB_CONTROL_SET_SINK,              3u, &SetSink},
+    {USB_CONTROL_SET_RECORD_MODE,       1u, &SetRecordMode},
+    {USB_CONTROL_GET_BUTTON,            0u, &GetButton},
+};
+
+#define ENTRY_COUNT (sizeof(entries) / sizeof(entries[0]))
+
+static uint8_t response[USB_CDC_ENCAPSULATED_SIZE];
+
+static uint8_t* PutUint16(uint8_t* output, uint16_t value);
+static uint8_t* PutUint32(uint8_t* output, uint32_t value);
+static uint16_t GetUint16(const uint8_t* input);
+
+void USB_CONTROL_Tasks(void)
+{
+    const uint8_t* command;
+    uint8_t instance;
+    uint16_t length;
+    uint8_t resultLength = 0;
+    USB_CONTROL_STATUS status = USB_CONTROL_STATUS_UNKNOWN_COMMAND;
+    uint8_t i;
+    
+    command = CDCEncapsulatedCommandAcquire(&instance, &length);
+    
+    if(command == NULL)
+    {
+        return;
+    }
+    
+    //Every CDC function answers the same commands.
+    (void)instance;
+    
+    for(i = 0; i < ENTRY_COUNT; i++)
+    {
+        if(entries[i].code == (USB_CONTROL_COMMAND)command[0])
+        {
+            if(length != (1u + entries[i].argumentLength))
+            {
+                status = USB_CONTROL_STATUS_BAD_LENGTH;
+            }
+            else
+            {
+                status = USB_CONTROL_STATUS_OK;
+                resultLength = entries[i].handler(&command[1], &response[RESPONSE_HEADER_SIZE], &status);
+            }
+            break;
+        }
+    }
+    
+    response[0] = command[0];
+    response[1] = (uint8_t)status;
+    
+    CDCEncapsulatedCommandRespond(response, RESPONSE_HEADER_SIZE + resultLength);
+}
+
+static uint8_t GetUptime(const uint8_t* arguments, uint8_t* results, USB_CONTROL_STATUS* status)
+{
+    (void)arguments;
+    (void)status;
+    
+    return (uint8_t)(PutUint32(results, USBGet1msTickCount()) - results);
+}
+
+static uint8_t GetStatistics(const uint8_t* arguments, uint8_t* results, USB_CONTROL_STATUS* status)
+{
+    CONSOLE_STATISTICS statistics;
+    uint8_t* output = results;
+    uint8_t i;
+    
+    (void)arguments;
+    (void)status;
+    
+    CONSOLE_GetStatistics(&statistics);
+    
+    for(i = 0; i < (uint8_t)CONSOLE_OVERFLOW_POLICY_COUNT; i++)
+    {
+        output = PutUint32(output, statistics.policy[i].droppedBytes);
+        output = PutUint32(output, statistics.policy[i].droppedMessages);
+    }
+    
+    for(i = 0; i < (uint8_t)CONSOLE_LANE_COUNT; i++)
+    {
+        output = PutUint16(output, statistics.highWaterMark[i]);
+    }
+    
+    output = PutUint32(output, statistics.repeatedMessages);
+    output = PutUint32(output, statistics.rateLimitedMessages);
+    
+    for(i = 0; i < (uint8_t)CONSOLE_SINK_COUNT; i++)
+    {
+        output = PutUint32(output, statistics.sinkDroppedBytes[i]);
+    }
+    
+    return (uint8_t)(output - results);
+}
+
+static uint8_t ClearStatistics(const uint8_t* arguments, uint8_t* results, USB_CONTROL_STATUS* status)
+{
+    (void)arguments;
+    (void)results;
+    (void)status;
+    
+    CONSOLE_ClearStatistics();
+    
+#if defined(USB_CDC_RX_RING_SIZE)
+    CDCRxRingClearHighWaterMark(CONSOLE_CDC_INSTANCE);
+#endif
+    
+#if defined(USB_CDC_RX_FLOW_CONTROL)
+    CDCRxClearThrottleCount(CONSOLE_CDC_INSTANCE);
+#endif
+    
+#if defined(USB_CDC_MASKED_TIMER)
+    CDCClearLongestMaskedTime();
+#endif
+    
+    return 0;
+}
+
+//Counters that are not built in read as 0.
+static uint8_t GetUSBStatistics(const uint8_t* arguments, uint8_t* results, USB_CONTROL_STATUS* status)
+{
+    uint16_t highWater = 0;
+    uint16_t ringSize = 0;
+    uint16_t throttles = 0;
+    uint16_t maskedTime = 0;
+    uint8_t* output = results;
+    
+    (void)arguments;
+    (void)status;
+    
+#if defined(USB_CDC_RX_RING_SIZE)
+    highWater = CDCRxRingGetHighWaterMark(CONSOLE_CDC_INSTANCE);
+    ringSize = USB_CDC_RX_RING_SIZE;
+#endif
+    
+#if defined(USB_CDC_RX_FLOW_CONTROL)
+    throttles = CDCRxGetThrottleCount(CONSOLE_CDC_INSTANCE);
+#endif
+    
+#if defined(USB_CDC_MASKED_TIMER)
+    maskedTime = CDCGetLongestMaskedTime();
+#endif
+    
+    output = PutUint16(output, highWater);
+    output = PutUint16(output, ringSize);
+    output = PutUint16(output, throttles);
+    output = PutUint16(output, maskedTime);
+    
+    return (uint8_t)(output - results);
+}
+
+static uint8_t SetCoalescing(const uint8_t* arguments, uint8_t* results, USB_CONTROL_STATUS* status)
+{
+    (void)results;
+    (void)status;
+    
+    CONSOLE_SetCoalescing(GetUint16(arguments));
+    
+    return 0;
+}
+
+static uint8_t SetSink(const uint8_t* arguments, uint8_t* results, USB_CONTROL_STATUS* status)
+{
+    (void)results;
+    
+    if((arguments[0] >= (uint8_t)CONSOLE_SINK_COUNT) ||
+       (arguments[1] > 1u) ||
+       (arguments[2] >= (uint8_t)CONSOLE_LANE_COUNT))
+    {
+        *status = USB_CONTROL_STATUS_BAD_ARGUMENT;
+        return 0;
+    }
+    
+    CONSOLE_SetSink((CONSOLE_SINK)arguments[0], (arguments[1] == 1u), (CONSOLE_LANE)arguments[2]);
+    
+    return 0;
+}
+
+static uint8_t SetRecordMode(const uint8_t* arguments, uint8_t* results, USB_CONTROL_STATUS* status)
+{
+    (void)results;
+    
+    if(arguments[0] > 1u)
+    {
+        *status = USB_CONTROL_STATUS_BAD_ARGUMENT;
+        return 0;
+    }
+    
+    CONSOLE_SetRecordMode(arguments[0] == 1u);
+    
+    return 0;
+}
+
+static uint8_t GetButton(const uint8_t* arguments, uint8_t* results, USB_CONTROL_STATUS* status)
+{
+    (void)arguments;
+    (void)status;
+    
+    results[0] = (BUTTON_IsPressed() == true) ? 1u : 0u;
+    
+    return 1;
+}
+
+static uint8_t* PutUint16(uint8_t* output, uint16_t value)
+{
+    output[0] = (uint8_t)value;
+    output[1] = (uint8_t)(value >> 8);
+    
+    return &output[2];
+}
+
+static uint8_t* PutUint32(uint8_t* output, uint32_t value)
+{
+    output = PutUint16(output, (uint16_t)value);
+    
+    return PutUint16(output, (uint16_t)(value >> 16));
+}
+
+static uint16_t GetUint16(const uint8_t* input)
+{
+    return (uint16_t)input[0] | ((uint16_t)input[1] << 8);
+}
@@ -0,0 +1,58 @@
+//Copyright 2016 Microchip Technology Inc. (www.microchip.com)
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+#ifndef USB_CONTROL_H
+#define USB_CONTROL_H
+
+//Control requests carried by CDC SEND_ENCAPSULATED_COMMAND.  A command is
+//its code followed by its arguments; the response, read with
+//GET_ENCAPSULATED_RESPONSE, is the code, a USB_CONTROL_STATUS and the
+//results.  Multi-byte values are little endian.  tools/cdc_control.py is
+//the host side.
+typedef enum
+{
+    USB_CONTROL_GET_UPTIME          = 0x01, //-> uint32 ms since USB start
+    USB_CONTROL_GET_STATISTICS      = 0x02, //-> CONSOLE_STATISTICS, field by field
+    USB_CONTROL_CLEAR_STATISTICS    = 0x03, //console and USB counters
+    USB_CONTROL_GET_USB_STATISTICS  = 0x04, //-> uint16 RX ring high water, ring size, flow control hold-offs, longest masked time
+    USB_CONTROL_SET_COALESCING      = 0x05, //uint16 deadline in ms
+    USB_CONTROL_SET_SINK            = 0x06, //uint8 sink, enable, level
+    USB_CONTROL_SET_RECORD_MODE     = 0x07, //uint8 enable
+    USB_CONTROL_GET_BUTTON          = 0x08  //-> uint8 pressed
+} USB_CONTROL_COMMAND;
+
+typedef enum
+{
+    USB_CONTROL_STATUS_OK,
+    USB_CONTROL_STATUS_UNKNOWN_COMMAND,
+    USB_CONTROL_STATUS_BAD_LENGTH,
+    USB_CONTROL_STATUS_BAD_ARGUMENT
+} USB_CONTROL_STATUS;
+
+/*********************************************************************
+* Function: void USB_CONTROL_Tasks(void);
+*
+* Overview: Answers the CDC encapsulated command waiting, if any.  Call
+*           from the main loop.
+*
+* PreCondition: None
+*
+* Input: None
+*
+* Output: None
+*
+********************************************************************/
+void USB_CONTROL_Tasks(void);
+
+#endif //USB_CONTROL_H
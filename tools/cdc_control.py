@@ -0,0 +1,187 @@
+#!/usr/bin/env python3
+#Copyright 2016 Microchip Technology Inc. (www.microchip.com)
+#
+#Licensed under the Apache License, Version 2.0 (the "License");
+#you may not use this file except in compliance with the License.
+#You may obtain a copy of the License at
+#
+#    http://www.apache.org/licenses/LICENSE-2.0
+#
+#Unless required by applicable law or agreed to in writing, software
+#distributed under the License is distributed on an "AS IS" BASIS,
+#WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#See the License for the specific language governing permissions and
+#limitations under the License.
+
+"""Host side of the control requests (usb_control.h).
+
+  cdc_control.py uptime
+  cdc_control.py stats
+  cdc_control.py usb
+  cdc_control.py clear
+  cdc_control.py coalesce 2
+  cdc_control.py sink 1 1 2
+  cdc_control.py records 1
+  cdc_control.py button
+
+Each request is a CDC SEND_ENCAPSULATED_COMMAND on the control endpoint,
+answered with GET_ENCAPSULATED_RESPONSE once the board has sent
+RESPONSE_AVAILABLE.  Bulk data on either COM port is not disturbed.  The
+host serial driver does not pass these requests on, so it is detached from
+the communication interface used (--interface, default 0: the "Data"
+function, leaving the console port open).  Needs pyusb.
+"""
+
+import argparse
+import struct
+import sys
+
+VENDOR_ID = 0x04D8
+PRODUCT_ID = 0x000A
+
+SEND_ENCAPSULATED_COMMAND = 0x00
+GET_ENCAPSULATED_RESPONSE = 0x01
+RESPONSE_AVAILABLE = 0x01
+ENCAPSULATED_SIZE = 64
+
+GET_UPTIME = 0x01
+GET_STATISTICS = 0x02
+CLEAR_STATISTICS = 0x03
+GET_USB_STATISTICS = 0x04
+SET_COALESCING = 0x05
+SET_SINK = 0x06
+SET_RECORD_MODE = 0x07
+GET_BUTTON = 0x08
+
+STATUS = ("ok", "unknown command", "bad length", "bad argument")
+
+POLICIES = ("drop newest", "drop oldest", "block", "all or nothing")
+LANES = ("fault", "warn", "info")
+SINKS = ("cdc", "uart", "trace")
+STATISTICS = struct.Struct("<" + "II" * len(POLICIES) + "H" * len(LANES) + "II" + "I" * len(SINKS))
+USB_STATISTICS = struct.Struct("<HHHH")
+
+
+class ControlError(IOError):
+    pass
+
+
+class Control:
+    """Sends control requests to one CDC function of the board."""
+
+    def __init__(self, device, interface=0, notification_endpoint=None, timeout=1000):
+        import usb.util
+        self.device = device
+        self.interface = interface
+        self.timeout = timeout
+        if device.is_kernel_driver_active(interface):
+            device.detach_kernel_driver(interface)
+        usb.util.claim_interface(device, interface)
+        if notification_endpoint is None:
+            settings = device.get_active_configuration()[(interface, 0)]
+            notification_endpoint = settings[0].bEndpointAddress
+        self.notification_endpoint = notification_endpoint
+
+    def wait_response_available(self):
+        """Skips SERIAL_STATE notifications up to RESPONSE_AVAILABLE."""
+        while True:
+            notification = self.device.read(self.notification_endpoint, 16, self.timeout)
+            if len(notification) >= 2 and notification[1] == RESPONSE_AVAILABLE:
+                return
+
+    def request(self, code, arguments=b""):
+        self.device.ctrl_transfer(0x21, SEND_ENCAPSULATED_COMMAND, 0, self.interface,
+                                  bytes([code]) + bytes(arguments), self.timeout)
+        self.wait_response_available()
+        response = bytes(self.device.ctrl_transfer(0xA1, GET_ENCAPSULATED_RESPONSE, 0, self.interface,
+                                                   ENCAPSULATED_SIZE, self.timeout))
+        if len(response) < 2 or response[0] != code:
+            raise ControlError("unexpected response %r" % response)
+        if response[1] != 0:
+            status = STATUS[response[1]] if response[1] < len(STATUS) else "status %u" % response[1]
+            raise ControlError(status)
+        return response[2:]
+
+    def uptime(self):
+        return struct.unpack("<I", self.request(GET_UPTIME))[0]
+
+    def statistics(self):
+        values = list(STATISTICS.unpack(self.request(GET_STATISTICS)))
+        result = {}
+        for policy in POLICIES:
+            result[policy] = (values.pop(0), values.pop(0))
+        result["high water"] = dict((lane, values.pop(0)) for lane in LANES)
+        result["repeated"] = values.pop(0)
+        result["rate limited"] = values.pop(0)
+        result["sink dropped"] = dict((sink, values.pop(0)) for sink in SINKS)
+        return result
+
+    def usb_statistics(self):
+        return dict(zip(("rx high water", "rx ring size", "rx hold-offs", "masked time"),
+                        USB_STATISTICS.unpack(self.request(GET_USB_STATISTICS))))
+
+    def clear(self):
+        self.request(CLEAR_STATISTICS)
+
+    def set_coalescing(self, milliseconds):
+        self.request(SET_COALESCING, struct.pack("<H", milliseconds))
+
+    def set_sink(self, sink, enable, level):
+        self.request(SET_SINK, bytes([sink, 1 if enable else 0, level]))
+
+    def set_record_mode(self, enable):
+        self.request(SET_RECORD_MODE, bytes([1 if enable else 0]))
+
+    def button(self):
+        return self.request(GET_BUTTON)[0] != 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--interface", type=int, default=0, help="communication interface of the CDC function")
+    commands = parser.add_subparsers(dest="command", required=True)
+    commands.add_parser("uptime", help="milliseconds since USB start")
+    commands.add_parser("stats", help="console drop counters")
+    commands.add_parser("usb", help="CDC driver counters")
+    commands.add_parser("clear", help="reset the counters")
+    coalesce_command = commands.add_parser("coalesce", help="console packet coalescing deadline")
+    coalesce_command.add_argument("milliseconds", type=int)
+    sink_command = commands.add_parser("sink", help="enable or disable a console sink")
+    sink_command.add_argument("sink", type=int, help="0 cdc, 1 uart, 2 trace")
+    sink_command.add_argument("enable", type=int)
+    sink_command.add_argument("level", type=int, help="0 fault, 1 warn, 2 info")
+    records_command = commands.add_parser("records", help="console record mode")
+    records_command.add_argument("enable", type=int)
+    commands.add_parser("button", help="current button state")
+
+    args = parser.parse_args()
+
+    import usb.core
+
+    device = usb.core.find(idVendor=VENDOR_ID, idProduct=PRODUCT_ID)
+    if device is None:
+        sys.exit("board not found")
+    control = Control(device, args.interface)
+
+    if args.command == "uptime":
+        print("%u ms" % control.uptime())
+    elif args.command == "stats":
+        for name, value in control.statistics().items():
+            print("%s: %s" % (name, value))
+    elif args.command == "usb":
+        for name, value in control.usb_statistics().items():
+            print("%s: %u" % (name, value))
+    elif args.command == "clear":
+        control.clear()
+    elif args.command == "coalesce":
+        control.set_coalescing(args.milliseconds)
+    elif args.command == "sink":
+        control.set_sink(args.sink, args.enable, args.level)
+    elif args.command == "records":
+        control.set_record_mode(args.enable)
+    elif args.command == "button":
+        print("pressed" if control.button() else "released")
+
+
+if __name__ == "__main__":
+    main()
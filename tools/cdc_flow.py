@@ -0,0 +1,115 @@
+#!/usr/bin/env python3
+#Copyright 2016 Microchip Technology Inc. (www.microchip.com)
+#
+#Licensed under the Apache License, Version 2.0 (the "License");
+#you may not use this file except in compliance with the License.
+#You may obtain a copy of the License at
+#
+#    http://www.apache.org/licenses/LICENSE-2.0
+#
+#Unless required by applicable law or agreed to in writing, software
+#distributed under the License is distributed on an "AS IS" BASIS,
+#WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#See the License for the specific language governing permissions and
+#limitations under the License.
+
+"""Host side of the CDC receive flow control (USB_CDC_RX_FLOW_CONTROL).
+
+  cdc_flow.py send /dev/ttyACM0 file.bin
+  cdc_flow.py send --chunk 16 COM5 -
+
+The board drops DSR in a SERIAL_STATE notification while its receive ring is
+nearly full and raises it again once the application has read it down.
+'send' writes the file (or stdin) to the port a chunk at a time and waits
+while DSR is low, so a fast host backs off instead of being NAKed.
+
+DSR reaches the host in a notification on the interrupt endpoint, which the
+host polls every 2 ms, so the DSR the host sees right after a write does not
+yet reflect that write.  After each chunk the writer therefore waits
+NOTIFY_INTERVAL, a little longer than one polling interval, before it looks
+at DSR again.  With that wait at most one chunk goes out after the ring
+reaches the board's off level, and it must fit in the room left above it
+(64 bytes for the default 256 byte ring): keep the chunk below that.  The
+default of 32 bytes leaves half of the room as a margin.
+
+FlowControlledWriter does the same for any object with write(), flush() and
+a dsr attribute, such as a pyserial Serial.  Needs pyserial for 'send'.
+"""
+
+import argparse
+import sys
+import time
+
+DEFAULT_CHUNK = 32
+POLL_INTERVAL = 0.001
+#One interrupt endpoint polling interval (bInterval 2 at full speed) and a
+#margin for the host driver to hand the notification on.
+NOTIFY_INTERVAL = 0.003
+
+
+class FlowTimeout(IOError):
+    """DSR stayed low for longer than the writer's timeout."""
+
+
+class FlowControlledWriter:
+    """Writes to 'port' only while its DSR line is high."""
+
+    def __init__(self, port, chunk=DEFAULT_CHUNK, timeout=None, settle=NOTIFY_INTERVAL):
+        self.port = port
+        self.chunk = chunk
+        self.settle = settle
+        self.timeout = timeout
+        self.waits = 0
+
+    def wait_ready(self):
+        """Blocks until DSR is high; raises FlowTimeout after 'timeout' s."""
+        if self.port.dsr:
+            return
+        self.waits += 1
+        deadline = None if self.timeout is None else time.monotonic() + self.timeout
+        while not self.port.dsr:
+            if deadline is not None and time.monotonic() >= deadline:
+                raise FlowTimeout("DSR held low for %.3f s" % self.timeout)
+            time.sleep(POLL_INTERVAL)
+
+    def write(self, data):
+        view = memoryview(data)
+        for start in range(0, len(view), self.chunk):
+            self.wait_ready()
+            self.port.write(view[start:start + self.chunk])
+            #The board only sees (and can only refuse) what has left the
+            #host queue: push each chunk out, then give the DSR drop it may
+            #cause time to come back before checking DSR again.
+            self.port.flush()
+            time.sleep(self.settle)
+        return len(view)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    commands = parser.add_subparsers(dest="command", required=True)
+
+    send_command = commands.add_parser("send", help="write a file to the board")
+    send_command.add_argument("--chunk", type=int, default=DEFAULT_CHUNK, help="bytes written per DSR check")
+    send_command.add_argument("--timeout", type=float, default=None, help="seconds to wait for DSR before giving up")
+    send_command.add_argument("port", help="serial device")
+    send_command.add_argument("input", nargs="?", default="-", help="file to send")
+
+    args = parser.parse_args()
+
+    import serial
+
+    source = sys.stdin.buffer if args.input == "-" else open(args.input, "rb")
+    with serial.Serial(args.port) as port:
+        writer = FlowControlledWriter(port, args.chunk, args.timeout)
+        total = 0
+        while True:
+            data = source.read(4096)
+            if not data:
+                break
+            total += writer.write(data)
+    sys.stderr.write("%u bytes sent, held off %u times\n" % (total, writer.waits))
+
+
+if __name__ == "__main__":
+    main()
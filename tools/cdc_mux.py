@@ -0,0 +1,246 @@
+#!/usr/bin/env python3
+#Copyright 2016 Microchip Technology Inc. (www.microchip.com)
+#
+#Licensed under the Apache License, Version 2.0 (the "License");
+#you may not use this file except in compliance with the License.
+#You may obtain a copy of the License at
+#
+#    http://www.apache.org/licenses/LICENSE-2.0
+#
+#Unless required by applicable law or agreed to in writing, software
+#distributed under the License is distributed on an "AS IS" BASIS,
+#WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#See the License for the specific language governing permissions and
+#limitations under the License.
+
+"""Host side of the multiplexed channels on the data port (cdc_mux.h).
+
+  cdc_mux.py echo /dev/ttyACM0
+  cdc_mux.py echo --bytes 65536 --stall 2 COM5
+
+The data port carries CDC_MUX_CHANNEL_COUNT logical channels, each with its
+own credit: the board only sends what the host has room for and the host
+only sends what the board has room for, so a channel nobody reads stops on
+its own while the others keep going.  'echo' sends random data on every
+channel at once, reads the board's echo back and checks it; with --stall
+one channel is never read, and the others must still complete.
+
+Mux does the framing and the credit for any object with read(), write() and
+in_waiting, such as a pyserial Serial.  Needs pyserial for 'echo'.
+
+The board sends nothing until reset() and forgets the link when the port
+is closed (which drops DTR) or the board is detached, so every session must
+start with reset().
+"""
+
+import argparse
+import os
+import struct
+import time
+
+CHANNEL_COUNT = 4
+FRAME_HEADER_SIZE = 2
+DATA_FRAME = 0x00
+CREDIT_FRAME = 0x80
+RESET_FRAME = 0xFF
+MAX_PAYLOAD = 62
+
+DEFAULT_WINDOW = 1024
+POLL_INTERVAL = 0.001
+
+
+class MuxTimeout(IOError):
+    """The board did not answer in time."""
+
+
+class Mux:
+    """Splits one serial stream into CHANNEL_COUNT credit-controlled channels."""
+
+    def __init__(self, port, channels=CHANNEL_COUNT, window=DEFAULT_WINDOW):
+        self.port = port
+        self.channels = channels
+        self.window = window
+        self.tx = [bytearray() for _ in range(channels)]
+        self.rx = [bytearray() for _ in range(channels)]
+        self.tx_credit = [0] * channels
+        #Read by the application, not yet granted back to the board.
+        self.rx_ungranted = [0] * channels
+        self.next_channel = 0
+        self.input = bytearray()
+        self.synchronized = False
+
+    def reset(self, timeout=1.0):
+        """Starts the link over: both sides drop what they hold, the board
+        is granted 'window' bytes per channel, and everything up to the
+        board's reset answer is discarded."""
+        for channel in range(self.channels):
+            self.tx[channel].clear()
+            self.rx[channel].clear()
+            self.tx_credit[channel] = 0
+            self.rx_ungranted[channel] = 0
+        self.next_channel = 0
+        self.input.clear()
+        self.synchronized = False
+
+        frames = bytes([RESET_FRAME, 0])
+        for channel in range(self.channels):
+            frames += self.credit_frame(channel, self.window)
+        self.port.write(frames)
+
+        deadline = time.monotonic() + timeout
+        while not self.synchronized:
+            if time.monotonic() >= deadline:
+                raise MuxTimeout("no reset answer")
+            self.poll()
+
+    @staticmethod
+    def credit_frame(channel, count):
+        return bytes([CREDIT_FRAME | channel, 2]) + struct.pack("<H", count)
+
+    def write(self, channel, data):
+        """Queues data on a channel; poll() sends it as credit arrives."""
+        self.tx[channel] += data
+        self.poll()
+
+    def pending(self, channel):
+        """Bytes queued on a channel and not yet sent."""
+        return len(self.tx[channel])
+
+    def read(self, channel, size=None):
+        """Takes up to 'size' received bytes (all of them by default) and
+        grants their room back to the board."""
+        self.poll()
+        buffer = self.rx[channel]
+        if size is None or size > len(buffer):
+            size = len(buffer)
+        data = bytes(buffer[:size])
+        del buffer[:size]
+        self.rx_ungranted[channel] += size
+        return data
+
+    def poll(self):
+        """Parses whatever the port has received, then sends credit and
+        data.  Call it while waiting on a channel."""
+        waiting = self.port.in_waiting
+        if waiting:
+            self.input += self.port.read(waiting)
+            self.parse()
+        self.send()
+
+    def parse(self):
+        if not self.synchronized:
+            #Data frames from before the reset may still be in flight.
+            start = self.input.find(bytes([RESET_FRAME, 0]))
+            if start < 0:
+                del self.input[:max(len(self.input) - 1, 0)]
+                return
+            del self.input[:start + FRAME_HEADER_SIZE]
+            self.synchronized = True
+
+        while len(self.input) >= FRAME_HEADER_SIZE:
+            frame_id, length = self.input[0], self.input[1]
+            if len(self.input) < FRAME_HEADER_SIZE + length:
+                return
+            payload = bytes(self.input[FRAME_HEADER_SIZE:FRAME_HEADER_SIZE + length])
+            del self.input[:FRAME_HEADER_SIZE + length]
+
+            channel = frame_id & ~CREDIT_FRAME
+            if frame_id == RESET_FRAME:
+                continue
+            if channel >= self.channels:
+                continue
+            if frame_id & CREDIT_FRAME:
+                if length == 2:
+                    self.tx_credit[channel] += struct.unpack("<H", payload)[0]
+            else:
+                self.rx[channel] += payload
+
+    def send(self):
+        """Credit frames first, then data, MAX_PAYLOAD bytes per channel in
+        turn, within each channel's credit."""
+        frames = bytearray()
+        for channel in range(self.channels):
+            if self.rx_ungranted[channel] == 0:
+                continue
+            if self.rx_ungranted[channel] >= self.window // 4 or not self.rx[channel]:
+                frames += self.credit_frame(channel, self.rx_ungranted[channel])
+                self.rx_ungranted[channel] = 0
+
+        idle = 0
+        channel = self.next_channel
+        while idle < self.channels:
+            count = min(len(self.tx[channel]), self.tx_credit[channel], MAX_PAYLOAD)
+            if count == 0:
+                idle += 1
+            else:
+                frames += bytes([DATA_FRAME | channel, count]) + self.tx[channel][:count]
+                del self.tx[channel][:count]
+                self.tx_credit[channel] -= count
+                idle = 0
+                self.next_channel = (channel + 1) % self.channels
+            channel = (channel + 1) % self.channels
+
+        if frames:
+            self.port.write(frames)
+
+
+def echo(mux, total, stall=None, timeout=10.0):
+    """Sends 'total' random bytes on every channel and checks the echo.
+    Returns {channel: (bytes echoed, seconds)}."""
+    sent = {}
+    received = {}
+    finished = {}
+    active = [channel for channel in range(mux.channels) if channel != stall]
+    start = time.monotonic()
+
+    for channel in range(mux.channels):
+        sent[channel] = os.urandom(total)
+        received[channel] = bytearray()
+        mux.write(channel, sent[channel])
+
+    while len(finished) < len(active):
+        if time.monotonic() - start >= timeout:
+            raise MuxTimeout("channels %s did not finish" %
+                             [channel for channel in active if channel not in finished])
+        mux.poll()
+        for channel in active:
+            if channel in finished:
+                continue
+            received[channel] += mux.read(channel)
+            if not sent[channel].startswith(bytes(received[channel])):
+                raise IOError("channel %u: echo differs at byte %u" %
+                              (channel, len(received[channel])))
+            if len(received[channel]) == total:
+                finished[channel] = time.monotonic() - start
+        time.sleep(POLL_INTERVAL)
+
+    return dict((channel, (len(received[channel]), finished[channel])) for channel in active)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    commands = parser.add_subparsers(dest="command", required=True)
+
+    echo_command = commands.add_parser("echo", help="check the board's echo on every channel")
+    echo_command.add_argument("--bytes", type=int, default=16384, help="bytes sent per channel")
+    echo_command.add_argument("--stall", type=int, default=None, help="channel never read")
+    echo_command.add_argument("--window", type=int, default=DEFAULT_WINDOW, help="receive credit per channel")
+    echo_command.add_argument("--timeout", type=float, default=10.0, help="seconds for the whole test")
+    echo_command.add_argument("port", help="serial device")
+
+    args = parser.parse_args()
+
+    import serial
+
+    with serial.Serial(args.port, timeout=0) as port:
+        mux = Mux(port, window=args.window)
+        mux.reset()
+        results = echo(mux, args.bytes, args.stall, args.timeout)
+        for channel, (count, seconds) in sorted(results.items()):
+            print("channel %u: %u bytes in %.3f s" % (channel, count, seconds))
+        if args.stall is not None:
+            print("channel %u: %u bytes left unsent" % (args.stall, mux.pending(args.stall)))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,267 @@
+#!/usr/bin/env python3
+#Copyright 2016 Microchip Technology Inc. (www.microchip.com)
+#
+#Licensed under the Apache License, Version 2.0 (the "License");
+#you may not use this file except in compliance with the License.
+#You may obtain a copy of the License at
+#
+#    http://www.apache.org/licenses/LICENSE-2.0
+#
+#Unless required by applicable law or agreed to in writing, software
+#distributed under the License is distributed on an "AS IS" BASIS,
+#WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#See the License for the specific language governing permissions and
+#limitations under the License.
+
+"""Host side of the tokenized console log (CONSOLE_LOG_TOKENIZED).
+
+  console_log.py table console_log_strings.h -o console_log_table.json
+  console_log.py decode console_log_table.json /dev/ttyACM0
+  console_log.py decode --records console_log_table.json /dev/ttyACM0
+
+'table' is the build step: it extracts the format strings, in ID order, from
+console_log_strings.h.  'decode' reads the console stream and prints it with
+every record expanded back into text.  With --records the stream is expected
+in the console's record mode (CONSOLE_RECORDS): COBS frames carrying a
+sequence number, a 1ms timestamp and the lane of each message.  --lzss
+undoes the console's compression (CONSOLE_COMPRESSION) first.
+"""
+
+import argparse
+import codecs
+import json
+import re
+import struct
+import sys
+
+RECORD_START = 0x00
+RECORD_HEADER = struct.Struct("<BHB")
+ARGUMENT = struct.Struct("<I")
+
+ENTRY = re.compile(r'CONSOLE_LOG_STRING\(\s*(\w+)\s*,\s*((?:"(?:[^"\\]|\\.)*"\s*)+)\)')
+LITERAL = re.compile(r'"((?:[^"\\]|\\.)*)"')
+CONVERSION = re.compile(r"%([%udx])")
+
+FRAME_DELIMITER = 0x00
+FRAME_HEADER = struct.Struct("<HIB")
+LANES = ("fault", "warn", "info")
+
+LZSS_WINDOW = 512
+LZSS_MIN_MATCH = 3
+LZSS_END_OF_GROUP = 0x7F
+
+
+def extract_table(header_text):
+    """Returns [(name, format), ...] in enum (ID) order."""
+    header_text = re.sub(r"//[^\n]*", "", header_text)
+    table = []
+    for name, literals in ENTRY.findall(header_text):
+        text = "".join(codecs.decode(part, "unicode_escape")
+                       for part in LITERAL.findall(literals))
+        table.append((name, text))
+    return table
+
+
+def format_record(table, log_id, arguments):
+    if log_id >= len(table):
+        return "<unknown log id %u %r>" % (log_id, arguments)
+
+    remaining = list(arguments)
+
+    def convert(match):
+        kind = match.group(1)
+        if kind == "%":
+            return "%"
+        if not remaining:
+            return ""
+        value = remaining.pop(0)
+        if kind == "x":
+            return "%X" % value
+        if kind == "d" and value & 0x80000000:
+            value -= 1 << 32
+        return "%d" % value
+
+    return CONVERSION.sub(convert, table[log_id][1])
+
+
+class Decoder:
+    """Incremental decoder; feed() accepts any split of the byte stream."""
+
+    def __init__(self, table):
+        self.table = table
+        self.pending = bytearray()
+
+    def feed(self, data):
+        self.pending += data
+        text = []
+        while self.pending:
+            start = self.pending.find(RECORD_START)
+            if start != 0:
+                end = len(self.pending) if start < 0 else start
+                text.append(self.pending[:end].decode("latin-1"))
+                del self.pending[:end]
+                continue
+            if len(self.pending) < RECORD_HEADER.size:
+                break
+            _, log_id, count = RECORD_HEADER.unpack_from(self.pending)
+            size = RECORD_HEADER.size + count * ARGUMENT.size
+            if len(self.pending) < size:
+                break
+            arguments = [ARGUMENT.unpack_from(self.pending, RECORD_HEADER.size + i * ARGUMENT.size)[0]
+                         for i in range(count)]
+            text.append(format_record(self.table, log_id, arguments))
+            del self.pending[:size]
+        return "".join(text)
+
+
+def cobs_decode(frame):
+    """Returns the decoded bytes, or None if the frame is malformed."""
+    output = bytearray()
+    index = 0
+    while index < len(frame):
+        code = frame[index]
+        if code == 0 or index + code > len(frame):
+            return None
+        output += frame[index + 1:index + code]
+        index += code
+        if code != 0xFF and index < len(frame):
+            output.append(0)
+    return bytes(output)
+
+
+class RecordDecoder:
+    """Splits a record mode stream into (lane, sequence, timestamp, gap,
+    payload) tuples.  Sequence numbers are per lane; 'gap' is the number of
+    messages the device dropped on that lane just before this one."""
+
+    def __init__(self):
+        self.pending = bytearray()
+        self.expected = {}
+        self.lost = 0
+        self.malformed = 0
+
+    def feed(self, data):
+        self.pending += data
+        records = []
+        while True:
+            end = self.pending.find(FRAME_DELIMITER)
+            if end < 0:
+                break
+            frame = bytes(self.pending[:end])
+            del self.pending[:end + 1]
+            if not frame:
+                continue
+            decoded = cobs_decode(frame)
+            if decoded is None or len(decoded) < FRAME_HEADER.size:
+                self.malformed += 1
+                continue
+            sequence, timestamp, lane = FRAME_HEADER.unpack_from(decoded)
+            gap = (sequence - self.expected.get(lane, sequence)) & 0xFFFF
+            self.lost += gap
+            self.expected[lane] = (sequence + 1) & 0xFFFF
+            records.append((lane, sequence, timestamp, gap, decoded[FRAME_HEADER.size:]))
+        return records
+
+
+class LzssDecoder:
+    """Incremental decompressor for the format described in console_lzss.h."""
+
+    def __init__(self):
+        self.pending = bytearray()
+        self.history = bytearray()
+        self.flags = 0
+        self.items = 0
+
+    def feed(self, data):
+        self.pending += data
+        output = bytearray()
+        index = 0
+        while index < len(self.pending):
+            if self.items == 0:
+                self.flags = self.pending[index]
+                self.items = 8
+                index += 1
+                continue
+            if self.flags & 1:
+                output.append(self.pending[index])
+                self.history.append(self.pending[index])
+                index += 1
+            else:
+                if index + 2 > len(self.pending):
+                    break
+                low, high = self.pending[index], self.pending[index + 1]
+                index += 2
+                if high & 0x7F == LZSS_END_OF_GROUP:
+                    self.items = 0
+                    continue
+                distance = (low | (high >> 7) << 8) + 1
+                if distance > len(self.history):
+                    raise ValueError("match reaches before the start of the stream")
+                for _ in range((high & 0x7F) + LZSS_MIN_MATCH):
+                    value = self.history[-distance]
+                    output.append(value)
+                    self.history.append(value)
+            self.flags >>= 1
+            self.items -= 1
+        del self.pending[:index]
+        del self.history[:-LZSS_WINDOW]
+        return bytes(output)
+
+
+def lane_name(lane):
+    return LANES[lane] if lane < len(LANES) else "lane%u" % lane
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    commands = parser.add_subparsers(dest="command", required=True)
+
+    table_command = commands.add_parser("table", help="extract the string table")
+    table_command.add_argument("strings", help="path to console_log_strings.h")
+    table_command.add_argument("-o", "--output", default="-", help="output JSON file")
+
+    decode_command = commands.add_parser("decode", help="decode a console stream")
+    decode_command.add_argument("--lzss", action="store_true", help="the console output is compressed")
+    decode_command.add_argument("--records", action="store_true", help="the console is in record mode")
+    decode_command.add_argument("table", help="JSON table written by 'table'")
+    decode_command.add_argument("input", nargs="?", default="-", help="capture file or serial device")
+
+    args = parser.parse_args()
+
+    if args.command == "table":
+        with open(args.strings, encoding="utf-8") as header:
+            table = extract_table(header.read())
+        output = sys.stdout if args.output == "-" else open(args.output, "w", encoding="utf-8")
+        json.dump([{"id": name, "format": text} for name, text in table], output, indent=2)
+        output.write("\n")
+        return
+
+    with open(args.table, encoding="utf-8") as table_file:
+        table = [(entry["id"], entry["format"]) for entry in json.load(table_file)]
+    decoder = Decoder(table)
+    records = RecordDecoder()
+    lzss = LzssDecoder()
+    lanes = {}
+    stream = sys.stdin.buffer if args.input == "-" else open(args.input, "rb", buffering=0)
+    while True:
+        data = stream.read(64)
+        if not data:
+            break
+        if args.lzss:
+            data = lzss.feed(data)
+        if not args.records:
+            sys.stdout.write(decoder.feed(data))
+        else:
+            for lane, sequence, timestamp, gap, payload in records.feed(data):
+                if gap:
+                    sys.stdout.write("<%u %s messages lost>\n" % (gap, lane_name(lane)))
+                #Each lane carries its own text stream.
+                lane_decoder = lanes.setdefault(lane, Decoder(table))
+                text = lane_decoder.feed(payload)
+                sys.stdout.write("[%10u.%03u %-5s #%u] %s" % (timestamp // 1000, timestamp % 1000,
+                                                          lane_name(lane), sequence, text))
+        sys.stdout.flush()
+
+
+if __name__ == "__main__":
+    main()
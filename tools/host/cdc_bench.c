@@ -0,0 +1,197 @@
+//Copyright 2016 Microchip Technology Inc. (www.microchip.com)
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+//The CDC data OUT endpoint through usb_device_cdc.c and the BDT model of
+//host_usb.c.  A slot is the time of one 64 byte bulk transaction.  Every
+//BURST_PERIOD slots the host has BURST_SIZE packets of a numbered stream to
+//send, and tries the next one in every slot until it is taken; in a second
+//run it always has the next packet ready, so that only the device limits
+//throughput.  The main loop leases each packet with CDCRxAcquireBuffer(),
+//works on it for a few slots, gives it back and runs its other tasks for 0
+//to 2 slots.  A main loop pass is much shorter than a transaction, so with
+//no other tasks it asks for the next packet in the slot it gave the last
+//one back.  Every CLEAR_HALT_PERIOD slots the host also clears a halt on
+//the endpoint, and the stream is checked end to end.  Built with
+//-DCDC_RX_BUFFER_COUNT=1 (as cdc_single_bench) the driver arms one buffer
+//at a time, as it used to.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "mcc_generated_files/usb/usb.h"
+#include "mcc_generated_files/usb/usb_device_cdc.h"
+#include "host.h"
+
+#define SLOT_COUNT          1000000ul
+#define CLEAR_HALT_PERIOD   997ul
+#define MAX_WORK            3u
+#define BURST_PERIOD        64u
+#define BURST_SIZE          8u
+#define MAX_TASKS           2u
+#define DATA_INSTANCE       0u
+
+typedef struct
+{
+    uint32_t queued;            //packets the host has had to send
+    uint32_t sent;              //next packet the host offers
+    uint32_t waited;            //packet-slots spent queued at the host
+    uint32_t received;          //next packet the main loop expects
+    uint8_t* packet;            //leased packet, or NULL
+    uint8_t wait;               //slots the main loop is still busy for
+    bool failed;
+} STREAM;
+
+static void MainLoop(STREAM* stream, uint8_t work, uint32_t* seed);
+static void MakePacket(uint8_t* packet, uint32_t number);
+static uint32_t GetRandom(uint32_t* seed);
+
+int main(void)
+{
+    uint8_t packet[CDC_DATA_OUT_EP_SIZE];
+    STREAM stream;
+    uint32_t seed;
+    uint32_t slot;
+    uint8_t run;
+    uint8_t work;
+    bool saturated;
+    
+    printf("cdc_bench: data OUT endpoint, %u receive buffer(s), %lu slots each\n",
+           (unsigned)CDC_RX_BUFFER_COUNT, (unsigned long)SLOT_COUNT);
+    printf("  %-26s  %12s  %11s  %12s\n", "main loop work per packet", "packets/slot", "NAKs/packet",
+           "slots waited");
+    
+    //Each value of work, first with bursts from the host, then saturated.
+    for(run = 0; run < (2u * (MAX_WORK + 1u)); run++)
+    {
+        work = run % (MAX_WORK + 1u);
+        saturated = (run > MAX_WORK);
+        
+        if(run == 0u)
+        {
+            printf("  host sends %u packets every %u slots\n", BURST_SIZE, BURST_PERIOD);
+        }
+        else if(run == (MAX_WORK + 1u))
+        {
+            printf("  host always has the next packet ready\n");
+        }
+        
+        CDCInitEP();
+        (void)memset(&HOST_usb, 0, sizeof(HOST_usb));
+        (void)memset(&stream, 0, sizeof(stream));
+        seed = 1;
+    
+        for(slot = 0; slot < SLOT_COUNT; slot++)
+        {
+            if((slot % CLEAR_HALT_PERIOD) == (CLEAR_HALT_PERIOD - 1u))
+            {
+                HOST_USB_ClearHalt(CDC_DATA_EP, OUT_FROM_HOST);
+            }
+    
+            if(saturated == true)
+            {
+                stream.queued = stream.sent + 1u;
+            }
+            else if((slot % BURST_PERIOD) == 0u)
+            {
+                stream.queued += BURST_SIZE;
+            }
+    
+            if(stream.sent != stream.queued)
+            {
+                MakePacket(packet, stream.sent);
+    
+                if(HOST_USB_Out(CDC_DATA_EP, packet, sizeof(packet)) == true)
+                {
+                    stream.sent++;
+                }
+                stream.waited += stream.queued - stream.sent;
+            }
+    
+            MainLoop(&stream, work, &seed);
+        }
+    
+        if((stream.failed == true) || (HOST_usb.errors != 0u) || ((stream.sent - stream.received) > CDC_RX_BUFFER_COUNT))
+        {
+            printf("cdc_bench: FAILED, packet %lu of %lu is lost or damaged\n",
+                   (unsigned long)stream.received, (unsigned long)stream.sent);
+            return 1;
+        }
+    
+        printf("    %u slot(s)%15s  %12.3f  %11.2f  %12.2f\n", (unsigned)work, "",
+               (double)stream.received / SLOT_COUNT,
+               (double)HOST_usb.naks / stream.received, (double)stream.waited / stream.received);
+    }
+    
+    return 0;
+}
+
+static void MainLoop(STREAM* stream, uint8_t work, uint32_t* seed)
+{
+    uint8_t expected[CDC_DATA_OUT_EP_SIZE];
+    uint8_t length;
+    
+    if(stream->wait != 0u)
+    {
+        stream->wait--;
+        return;
+    }
+    
+    if(stream->packet != NULL)
+    {
+        CDCRxReleaseBuffer(DATA_INSTANCE);
+        stream->packet = NULL;
+        stream->wait = (uint8_t)(GetRandom(seed) % (MAX_TASKS + 1u));
+        
+        if(stream->wait != 0u)
+        {
+            return;
+        }
+    }
+    
+    stream->packet = CDCRxAcquireBuffer(DATA_INSTANCE, &length);
+    
+    if(stream->packet == NULL)
+    {
+        return;
+    }
+    
+    MakePacket(expected, stream->received);
+    
+    if((length != sizeof(expected)) || (memcmp(stream->packet, expected, sizeof(expected)) != 0))
+    {
+        stream->failed = true;
+    }
+    
+    stream->received++;
+    stream->wait = work;
+}
+
+static void MakePacket(uint8_t* packet, uint32_t number)
+{
+    uint8_t i;
+    
+    for(i = 0; i < CDC_DATA_OUT_EP_SIZE; i++)
+    {
+        packet[i] = (uint8_t)(number + (i * 7u));
+    }
+    
+    (void)memcpy(packet, &number, sizeof(number));
+}
+
+static uint32_t GetRandom(uint32_t* seed)
+{
+    *seed = (*seed * 1103515245ul) + 12345ul;
+    
+    return *seed >> 8;
+}
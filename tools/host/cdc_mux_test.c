@@ -0,0 +1,483 @@
+//Copyright 2016 Microchip Technology Inc. (www.microchip.com)
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+//Behaviour checks of cdc_mux.c on usb_device_cdc.c and the BDT model of
+//host_usb.c, with this file as the host: the credit either side grants is
+//never overrun, channels take turns a quantum at a time, and a new host's
+//reset is understood whatever the last one left half sent.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "mcc_generated_files/usb/usb.h"
+#include "mcc_generated_files/usb/usb_device_cdc.h"
+#include "cdc_mux.h"
+#include "host.h"
+
+#define MAX_PACKET          CDC_DATA_IN_EP_SIZE
+#define CAPTURE_SIZE        16384u
+
+//As in cdc_mux.c.
+#define RX_FIFO_SIZE        128u
+#define QUANTUM             16u
+
+typedef struct
+{
+    const char* name;
+    bool (*run)(void);
+} TEST;
+
+//What the host has taken from the board.
+typedef struct
+{
+    uint8_t data[CDC_MUX_CHANNEL_COUNT][CAPTURE_SIZE];
+    uint16_t received[CDC_MUX_CHANNEL_COUNT];
+    uint32_t granted[CDC_MUX_CHANNEL_COUNT];
+    uint8_t resets;
+    uint8_t longestData;
+    bool malformed;
+} LINK;
+
+static void Reset(void);
+static void Pass(void);
+static bool Send(const uint8_t* data, uint8_t length);
+static bool Link(uint16_t credit);
+static uint8_t Frame(uint8_t* frame, uint8_t id, const uint8_t* payload, uint8_t length);
+static uint8_t CreditFrame(uint8_t* frame, uint8_t channel, uint16_t count);
+static bool TestNothingBeforeReset(void);
+static bool TestCreditToHost(void);
+static bool TestCreditFromHost(void);
+static bool TestRoundRobin(void);
+static bool TestResyncAfterDetach(void);
+static bool TestResyncAfterClose(void);
+
+static const TEST tests[] =
+{
+    {"nothing is sent before the host resets the link", &TestNothingBeforeReset},
+    {"the board sends no more than the host's credit", &TestCreditToHost},
+    {"the board grants back only what was read", &TestCreditFromHost},
+    {"a trickling channel is not starved by a saturated one", &TestRoundRobin},
+    {"a reset after a detach in mid frame is understood", &TestResyncAfterDetach},
+    {"a reset after DTR drops in mid frame is understood", &TestResyncAfterClose},
+};
+
+static LINK link;
+
+int main(void)
+{
+    uint8_t failures = 0;
+    uint8_t i;
+    
+    for(i = 0; i < (sizeof(tests) / sizeof(tests[0])); i++)
+    {
+        Reset();
+    
+        if(tests[i].run() == false)
+        {
+            printf("cdc_mux_test: FAILED %s\n", tests[i].name);
+            failures++;
+        }
+    }
+    
+    printf("cdc_mux_test: %u of %u passed\n", (unsigned)(i - failures), (unsigned)i);
+    
+    return (failures == 0u) ? 0 : 1;
+}
+
+//A freshly enumerated board with a host that has opened the port.
+static void Reset(void)
+{
+    USBDeviceState = CONFIGURED_STATE;
+    cdc_instance[CDC_MUX_CDC_INSTANCE].control_signal_bitmap.DTE_PRESENT = 1;
+    CDCInitEP();
+    CDC_MUX_Initialize();
+    (void)memset(&HOST_usb, 0, sizeof(HOST_usb));
+    (void)memset(&link, 0, sizeof(link));
+}
+
+//Runs the main loop once, then lets the host read the data endpoint and
+//sort the frames of the packet, if there was one.
+static void Pass(void)
+{
+    uint8_t packet[MAX_PACKET];
+    int16_t length;
+    uint8_t i = 0;
+    uint8_t id;
+    uint8_t count;
+    uint8_t channel;
+    
+    CDC_MUX_Tasks();
+    length = HOST_USB_In(CDC_DATA_EP, packet);
+    
+    //The board never splits a frame between packets.
+    while(i < length)
+    {
+        if((i + CDC_MUX_FRAME_HEADER_SIZE) > length)
+        {
+            link.malformed = true;
+            return;
+        }
+    
+        id = packet[i];
+        count = packet[i + 1u];
+        i += CDC_MUX_FRAME_HEADER_SIZE;
+        channel = id & (uint8_t)~CDC_MUX_CREDIT_FRAME;
+    
+        if(((i + count) > length) || ((id != CDC_MUX_RESET_FRAME) && (channel >= CDC_MUX_CHANNEL_COUNT)))
+        {
+            link.malformed = true;
+            return;
+        }
+    
+        if(id == CDC_MUX_RESET_FRAME)
+        {
+            link.resets++;
+        }
+        else if((id & CDC_MUX_CREDIT_FRAME) != 0u)
+        {
+            link.granted[channel] += (uint16_t)packet[i] | ((uint16_t)packet[i + 1u] << 8);
+        }
+        else
+        {
+            if((link.received[channel] + count) <= CAPTURE_SIZE)
+            {
+                (void)memcpy(&link.data[channel][link.received[channel]], &packet[i], count);
+            }
+    
+            link.received[channel] += count;
+    
+            if(count > link.longestData)
+            {
+                link.longestData = count;
+            }
+        }
+    
+        i += count;
+    }
+}
+
+//Writes a packet to the board and gives the main loop a pass to read it.
+static bool Send(const uint8_t* data, uint8_t length)
+{
+    if(HOST_USB_Out(CDC_DATA_EP, data, length) == false)
+    {
+        return false;
+    }
+    
+    Pass();
+    
+    return true;
+}
+
+//The host's reset, with credit for every channel, and the board's answer.
+static bool Link(uint16_t credit)
+{
+    uint8_t packet[MAX_PACKET];
+    uint8_t length;
+    uint8_t i;
+    
+    length = Frame(packet, CDC_MUX_RESET_FRAME, NULL, 0u);
+    
+    for(i = 0; i < CDC_MUX_CHANNEL_COUNT; i++)
+    {
+        length += CreditFrame(&packet[length], i, credit);
+    }
+    
+    if(Send(packet, length) == false)
+    {
+        return false;
+    }
+    
+    Pass();
+    
+    return link.resets == 1u;
+}
+
+static uint8_t Frame(uint8_t* frame, uint8_t id, const uint8_t* payload, uint8_t length)
+{
+    frame[0] = id;
+    frame[1] = length;
+    
+    if(length != 0u)
+    {
+        (void)memcpy(&frame[CDC_MUX_FRAME_HEADER_SIZE], payload, length);
+    }
+    
+    return CDC_MUX_FRAME_HEADER_SIZE + length;
+}
+
+static uint8_t CreditFrame(uint8_t* frame, uint8_t channel, uint16_t count)
+{
+    uint8_t payload[2];
+    
+    payload[0] = (uint8_t)count;
+    payload[1] = (uint8_t)(count >> 8);
+    
+    return Frame(frame, CDC_MUX_CREDIT_FRAME | channel, payload, sizeof(payload));
+}
+
+static bool TestNothingBeforeReset(void)
+{
+    uint8_t i;
+    
+    (void)CDC_MUX_Write(0u, (const uint8_t*)"early", 5u);
+    
+    for(i = 0; i < 10u; i++)
+    {
+        Pass();
+    }
+    
+    if((HOST_usb.packets != 0u) || (link.granted[0] != 0u))
+    {
+        return false;
+    }
+    
+    //The reset drops what was queued before it, and grants every FIFO.
+    if(Link(0u) == false)
+    {
+        return false;
+    }
+    
+    for(i = 0; i < CDC_MUX_CHANNEL_COUNT; i++)
+    {
+        if(link.granted[i] != RX_FIFO_SIZE)
+        {
+            return false;
+        }
+    }
+    
+    return (link.received[0] == 0u) && (CDC_MUX_GetWriteSpace(0u) != 0u) && (link.malformed == false);
+}
+
+static bool TestCreditToHost(void)
+{
+    uint8_t packet[MAX_PACKET];
+    uint8_t data[100];
+    uint8_t i;
+    
+    for(i = 0; i < sizeof(data); i++)
+    {
+        data[i] = i;
+    }
+    
+    if((Link(0u) == false) || (CDC_MUX_Write(1u, data, sizeof(data)) != sizeof(data)))
+    {
+        return false;
+    }
+    
+    //Nothing goes without credit, then exactly what was granted.
+    for(i = 0; i < 10u; i++)
+    {
+        Pass();
+    }
+    
+    if((link.received[1] != 0u) || (Send(packet, CreditFrame(packet, 1u, 20u)) == false))
+    {
+        return false;
+    }
+    
+    for(i = 0; i < 10u; i++)
+    {
+        Pass();
+    }
+    
+    if((link.received[1] != 20u) || (Send(packet, CreditFrame(packet, 1u, 30u)) == false))
+    {
+        return false;
+    }
+    
+    for(i = 0; i < 10u; i++)
+    {
+        Pass();
+    }
+    
+    return (link.received[1] == 50u) && (memcmp(link.data[1], data, 50u) == 0) &&
+           (link.received[0] == 0u) && (link.malformed == false);
+}
+
+static bool TestCreditFromHost(void)
+{
+    uint8_t packet[MAX_PACKET];
+    uint8_t data[RX_FIFO_SIZE];
+    uint8_t payload[32];
+    uint16_t sent = 0;
+    uint8_t i;
+    
+    if(Link(0u) == false)
+    {
+        return false;
+    }
+    
+    //Use up the whole grant on channel 3 while the application reads none.
+    (void)memset(payload, 'c', sizeof(payload));
+    
+    while(sent < link.granted[3])
+    {
+        if(Send(packet, Frame(packet, 3u, payload, sizeof(payload))) == false)
+        {
+            return false;
+        }
+    
+        sent += sizeof(payload);
+    }
+    
+    for(i = 0; i < 10u; i++)
+    {
+        Pass();
+    }
+    
+    if(link.granted[3] != RX_FIFO_SIZE)
+    {
+        return false;
+    }
+    
+    //Reading part of it grants that part back, and no more.
+    if(CDC_MUX_Read(3u, data, 40u) != 40u)
+    {
+        return false;
+    }
+    
+    for(i = 0; i < 10u; i++)
+    {
+        Pass();
+    }
+    
+    if(link.granted[3] != (RX_FIFO_SIZE + 40u))
+    {
+        return false;
+    }
+    
+    if(CDC_MUX_Read(3u, data, sizeof(data)) != (RX_FIFO_SIZE - 40u))
+    {
+        return false;
+    }
+    
+    for(i = 0; i < 10u; i++)
+    {
+        Pass();
+    }
+    
+    return (link.granted[3] == (2u * RX_FIFO_SIZE)) && (link.malformed == false);
+}
+
+//Channel 0 always has a full FIFO; channel 2 gets a few bytes a pass.
+static bool TestRoundRobin(void)
+{
+    uint8_t data[RX_FIFO_SIZE];
+    uint32_t trickled = 0;
+    uint16_t pass;
+    
+    (void)memset(data, 's', sizeof(data));
+    
+    if(Link(60000u) == false)
+    {
+        return false;
+    }
+    
+    for(pass = 0; pass < 500u; pass++)
+    {
+        (void)CDC_MUX_Write(0u, data, CDC_MUX_GetWriteSpace(0u));
+    
+        if(CDC_MUX_Write(2u, (const uint8_t*)"tick", 4u) != 4u)
+        {
+            return false;
+        }
+    
+        trickled += 4u;
+        Pass();
+    
+        //Each packet takes what channel 2 had, so it never backs up.
+        if((trickled - link.received[2]) > 4u)
+        {
+            return false;
+        }
+    }
+    
+    //Channel 0 still fills the rest of the packets, a quantum at a time.
+    return (link.longestData <= QUANTUM) && (link.received[0] > (400u * (MAX_PACKET - 16u))) &&
+           (link.malformed == false) && (HOST_usb.errors == 0u);
+}
+
+static bool TestResyncAfterDetach(void)
+{
+    uint8_t packet[MAX_PACKET];
+    uint8_t payload[10];
+    uint8_t data[8];
+    
+    (void)memset(payload, 0, sizeof(payload));
+    
+    if(Link(RX_FIFO_SIZE) == false)
+    {
+        return false;
+    }
+    
+    //Announces 40 bytes and sends 10, then the cable is pulled.
+    (void)Frame(packet, 2u, payload, sizeof(payload));
+    packet[1] = 40u;
+    
+    if(Send(packet, CDC_MUX_FRAME_HEADER_SIZE + sizeof(payload)) == false)
+    {
+        return false;
+    }
+    
+    USBDeviceState = DEFAULT_STATE;
+    Pass();
+    USBDeviceState = CONFIGURED_STATE;
+    CDCInitEP();
+    (void)memset(&link, 0, sizeof(link));
+    
+    if((Link(RX_FIFO_SIZE) == false) || (Send(packet, Frame(packet, 2u, (const uint8_t*)"hello", 5u)) == false))
+    {
+        return false;
+    }
+    
+    return (CDC_MUX_Read(2u, data, sizeof(data)) == 5u) && (memcmp(data, "hello", 5u) == 0) &&
+           (link.malformed == false);
+}
+
+static bool TestResyncAfterClose(void)
+{
+    uint8_t packet[MAX_PACKET];
+    uint8_t payload[10];
+    uint8_t data[8];
+    
+    (void)memset(payload, 0, sizeof(payload));
+    
+    if(Link(RX_FIFO_SIZE) == false)
+    {
+        return false;
+    }
+    
+    //Announces 40 bytes and sends 10, then the host program is closed.
+    (void)Frame(packet, 2u, payload, sizeof(payload));
+    packet[1] = 40u;
+    
+    if(Send(packet, CDC_MUX_FRAME_HEADER_SIZE + sizeof(payload)) == false)
+    {
+        return false;
+    }
+    
+    cdc_instance[CDC_MUX_CDC_INSTANCE].control_signal_bitmap.DTE_PRESENT = 0;
+    Pass();
+    cdc_instance[CDC_MUX_CDC_INSTANCE].control_signal_bitmap.DTE_PRESENT = 1;
+    (void)memset(&link, 0, sizeof(link));
+    
+    if((Link(RX_FIFO_SIZE) == false) || (Send(packet, Frame(packet, 2u, (const uint8_t*)"hello", 5u)) == false))
+    {
+        return false;
+    }
+    
+    return (CDC_MUX_Read(2u, data, sizeof(data)) == 5u) && (memcmp(data, "hello", 5u) == 0) &&
+           (link.malformed == false);
+}
@@ -0,0 +1,404 @@
+//Copyright 2016 Microchip Technology Inc. (www.microchip.com)
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+//Behaviour checks of usb_device_cdc.c, and of console.c on top of it,
+//against the BDT model of host_usb.c.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "mcc_generated_files/usb/usb.h"
+#include "mcc_generated_files/usb/usb_device_cdc.h"
+#include "console.h"
+#include "host.h"
+
+#define MAX_PACKET          CDC_DATA_IN_EP_SIZE
+#define DATA_INSTANCE       0u
+#define SERIAL_STATE_DSR    0x02u
+
+#if (CDC_INSTANCE_COUNT > 1)
+    #define CONSOLE_EP      CDC1_DATA_EP
+#else
+    #define CONSOLE_EP      CDC_DATA_EP
+#endif
+
+typedef struct
+{
+    const char* name;
+    bool (*run)(void);
+} TEST;
+
+static void Reset(void);
+static int16_t TakePacket(uint8_t* packet);
+static bool TestFullPacketEndsWithZlp(void);
+static bool TestResetDropsAcquiredBuffer(void);
+static bool TestResetDuringTxCopy(void);
+#if defined(USB_CDC_RX_RING_SIZE)
+static bool TestResetDuringRxCopy(void);
+#endif
+#if defined(USB_CDC_RX_FLOW_CONTROL)
+static bool TestFlowControl(void);
+static uint8_t TakeSerialStates(uint8_t* state);
+#endif
+#if (CDC_INSTANCE_COUNT > 1)
+static bool TestInstancesAreSeparate(void);
+#endif
+static void InterruptReset(void);
+
+static const TEST tests[] =
+{
+    {"a full console packet is followed by a ZLP", &TestFullPacketEndsWithZlp},
+    {"a buffer acquired before CDCInitEP() is not sent", &TestResetDropsAcquiredBuffer},
+    {"CDCInitEP() in a transmit copy sends nothing staged before it", &TestResetDuringTxCopy},
+#if defined(USB_CDC_RX_RING_SIZE)
+    {"CDCInitEP() in a receive ring copy keeps the ring in step", &TestResetDuringRxCopy},
+#endif
+#if defined(USB_CDC_RX_FLOW_CONTROL)
+    {"DSR drops at the ring's off level and comes back at its on level", &TestFlowControl},
+#endif
+#if (CDC_INSTANCE_COUNT > 1)
+    {"the two CDC functions keep their own transmit and receive state", &TestInstancesAreSeparate},
+#endif
+};
+
+static bool interruptOk;
+
+int main(void)
+{
+    uint8_t failures = 0;
+    uint8_t i;
+    
+    for(i = 0; i < (sizeof(tests) / sizeof(tests[0])); i++)
+    {
+        Reset();
+        
+        if(tests[i].run() == false)
+        {
+            printf("cdc_test: FAILED %s\n", tests[i].name);
+            failures++;
+        }
+    }
+    
+    printf("cdc_test: %u of %u passed\n", (unsigned)(i - failures), (unsigned)i);
+    
+    return (failures == 0u) ? 0 : 1;
+}
+
+static void Reset(void)
+{
+    CDCInitEP();
+    CONSOLE_Initialize();
+    CONSOLE_SetCoalescing(0u);
+    CONSOLE_SetRecordMode(false);
+    CONSOLE_SetSink(CONSOLE_SINK_TRACE, false, CONSOLE_LANE_INFO);
+    (void)memset(&HOST_usb, 0, sizeof(HOST_usb));
+    HOST_ticks = 0;
+    IEC5bits.USB1IE = 1;
+}
+
+//Runs the main loop once, then lets the host read the console endpoint.
+static int16_t TakePacket(uint8_t* packet)
+{
+    HOST_ticks++;
+    CONSOLE_Tasks();
+    
+    return HOST_USB_In(CONSOLE_EP, packet);
+}
+
+static bool TestFullPacketEndsWithZlp(void)
+{
+    uint8_t message[MAX_PACKET];
+    uint8_t packet[MAX_PACKET];
+    uint8_t i;
+    
+    (void)memset(message, '.', sizeof(message));
+    (void)CONSOLE_Write(message, sizeof(message));
+    
+    if(TakePacket(packet) != MAX_PACKET)
+    {
+        return false;
+    }
+    
+    //The main loop found nothing more to send; the ZLP must still go.
+    for(i = 0; i < 10u; i++)
+    {
+        if(TakePacket(packet) == 0)
+        {
+            return HOST_usb.errors == 0u;
+        }
+    }
+    
+    return false;
+}
+
+static bool TestResetDropsAcquiredBuffer(void)
+{
+    uint8_t packet[MAX_PACKET];
+    uint8_t* buffer = CDCTxAcquireBuffer(CONSOLE_CDC_INSTANCE);
+    
+    if(buffer == NULL)
+    {
+        return false;
+    }
+    
+    (void)memset(buffer, '!', 8u);
+    
+    //A bus reset, or the host setting the configuration again.
+    CDCInitEP();
+    CDCTxCommitBuffer(CONSOLE_CDC_INSTANCE, 8u);
+    CDCTxService(CONSOLE_CDC_INSTANCE);
+    
+    return (HOST_USB_In(CONSOLE_EP, packet) < 0) && (HOST_usb.errors == 0u);
+}
+
+static bool TestResetDuringTxCopy(void)
+{
+    uint8_t data[100];
+    uint8_t packet[MAX_PACKET];
+    
+    (void)memset(data, 'x', sizeof(data));
+    putUSBUSART(DATA_INSTANCE, data, sizeof(data));
+    
+    interruptOk = false;
+    HOST_copyHook = &InterruptReset;
+    CDCTxService(DATA_INSTANCE);
+    
+    if((interruptOk == false) || (HOST_USB_In(CDC_DATA_EP, packet) >= 0))
+    {
+        return false;
+    }
+    
+    putUSBUSART(DATA_INSTANCE, (uint8_t*)"after", 5u);
+    CDCTxService(DATA_INSTANCE);
+    
+    return (HOST_USB_In(CDC_DATA_EP, packet) == 5) && (memcmp(packet, "after", 5u) == 0) &&
+           (HOST_USB_In(CDC_DATA_EP, packet) < 0) && (HOST_usb.errors == 0u);
+}
+
+#if defined(USB_CDC_RX_RING_SIZE)
+static bool TestResetDuringRxCopy(void)
+{
+    uint8_t packet[MAX_PACKET];
+    uint8_t data[USB_CDC_RX_RING_SIZE];
+    uint8_t expected[USB_CDC_RX_RING_SIZE];
+    uint16_t count = 0;
+    uint8_t length;
+    uint8_t i;
+    
+    //Fills the ring, then both endpoint buffers.
+    for(i = 0; i < ((USB_CDC_RX_RING_SIZE / MAX_PACKET) + 2u); i++)
+    {
+        (void)memset(packet, 'A' + i, sizeof(packet));
+        
+        if(HOST_USB_Out(CDC_DATA_EP, packet, sizeof(packet)) == false)
+        {
+            return false;
+        }
+    }
+    
+    //Reading a packet's worth makes room for the first held one, and
+    //CDCInitEP() arrives while it is copied into the ring.
+    if(CDCRxAcquireBuffer(DATA_INSTANCE, &length) == NULL)
+    {
+        return false;
+    }
+    
+    interruptOk = false;
+    HOST_copyHook = &InterruptReset;
+    CDCRxReleaseBuffer(DATA_INSTANCE);
+    
+    //The held packets are dropped; what reached the ring is kept.
+    (void)memset(packet, '!', sizeof(packet));
+    
+    if((interruptOk == false) || (HOST_USB_Out(CDC_DATA_EP, packet, sizeof(packet)) == false))
+    {
+        return false;
+    }
+    
+    (void)memset(expected, 'A' + 1, MAX_PACKET);
+    (void)memset(&expected[MAX_PACKET], 'A' + 2, MAX_PACKET);
+    (void)memset(&expected[2u * MAX_PACKET], 'A' + 3, MAX_PACKET);
+    (void)memset(&expected[3u * MAX_PACKET], '!', MAX_PACKET);
+    
+    while((length = getsUSBUSART(DATA_INSTANCE, &data[count], MAX_PACKET)) != 0u)
+    {
+        count += length;
+        
+        if(count > (USB_CDC_RX_RING_SIZE - MAX_PACKET))
+        {
+            break;
+        }
+    }
+    
+    return (count == (4u * MAX_PACKET)) && (memcmp(data, expected, count) == 0) && (HOST_usb.errors == 0u);
+}
+#endif
+
+#if defined(USB_CDC_RX_FLOW_CONTROL)
+static bool TestFlowControl(void)
+{
+    uint8_t packet[MAX_PACKET];
+    uint8_t state = 0;
+    uint16_t level = 0;
+    uint8_t count;
+    
+    //Earlier tests may have left bytes in the ring.
+    while(getsUSBUSART(DATA_INSTANCE, packet, sizeof(packet)) != 0u)
+    {
+    }
+    
+    CDCRxClearThrottleCount(DATA_INSTANCE);
+    
+    if((TakeSerialStates(&state) == 0u) || ((state & SERIAL_STATE_DSR) == 0u))
+    {
+        return false;
+    }
+    
+    //Nothing is sent below the off level; reaching it drops DSR.
+    (void)memset(packet, 'f', sizeof(packet));
+    
+    while(level < USB_CDC_RX_FLOW_OFF_LEVEL)
+    {
+        if(HOST_USB_Out(CDC_DATA_EP, packet, sizeof(packet)) == false)
+        {
+            return false;
+        }
+        
+        level += sizeof(packet);
+        count = TakeSerialStates(&state);
+        
+        if((level < USB_CDC_RX_FLOW_OFF_LEVEL) && (count != 0u))
+        {
+            return false;
+        }
+    }
+    
+    if((count != 1u) || ((state & SERIAL_STATE_DSR) != 0u) || (CDCRxGetThrottleCount(DATA_INSTANCE) != 1u))
+    {
+        return false;
+    }
+    
+    //DSR stays low between the levels and comes back at the on level.
+    while(level > USB_CDC_RX_FLOW_ON_LEVEL)
+    {
+        if(getsUSBUSART(DATA_INSTANCE, packet, 16u) != 16u)
+        {
+            return false;
+        }
+        
+        level -= 16u;
+        count = TakeSerialStates(&state);
+        
+        if((level > USB_CDC_RX_FLOW_ON_LEVEL) && (count != 0u))
+        {
+            return false;
+        }
+    }
+    
+    return (count == 1u) && ((state & SERIAL_STATE_DSR) != 0u) &&
+           (CDCRxGetThrottleCount(DATA_INSTANCE) == 1u) && (HOST_usb.errors == 0u);
+}
+
+//Reads every notification waiting on the data port's interrupt endpoint,
+//and returns how many SERIAL_STATE notifications there were, with the serial
+//state of the last one in state.
+static uint8_t TakeSerialStates(uint8_t* state)
+{
+    uint8_t packet[MAX_PACKET];
+    SERIAL_STATE_NOTIFICATION notification;
+    uint8_t count = 0;
+    
+    while(HOST_USB_In(CDC_COMM_EP, packet) == (int16_t)sizeof(notification))
+    {
+        (void)memcpy(&notification, packet, sizeof(notification));
+        
+        if(notification.bNotification == SERIAL_STATE)
+        {
+            *state = notification.SerialState.byte;
+            count++;
+        }
+    }
+    
+    return count;
+}
+#endif
+
+//The bus is reset, or the host sets the configuration again, while the main
+//loop is copying a packet with the USB interrupt enabled.
+static void InterruptReset(void)
+{
+    HOST_copyHook = NULL;
+    interruptOk = (IEC5bits.USB1IE == 1u);
+    CDCInitEP();
+}
+
+#if (CDC_INSTANCE_COUNT > 1)
+//Data sent to, and written on, one function must only ever show up on its
+//own endpoints, and one function being busy must not hold up the other.
+static bool TestInstancesAreSeparate(void)
+{
+    uint8_t data[] = "to the data port";
+    uint8_t console[] = "to the console";
+    uint8_t packet[MAX_PACKET];
+    uint8_t length;
+    
+    //A receive ring keeps what an earlier test left in it across CDCInitEP().
+    while((getsUSBUSART(DATA_INSTANCE, packet, sizeof(packet)) != 0u) ||
+          (getsUSBUSART(CONSOLE_CDC_INSTANCE, packet, sizeof(packet)) != 0u))
+    {
+    }
+    
+    if((HOST_USB_Out(CDC_DATA_EP, (const uint8_t*)"from the data port", 18u) == false) ||
+       (HOST_USB_Out(CDC1_DATA_EP, (const uint8_t*)"from the console", 16u) == false))
+    {
+        return false;
+    }
+    
+    length = getsUSBUSART(CONSOLE_CDC_INSTANCE, packet, sizeof(packet));
+    
+    if((length != 16u) || (memcmp(packet, "from the console", 16u) != 0))
+    {
+        return false;
+    }
+    
+    length = getsUSBUSART(DATA_INSTANCE, packet, sizeof(packet));
+    
+    if((length != 18u) || (memcmp(packet, "from the data port", 18u) != 0) ||
+       (getsUSBUSART(CONSOLE_CDC_INSTANCE, packet, sizeof(packet)) != 0u))
+    {
+        return false;
+    }
+    
+    //Both staged before either is serviced.
+    putUSBUSART(DATA_INSTANCE, data, sizeof(data) - 1u);
+    
+    if(USBUSARTIsTxTrfReady(CONSOLE_CDC_INSTANCE) == false)
+    {
+        return false;
+    }
+    
+    putUSBUSART(CONSOLE_CDC_INSTANCE, console, sizeof(console) - 1u);
+    CDCTxService(CONSOLE_CDC_INSTANCE);
+    CDCTxService(DATA_INSTANCE);
+    
+    if((HOST_USB_In(CONSOLE_EP, packet) != (int16_t)(sizeof(console) - 1u)) ||
+       (memcmp(packet, console, sizeof(console) - 1u) != 0))
+    {
+        return false;
+    }
+    
+    return (HOST_USB_In(CDC_DATA_EP, packet) == (int16_t)(sizeof(data) - 1u)) &&
+           (memcmp(packet, data, sizeof(data) - 1u) == 0) && (HOST_usb.errors == 0u);
+}
+#endif
@@ -0,0 +1,158 @@
+//Copyright 2016 Microchip Technology Inc. (www.microchip.com)
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+//CDC packets per KB of console output for a few coalescing deadlines, with
+//console.c on usb_device_cdc.c and the BDT model of host_usb.c.  The main
+//loop runs PASSES_PER_MS times per 1ms tick and queues a 6 to 20 byte line
+//on about one pass in three; the host reads the console endpoint after
+//every pass.  The worst time from queuing a line to the host having all of
+//it is shown too, and the stream is checked end to end.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "mcc_generated_files/usb/usb.h"
+#include "mcc_generated_files/usb/usb_device_cdc.h"
+#include "console.h"
+#include "host.h"
+
+#define PASS_COUNT          200000ul
+#define PASSES_PER_MS       10u
+#define STREAM_SIZE         (PASS_COUNT * 8u)
+#define MESSAGE_QUEUE_SIZE  256u
+
+#if (CDC_INSTANCE_COUNT > 1)
+    #define CONSOLE_EP      CDC1_DATA_EP
+#else
+    #define CONSOLE_EP      CDC_DATA_EP
+#endif
+
+//End of each line in the stream, and the tick it was queued at.
+typedef struct
+{
+    uint32_t end;
+    uint32_t tick;
+} MESSAGE;
+
+static const uint16_t deadlines[] = {0u, 1u, 2u, 4u};
+
+static uint8_t stream[STREAM_SIZE];
+static uint8_t received[STREAM_SIZE];
+static MESSAGE messages[MESSAGE_QUEUE_SIZE];
+
+static uint32_t MakeLine(uint8_t* line, uint32_t* seed);
+static uint32_t GetRandom(uint32_t* seed);
+
+int main(void)
+{
+    uint8_t line[32];
+    uint32_t seed;
+    uint32_t queued;
+    uint32_t count;
+    uint32_t packets;
+    uint32_t pass;
+    uint32_t latency;
+    uint32_t worst;
+    uint16_t head;
+    uint16_t tail;
+    int16_t length;
+    uint8_t i;
+    
+    printf("coalesce_bench: %lu main loop passes, %u per ms, a 6 to 20 byte line every ~3 passes\n",
+           (unsigned long)PASS_COUNT, PASSES_PER_MS);
+    printf("  %-10s  %12s  %16s\n", "deadline", "packets/KB", "worst latency");
+    
+    for(i = 0; i < (sizeof(deadlines) / sizeof(deadlines[0])); i++)
+    {
+        CDCInitEP();
+        CONSOLE_Initialize();
+        CONSOLE_SetCoalescing(deadlines[i]);
+        CONSOLE_SetSink(CONSOLE_SINK_TRACE, false, CONSOLE_LANE_INFO);
+        HOST_ticks = 0;
+        seed = 7;
+        queued = 0;
+        count = 0;
+        packets = 0;
+        worst = 0;
+        head = 0;
+        tail = 0;
+    
+        for(pass = 0; pass < (PASS_COUNT + (100u * PASSES_PER_MS)); pass++)
+        {
+            if((pass % PASSES_PER_MS) == 0u)
+            {
+                HOST_ticks++;
+            }
+    
+            if((pass < PASS_COUNT) && ((GetRandom(&seed) % 3u) == 0u))
+            {
+                length = (int16_t)MakeLine(line, &seed);
+    
+                if(CONSOLE_Write(line, (uint16_t)length) == true)
+                {
+                    (void)memcpy(&stream[queued], line, (size_t)length);
+                    queued += (uint32_t)length;
+                    messages[tail % MESSAGE_QUEUE_SIZE].end = queued;
+                    messages[tail % MESSAGE_QUEUE_SIZE].tick = HOST_ticks;
+                    tail++;
+                }
+            }
+    
+            CONSOLE_Tasks();
+    
+            while((length = HOST_USB_In(CONSOLE_EP, &received[count])) >= 0)
+            {
+                count += (uint32_t)length;
+                packets += (length != 0) ? 1u : 0u;
+            }
+    
+            while((head != tail) && (messages[head % MESSAGE_QUEUE_SIZE].end <= count))
+            {
+                latency = HOST_ticks - messages[head % MESSAGE_QUEUE_SIZE].tick;
+                worst = (latency > worst) ? latency : worst;
+                head++;
+            }
+        }
+    
+        if((count != queued) || (memcmp(stream, received, queued) != 0) || (HOST_usb.errors != 0u))
+        {
+            printf("coalesce_bench: FAILED, %lu of %lu bytes arrived intact\n", (unsigned long)count,
+                   (unsigned long)queued);
+            return 1;
+        }
+    
+        printf("  %u ms%6s  %12.1f  %13lu ms\n", (unsigned)deadlines[i], "", (packets * 1024.0) / count,
+               (unsigned long)worst);
+    }
+    
+    return 0;
+}
+
+static uint32_t MakeLine(uint8_t* line, uint32_t* seed)
+{
+    uint32_t length = 6u + (GetRandom(seed) % 15u);
+    
+    (void)memset(line, 'a' + (int)length, length - 2u);
+    line[length - 2u] = '\r';
+    line[length - 1u] = '\n';
+    
+    return length;
+}
+
+static uint32_t GetRandom(uint32_t* seed)
+{
+    *seed = (*seed * 1103515245ul) + 12345ul;
+    
+    return *seed >> 8;
+}
@@ -0,0 +1,495 @@
+//Copyright 2016 Microchip Technology Inc. (www.microchip.com)
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+//Behaviour checks of console.c through its public API, with the stand-in
+//CDC driver of host_cdc.c capturing what would go to the host.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "mcc_generated_files/usb/usb_device_cdc.h"
+#include "console.h"
+#include "console_log.h"
+#include "console_trace.h"
+#include "host.h"
+
+#define CAPTURE_SIZE    65536u
+
+typedef struct
+{
+    const char* name;
+    bool (*run)(void);
+} TEST;
+
+static uint8_t capture[CAPTURE_SIZE];
+static uint16_t interruptedEnd;
+static bool interruptOk;
+
+static void Reset(void);
+static void Drain(void);
+static bool IsCaptured(const char* text);
+static uint32_t CountFrames(void);
+static uint32_t DecodeFrame(uint8_t* output, uint32_t size);
+static bool TestBlockDoesNotReenter(void);
+static bool TestLogIsOneRecord(void);
+static bool TestTraceWriteInterrupted(void);
+static bool TestPrintfIsOneRecord(void);
+static bool TestPrintfAllOrNothing(void);
+static bool TestTailIsCoalesced(void);
+static bool TestPrintfDropOldest(void);
+static bool TestPrintfNullString(void);
+static bool TestFaultWriteInterrupted(void);
+static void InterruptFaultWrite(void);
+static bool TestFaultRecord(void);
+static bool TestStatsReportFits(void);
+static void InterruptTraceWrite(void);
+
+static const TEST tests[] =
+{
+    {"BLOCK does not wait again from inside its wait", &TestBlockDoesNotReenter},
+    {"a text mode CONSOLE_Log() is one record", &TestLogIsOneRecord},
+    {"trace writes copy unmasked and publish in order", &TestTraceWriteInterrupted},
+    {"a record mode CONSOLE_Printf() is one record", &TestPrintfIsOneRecord},
+    {"ALL_OR_NOTHING drops a record mode CONSOLE_Printf() whole", &TestPrintfAllOrNothing},
+    {"the tail of a partly sent message waits for the deadline", &TestTailIsCoalesced},
+    {"DROP_OLDEST makes room for a whole text mode CONSOLE_Printf()", &TestPrintfDropOldest},
+    {"CONSOLE_Printf() prints a NULL %s as (null)", &TestPrintfNullString},
+    {"fault lane writes nest and other paths refuse the lane", &TestFaultWriteInterrupted},
+    {"a record mode CONSOLE_PrintFault() is one record", &TestFaultRecord},
+    {"the shell's stats report fits the info lane", &TestStatsReportFits},
+};
+
+int main(void)
+{
+    uint8_t failures = 0;
+    uint8_t i;
+    
+    for(i = 0; i < (sizeof(tests) / sizeof(tests[0])); i++)
+    {
+        Reset();
+        
+        if(tests[i].run() == false)
+        {
+            printf("console_test: FAILED %s\n", tests[i].name);
+            failures++;
+        }
+    }
+    
+    printf("console_test: %u of %u passed\n", (unsigned)(i - failures), (unsigned)i);
+    
+    return (failures == 0u) ? 0 : 1;
+}
+
+static void Reset(void)
+{
+    CONSOLE_Initialize();
+    CONSOLE_SetOverflowPolicy(CONSOLE_OVERFLOW_DROP_NEWEST, 0u);
+    CONSOLE_SetCoalescing(0u);
+    CONSOLE_SetRecordMode(false);
+    CONSOLE_SetSink(CONSOLE_SINK_TRACE, false, CONSOLE_LANE_INFO);
+    CONSOLE_ClearStatistics();
+    HOST_CDC_Reset(capture, sizeof(capture));
+    HOST_ticks = 0;
+    
+    //Forget the previous test's last message.
+    (void)CONSOLE_Print("");
+    CONSOLE_Tasks();
+    HOST_CDC_Reset(capture, sizeof(capture));
+}
+
+static void Drain(void)
+{
+    uint8_t i;
+    
+    HOST_cdcOutput.stalled = false;
+    
+    for(i = 0; i < 100u; i++)
+    {
+        HOST_ticks++;
+        CONSOLE_Tasks();
+    }
+}
+
+static bool IsCaptured(const char* text)
+{
+    size_t length = strlen(text);
+    uint32_t i;
+    
+    for(i = 0; (i + length) <= HOST_cdcOutput.bytes; i++)
+    {
+        if(memcmp(&capture[i], text, length) == 0)
+        {
+            return true;
+        }
+    }
+    
+    return false;
+}
+
+static uint32_t CountFrames(void)
+{
+    uint32_t frames = 0;
+    uint32_t i;
+    
+    for(i = 0; i < HOST_cdcOutput.bytes; i++)
+    {
+        if(capture[i] == 0u)
+        {
+            frames++;
+        }
+    }
+    
+    return frames;
+}
+
+//COBS decodes the first frame captured; returns its length, 0 if malformed.
+static uint32_t DecodeFrame(uint8_t* output, uint32_t size)
+{
+    uint32_t length = 0;
+    uint32_t i = 0;
+    uint8_t code;
+    uint8_t j;
+    
+    while((i < HOST_cdcOutput.bytes) && (capture[i] != 0u))
+    {
+        code = capture[i++];
+        
+        for(j = 1; j < code; j++)
+        {
+            if((i >= HOST_cdcOutput.bytes) || (capture[i] == 0u) || (length >= size))
+            {
+                return 0;
+            }
+            
+            output[length++] = capture[i++];
+        }
+        
+        if((code != 0xFFu) && (i < HOST_cdcOutput.bytes) && (capture[i] != 0u))
+        {
+            if(length >= size)
+            {
+                return 0;
+            }
+            
+            output[length++] = 0;
+        }
+    }
+    
+    return length;
+}
+
+//A repeat summary due while a BLOCK writer waits must not be queued from
+//inside the wait, where it would wait (and drop) in turn.
+static bool TestBlockDoesNotReenter(void)
+{
+    static const uint8_t chunk[64] = {'x'};
+    CONSOLE_STATISTICS statistics;
+    uint32_t start;
+    
+    (void)CONSOLE_Admit(1u, 0x1234u);
+    (void)CONSOLE_Admit(1u, 0x1234u);
+    HOST_ticks = 2000u;
+    
+    HOST_cdcOutput.stalled = true;
+    
+    while(CONSOLE_Write(chunk, sizeof(chunk)) == true)
+    {
+    }
+    
+    CONSOLE_ClearStatistics();
+    CONSOLE_SetOverflowPolicy(CONSOLE_OVERFLOW_BLOCK, 10u);
+    start = HOST_ticks;
+    
+    if(CONSOLE_Write(chunk, sizeof(chunk)) == true)
+    {
+        return false;
+    }
+    
+    CONSOLE_GetStatistics(&statistics);
+    
+    if(((HOST_ticks - start) > 11u) || (statistics.policy[CONSOLE_OVERFLOW_BLOCK].droppedMessages != 1u))
+    {
+        return false;
+    }
+    
+    Drain();
+    
+    return IsCaptured("last message repeated 1 times\r\n");
+}
+
+//The literals, the numbers and the references to the format string of one
+//message must reach the host as a single frame, header first.
+static bool TestLogIsOneRecord(void)
+{
+    static const char text[] = "policy 1: 200 bytes, 3 messages dropped\r\n";
+    uint8_t frame[256];
+    uint32_t length;
+    
+    CONSOLE_SetRecordMode(true);
+    
+    if(CONSOLE_LOG3(CONSOLE_LOG_SHELL_DROPS, 1u, 200u, 3u) == false)
+    {
+        return false;
+    }
+    
+    Drain();
+    length = DecodeFrame(frame, sizeof(frame));
+    
+    return (CountFrames() == 1u) && (length == (7u + sizeof(text) - 1u)) &&
+           (frame[6] == (uint8_t)CONSOLE_LANE_INFO) && (memcmp(&frame[7], text, sizeof(text) - 1u) == 0);
+}
+
+//An interrupt writing to the trace while the main loop copies its own write
+//in: the copy must run unmasked, and neither write may show until both are
+//complete, in the order their space was reserved.
+static bool TestTraceWriteInterrupted(void)
+{
+    uint8_t text[16];
+    uint16_t position = CONSOLE_TRACE_GetEnd();
+    uint16_t length;
+    
+    interruptedEnd = position;
+    interruptOk = false;
+    HOST_copyHook = &InterruptTraceWrite;
+    (void)CONSOLE_TRACE_Write((const uint8_t*)"outer;", 6u);
+    HOST_copyHook = NULL;
+    
+    length = CONSOLE_TRACE_Read(&position, text, sizeof(text));
+    
+    return interruptOk && (length == 12u) && (memcmp(text, "outer;inner;", 12u) == 0);
+}
+
+static void InterruptTraceWrite(void)
+{
+    HOST_copyHook = NULL;
+    interruptOk = (SRbits.IPL == 0u);
+    (void)CONSOLE_TRACE_Write((const uint8_t*)"inner;", 6u);
+    interruptOk = interruptOk && (CONSOLE_TRACE_GetEnd() == interruptedEnd);
+}
+
+static bool TestPrintfIsOneRecord(void)
+{
+    char text[128];
+    uint8_t frame[256];
+    uint32_t length;
+    int count;
+    
+    count = snprintf(text, sizeof(text), "%s=%u, %d, %x|%-6s|%05u %c\r\n", "a somewhat long name", 40000u, -123, 0xBEEFu,
+                     "ab", 42u, '!');
+    CONSOLE_SetRecordMode(true);
+    
+    if(CONSOLE_Printf("%s=%u, %d, %x|%-6s|%05u %c\r\n", "a somewhat long name", 40000u, -123, 0xBEEFu, "ab", 42u, '!') == false)
+    {
+        return false;
+    }
+    
+    Drain();
+    length = DecodeFrame(frame, sizeof(frame));
+    
+    return (CountFrames() == 1u) && (length == (7u + (uint32_t)count)) && (memcmp(&frame[7], text, (size_t)count) == 0);
+}
+
+//With room for a 32 byte piece of the message but not for all of it,
+//nothing of it may reach the host.
+static bool TestPrintfAllOrNothing(void)
+{
+    static const uint8_t chunk[64] = {'x'};
+    CONSOLE_STATISTICS statistics;
+    uint8_t i;
+    
+    CONSOLE_SetRecordMode(true);
+    CONSOLE_SetOverflowPolicy(CONSOLE_OVERFLOW_ALL_OR_NOTHING, 0u);
+    HOST_cdcOutput.stalled = true;
+    
+    //13 frames of 73 bytes leave 75 of the info lane's 1024 free.
+    for(i = 0; i < 13u; i++)
+    {
+        if(CONSOLE_Write(chunk, sizeof(chunk)) == false)
+        {
+            return false;
+        }
+    }
+    
+    CONSOLE_ClearStatistics();
+    
+    if(CONSOLE_Printf("%s %s %u\r\n", "0123456789012345678901234567890123456789",
+                      "0123456789012345678901234567890123456789", 12345u) == true)
+    {
+        return false;
+    }
+    
+    CONSOLE_GetStatistics(&statistics);
+    Drain();
+    
+    return (CountFrames() == 13u) &&
+           (statistics.policy[CONSOLE_OVERFLOW_ALL_OR_NOTHING].droppedMessages == 1u) &&
+           (statistics.policy[CONSOLE_OVERFLOW_ALL_OR_NOTHING].droppedBytes == 89u);
+}
+
+//The last 6 bytes of a 70 byte message, left in a partly sent segment, are
+//held for the coalescing deadline like any other short packet.
+static bool TestTailIsCoalesced(void)
+{
+    static const uint8_t message[70] = {'x'};
+    uint32_t sent[3];
+    uint8_t i;
+    
+    CONSOLE_SetCoalescing(2u);
+    (void)CONSOLE_Write(message, sizeof(message));
+    
+    for(i = 0; i < 3u; i++)
+    {
+        CONSOLE_Tasks();
+        sent[i] = HOST_cdcOutput.bytes;
+        HOST_ticks++;
+    }
+    
+    return (sent[0] == 64u) && (sent[1] == 64u) && (sent[2] == sizeof(message));
+}
+
+//A full lane must give up its oldest messages for a Printf as it does for
+//a write, rather than truncating the Printf to the space already free.
+static bool TestPrintfDropOldest(void)
+{
+    static const uint8_t chunk[64] = {'x'};
+    CONSOLE_STATISTICS statistics;
+    
+    HOST_cdcOutput.stalled = true;
+    
+    while(CONSOLE_Write(chunk, sizeof(chunk)) == true)
+    {
+    }
+    
+    CONSOLE_ClearStatistics();
+    CONSOLE_SetOverflowPolicy(CONSOLE_OVERFLOW_DROP_OLDEST, 0u);
+    
+    if(CONSOLE_Printf("%s %s %u\r\n", "0123456789012345678901234567890123456789",
+                      "0123456789012345678901234567890123456789", 12345u) == false)
+    {
+        return false;
+    }
+    
+    CONSOLE_GetStatistics(&statistics);
+    Drain();
+    
+    return IsCaptured("0123456789012345678901234567890123456789 "
+                      "0123456789012345678901234567890123456789 12345\r\n") &&
+           (statistics.policy[CONSOLE_OVERFLOW_DROP_OLDEST].droppedMessages == 2u);
+}
+
+static bool TestPrintfNullString(void)
+{
+    //Hidden from the compiler's format check, which would warn about it.
+    const char* volatile text = NULL;
+    
+    if(CONSOLE_Printf("[%s]\r\n", text) == false)
+    {
+        return false;
+    }
+    
+    Drain();
+    
+    return IsCaptured("[(null)]\r\n");
+}
+
+//A fault message from an interrupt that lands in the middle of another
+//one's copy must queue behind it, not over it.
+static bool TestFaultWriteInterrupted(void)
+{
+    bool outer;
+    
+    if((CONSOLE_PrintLane(CONSOLE_LANE_FAULT, "lane\r\n") == true) ||
+       (CONSOLE_PrintfLane(CONSOLE_LANE_FAULT, "%s\r\n", "printf") == true) ||
+       (CONSOLE_WriteSegment(CONSOLE_LANE_FAULT, (const uint8_t*)"segment\r\n", 9u, CONSOLE_MEMORY_RAM) == true))
+    {
+        return false;
+    }
+    
+    interruptOk = false;
+    HOST_copyHook = &InterruptFaultWrite;
+    outer = CONSOLE_PrintFault("outer fault\r\n");
+    HOST_copyHook = NULL;
+    
+    Drain();
+    
+    return outer && interruptOk && IsCaptured("outer fault\r\ninner fault\r\n") &&
+           (IsCaptured("lane") == false) && (IsCaptured("printf") == false) && (IsCaptured("segment") == false);
+}
+
+static void InterruptFaultWrite(void)
+{
+    HOST_copyHook = NULL;
+    interruptOk = (SRbits.IPL == 0u);
+    interruptOk = interruptOk && CONSOLE_PrintFault("inner fault\r\n");
+}
+
+static bool TestFaultRecord(void)
+{
+    static const char text[] = "fault";
+    uint8_t frame[256];
+    uint32_t length;
+    
+    CONSOLE_SetRecordMode(true);
+    
+    if(CONSOLE_PrintFault(text) == false)
+    {
+        return false;
+    }
+    
+    Drain();
+    length = DecodeFrame(frame, sizeof(frame));
+    
+    return (CountFrames() == 1u) && (length == (7u + sizeof(text) - 1u)) &&
+           (frame[6] == (uint8_t)CONSOLE_LANE_FAULT) && (memcmp(&frame[7], text, sizeof(text) - 1u) == 0);
+}
+
+//The stats command's report as shell.c queues it, with every build option
+//on and the widest numbers, while the host takes nothing.
+static bool TestStatsReportFits(void)
+{
+    const uint32_t wide = 4000000000u;
+    bool result = true;
+    uint8_t i;
+    
+    HOST_cdcOutput.stalled = true;
+    
+    result &= CONSOLE_Write((const uint8_t*)"stats\r", 6u);
+    result &= CONSOLE_PrintConst("\r\n");
+    
+    for(i = 0; i < (uint8_t)CONSOLE_OVERFLOW_POLICY_COUNT; i++)
+    {
+        result &= CONSOLE_LOG3(CONSOLE_LOG_SHELL_DROPS, i, wide, wide);
+    }
+    
+    for(i = 0; i < (uint8_t)CONSOLE_LANE_COUNT; i++)
+    {
+        result &= CONSOLE_LOG2(CONSOLE_LOG_SHELL_HIGH_WATER, i, 1024u);
+    }
+    
+    result &= CONSOLE_LOG2(CONSOLE_LOG_SHELL_SUPPRESSED, wide, wide);
+    
+    for(i = CONSOLE_SINK_UART; i < (uint8_t)CONSOLE_SINK_COUNT; i++)
+    {
+        result &= CONSOLE_LOG2(CONSOLE_LOG_SHELL_SINK_DROPS, i, wide);
+    }
+    
+    result &= CONSOLE_LOG2(CONSOLE_LOG_SHELL_RX_HIGH_WATER, 256u, 256u);
+    result &= CONSOLE_LOG1(CONSOLE_LOG_SHELL_RX_THROTTLED, wide);
+    result &= CONSOLE_LOG1(CONSOLE_LOG_SHELL_MASKED, 65535u);
+    result &= CONSOLE_LOG2(CONSOLE_LOG_SHELL_COPY, 65535u, 65535u);
+    
+    Drain();
+    
+    return result && IsCaptured("64 byte packet copy: 65535 timer counts by DMA_COPY_Copy(), 65535 by memcpy()\r\n");
+}
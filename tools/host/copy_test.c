@@ -0,0 +1,94 @@
+//Copyright 2016 Microchip Technology Inc. (www.microchip.com)
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+//Counts the bytes the console copies for each byte it sends.  console.c is
+//built with -Dmemcpy=HOST_Memcpy here, so its memcpy() calls are counted
+//along with DMA_COPY_Copy().  The original console copied each byte three
+//times: into its FIFO, out into a packet buffer, and from there into the
+//endpoint buffer.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "mcc_generated_files/usb/usb_device_cdc.h"
+#include "console.h"
+#include "host.h"
+
+#define MESSAGE_COUNT   10000u
+
+static const char constText[] = "a constant message queued by reference\r\n";
+
+static bool Check(const char* name, uint32_t expectedCopies);
+
+int main(void)
+{
+    char message[64];
+    bool passed = true;
+    uint32_t i;
+    
+    CONSOLE_Initialize();
+    CONSOLE_SetCoalescing(0u);
+    CONSOLE_SetSink(CONSOLE_SINK_TRACE, false, CONSOLE_LANE_INFO);
+    
+    //RAM data: into the lane FIFO, then straight into the endpoint buffer.
+    HOST_CDC_Reset(NULL, 0u);
+    HOST_copiedBytes = 0;
+    
+    for(i = 0; i < MESSAGE_COUNT; i++)
+    {
+        (void)snprintf(message, sizeof(message), "message %lu of the copy test\r\n", (unsigned long)i);
+        (void)CONSOLE_Write((const uint8_t*)message, (uint16_t)strlen(message));
+        CONSOLE_Tasks();
+    }
+    
+    passed &= Check("CONSOLE_Write", 2u);
+    
+    //Formatted straight into the lane FIFO.
+    HOST_CDC_Reset(NULL, 0u);
+    HOST_copiedBytes = 0;
+    
+    for(i = 0; i < MESSAGE_COUNT; i++)
+    {
+        (void)CONSOLE_Printf("message %lu of the copy test\r\n", (unsigned long)i);
+        CONSOLE_Tasks();
+    }
+    
+    passed &= Check("CONSOLE_Printf", 2u);
+    
+    //Constants are only copied into the endpoint buffer.
+    HOST_CDC_Reset(NULL, 0u);
+    HOST_copiedBytes = 0;
+    
+    for(i = 0; i < MESSAGE_COUNT; i++)
+    {
+        (void)CONSOLE_PrintConst(constText);
+        CONSOLE_Tasks();
+    }
+    
+    passed &= Check("CONSOLE_PrintConst", 1u);
+    
+    return (passed == true) ? 0 : 1;
+}
+
+static bool Check(const char* name, uint32_t expectedCopies)
+{
+    bool passed = (HOST_cdcOutput.bytes != 0u) && (HOST_copiedBytes == (expectedCopies * HOST_cdcOutput.bytes));
+    
+    printf("copy_test: %-18s %7lu bytes sent, %7lu copied, %.2f copies per byte (expected %lu)%s\n",
+           name, (unsigned long)HOST_cdcOutput.bytes, (unsigned long)HOST_copiedBytes,
+           (HOST_cdcOutput.bytes != 0u) ? ((double)HOST_copiedBytes / HOST_cdcOutput.bytes) : 0.0,
+           (unsigned long)expectedCopies, (passed == true) ? "" : "  FAILED");
+    
+    return passed;
+}
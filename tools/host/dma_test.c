@@ -0,0 +1,174 @@
+//Copyright 2016 Microchip Technology Inc. (www.microchip.com)
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+//Functional checks of dma_copy.c against the DMA model of host_dma.c: every
+//copy must come out as memcpy() would make it, through the channel when it
+//can reach both areas and the copy is long enough, and through the CPU
+//otherwise.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "dma_copy.h"
+#include "host.h"
+
+#define SOURCE_ADDRESS      0x1000u
+#define DESTINATION_ADDRESS 0x2000u
+#define CONSTANT_ADDRESS    0x8000u
+#define GUARD_SIZE          4u
+#define GUARD               0xEEu
+#define MAX_LENGTH          130u
+#define PACKET_SIZE         64u
+
+typedef struct
+{
+    const char* name;
+    bool (*run)(void);
+} TEST;
+
+static bool Copy(uint16_t destination, uint16_t source, uint16_t length, uint32_t blocks);
+static bool TestEveryLengthAndAlignment(void);
+static bool TestPacketTransfers(void);
+static bool TestConstantsUseCpu(void);
+static bool TestPastHighLimitUsesCpu(void);
+static bool TestInterruptUsesCpu(void);
+static bool TestStuckChannelIsNotUsed(void);
+static void InterruptCopy(void);
+
+static const TEST tests[] =
+{
+    {"copies of 0 to 130 bytes at every alignment match memcpy()", &TestEveryLengthAndAlignment},
+    {"a 64 byte packet takes 32 word transfers, or 64 byte ones when odd", &TestPacketTransfers},
+    {"constants above data RAM are copied by the CPU", &TestConstantsUseCpu},
+    {"a copy reaching past DMAH is made by the CPU", &TestPastHighLimitUsesCpu},
+    {"an interrupt copying while the channel is busy uses the CPU", &TestInterruptUsesCpu},
+    {"a channel that fails its test transfer is not used", &TestStuckChannelIsNotUsed},
+};
+
+static bool interruptOk;
+
+int main(void)
+{
+    uint8_t failures = 0;
+    uint8_t i;
+    
+    for(i = 0; i < (sizeof(tests) / sizeof(tests[0])); i++)
+    {
+        HOST_dmaStuck = false;
+        DMA_COPY_Initialize();
+        (void)memset(&HOST_dma, 0, sizeof(HOST_dma));
+    
+        if((tests[i].run() == false) || (HOST_dma.errors != 0u))
+        {
+            printf("dma_test: FAILED %s\n", tests[i].name);
+            failures++;
+        }
+    }
+    
+    printf("dma_test: %u of %u passed\n", (unsigned)(i - failures), (unsigned)i);
+    
+    return (failures == 0u) ? 0 : 1;
+}
+
+//Copies between two device addresses and checks the result, the guard bytes
+//on either side, and how many blocks the channel moved.
+static bool Copy(uint16_t destination, uint16_t source, uint16_t length, uint32_t blocks)
+{
+    uint8_t expected[MAX_LENGTH];
+    uint32_t start = HOST_dma.blocks;
+    uint16_t i;
+    
+    for(i = 0; i < length; i++)
+    {
+        HOST_dataSpace[source + i] = (uint8_t)((i * 7u) + length);
+    }
+    
+    (void)memcpy(expected, &HOST_dataSpace[source], length);
+    (void)memset(&HOST_dataSpace[destination - GUARD_SIZE], GUARD, length + (2u * GUARD_SIZE));
+    
+    DMA_COPY_Copy(&HOST_dataSpace[destination], &HOST_dataSpace[source], length);
+    
+    for(i = 0; i < GUARD_SIZE; i++)
+    {
+        if((HOST_dataSpace[destination - 1u - i] != GUARD) || (HOST_dataSpace[destination + length + i] != GUARD))
+        {
+            return false;
+        }
+    }
+    
+    return (memcmp(&HOST_dataSpace[destination], expected, length) == 0) && ((HOST_dma.blocks - start) == blocks);
+}
+
+static bool TestEveryLengthAndAlignment(void)
+{
+    uint16_t length;
+    uint8_t alignment;
+    
+    for(length = 0; length <= MAX_LENGTH; length++)
+    {
+        for(alignment = 0; alignment < 4u; alignment++)
+        {
+            if(Copy(DESTINATION_ADDRESS + (alignment & 1u), SOURCE_ADDRESS + (alignment >> 1), length,
+                    (length >= DMA_COPY_THRESHOLD) ? 1u : 0u) == false)
+            {
+                return false;
+            }
+        }
+    }
+    
+    return true;
+}
+
+static bool TestPacketTransfers(void)
+{
+    if((Copy(DESTINATION_ADDRESS, SOURCE_ADDRESS, PACKET_SIZE, 1u) == false) || (HOST_dma.transfers != 32u))
+    {
+        return false;
+    }
+    
+    return Copy(DESTINATION_ADDRESS + 1u, SOURCE_ADDRESS, PACKET_SIZE, 1u) && (HOST_dma.transfers == (32u + 64u));
+}
+
+static bool TestConstantsUseCpu(void)
+{
+    return Copy(DESTINATION_ADDRESS, CONSTANT_ADDRESS, PACKET_SIZE, 0u);
+}
+
+static bool TestPastHighLimitUsesCpu(void)
+{
+    //The last 16 bytes of data RAM are reachable, the 16 after them not.
+    return Copy(DESTINATION_ADDRESS, DMA_COPY_HIGH_LIMIT + 1u - 16u, 32u, 0u) &&
+           Copy(DESTINATION_ADDRESS, DMA_COPY_HIGH_LIMIT + 1u - 32u, 32u, 1u);
+}
+
+static bool TestInterruptUsesCpu(void)
+{
+    interruptOk = false;
+    HOST_dmaHook = &InterruptCopy;
+    
+    return Copy(DESTINATION_ADDRESS, SOURCE_ADDRESS, PACKET_SIZE, 1u) && interruptOk;
+}
+
+static void InterruptCopy(void)
+{
+    interruptOk = Copy(DESTINATION_ADDRESS + 0x100u, SOURCE_ADDRESS + 0x100u, PACKET_SIZE, 0u);
+}
+
+static bool TestStuckChannelIsNotUsed(void)
+{
+    HOST_dmaStuck = true;
+    DMA_COPY_Initialize();
+    
+    return Copy(DESTINATION_ADDRESS, SOURCE_ADDRESS, PACKET_SIZE, 0u);
+}
@@ -0,0 +1,255 @@
+//Copyright 2016 Microchip Technology Inc. (www.microchip.com)
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+//Console FIFO throughput: the original byte FIFO (1000 bytes, a compare and
+//wrap per byte, a byte at a time into a packet buffer that is then copied to
+//the endpoint) against console.c's power-of-two lanes, on the same stream
+//of messages.  Host bytes/s are only a relative figure for the PIC24.  The
+//two alternate over several rounds and the medians are printed, with the
+//spread of the ratio, since a single run on a busy host is mostly noise.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "mcc_generated_files/usb/usb_device_cdc.h"
+#include "console.h"
+#include "host.h"
+
+#ifndef BENCH_NAME
+#define BENCH_NAME      "fifo_bench"
+#endif
+
+#define MESSAGE_COUNT   500000ul
+#define ROUND_COUNT     9u
+#define MAX_PACKET      64u
+
+#define BASELINE_FIFO_SIZE 1000u
+
+static uint8_t baselineFIFO[BASELINE_FIFO_SIZE];
+static uint8_t baselineTxBuffer[MAX_PACKET];
+static uint8_t baselineEndpoint[MAX_PACKET];
+static uint16_t baselineHead = 0;
+static uint16_t baselineTail = 0;
+static uint32_t baselineBytes = 0;
+
+static double RunBaseline(uint32_t* queued);
+static double RunLanes(uint32_t* queued);
+static double GetMedian(double* values, uint8_t count);
+static uint8_t GetMessage(uint32_t index, uint8_t* message);
+static void BaselineWrite(const uint8_t* data, uint16_t length);
+static void BaselineTasks(void);
+static uint16_t BaselineGetDepth(void);
+static void BaselinePut(uint8_t data);
+static uint8_t BaselineGet(void);
+
+int main(void)
+{
+    double baselineSeconds[ROUND_COUNT];
+    double laneSeconds[ROUND_COUNT];
+    double ratios[ROUND_COUNT];
+    double ratio;
+    uint32_t queued = 0;
+    uint32_t laneQueued = 0;
+    uint8_t round;
+    
+    for(round = 0; round < ROUND_COUNT; round++)
+    {
+        baselineSeconds[round] = RunBaseline(&queued);
+        laneSeconds[round] = RunLanes(&laneQueued);
+        
+        if((baselineBytes != queued) || (laneQueued != queued) || (HOST_cdcOutput.bytes != queued))
+        {
+            printf(BENCH_NAME ": FAILED, %lu bytes queued, baseline sent %lu, lanes sent %lu\n",
+                   (unsigned long)queued, (unsigned long)baselineBytes, (unsigned long)HOST_cdcOutput.bytes);
+            return 1;
+        }
+        
+        ratios[round] = baselineSeconds[round] / laneSeconds[round];
+    }
+    
+    ratio = GetMedian(ratios, ROUND_COUNT);
+    
+    printf(BENCH_NAME ": %lu messages, %lu bytes, median of %u rounds\n",
+           (unsigned long)MESSAGE_COUNT, (unsigned long)queued, ROUND_COUNT);
+    printf("  byte FIFO (baseline)  %8.1f MB/s\n", queued / GetMedian(baselineSeconds, ROUND_COUNT) / 1e6);
+    printf("  power-of-two lanes    %8.1f MB/s\n", queued / GetMedian(laneSeconds, ROUND_COUNT) / 1e6);
+    printf("  lanes/baseline        %8.2fx  (rounds from %.2fx to %.2fx)\n",
+           ratio, ratios[0], ratios[ROUND_COUNT - 1u]);
+    
+    return 0;
+}
+
+static double RunBaseline(uint32_t* queued)
+{
+    uint8_t message[MAX_PACKET];
+    uint32_t i;
+    uint8_t length;
+    double start = HOST_GetSeconds();
+    
+    baselineBytes = 0;
+    *queued = 0;
+    
+    for(i = 0; i < MESSAGE_COUNT; i++)
+    {
+        length = GetMessage(i, message);
+        BaselineWrite(message, length);
+        BaselineTasks();
+        *queued += length;
+    }
+    
+    while(BaselineGetDepth() != 0u)
+    {
+        BaselineTasks();
+    }
+    
+    return HOST_GetSeconds() - start;
+}
+
+static double RunLanes(uint32_t* queued)
+{
+    uint8_t message[MAX_PACKET];
+    uint32_t i;
+    uint8_t length;
+    double start;
+    
+    CONSOLE_Initialize();
+    CONSOLE_SetCoalescing(0u);
+    HOST_CDC_Reset(NULL, 0u);
+    *queued = 0;
+    start = HOST_GetSeconds();
+    
+    for(i = 0; i < MESSAGE_COUNT; i++)
+    {
+        length = GetMessage(i, message);
+        (void)CONSOLE_Write(message, length);
+        CONSOLE_Tasks();
+        *queued += length;
+    }
+    
+    CONSOLE_Tasks();
+    
+    return HOST_GetSeconds() - start;
+}
+
+//Sorts values in place, so that afterwards the first and last are the
+//smallest and the largest.
+static double GetMedian(double* values, uint8_t count)
+{
+    double value;
+    uint8_t i;
+    uint8_t j;
+    
+    for(i = 1; i < count; i++)
+    {
+        value = values[i];
+        
+        for(j = i; (j > 0u) && (values[j - 1u] > value); j--)
+        {
+            values[j] = values[j - 1u];
+        }
+        
+        values[j] = value;
+    }
+    
+    return values[count / 2u];
+}
+
+//8 to 63 bytes of text ending in CR LF, in a fixed pseudo-random sequence.
+static uint8_t GetMessage(uint32_t index, uint8_t* message)
+{
+    uint32_t seed = (index * 1103515245ul) + 12345ul;
+    uint8_t length = (uint8_t)(8u + ((seed >> 16) % 56u));
+    
+    (void)memset(message, 'a' + (int)(index % 26u), length);
+    message[length - 2u] = '\r';
+    message[length - 1u] = '\n';
+    
+    return length;
+}
+
+//The console of the original demo, with putUSBUSART() and CDCTxService()
+//reduced to their copy into the endpoint buffer.
+static void BaselineWrite(const uint8_t* data, uint16_t length)
+{
+    while(length-- != 0u)
+    {
+        BaselinePut(*data++);
+    }
+}
+
+static void BaselineTasks(void)
+{
+    uint16_t transmitSize = BaselineGetDepth();
+    uint8_t i;
+    
+    if(transmitSize != 0u)
+    {
+        if(transmitSize > MAX_PACKET)
+        {
+            transmitSize = MAX_PACKET;
+        }
+        
+        for(i = 0; i < transmitSize; i++)
+        {
+            baselineTxBuffer[i] = BaselineGet();
+        }
+        
+        (void)memcpy(baselineEndpoint, baselineTxBuffer, transmitSize);
+        baselineBytes += transmitSize;
+    }
+}
+
+static uint16_t BaselineGetDepth(void)
+{
+    uint16_t depth = (baselineTail - baselineHead);
+    
+    if(baselineTail < baselineHead)
+    {
+        depth = ((BASELINE_FIFO_SIZE - baselineHead) + baselineTail);
+    }
+    
+    return depth;
+}
+
+static void BaselinePut(uint8_t data)
+{
+    if(BaselineGetDepth() < (BASELINE_FIFO_SIZE - 1u))
+    {
+        baselineFIFO[baselineTail] = data;
+        baselineTail++;
+        
+        if(baselineTail == BASELINE_FIFO_SIZE)
+        {
+            baselineTail = 0;
+        }
+    }
+}
+
+static uint8_t BaselineGet(void)
+{
+    uint8_t data = 0u;
+    
+    if(BaselineGetDepth() > 0u)
+    {
+        data = baselineFIFO[baselineHead];
+        baselineHead++;
+        
+        if(baselineHead == BASELINE_FIFO_SIZE)
+        {
+            baselineHead = 0;
+        }
+    }
+    
+    return data;
+}
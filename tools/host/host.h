@@ -0,0 +1,159 @@
+//Copyright 2016 Microchip Technology Inc. (www.microchip.com)
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+#ifndef HOST_H
+#define HOST_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+//What the console sent through the stand-in CDC driver of host_cdc.c.
+typedef struct
+{
+    uint32_t packets;
+    uint32_t bytes;
+    uint8_t* capture;           //every byte sent is kept here if not NULL
+    uint32_t captureSize;
+    bool stalled;               //the host takes nothing; each CDCTxService() is 1ms
+} HOST_CDC_OUTPUT;
+
+extern HOST_CDC_OUTPUT HOST_cdcOutput;
+
+//Packets the host model of host_usb.c took or gave, the transactions it
+//NAKed because the next BDT entry was not armed, and arms of an entry the
+//SIE still owned.
+typedef struct
+{
+    uint32_t packets;
+    uint32_t naks;
+    uint32_t errors;
+} HOST_USB_COUNTS;
+
+extern HOST_USB_COUNTS HOST_usb;
+
+//Blocks the DMA model of host_dma.c moved, the word or byte transfers they
+//took, and transfers the real channel would have refused: outside DMAL to
+//DMAH, words at odd addresses, or a channel programmed while in use.
+typedef struct
+{
+    uint32_t blocks;
+    uint32_t transfers;
+    uint32_t errors;
+} HOST_DMA_COUNTS;
+
+extern HOST_DMA_COUNTS HOST_dma;
+
+//Data space for dma_copy.c on the host: 64 KB aligned on 64 KB, so that the
+//low 16 bits of a pointer into it are the device address.  Data RAM starts
+//at 0x0800; above 0x8000 stands for constants read through the PSV window.
+extern uint8_t HOST_dataSpace[0x10000];
+
+//The DMA channel never completes a transfer while set.
+extern bool HOST_dmaStuck;
+
+//Called once as the next DMA transfer starts, if not NULL: an interrupt
+//arriving while the channel is busy.
+extern void (*HOST_dmaHook)(void);
+
+//Returned by USBGet1msTickCount().
+extern uint32_t HOST_ticks;
+
+//Bytes moved by DMA_COPY_Copy(), and by memcpy() in sources built with
+//-Dmemcpy=HOST_Memcpy.
+extern uint32_t HOST_copiedBytes;
+
+//Called by HOST_Memcpy() and DMA_COPY_Copy() before they copy, if not
+//NULL: an interrupt arriving in the middle of the caller.
+extern void (*HOST_copyHook)(void);
+
+void* HOST_Memcpy(void* destination, const void* source, size_t length);
+
+/*********************************************************************
+* Function: void HOST_CDC_Reset(uint8_t* capture, uint32_t captureSize);
+*
+* Overview: Clears the counts in HOST_cdcOutput and starts a new capture.
+*
+* PreCondition: None
+*
+* Input: capture - buffer for the bytes sent, or NULL to only count them
+*        captureSize - size of capture
+*
+* Output: None
+*
+********************************************************************/
+void HOST_CDC_Reset(uint8_t* capture, uint32_t captureSize);
+
+/*********************************************************************
+* Function: int16_t HOST_USB_In(uint8_t endpoint, uint8_t* data);
+*
+* Overview: The host reads one packet from an IN endpoint of host_usb.c.
+*
+* PreCondition: USBEnableEndpoint() called for the endpoint
+*
+* Input: endpoint - endpoint number
+*        data - where the packet goes, 64 bytes
+*
+* Output: length of the packet, or -1 if it was NAKed
+*
+********************************************************************/
+int16_t HOST_USB_In(uint8_t endpoint, uint8_t* data);
+
+/*********************************************************************
+* Function: bool HOST_USB_Out(uint8_t endpoint, const uint8_t* data, uint8_t length);
+*
+* Overview: The host writes one packet to an OUT endpoint of host_usb.c.
+*
+* PreCondition: USBEnableEndpoint() called for the endpoint
+*
+* Input: endpoint - endpoint number
+*        data - the packet
+*        length - its length, up to the size of the endpoint
+*
+* Output: true if the packet was taken, false if it was NAKed
+*
+********************************************************************/
+bool HOST_USB_Out(uint8_t endpoint, const uint8_t* data, uint8_t length);
+
+/*********************************************************************
+* Function: void HOST_USB_ClearHalt(uint8_t endpoint, uint8_t direction);
+*
+* Overview: The host clears a halt on an endpoint of host_usb.c, which
+*           terminates the transfers armed on it.
+*
+* PreCondition: USBEnableEndpoint() called for the endpoint
+*
+* Input: endpoint - endpoint number
+*        direction - OUT_FROM_HOST or IN_TO_HOST
+*
+* Output: None
+*
+********************************************************************/
+void HOST_USB_ClearHalt(uint8_t endpoint, uint8_t direction);
+
+/*********************************************************************
+* Function: double HOST_GetSeconds(void);
+*
+* Overview: Monotonic wall clock time, for the benchmarks.
+*
+* PreCondition: None
+*
+* Input: None
+*
+* Output: seconds since an arbitrary start
+*
+********************************************************************/
+double HOST_GetSeconds(void);
+
+#endif //HOST_H
@@ -0,0 +1,71 @@
+//Copyright 2016 Microchip Technology Inc. (www.microchip.com)
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "mcc_generated_files/usb/usb_device_cdc.h"
+#include "host.h"
+
+//Stands in for the CDC driver on the console's side: an IN buffer is
+//always free, so the console runs as fast as it can build packets.
+
+HOST_CDC_OUTPUT HOST_cdcOutput;
+
+static uint8_t endpoint[CDC_DATA_IN_EP_SIZE];
+
+void HOST_CDC_Reset(uint8_t* capture, uint32_t captureSize)
+{
+    HOST_cdcOutput.packets = 0;
+    HOST_cdcOutput.bytes = 0;
+    HOST_cdcOutput.capture = capture;
+    HOST_cdcOutput.captureSize = captureSize;
+    HOST_cdcOutput.stalled = false;
+}
+
+uint8_t* CDCTxAcquireBuffer(uint8_t instance)
+{
+    (void)instance;
+    
+    return (HOST_cdcOutput.stalled == true) ? NULL : endpoint;
+}
+
+void CDCTxCommitBuffer(uint8_t instance, uint8_t length)
+{
+    (void)instance;
+    
+    if(length == 0u)
+    {
+        return;
+    }
+    
+    if((HOST_cdcOutput.capture != NULL) && ((HOST_cdcOutput.bytes + length) <= HOST_cdcOutput.captureSize))
+    {
+        (void)memcpy(&HOST_cdcOutput.capture[HOST_cdcOutput.bytes], endpoint, length);
+    }
+    
+    HOST_cdcOutput.packets++;
+    HOST_cdcOutput.bytes += length;
+}
+
+void CDCTxService(uint8_t instance)
+{
+    (void)instance;
+    
+    if(HOST_cdcOutput.stalled == true)
+    {
+        HOST_ticks++;
+    }
+}
@@ -0,0 +1,53 @@
+//Copyright 2016 Microchip Technology Inc. (www.microchip.com)
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "dma_copy.h"
+#include "host.h"
+
+//Stands in for dma_copy.c, whose DMA channel does not exist on the host.
+
+uint32_t HOST_copiedBytes;
+void (*HOST_copyHook)(void);
+
+void DMA_COPY_Initialize(void)
+{
+}
+
+void DMA_COPY_Copy(void* destination, const void* source, uint16_t length)
+{
+    HOST_copiedBytes += length;
+    
+    if(HOST_copyHook != NULL)
+    {
+        HOST_copyHook();
+    }
+    
+    (void)memcpy(destination, source, length);
+}
+
+void* HOST_Memcpy(void* destination, const void* source, size_t length)
+{
+    HOST_copiedBytes += (uint32_t)length;
+    
+    if(HOST_copyHook != NULL)
+    {
+        HOST_copyHook();
+    }
+    
+    return memcpy(destination, source, length);
+}
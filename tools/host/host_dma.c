@@ -0,0 +1,120 @@
+//Copyright 2016 Microchip Technology Inc. (www.microchip.com)
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+#include <xc.h>
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "host.h"
+
+//Stands in for channel 1 of the DMA module under dma_copy.c, as dma_copy.c
+//sets it up: continuous mode, both addresses incremented, one block per
+//CHREQ.  The block moves when DMAINT1bits is next used after the request,
+//as if the DMA had moved it between two instructions.
+
+#define DMA_SIZE_BYTE           1u
+#define DMA_TRMODE_CONTINUOUS   2u
+#define DMA_MODE_INCREMENT      1u
+
+volatile HOST_DMACONBITS DMACONbits;
+volatile HOST_DMACHBITS DMACH1bits;
+volatile unsigned int DMAL;
+volatile unsigned int DMAH;
+volatile unsigned int DMACH1;
+volatile unsigned int DMAINT1;
+volatile unsigned int DMACNT1;
+volatile unsigned int DMASRC1;
+volatile unsigned int DMADST1;
+
+HOST_DMA_COUNTS HOST_dma;
+uint8_t HOST_dataSpace[0x10000] __attribute__((aligned(0x10000)));
+bool HOST_dmaStuck;
+void (*HOST_dmaHook)(void);
+
+static volatile HOST_DMAINTBITS dmaInt1bits;
+static bool transferring;
+
+static void Transfer(void);
+static bool IsReachable(uint16_t address, uint32_t length);
+
+volatile HOST_DMAINTBITS* HOST_DMA_Run(void)
+{
+    void (*hook)(void) = HOST_dmaHook;
+    
+    if((DMACH1bits.CHEN == 0u) || (DMACH1bits.CHREQ == 0u) || (HOST_dmaStuck == true))
+    {
+        return &dmaInt1bits;
+    }
+    
+    //Programmed again by an interrupt while the block was moving.
+    if(transferring == true)
+    {
+        HOST_dma.errors++;
+        return &dmaInt1bits;
+    }
+    
+    DMACH1bits.CHREQ = 0;
+    transferring = true;
+    
+    if(hook != NULL)
+    {
+        HOST_dmaHook = NULL;
+        hook();
+    }
+    
+    Transfer();
+    transferring = false;
+    
+    return &dmaInt1bits;
+}
+
+static void Transfer(void)
+{
+    uint32_t length = DMACNT1;
+    
+    if(DMACH1bits.SIZE != DMA_SIZE_BYTE)
+    {
+        length *= 2u;
+    
+        if(((DMASRC1 | DMADST1) & 1u) != 0u)
+        {
+            HOST_dma.errors++;
+        }
+    }
+    
+    if((DMACONbits.DMAEN == 0u) || (DMACH1bits.TRMODE != DMA_TRMODE_CONTINUOUS) ||
+       (DMACH1bits.SAMODE != DMA_MODE_INCREMENT) || (DMACH1bits.DAMODE != DMA_MODE_INCREMENT) ||
+       (IsReachable((uint16_t)DMASRC1, length) == false) || (IsReachable((uint16_t)DMADST1, length) == false))
+    {
+        HOST_dma.errors++;
+    }
+    else
+    {
+        (void)memcpy(&HOST_dataSpace[DMADST1], &HOST_dataSpace[DMASRC1], length);
+    }
+    
+    HOST_dma.blocks++;
+    HOST_dma.transfers += DMACNT1;
+    
+    //The channel turns itself off at the end of a continuous block.
+    DMACH1bits.CHEN = 0;
+    dmaInt1bits.DONEIF = 1;
+}
+
+static bool IsReachable(uint16_t address, uint32_t length)
+{
+    return (length != 0u) && (address >= DMAL) && ((address + length - 1u) <= DMAH);
+}
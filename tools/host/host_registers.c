@@ -0,0 +1,57 @@
+//Copyright 2016 Microchip Technology Inc. (www.microchip.com)
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+#include <xc.h>
+
+#include <time.h>
+
+#include "mcc_generated_files/usb/usb.h"
+#include "host.h"
+
+volatile HOST_SRBITS SRbits;
+volatile HOST_IEC5BITS IEC5bits;
+volatile HOST_U1PWRCBITS U1PWRCbits;
+volatile unsigned int PR3 = 15999u;
+#if !defined(HOST_TIMER)
+volatile unsigned int TMR3;
+#endif
+
+//The USB stack's state: the device is always configured.
+USB_VOLATILE USB_DEVICE_STATE USBDeviceState = CONFIGURED_STATE;
+uint32_t HOST_ticks;
+
+uint32_t USBGet1msTickCount(void)
+{
+    return HOST_ticks;
+}
+
+double HOST_GetSeconds(void)
+{
+    struct timespec now;
+    
+    (void)clock_gettime(CLOCK_MONOTONIC, &now);
+    
+    return (double)now.tv_sec + ((double)now.tv_nsec * 1e-9);
+}
+
+#if defined(HOST_TIMER)
+unsigned int HOST_ReadTimer(void)
+{
+    struct timespec now;
+    
+    (void)clock_gettime(CLOCK_MONOTONIC, &now);
+    
+    return (unsigned int)(now.tv_nsec % (PR3 + 1u));
+}
+#endif
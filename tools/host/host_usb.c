@@ -0,0 +1,164 @@
+//Copyright 2016 Microchip Technology Inc. (www.microchip.com)
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "mcc_generated_files/usb/usb.h"
+#include "mcc_generated_files/usb/usb_device_cdc.h"
+#include "host.h"
+
+//Stands in for the USB stack and the SIE under usb_device_cdc.c.  Each
+//endpoint has an EVEN and an ODD BDT entry per direction, armed by
+//USBTransferOnePacket() one after the other, and the host takes them in the
+//same order as the SIE does, NAKing while the next one is not armed.  The
+//stack's events are handed to USBCDCEventHandler() as the USB interrupt
+//would hand them.
+
+#define DIRECTION_COUNT     2u
+#define PING_PONG_COUNT     2u
+
+USB_VOLATILE IN_PIPE inPipes[1];
+USB_VOLATILE OUT_PIPE outPipes[1];
+volatile CTRL_TRF_SETUP SetupPkt;
+
+HOST_USB_COUNTS HOST_usb;
+volatile BDT_ENTRY* pBDTEntryOut[USB_MAX_EP_NUMBER + 1];
+volatile BDT_ENTRY* pBDTEntryIn[USB_MAX_EP_NUMBER + 1];
+
+static BDT_ENTRY bdt[USB_MAX_EP_NUMBER + 1][DIRECTION_COUNT][PING_PONG_COUNT];
+static uint8_t* addresses[USB_MAX_EP_NUMBER + 1][DIRECTION_COUNT][PING_PONG_COUNT];
+
+//The entry the SIE uses next, per endpoint and direction.
+static uint8_t pingPong[USB_MAX_EP_NUMBER + 1][DIRECTION_COUNT];
+
+static volatile BDT_ENTRY** GetNextEntry(uint8_t endpoint, uint8_t direction);
+static void Complete(uint8_t endpoint, uint8_t direction);
+static void Terminate(BDT_ENTRY* entry);
+
+void USBEnableEndpoint(uint8_t ep, uint8_t options)
+{
+    (void)options;
+    
+    (void)memset(bdt[ep], 0, sizeof(bdt[ep]));
+    pingPong[ep][OUT_FROM_HOST] = 0;
+    pingPong[ep][IN_TO_HOST] = 0;
+    pBDTEntryOut[ep] = &bdt[ep][OUT_FROM_HOST][0];
+    pBDTEntryIn[ep] = &bdt[ep][IN_TO_HOST][0];
+}
+
+USB_HANDLE USBTransferOnePacket(uint8_t ep, uint8_t dir, uint8_t* data, uint8_t len)
+{
+    volatile BDT_ENTRY** next = GetNextEntry(ep, dir);
+    BDT_ENTRY* entry = (BDT_ENTRY*)*next;
+    uint8_t index = (uint8_t)(entry - &bdt[ep][dir][0]);
+    
+    //The real stack would corrupt a transfer in progress.
+    if(entry->STAT.UOWN == 1)
+    {
+        HOST_usb.errors++;
+        return (USB_HANDLE)entry;
+    }
+    
+    addresses[ep][dir][index] = data;
+    entry->CNT = len;
+    entry->STAT.UOWN = 1;
+    *next = &bdt[ep][dir][index ^ 1u];
+    
+    return (USB_HANDLE)entry;
+}
+
+int16_t HOST_USB_In(uint8_t endpoint, uint8_t* data)
+{
+    BDT_ENTRY* entry = &bdt[endpoint][IN_TO_HOST][pingPong[endpoint][IN_TO_HOST]];
+    uint8_t length;
+    
+    if(entry->STAT.UOWN == 0)
+    {
+        HOST_usb.naks++;
+        return -1;
+    }
+    
+    length = entry->CNT;
+    (void)memcpy(data, addresses[endpoint][IN_TO_HOST][pingPong[endpoint][IN_TO_HOST]], length);
+    entry->STAT.UOWN = 0;
+    Complete(endpoint, IN_TO_HOST);
+    
+    return length;
+}
+
+bool HOST_USB_Out(uint8_t endpoint, const uint8_t* data, uint8_t length)
+{
+    BDT_ENTRY* entry = &bdt[endpoint][OUT_FROM_HOST][pingPong[endpoint][OUT_FROM_HOST]];
+    
+    if(entry->STAT.UOWN == 0)
+    {
+        HOST_usb.naks++;
+        return false;
+    }
+    
+    if(length > entry->CNT)
+    {
+        HOST_usb.errors++;
+        length = entry->CNT;
+    }
+    
+    (void)memcpy(addresses[endpoint][OUT_FROM_HOST][pingPong[endpoint][OUT_FROM_HOST]], data, length);
+    entry->CNT = length;
+    entry->STAT.UOWN = 0;
+    Complete(endpoint, OUT_FROM_HOST);
+    
+    return true;
+}
+
+//As USBStdFeatureReqHandler() handles CLEAR_FEATURE(ENDPOINT_HALT): the
+//stack arms next from the entry the SIE is on, then terminates the other
+//entry and that one.
+void HOST_USB_ClearHalt(uint8_t endpoint, uint8_t direction)
+{
+    uint8_t active = pingPong[endpoint][direction];
+    
+    *GetNextEntry(endpoint, direction) = &bdt[endpoint][direction][active];
+    Terminate(&bdt[endpoint][direction][active ^ 1u]);
+    Terminate(&bdt[endpoint][direction][active]);
+}
+
+static volatile BDT_ENTRY** GetNextEntry(uint8_t endpoint, uint8_t direction)
+{
+    return (direction == IN_TO_HOST) ? &pBDTEntryIn[endpoint] : &pBDTEntryOut[endpoint];
+}
+
+static void Complete(uint8_t endpoint, uint8_t direction)
+{
+    USTAT_FIELDS status;
+    
+    status.Val = 0;
+    status.endpoint_number = endpoint;
+    status.direction = direction;
+    status.ping_pong = pingPong[endpoint][direction];
+    pingPong[endpoint][direction] ^= 1u;
+    HOST_usb.packets++;
+    
+    (void)USBCDCEventHandler(EVENT_TRANSFER, &status, sizeof(status));
+}
+
+static void Terminate(BDT_ENTRY* entry)
+{
+    if(entry->STAT.UOWN == 1)
+    {
+        entry->STAT.UOWN = 0;
+        (void)USBCDCEventHandler(EVENT_TRANSFER_TERMINATED, entry, sizeof(entry));
+    }
+}
@@ -0,0 +1,96 @@
+//Copyright 2016 Microchip Technology Inc. (www.microchip.com)
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+#ifndef XC_H
+#define XC_H
+
+//Host stand-in for the XC16 device header: only what the firmware sources
+//built by this directory's Makefile use.  The registers are plain variables
+//defined in host_registers.c, and in host_dma.c for the DMA module.
+
+typedef struct
+{
+    unsigned IPL:3;
+} HOST_SRBITS;
+
+extern volatile HOST_SRBITS SRbits;
+
+typedef struct
+{
+    unsigned USB1IE:1;
+} HOST_IEC5BITS;
+
+extern volatile HOST_IEC5BITS IEC5bits;
+
+typedef struct
+{
+    unsigned USUSPEND:1;
+} HOST_U1PWRCBITS;
+
+extern volatile HOST_U1PWRCBITS U1PWRCbits;
+extern volatile unsigned int PR3;
+
+#if defined(HOST_TIMER)
+    //TMR3 counts host ns, from 0 to PR3.
+    #define TMR3    HOST_ReadTimer()
+    unsigned int HOST_ReadTimer(void);
+#else
+    extern volatile unsigned int TMR3;
+#endif
+
+#if defined(HOST_DMA)
+    //The DMA module, with channel 1 modelled by host_dma.c.  DMAINT1bits
+    //runs a requested transfer each time it is used.
+    typedef struct
+    {
+        unsigned DMAEN:1;
+    } HOST_DMACONBITS;
+    
+    typedef struct
+    {
+        unsigned CHEN:1;
+        unsigned SIZE:1;
+        unsigned TRMODE:2;
+        unsigned SAMODE:2;
+        unsigned DAMODE:2;
+        unsigned CHREQ:1;
+    } HOST_DMACHBITS;
+    
+    typedef struct
+    {
+        unsigned CHSEL:7;
+        unsigned DONEIF:1;
+    } HOST_DMAINTBITS;
+    
+    extern volatile HOST_DMACONBITS DMACONbits;
+    extern volatile HOST_DMACHBITS DMACH1bits;
+    extern volatile unsigned int DMAL;
+    extern volatile unsigned int DMAH;
+    extern volatile unsigned int DMACH1;
+    extern volatile unsigned int DMAINT1;
+    extern volatile unsigned int DMACNT1;
+    extern volatile unsigned int DMASRC1;
+    extern volatile unsigned int DMADST1;
+    
+    #define DMAINT1bits     (*HOST_DMA_Run())
+    volatile HOST_DMAINTBITS* HOST_DMA_Run(void);
+#endif
+
+#define SET_AND_SAVE_CPU_IPL(save, ipl)     {(save) = SRbits.IPL; SRbits.IPL = (ipl);}
+#define RESTORE_CPU_IPL(save)               {SRbits.IPL = (save);}
+
+#define __builtin_divud(numerator, denominator) \
+    ((unsigned int)((unsigned long)(numerator) / (unsigned int)(denominator)))
+
+#endif //XC_H
@@ -0,0 +1,254 @@
+//Copyright 2016 Microchip Technology Inc. (www.microchip.com)
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+//Compression ratio and speed of console_lzss.c, driven the way console.c's
+//BuildCompressedPacket() drives it, on console-like text and on two inputs
+//that defeat it.  Every stream is decompressed again and compared.  Host
+//ns/byte are only a relative figure for the PIC24.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "console_lzss.h"
+#include "host.h"
+
+#define STREAM_SIZE     262144ul
+#define MAX_PACKET      64u
+#define WINDOW_SIZE     512u
+#define MIN_MATCH       3u
+#define END_OF_GROUP    0x7Fu
+
+typedef struct
+{
+    const char* name;
+    uint32_t (*make)(uint8_t* stream, uint32_t size);
+} INPUT;
+
+typedef struct
+{
+    uint8_t history[WINDOW_SIZE];
+    uint16_t position;
+    uint8_t flags;
+    uint8_t items;
+} DECODER;
+
+static uint8_t stream[STREAM_SIZE];
+static uint8_t compressed[STREAM_SIZE * 2u];
+static uint8_t decompressed[STREAM_SIZE];
+
+static uint32_t MakeLog(uint8_t* stream, uint32_t size);
+static uint32_t MakeBinary(uint8_t* stream, uint32_t size);
+static uint32_t MakeRandom(uint8_t* stream, uint32_t size);
+static uint32_t GetRandom(uint32_t* seed);
+static uint32_t Decode(DECODER* decoder, const uint8_t* data, uint32_t length, uint8_t* output);
+
+static const INPUT inputs[] =
+{
+    {"console log text", &MakeLog},
+    {"two-letter noise", &MakeBinary},
+    {"random bytes", &MakeRandom},
+};
+
+int main(void)
+{
+    uint8_t packet[MAX_PACKET];
+    DECODER decoder;
+    uint32_t size;
+    uint32_t index;
+    uint32_t packed;
+    uint32_t unpacked;
+    uint16_t space;
+    uint16_t length;
+    double start;
+    double seconds;
+    uint8_t i;
+    
+    printf("lzss_bench: %lu bytes per input, written as console.c writes them\n", (unsigned long)STREAM_SIZE);
+    
+    for(i = 0; i < (sizeof(inputs) / sizeof(inputs[0])); i++)
+    {
+        size = inputs[i].make(stream, STREAM_SIZE);
+        CONSOLE_LZSS_Initialize();
+        index = 0;
+        packed = 0;
+        start = HOST_GetSeconds();
+    
+        while(index < size)
+        {
+            while((index < size) && ((space = CONSOLE_LZSS_GetSpace()) != 0u))
+            {
+                length = (uint16_t)(((size - index) > space) ? space : (size - index));
+                CONSOLE_LZSS_Write(&stream[index], length);
+                index += length;
+            }
+    
+            do
+            {
+                length = CONSOLE_LZSS_Read(packet, sizeof(packet));
+                (void)memcpy(&compressed[packed], packet, length);
+                packed += length;
+            } while((index >= size) && (length != 0u));
+        }
+    
+        seconds = HOST_GetSeconds() - start;
+    
+        (void)memset(&decoder, 0, sizeof(decoder));
+        unpacked = Decode(&decoder, compressed, packed, decompressed);
+    
+        if((unpacked != size) || (memcmp(stream, decompressed, size) != 0))
+        {
+            printf("lzss_bench: FAILED, %s does not decompress to its input\n", inputs[i].name);
+            return 1;
+        }
+    
+        printf("  %-18s %5.1f%% of its size  %7.1f ns/byte\n", inputs[i].name,
+               (100.0 * packed) / size, (seconds * 1e9) / size);
+    }
+    
+    return 0;
+}
+
+//Lines of the kinds the demo prints, with changing numbers.
+static uint32_t MakeLog(uint8_t* stream, uint32_t size)
+{
+    uint32_t seed = 1;
+    uint32_t length = 0;
+    char line[96];
+    int count;
+    
+    while(1)
+    {
+        switch(GetRandom(&seed) % 5u)
+        {
+            case 0:
+                count = snprintf(line, sizeof(line), "policy %lu: %lu bytes, %lu messages dropped\r\n",
+                                 (unsigned long)(GetRandom(&seed) % 4u), (unsigned long)(GetRandom(&seed) % 5000u),
+                                 (unsigned long)(GetRandom(&seed) % 100u));
+                break;
+            case 1:
+                count = snprintf(line, sizeof(line), "lane %lu: FIFO high water mark %lu bytes\r\n",
+                                 (unsigned long)(GetRandom(&seed) % 3u), (unsigned long)(GetRandom(&seed) % 2048u));
+                break;
+            case 2:
+                count = snprintf(line, sizeof(line), "%lu ms\r\n", (unsigned long)GetRandom(&seed));
+                break;
+            case 3:
+                count = snprintf(line, sizeof(line), "Button Pressed\r\n");
+                break;
+            default:
+                count = snprintf(line, sizeof(line), "USB RX ring high water mark %lu of %u bytes\r\n",
+                                 (unsigned long)(GetRandom(&seed) % 512u), 512u);
+                break;
+        }
+    
+        if((length + (uint32_t)count) > size)
+        {
+            return length;
+        }
+    
+        (void)memcpy(&stream[length], line, (size_t)count);
+        length += (uint32_t)count;
+    }
+}
+
+//Many short partial matches everywhere: the most work per byte for a
+//search that tries every distance.
+static uint32_t MakeBinary(uint8_t* stream, uint32_t size)
+{
+    uint32_t seed = 2;
+    uint32_t i;
+    
+    for(i = 0; i < size; i++)
+    {
+        stream[i] = ((GetRandom(&seed) & 0x100u) != 0u) ? 'a' : 'b';
+    }
+    
+    return size;
+}
+
+static uint32_t MakeRandom(uint8_t* stream, uint32_t size)
+{
+    uint32_t seed = 3;
+    uint32_t i;
+    
+    for(i = 0; i < size; i++)
+    {
+        stream[i] = (uint8_t)(GetRandom(&seed) >> 16);
+    }
+    
+    return size;
+}
+
+static uint32_t GetRandom(uint32_t* seed)
+{
+    *seed = (*seed * 1103515245ul) + 12345ul;
+    
+    return *seed >> 8;
+}
+
+//The format of console_lzss.h, as tools/console_log.py decodes it.
+static uint32_t Decode(DECODER* decoder, const uint8_t* data, uint32_t length, uint8_t* output)
+{
+    uint32_t count = 0;
+    uint32_t i = 0;
+    uint16_t distance;
+    uint8_t matchLength;
+    uint8_t value;
+    
+    while(i < length)
+    {
+        if(decoder->items == 0u)
+        {
+            decoder->flags = data[i++];
+            decoder->items = 8u;
+            continue;
+        }
+    
+        if((decoder->flags & 1u) != 0u)
+        {
+            value = data[i++];
+            output[count++] = value;
+            decoder->history[decoder->position++ % WINDOW_SIZE] = value;
+        }
+        else
+        {
+            if((i + 2u) > length)
+            {
+                break;
+            }
+    
+            distance = (uint16_t)(data[i] | ((data[i + 1u] >> 7) << 8)) + 1u;
+            matchLength = data[i + 1u] & 0x7Fu;
+            i += 2u;
+    
+            if(matchLength == END_OF_GROUP)
+            {
+                decoder->items = 0;
+                continue;
+            }
+    
+            for(matchLength += MIN_MATCH; matchLength != 0u; matchLength--)
+            {
+                value = decoder->history[(uint16_t)(decoder->position - distance) % WINDOW_SIZE];
+                output[count++] = value;
+                decoder->history[decoder->position++ % WINDOW_SIZE] = value;
+            }
+        }
+    
+        decoder->flags >>= 1;
+        decoder->items--;
+    }
+    
+    return count;
+}
@@ -0,0 +1,160 @@
+//Copyright 2016 Microchip Technology Inc. (www.microchip.com)
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+//The longest time usb_device_cdc.c keeps the USB interrupt masked, as
+//CDCGetLongestMaskedTime() measures it with TMR3 counting host ns, next to
+//the longest CDCTxService() and getsUSBUSART() calls, which copy the packets
+//and would be masked whole if the driver masked around its copies.  The
+//data port sends and receives through the receive ring while the console
+//writes on the other one, against the BDT model of host_usb.c.  Each figure
+//is the smallest of several runs' longest, to leave out the host's own
+//interrupts; host ns are only a relative figure for the PIC24.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "mcc_generated_files/usb/usb.h"
+#include "mcc_generated_files/usb/usb_device_cdc.h"
+#include "console.h"
+#include "host.h"
+
+#define RUN_COUNT           200u
+#define PASS_COUNT          500ul
+#define DATA_INSTANCE       0u
+#define WRITE_SIZE          200u
+
+#if (CDC_INSTANCE_COUNT > 1)
+    #define CONSOLE_EP      CDC1_DATA_EP
+#else
+    #define CONSOLE_EP      CDC_DATA_EP
+#endif
+
+typedef enum
+{
+    FIGURE_MASKED,
+    FIGURE_SERVICE,
+    FIGURE_READ,
+    FIGURE_COUNT
+} FIGURE;
+
+static const char* const figureNames[FIGURE_COUNT] =
+{
+    "longest masked window",
+    "longest CDCTxService()",
+    "longest getsUSBUSART()",
+};
+
+static void Run(double* longest);
+static void Lengthen(double* longest, double start);
+
+int main(void)
+{
+    double best[FIGURE_COUNT];
+    double longest[FIGURE_COUNT];
+    uint8_t run;
+    uint8_t i;
+    
+    printf("mask_bench: %u runs of %lu main loop passes, %u byte writes on the data port\n", RUN_COUNT,
+           (unsigned long)PASS_COUNT, WRITE_SIZE);
+    
+    for(run = 0; run < RUN_COUNT; run++)
+    {
+        Run(longest);
+    
+        if(HOST_usb.errors != 0u)
+        {
+            printf("mask_bench: FAILED, %lu BDT entries armed while the SIE owned them\n",
+                   (unsigned long)HOST_usb.errors);
+            return 1;
+        }
+    
+        for(i = 0; i < FIGURE_COUNT; i++)
+        {
+            if((run == 0u) || (longest[i] < best[i]))
+            {
+                best[i] = longest[i];
+            }
+        }
+    }
+    
+    for(i = 0; i < FIGURE_COUNT; i++)
+    {
+        printf("  %-24s %7.0f ns\n", figureNames[i], best[i]);
+    }
+    
+    return 0;
+}
+
+static void Run(double* longest)
+{
+    uint8_t data[WRITE_SIZE];
+    uint8_t packet[CDC_DATA_IN_EP_SIZE];
+    double start;
+    uint32_t pass;
+    
+    CDCInitEP();
+    CONSOLE_Initialize();
+    CONSOLE_SetCoalescing(0u);
+    CONSOLE_SetSink(CONSOLE_SINK_TRACE, false, CONSOLE_LANE_INFO);
+    (void)memset(&HOST_usb, 0, sizeof(HOST_usb));
+    (void)memset(data, 'd', sizeof(data));
+    (void)memset(packet, 'h', sizeof(packet));
+    longest[FIGURE_SERVICE] = 0;
+    longest[FIGURE_READ] = 0;
+    CDCClearLongestMaskedTime();
+    
+    for(pass = 0; pass < PASS_COUNT; pass++)
+    {
+        if(USBUSARTIsTxTrfReady(DATA_INSTANCE))
+        {
+            putUSBUSART(DATA_INSTANCE, data, sizeof(data));
+        }
+    
+        start = HOST_GetSeconds();
+        CDCTxService(DATA_INSTANCE);
+        Lengthen(&longest[FIGURE_SERVICE], start);
+    
+        start = HOST_GetSeconds();
+        (void)getsUSBUSART(DATA_INSTANCE, data, CDC_DATA_OUT_EP_SIZE);
+        Lengthen(&longest[FIGURE_READ], start);
+    
+        (void)CONSOLE_Write((const uint8_t*)"status: running\r\n", 17u);
+        CONSOLE_Tasks();
+    
+        //The host keeps every endpoint as busy as the BDT entries allow.
+        while(HOST_USB_In(CDC_DATA_EP, packet) >= 0)
+        {
+        }
+    
+        while(HOST_USB_In(CONSOLE_EP, packet) >= 0)
+        {
+        }
+    
+        while(HOST_USB_Out(CDC_DATA_EP, packet, sizeof(packet)) == true)
+        {
+        }
+    }
+    
+    longest[FIGURE_MASKED] = CDCGetLongestMaskedTime();
+}
+
+static void Lengthen(double* longest, double start)
+{
+    double elapsed = (HOST_GetSeconds() - start) * 1e9;
+    
+    if(elapsed > *longest)
+    {
+        *longest = elapsed;
+    }
+}
@@ -0,0 +1,144 @@
+//Copyright 2016 Microchip Technology Inc. (www.microchip.com)
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+//Time per message of CONSOLE_Printf() against formatting with the C
+//library's snprintf() and queuing the result with CONSOLE_Write(), on a few
+//typical formats; record mode, where CONSOLE_Printf() formats every message
+//twice, is timed too.  The host's snprintf() stands in for XC16's, which
+//cannot run here; host ns are only a relative figure for the PIC24.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "mcc_generated_files/usb/usb_device_cdc.h"
+#include "console.h"
+#include "host.h"
+
+#define MESSAGE_COUNT   1000000ul
+
+typedef enum
+{
+    METHOD_SNPRINTF,
+    METHOD_PRINTF,
+    METHOD_PRINTF_RECORDS,
+    METHOD_COUNT
+} METHOD;
+
+static const char* const methodNames[METHOD_COUNT] =
+{
+    "snprintf + Write",
+    "CONSOLE_Printf",
+    "CONSOLE_Printf, records",
+};
+
+static const char* const formatNames[] =
+{
+    "%u ms",
+    "policy %u: %u bytes, %u messages",
+    "%s=%08lX %-6d",
+};
+
+static void PrintMessage(METHOD method, uint8_t format, uint32_t value);
+
+int main(void)
+{
+    double seconds[METHOD_COUNT];
+    double start;
+    uint32_t i;
+    uint8_t format;
+    uint8_t method;
+    
+    printf("printf_bench: ns per message, %lu messages each\n", (unsigned long)MESSAGE_COUNT);
+    printf("  %-34s", "");
+    
+    for(method = 0; method < METHOD_COUNT; method++)
+    {
+        printf("  %24s", methodNames[method]);
+    }
+    
+    printf("\n");
+    
+    for(format = 0; format < (sizeof(formatNames) / sizeof(formatNames[0])); format++)
+    {
+        for(method = 0; method < METHOD_COUNT; method++)
+        {
+            CONSOLE_Initialize();
+            CONSOLE_SetCoalescing(0u);
+            CONSOLE_SetSink(CONSOLE_SINK_TRACE, false, CONSOLE_LANE_INFO);
+            CONSOLE_SetRecordMode(method == METHOD_PRINTF_RECORDS);
+            HOST_CDC_Reset(NULL, 0u);
+            start = HOST_GetSeconds();
+    
+            for(i = 0; i < MESSAGE_COUNT; i++)
+            {
+                PrintMessage((METHOD)method, format, i);
+                CONSOLE_Tasks();
+            }
+    
+            seconds[method] = HOST_GetSeconds() - start;
+        }
+    
+        printf("  %-34s", formatNames[format]);
+    
+        for(method = 0; method < METHOD_COUNT; method++)
+        {
+            printf("  %24.1f", (seconds[method] * 1e9) / MESSAGE_COUNT);
+        }
+    
+        printf("\n");
+    }
+    
+    return 0;
+}
+
+static void PrintMessage(METHOD method, uint8_t format, uint32_t value)
+{
+    char text[64];
+    int length = 0;
+    
+    if(method == METHOD_SNPRINTF)
+    {
+        switch(format)
+        {
+            case 0:
+                length = snprintf(text, sizeof(text), "%u ms\r\n", (unsigned)value);
+                break;
+            case 1:
+                length = snprintf(text, sizeof(text), "policy %u: %u bytes, %u messages dropped\r\n",
+                                  (unsigned)(value & 3u), (unsigned)(value % 5000u), (unsigned)(value % 100u));
+                break;
+            default:
+                length = snprintf(text, sizeof(text), "%s=%08lX %-6d\r\n", "status", (unsigned long)value,
+                                  -(int)(value % 1000u));
+                break;
+        }
+    
+        (void)CONSOLE_Write((const uint8_t*)text, (uint16_t)length);
+        return;
+    }
+    
+    switch(format)
+    {
+        case 0:
+            (void)CONSOLE_Printf("%u ms\r\n", (unsigned)value);
+            break;
+        case 1:
+            (void)CONSOLE_Printf("policy %u: %u bytes, %u messages dropped\r\n",
+                                 (unsigned)(value & 3u), (unsigned)(value % 5000u), (unsigned)(value % 100u));
+            break;
+        default:
+            (void)CONSOLE_Printf("%s=%08lX %-6d\r\n", "status", (unsigned long)value, -(int)(value % 1000u));
+            break;
+    }
+}
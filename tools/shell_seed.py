@@ -0,0 +1,76 @@
+#!/usr/bin/env python3
+#Copyright 2016 Microchip Technology Inc. (www.microchip.com)
+#
+#Licensed under the Apache License, Version 2.0 (the "License");
+#you may not use this file except in compliance with the License.
+#You may obtain a copy of the License at
+#
+#    http://www.apache.org/licenses/LICENSE-2.0
+#
+#Unless required by applicable law or agreed to in writing, software
+#distributed under the License is distributed on an "AS IS" BASIS,
+#WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#See the License for the specific language governing permissions and
+#limitations under the License.
+
+"""Finds HASH_SEED for the command table of shell.c.
+
+  shell_seed.py pic24fj64gu205-curiosity-nano-oob.X/shell.c
+  shell_seed.py --check pic24fj64gu205-curiosity-nano-oob.X/shell.c
+
+The shell looks commands up through a perfect hash whose seed is a
+constant in shell.c.  Without --check this prints the smallest seed that
+puts every command in its own slot; with --check it fails if shell.c's
+HASH_SEED does not do that (the shell then falls back to a slower lookup).
+"""
+
+import argparse
+import re
+import sys
+
+DEFINE = re.compile(r"^#define\s+(\w+)\s+(0x[0-9A-Fa-f]+|\d+)u?\b", re.MULTILINE)
+COMMAND = re.compile(r'^\s*\{"([^"]+)",', re.MULTILINE)
+
+
+def hash_name(seed, multiplier, name):
+    value = seed
+    for c in name.encode("ascii"):
+        value = (value * multiplier + c) & 0xFFFF
+    return value
+
+
+def is_perfect(seed, multiplier, slot_count, names):
+    slots = set(hash_name(seed, multiplier, name) & (slot_count - 1) for name in names)
+    return len(slots) == len(names)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--check", action="store_true", help="check HASH_SEED instead of printing a seed")
+    parser.add_argument("shell", help="path to shell.c")
+    args = parser.parse_args()
+
+    with open(args.shell, encoding="utf-8") as source:
+        text = source.read()
+    defines = dict((name, int(value, 0)) for name, value in DEFINE.findall(text))
+    names = COMMAND.findall(text)
+    multiplier = defines["HASH_MULTIPLIER"]
+    slot_count = defines["SLOT_COUNT"]
+
+    if args.check:
+        seed = defines["HASH_SEED"]
+        if not is_perfect(seed, multiplier, slot_count, names):
+            sys.exit("shell_seed.py: HASH_SEED %u collides for %s; set it to the value "
+                     "printed without --check" % (seed, ", ".join(names)))
+        print("shell_seed.py: HASH_SEED %u fits the %u commands" % (seed, len(names)))
+        return
+
+    for seed in range(0x10000):
+        if is_perfect(seed, multiplier, slot_count, names):
+            print(seed)
+            return
+    sys.exit("shell_seed.py: no seed fits; make SLOT_COUNT larger")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,183 @@
+#!/usr/bin/env python3
+#Copyright 2016 Microchip Technology Inc. (www.microchip.com)
+#
+#Licensed under the Apache License, Version 2.0 (the "License");
+#you may not use this file except in compliance with the License.
+#You may obtain a copy of the License at
+#
+#    http://www.apache.org/licenses/LICENSE-2.0
+#
+#Unless required by applicable law or agreed to in writing, software
+#distributed under the License is distributed on an "AS IS" BASIS,
+#WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#See the License for the specific language governing permissions and
+#limitations under the License.
+
+"""Tests of the stream decoders in console_log.py.
+
+  python3 tools/test_console_log.py
+
+The streams are built here the way console.c, console_log.c and
+console_lzss.c build them; 'make -C tools/host check' runs these too.
+"""
+
+import os
+import sys
+import unittest
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+
+import console_log
+
+TABLE = [
+    ("CONSOLE_LOG_WELCOME", "hello\r\n"),
+    ("CONSOLE_LOG_SHELL_DROPS", "policy %u: %u bytes, %u messages dropped\r\n"),
+    ("CONSOLE_LOG_VALUES", "%x %d 100%%\r\n"),
+]
+
+
+def cobs_encode(data):
+    """Frames data as console.c's RecordAppend() does, delimiter included."""
+    output = bytearray([0])
+    code_index = 0
+    code = 1
+    for value in data:
+        if value == 0:
+            output[code_index] = code
+            code_index = len(output)
+            output.append(0)
+            code = 1
+        else:
+            output.append(value)
+            code += 1
+            if code == 0xFF:
+                output[code_index] = code
+                code_index = len(output)
+                output.append(0)
+                code = 1
+    output[code_index] = code
+    output.append(console_log.FRAME_DELIMITER)
+    return bytes(output)
+
+
+def record(lane, sequence, payload, timestamp=0):
+    return cobs_encode(console_log.FRAME_HEADER.pack(sequence, timestamp, lane) + payload)
+
+
+def log_record(log_id, *arguments):
+    return (console_log.RECORD_HEADER.pack(console_log.RECORD_START, log_id, len(arguments)) +
+            b"".join(console_log.ARGUMENT.pack(value) for value in arguments))
+
+
+def lzss_match(distance, length):
+    distance -= 1
+    return bytes([distance & 0xFF, ((distance >> 8) << 7) | (length - console_log.LZSS_MIN_MATCH)])
+
+
+class CobsTest(unittest.TestCase):
+
+    def test_round_trip(self):
+        for data in (b"", b"\x00", b"a\x00b", b"\x00\x00", bytes(range(256)) * 3, b"x" * 254, b"x" * 255):
+            frame = cobs_encode(data)
+            self.assertNotIn(0, frame[:-1])
+            self.assertEqual(console_log.cobs_decode(frame[:-1]), data)
+
+    def test_malformed(self):
+        self.assertIsNone(console_log.cobs_decode(b"\x05ab"))
+        self.assertIsNone(console_log.cobs_decode(b"\x02a\x00"))
+
+
+class RecordDecoderTest(unittest.TestCase):
+
+    def test_records(self):
+        decoder = console_log.RecordDecoder()
+        stream = record(2, 7, b"one", 1000) + record(0, 0, b"\x00two\x00") + record(2, 8, b"three")
+        self.assertEqual(decoder.feed(stream), [
+            (2, 7, 1000, 0, b"one"),
+            (0, 0, 0, 0, b"\x00two\x00"),
+            (2, 8, 0, 0, b"three"),
+        ])
+        self.assertEqual(decoder.lost, 0)
+
+    def test_any_split(self):
+        stream = record(2, 1, b"a" * 300) + record(2, 2, b"b\x00c")
+        expected = console_log.RecordDecoder().feed(stream)
+        for size in (1, 2, 7, 64):
+            decoder = console_log.RecordDecoder()
+            records = []
+            for start in range(0, len(stream), size):
+                records += decoder.feed(stream[start:start + size])
+            self.assertEqual(records, expected)
+
+    def test_gaps_are_per_lane(self):
+        decoder = console_log.RecordDecoder()
+        records = decoder.feed(record(2, 10, b"") + record(1, 3, b"") + record(2, 13, b"") +
+                               record(1, 4, b"") + record(2, 0, b""))
+        self.assertEqual([gap for _, _, _, gap, _ in records], [0, 0, 2, 0, 65522])
+        self.assertEqual(decoder.lost, 65524)
+
+    def test_malformed_frame_is_skipped(self):
+        decoder = console_log.RecordDecoder()
+        records = decoder.feed(b"\x09abc\x00" + b"\x02x\x00" + record(2, 5, b"ok"))
+        self.assertEqual(records, [(2, 5, 0, 0, b"ok")])
+        self.assertEqual(decoder.malformed, 2)
+
+
+class DecoderTest(unittest.TestCase):
+
+    def test_text_and_records(self):
+        decoder = console_log.Decoder(TABLE)
+        stream = b"boot\r\n" + log_record(1, 1, 200, 3) + log_record(2, 0xBEEF, 0xFFFFFFFE) + log_record(0)
+        self.assertEqual(decoder.feed(stream),
+                         "boot\r\npolicy 1: 200 bytes, 3 messages dropped\r\nBEEF -2 100%\r\nhello\r\n")
+
+    def test_any_split(self):
+        stream = log_record(1, 1, 2, 3) + b"text" + log_record(0)
+        decoder = console_log.Decoder(TABLE)
+        text = "".join(decoder.feed(bytes([value])) for value in stream)
+        self.assertEqual(text, "policy 1: 2 bytes, 3 messages dropped\r\ntexthello\r\n")
+
+    def test_missing_and_unknown(self):
+        decoder = console_log.Decoder(TABLE)
+        self.assertEqual(decoder.feed(log_record(1, 4)), "policy 4:  bytes,  messages dropped\r\n")
+        self.assertEqual(decoder.feed(log_record(9, 1)), "<unknown log id 9 [1]>")
+
+
+class LzssDecoderTest(unittest.TestCase):
+
+    def test_literals_and_matches(self):
+        decoder = console_log.LzssDecoder()
+        #Four literals, a 6 byte match at distance 4, a literal, then the
+        #group ends early.
+        stream = bytes([0b00101111]) + b"abcd" + lzss_match(4, 6) + b"!" + lzss_match(1, 0x7F + 3)
+        self.assertEqual(decoder.feed(stream), b"abcdabcdab!")
+        self.assertEqual(decoder.feed(bytes([0b00000001]) + b"?" + lzss_match(12, 3)), b"?abc")
+
+    def test_long_distance_and_any_split(self):
+        history = bytes(range(256)) * 2
+        stream = bytearray()
+        for start in range(0, len(history), 8):
+            stream += bytes([0xFF]) + history[start:start + 8]
+        stream += bytes([0x00]) + lzss_match(512, 129) + lzss_match(300, 3) + lzss_match(1, 0x7F + 3)
+        expected = history + history[:129] + (history + history[:129])[-300:][:3]
+        decoder = console_log.LzssDecoder()
+        output = b"".join(decoder.feed(bytes([value])) for value in stream)
+        self.assertEqual(output, expected)
+
+    def test_match_before_start(self):
+        with self.assertRaises(ValueError):
+            console_log.LzssDecoder().feed(bytes([0b00000001]) + b"a" + lzss_match(2, 3))
+
+
+class TableTest(unittest.TestCase):
+
+    def test_extract(self):
+        header = ('//CONSOLE_LOG_STRING(CONSOLE_LOG_COMMENT, "no")\n'
+                  'CONSOLE_LOG_STRING(CONSOLE_LOG_A,\n    "one\\r\\n"\n    "%u\\r\\n")\n'
+                  'CONSOLE_LOG_STRING(CONSOLE_LOG_B, "two")\n')
+        self.assertEqual(console_log.extract_table(header),
+                         [("CONSOLE_LOG_A", "one\r\n%u\r\n"), ("CONSOLE_LOG_B", "two")])
+
+
+if __name__ == "__main__":
+    unittest.main()